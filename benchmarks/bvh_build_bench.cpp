@@ -0,0 +1,206 @@
+// BVH build benchmark: build time and SAH cost of the mesh BVH of every .off under assets/models3D, with the
+// binned SAH builder of BVH against the previous builder (a few evenly spaced planes per axis, each evaluated
+// by a pass over the node's triangles, with the squared box diagonal as cost)
+// Usage (from the repository root): bvh_build_bench [models dir] [repetitions]
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../src/core/shapes/Mesh.h"
+
+namespace fs = std::filesystem;
+
+// The builder used before the binned SAH one, kept as the reference point
+class LegacyBuilder
+{
+public:
+    struct Node
+    {
+        AABB box;
+        int start;
+        int count; // > 0 for a leaf, children at start and start + 1 otherwise
+    };
+
+    std::vector<Node> nodes;
+
+    LegacyBuilder(const std::vector<vec3> &positions, const std::vector<unsigned int> &indices)
+    {
+        AABB rootBox;
+        for (size_t t = 0; t < indices.size() / 3; ++t)
+        {
+            Triangle tri;
+            const vec3 &v0 = positions[indices[3 * t]];
+            const vec3 &v1 = positions[indices[3 * t + 1]];
+            const vec3 &v2 = positions[indices[3 * t + 2]];
+            tri.center = (v0 + v1 + v2) / 3.0f;
+            tri.box.GrowToInclude(v0);
+            tri.box.GrowToInclude(v1);
+            tri.box.GrowToInclude(v2);
+            rootBox.GrowToInclude(tri.box.minPoint);
+            rootBox.GrowToInclude(tri.box.maxPoint);
+            triangles.push_back(tri);
+        }
+        nodes.reserve(2 * triangles.size());
+        nodes.push_back({rootBox, 0, 0});
+        split(0, 0, static_cast<int>(triangles.size()), 0);
+    }
+
+private:
+    struct Triangle
+    {
+        vec3 center;
+        AABB box;
+    };
+    std::vector<Triangle> triangles;
+
+    static float axisOf(const vec3 &v, int axis) { return axis == 0 ? v.x : (axis == 1 ? v.y : v.z); }
+
+    static float nodeCost(const vec3 &size, int count)
+    {
+        return count == 0 ? 0.0f : (size.x * size.x + size.y * size.y + size.z * size.z) * count;
+    }
+
+    float evaluate(int axis, float pos, int start, int count, AABB &left, AABB &right, int &numOnLeft) const
+    {
+        left = AABB();
+        right = AABB();
+        numOnLeft = 0;
+        for (int i = start; i < start + count; ++i)
+        {
+            AABB &side = axisOf(triangles[i].center, axis) < pos ? left : right;
+            side.GrowToInclude(triangles[i].box.minPoint);
+            side.GrowToInclude(triangles[i].box.maxPoint);
+            numOnLeft += axisOf(triangles[i].center, axis) < pos;
+        }
+        return nodeCost(left.maxPoint - left.minPoint, numOnLeft) + nodeCost(right.maxPoint - right.minPoint, count - numOnLeft);
+    }
+
+    void split(int nodeIndex, int start, int count, int depth)
+    {
+        AABB box = nodes[nodeIndex].box;
+        vec3 size = box.maxPoint - box.minPoint;
+        float bestCost = FLT_MAX, bestPos = 0.0f;
+        int bestAxis = 0;
+        if (count > 1)
+        {
+            int maxTests = count < 10 ? 3 : 5;
+            float maxAxis = std::max(size.x, std::max(size.y, size.z));
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                int tests = std::max(static_cast<int>(std::ceil(maxTests * (axisOf(size, axis) / maxAxis))), 2);
+                for (int i = 0; i < tests; ++i)
+                {
+                    float pos = axisOf(box.minPoint, axis) + axisOf(size, axis) * (i + 1) / static_cast<float>(tests + 1);
+                    AABB left, right;
+                    int numOnLeft;
+                    float cost = evaluate(axis, pos, start, count, left, right, numOnLeft);
+                    if (cost < bestCost)
+                    {
+                        bestCost = cost;
+                        bestPos = pos;
+                        bestAxis = axis;
+                    }
+                }
+            }
+        }
+
+        if (bestCost < nodeCost(size, count) && depth < MAX_DEPTH)
+        {
+            AABB left, right;
+            int numOnLeft;
+            evaluate(bestAxis, bestPos, start, count, left, right, numOnLeft);
+            std::partition(triangles.begin() + start, triangles.begin() + start + count,
+                           [&](const Triangle &tri) { return axisOf(tri.center, bestAxis) < bestPos; });
+            int child = static_cast<int>(nodes.size());
+            nodes.push_back({left, start, 0});
+            nodes.push_back({right, start + numOnLeft, 0});
+            nodes[nodeIndex].start = child;
+            split(child, start, numOnLeft, depth + 1);
+            split(child + 1, start + numOnLeft, count - numOnLeft, depth + 1);
+        }
+        else
+        {
+            nodes[nodeIndex].start = start;
+            nodes[nodeIndex].count = count;
+        }
+    }
+};
+
+// Same estimate as BVH::sahCost
+static float legacyCost(const std::vector<LegacyBuilder::Node> &nodes)
+{
+    float rootArea = nodes[0].box.SurfaceArea();
+    float cost = 0.0f;
+    for (const LegacyBuilder::Node &node : nodes)
+        cost += node.box.SurfaceArea() * (node.count > 0 ? static_cast<float>(node.count) : 1.0f);
+    return rootArea > 0.0f ? cost / rootArea : 0.0f;
+}
+
+template <typename Build>
+static double timeBuilds(int repetitions, Build build)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repetitions; ++i)
+        build();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / repetitions;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string modelsDir = argc > 1 ? argv[1] : "assets/models3D";
+    int repetitions = argc > 2 ? std::stoi(argv[2]) : 3;
+
+    std::vector<std::string> files;
+    for (const auto &entry : fs::directory_iterator(modelsDir))
+    {
+        if (entry.is_regular_file() && entry.path().extension() == ".off")
+            files.push_back(entry.path().string());
+    }
+    std::sort(files.begin(), files.end());
+    if (files.empty())
+    {
+        std::cerr << "No .off file found under " << modelsDir << std::endl;
+        return 1;
+    }
+
+    // loadOFF is reused on a single mesh so that only the builds are timed
+    Mesh mesh(files.front());
+
+    double totalLegacy = 0.0;
+    double totalBinned = 0.0;
+    for (const std::string &path : files)
+    {
+        if (!mesh.loadOFF(path) || mesh.empty())
+            continue;
+        const std::vector<vec3> &positions = mesh.getPositions();
+        const std::vector<unsigned int> &indices = mesh.getIndices();
+
+        float legacySah = 0.0f;
+        size_t legacyNodes = 0;
+        double legacySeconds = timeBuilds(repetitions, [&]()
+                                          {
+            LegacyBuilder legacy(positions, indices);
+            legacySah = legacyCost(legacy.nodes);
+            legacyNodes = legacy.nodes.size(); });
+        float binnedSah = 0.0f;
+        size_t binnedNodes = 0;
+        double binnedSeconds = timeBuilds(repetitions, [&]()
+                                          {
+            BVH bvh(positions, indices);
+            binnedSah = bvh.sahCost();
+            binnedNodes = bvh.getGPUNodeCount(); });
+
+        std::cout << "  " << path << " (" << mesh.getTriangleCount() << " triangles): legacy " << legacySeconds * 1000.0 << " ms, SAH "
+                  << legacySah << " (" << legacyNodes << " nodes); binned " << binnedSeconds * 1000.0 << " ms, SAH " << binnedSah
+                  << " (" << binnedNodes << " nodes, " << (binnedSeconds > 0.0 ? legacySeconds / binnedSeconds : 0.0) << "x faster)"
+                  << std::endl;
+        totalLegacy += legacySeconds;
+        totalBinned += binnedSeconds;
+    }
+
+    std::cout << "total: legacy " << totalLegacy * 1000.0 << " ms, binned " << totalBinned * 1000.0 << " ms" << std::endl;
+    return 0;
+}
@@ -0,0 +1,70 @@
+// BVH report: quality of the mesh BVH of an .off file (or of every .off under a directory) as built, then after
+// BVH::optimize, with the time each step took
+// Usage (from the repository root): bvh_report [.off file or models dir] [high|spatial]
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../src/core/shapes/Mesh.h"
+
+namespace fs = std::filesystem;
+
+int main(int argc, char *argv[])
+{
+    std::string source = argc > 1 ? argv[1] : "assets/models3D";
+    std::string qualityName = argc > 2 ? argv[2] : "high";
+    if (qualityName != "high" && qualityName != "spatial")
+    {
+        std::cerr << "Unknown BVH quality " << qualityName << " (high or spatial)" << std::endl;
+        return 1;
+    }
+    int quality = qualityName == "spatial" ? QUALITY_SPATIAL : QUALITY_HIGH;
+
+    std::vector<std::string> files;
+    std::error_code error;
+    if (fs::is_directory(source, error))
+    {
+        for (const auto &entry : fs::directory_iterator(source))
+        {
+            if (entry.is_regular_file() && entry.path().extension() == ".off")
+                files.push_back(entry.path().string());
+        }
+        std::sort(files.begin(), files.end());
+    }
+    else
+    {
+        files.push_back(source);
+    }
+    if (files.empty())
+    {
+        std::cerr << "No .off file found under " << source << std::endl;
+        return 1;
+    }
+
+    // loadOFF is reused on a single mesh: the tree is built from the file as is, not placed in a scene
+    Mesh mesh(files.front());
+    for (const std::string &path : files)
+    {
+        if (!mesh.loadOFF(path) || mesh.empty())
+            continue;
+        auto start = std::chrono::steady_clock::now();
+        BVH bvh(mesh.getPositions(), mesh.getIndices(), quality);
+        double buildMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        BVH::Report built = bvh.report();
+
+        start = std::chrono::steady_clock::now();
+        bvh.optimize();
+        double optimizeMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        BVH::Report optimized = bvh.report();
+
+        std::cout << path << " (" << mesh.getTriangleCount() << " triangles)" << std::endl
+                  << "built in " << buildMilliseconds << " ms:" << std::endl
+                  << built.toString() << std::endl
+                  << "optimized in " << optimizeMilliseconds << " ms:" << std::endl
+                  << optimized.toString() << std::endl
+                  << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,216 @@
+// BVH traversal benchmark: the mesh BVH of every .off under assets/models3D built with object splits only
+// (QUALITY_HIGH), the same optimized by node rotations (BVH::optimize) and built with spatial splits
+// (QUALITY_SPATIAL, SBVH), each traced on the host by the same random rays with the kernel's closest hit
+// traversal. Reports build time, size and SAH cost, then the nodes visited and triangles tested per ray; every
+// tree must find the same hits
+// Usage (from the repository root): bvh_traversal_bench [models dir] [rays]
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "../src/core/shapes/Mesh.h"
+
+namespace fs = std::filesystem;
+
+struct Ray
+{
+    vec3 origin;
+    vec3 direction;
+};
+
+struct TraversalStats
+{
+    double nodes = 0.0;     // node boxes tested
+    double triangles = 0.0; // triangles tested
+    std::vector<float> hits; // distance per ray, -1 for a miss
+};
+
+// Slab test, the entry distance if the box is hit closer than tMax
+static bool hitBox(const GPUBVHNode &node, const Ray &ray, const vec3 &inverse, float tMax, float &tEntry)
+{
+    float t0 = 0.0f;
+    float t1 = tMax;
+    const float boxMin[3] = {node.minx, node.miny, node.minz};
+    const float boxMax[3] = {node.maxx, node.maxy, node.maxz};
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        float near = (boxMin[axis] - ray.origin[axis]) * inverse[axis];
+        float far = (boxMax[axis] - ray.origin[axis]) * inverse[axis];
+        if (near > far)
+            std::swap(near, far);
+        t0 = std::max(t0, near);
+        t1 = std::min(t1, far);
+    }
+    tEntry = t0;
+    return t0 <= t1;
+}
+
+// Moller-Trumbore, as in the kernel
+static float hitTriangle(const GPUTriangle &tri, const Ray &ray)
+{
+    vec3 v0(tri.v0.x, tri.v0.y, tri.v0.z);
+    vec3 edge1 = vec3(tri.v1.x, tri.v1.y, tri.v1.z) - v0;
+    vec3 edge2 = vec3(tri.v2.x, tri.v2.y, tri.v2.z) - v0;
+    vec3 p = vec3::cross(ray.direction, edge2);
+    float det = vec3::dot(edge1, p);
+    if (std::fabs(det) < 1e-12f)
+        return -1.0f;
+    float inverseDet = 1.0f / det;
+    vec3 s = ray.origin - v0;
+    float u = vec3::dot(s, p) * inverseDet;
+    if (u < 0.0f || u > 1.0f)
+        return -1.0f;
+    vec3 q = vec3::cross(s, edge1);
+    float v = vec3::dot(ray.direction, q) * inverseDet;
+    if (v < 0.0f || u + v > 1.0f)
+        return -1.0f;
+    float t = vec3::dot(edge2, q) * inverseDet;
+    return t > 1e-6f ? t : -1.0f;
+}
+
+// Closest hit: nearest child first, boxes farther than the current hit skipped
+static TraversalStats trace(const BVH &bvh, const std::vector<Ray> &rays)
+{
+    TraversalStats stats;
+    stats.hits.reserve(rays.size());
+    const GPUBVHNode *nodes = bvh.getGPUNodes();
+    const GPUTriangle *triangles = bvh.getGPUTriangles();
+    size_t nodeCount = 0;
+    size_t triangleCount = 0;
+    for (const Ray &ray : rays)
+    {
+        vec3 inverse(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+        float closest = FLT_MAX;
+        int stack[64];
+        int top = 0;
+        float entry;
+        nodeCount++;
+        if (hitBox(nodes[0], ray, inverse, closest, entry))
+            stack[top++] = 0;
+        while (top > 0)
+        {
+            const GPUBVHNode &node = nodes[stack[--top]];
+            if (node.triangleCount > 0)
+            {
+                for (int t = node.startIndex; t < node.startIndex + node.triangleCount; ++t)
+                {
+                    triangleCount++;
+                    float distance = hitTriangle(triangles[t], ray);
+                    if (distance > 0.0f && distance < closest)
+                        closest = distance;
+                }
+                continue;
+            }
+            float entries[2];
+            bool hit[2];
+            for (int c = 0; c < 2; ++c)
+            {
+                nodeCount++;
+                hit[c] = hitBox(nodes[node.startIndex + c], ray, inverse, closest, entries[c]);
+            }
+            int first = hit[1] && (!hit[0] || entries[1] < entries[0]) ? 1 : 0;
+            if (hit[1 - first])
+                stack[top++] = node.startIndex + 1 - first;
+            if (hit[first])
+                stack[top++] = node.startIndex + first;
+        }
+        stats.hits.push_back(closest < FLT_MAX ? closest : -1.0f);
+    }
+    stats.nodes = static_cast<double>(nodeCount) / rays.size();
+    stats.triangles = static_cast<double>(triangleCount) / rays.size();
+    return stats;
+}
+
+// Rays from a sphere around the mesh towards points inside its bounds, the same for every build
+static std::vector<Ray> makeRays(const std::vector<vec3> &positions, int count)
+{
+    AABB box;
+    for (const vec3 &position : positions)
+        box.GrowToInclude(position);
+    vec3 center = (box.minPoint + box.maxPoint) * 0.5f;
+    vec3 extent = box.maxPoint - box.minPoint;
+    float radius = extent.length();
+
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<Ray> rays(count);
+    for (Ray &ray : rays)
+    {
+        float z = 2.0f * unit(random) - 1.0f;
+        float phi = 6.2831853f * unit(random);
+        float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+        ray.origin = center + vec3(r * std::cos(phi), r * std::sin(phi), z) * radius;
+        vec3 target = box.minPoint + vec3(unit(random) * extent.x, unit(random) * extent.y, unit(random) * extent.z);
+        ray.direction = target - ray.origin;
+        ray.direction.normalize();
+    }
+    return rays;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string modelsDir = argc > 1 ? argv[1] : "assets/models3D";
+    int rayCount = argc > 2 ? std::stoi(argv[2]) : 100000;
+
+    std::vector<std::string> files;
+    for (const auto &entry : fs::directory_iterator(modelsDir))
+    {
+        if (entry.is_regular_file() && entry.path().extension() == ".off")
+            files.push_back(entry.path().string());
+    }
+    std::sort(files.begin(), files.end());
+    if (files.empty())
+    {
+        std::cerr << "No .off file found under " << modelsDir << std::endl;
+        return 1;
+    }
+
+    // loadOFF is reused on a single mesh so that only the builds are timed
+    Mesh mesh(files.front());
+
+    int mismatches = 0;
+    for (const std::string &path : files)
+    {
+        if (!mesh.loadOFF(path) || mesh.empty())
+            continue;
+        const std::vector<vec3> &positions = mesh.getPositions();
+        const std::vector<unsigned int> &indices = mesh.getIndices();
+        std::vector<Ray> rays = makeRays(positions, rayCount);
+
+        std::cout << path << " (" << mesh.getTriangleCount() << " triangles, " << rays.size() << " rays)" << std::endl;
+        std::vector<float> referenceHits;
+        const char *names[3] = {"object   ", "optimized", "spatial  "};
+        for (int variant = 0; variant < 3; ++variant)
+        {
+            auto start = std::chrono::steady_clock::now();
+            BVH bvh(positions, indices, variant == 2 ? QUALITY_SPATIAL : QUALITY_HIGH);
+            if (variant == 1)
+                bvh.optimize();
+            double buildMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            TraversalStats stats = trace(bvh, rays);
+
+            int missed = 0;
+            if (referenceHits.empty())
+                referenceHits = stats.hits;
+            for (size_t i = 0; i < rays.size(); ++i)
+            {
+                float expected = referenceHits[i];
+                if ((expected < 0.0f) != (stats.hits[i] < 0.0f) || std::fabs(expected - stats.hits[i]) > 1e-4f * std::max(1.0f, expected))
+                    missed++;
+            }
+            mismatches += missed;
+
+            std::cout << "  " << names[variant] << ": " << buildMilliseconds << " ms, "
+                      << bvh.getGPUNodeCount() << " nodes, " << bvh.getGPUTriangleCount() << " references, SAH " << bvh.sahCost()
+                      << "; per ray " << stats.nodes << " nodes, " << stats.triangles << " triangles";
+            if (missed > 0)
+                std::cout << " (" << missed << " hits differ)";
+            std::cout << std::endl;
+        }
+    }
+    return mismatches > 0 ? 1 : 0;
+}
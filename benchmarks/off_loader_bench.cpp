@@ -0,0 +1,115 @@
+// OFF loader benchmark: parse time and throughput of every .off under assets/models3D, with the
+// memory-mapped from_chars parser of Mesh::loadOFF against the previous iostream parser
+// Usage (from the repository root): off_loader_bench [models dir] [repetitions]
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../src/core/shapes/Mesh.h"
+
+namespace fs = std::filesystem;
+
+// The parser used before the memory-mapped loader, kept as the reference point (triangles only)
+static bool legacyLoad(const std::string &filename, std::vector<vec3> &positions, std::vector<unsigned int> &indices)
+{
+    std::ifstream in(filename.c_str());
+    if (!in)
+        return false;
+
+    std::string offString;
+    unsigned int sizeV, sizeT, tmp;
+    in >> offString >> sizeV >> sizeT >> tmp;
+    positions.resize(sizeV);
+    indices.resize(3 * sizeT);
+
+    for (unsigned int i = 0; i < sizeV; ++i)
+    {
+        float x, y, z;
+        in >> x >> y >> z;
+        positions[i] = vec3(x, y, z);
+    }
+
+    for (unsigned int i = 0; i < sizeT; ++i)
+    {
+        unsigned int v0, v1, v2;
+        in >> tmp >> v0 >> v1 >> v2;
+        indices[3 * i] = v0;
+        indices[3 * i + 1] = v1;
+        indices[3 * i + 2] = v2;
+
+        std::string restOfLine;
+        std::getline(in, restOfLine);
+    }
+    return true;
+}
+
+template <typename Loader>
+static double timeLoads(int repetitions, Loader load)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repetitions; ++i)
+        load();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / repetitions;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string modelsDir = argc > 1 ? argv[1] : "assets/models3D";
+    int repetitions = argc > 2 ? std::stoi(argv[2]) : 10;
+
+    std::vector<std::string> files;
+    for (const auto &entry : fs::directory_iterator(modelsDir))
+    {
+        if (entry.is_regular_file() && entry.path().extension() == ".off")
+            files.push_back(entry.path().string());
+    }
+    std::sort(files.begin(), files.end());
+    if (files.empty())
+    {
+        std::cerr << "No .off file found under " << modelsDir << std::endl;
+        return 1;
+    }
+
+    // loadOFF is reused on a single mesh so that only parsing is timed
+    Mesh mesh(files.front());
+
+    double totalLegacy = 0.0;
+    double totalMapped = 0.0;
+    double totalMegabytes = 0.0;
+    for (const std::string &path : files)
+    {
+        double megabytes = static_cast<double>(fs::file_size(path)) / (1024.0 * 1024.0);
+
+        std::vector<vec3> positions;
+        std::vector<unsigned int> legacyIndices;
+        double legacySeconds = timeLoads(repetitions, [&]()
+                                         { legacyLoad(path, positions, legacyIndices); });
+        bool loaded = true;
+        double mappedSeconds = timeLoads(repetitions, [&]()
+                                         { loaded = mesh.loadOFF(path); });
+
+        // The legacy parser keeps the first triangle of polygon faces, the new one triangulates them
+        bool same = loaded && mesh.getVertexCount() == positions.size();
+        for (size_t i = 0; same && i < positions.size(); ++i)
+        {
+            const vec3 &a = mesh.getVertexPosition(i);
+            same = a.x == positions[i].x && a.y == positions[i].y && a.z == positions[i].z;
+        }
+
+        std::cout << "  " << path << " (" << positions.size() << " vertices, " << legacyIndices.size() / 3 << " faces -> "
+                  << mesh.getTriangleCount() << " triangles, " << megabytes << " MB): iostream " << legacySeconds * 1000.0
+                  << " ms (" << megabytes / legacySeconds << " MB/s), mapped " << mappedSeconds * 1000.0 << " ms ("
+                  << megabytes / mappedSeconds << " MB/s, " << (mappedSeconds > 0.0 ? legacySeconds / mappedSeconds : 0.0) << "x)"
+                  << (same ? "" : " MISMATCH") << std::endl;
+        totalLegacy += legacySeconds;
+        totalMapped += mappedSeconds;
+        totalMegabytes += megabytes;
+    }
+
+    std::cout << "total: iostream " << totalLegacy * 1000.0 << " ms (" << totalMegabytes / totalLegacy << " MB/s), mapped "
+              << totalMapped * 1000.0 << " ms (" << totalMegabytes / totalMapped << " MB/s)" << std::endl;
+    return 0;
+}
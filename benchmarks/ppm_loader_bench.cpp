@@ -0,0 +1,162 @@
+// PPM loader benchmark: load time and throughput of every .ppm under assets/, with the
+// memory-mapped loader (copied into an ImageRGB, and used in place through PPMFile) against the
+// previous iostream parser, in binary (P6) and ASCII (P3) form
+// The ASCII copies are written to a temporary directory from the decoded assets
+// Usage (from the repository root): ppm_loader_bench [assets dir] [repetitions]
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../src/core/utils/imageLoader/ImageLoader.h"
+
+namespace fs = std::filesystem;
+
+// The parser used before the memory-mapped loader, kept as the reference point
+static void legacyLoad(ppmLoader::ImageRGB &img, const std::string &name)
+{
+    img.w = 0;
+    img.h = 0;
+    img.data.clear();
+    std::ifstream f(name.c_str(), std::ios::binary);
+    if (f.fail())
+        return;
+
+    ppmLoader::eat_comment(f);
+    std::string magic;
+    f >> magic;
+    ppmLoader::eat_comment(f);
+    f >> img.w;
+    ppmLoader::eat_comment(f);
+    f >> img.h;
+    ppmLoader::eat_comment(f);
+    int bits = 0;
+    f >> bits;
+
+    img.data.resize(static_cast<size_t>(img.w) * img.h);
+    if (magic == "P6")
+    {
+        f.get();
+        f.read(reinterpret_cast<char *>(&img.data[0]), img.data.size() * 3);
+    }
+    else
+    {
+        for (auto &pixel : img.data)
+        {
+            int v;
+            f >> v;
+            pixel.r = v;
+            f >> v;
+            pixel.g = v;
+            f >> v;
+            pixel.b = v;
+        }
+    }
+}
+
+static void writeAscii(const ppmLoader::ImageRGB &img, const std::string &path)
+{
+    FILE *f = std::fopen(path.c_str(), "w");
+    if (!f)
+        return;
+    std::fprintf(f, "P3\n%d %d\n255\n", img.w, img.h);
+    for (const auto &pixel : img.data)
+        std::fprintf(f, "%d %d %d\n", pixel.r, pixel.g, pixel.b);
+    std::fclose(f);
+}
+
+template <typename Loader>
+static double timeLoads(const std::string &path, int repetitions, Loader load)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repetitions; ++i)
+        load(path);
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / repetitions;
+}
+
+static void runBenchmark(const std::string &label, const std::vector<std::string> &files, int repetitions)
+{
+    double totalLegacy = 0.0;
+    double totalMapped = 0.0;
+    double totalSpan = 0.0;
+    double totalMegabytes = 0.0;
+    size_t mismatches = 0;
+
+    std::cout << "=== " << label << " ===" << std::endl;
+    for (const std::string &path : files)
+    {
+        double megabytes = static_cast<double>(fs::file_size(path)) / (1024.0 * 1024.0);
+
+        ppmLoader::ImageRGB legacy;
+        ppmLoader::ImageRGB mapped;
+        double legacySeconds = timeLoads(path, repetitions, [&legacy](const std::string &p)
+                                         { legacyLoad(legacy, p); });
+        double mappedSeconds = timeLoads(path, repetitions, [&mapped](const std::string &p)
+                                         { ppmLoader::load_ppm(mapped, p); });
+        // Pixels used in place through PPMFile (no copy into an ImageRGB for P6)
+        double spanSeconds = timeLoads(path, repetitions, [](const std::string &p)
+                                       { ppmLoader::PPMFile file;
+                                         file.open(p); });
+
+        bool same = legacy.w == mapped.w && legacy.h == mapped.h &&
+                    std::equal(legacy.data.begin(), legacy.data.end(), mapped.data.begin(), [](const ppmLoader::RGB &a, const ppmLoader::RGB &b)
+                               { return a.r == b.r && a.g == b.g && a.b == b.b; });
+        if (!same)
+            mismatches++;
+
+        std::cout << "  " << path << " (" << mapped.w << "x" << mapped.h << ", " << megabytes << " MB): iostream "
+                  << legacySeconds * 1000.0 << " ms, mapped " << mappedSeconds * 1000.0 << " ms ("
+                  << (mappedSeconds > 0.0 ? legacySeconds / mappedSeconds : 0.0) << "x), span " << spanSeconds * 1000.0 << " ms"
+                  << (same ? "" : " MISMATCH") << std::endl;
+        totalLegacy += legacySeconds;
+        totalMapped += mappedSeconds;
+        totalSpan += spanSeconds;
+        totalMegabytes += megabytes;
+    }
+
+    std::cout << "  total: iostream " << totalLegacy * 1000.0 << " ms (" << (totalLegacy > 0.0 ? totalMegabytes / totalLegacy : 0.0) << " MB/s), mapped "
+              << totalMapped * 1000.0 << " ms (" << (totalMapped > 0.0 ? totalMegabytes / totalMapped : 0.0) << " MB/s), span "
+              << totalSpan * 1000.0 << " ms, "
+              << mismatches << " mismatching files" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string assetsDir = argc > 1 ? argv[1] : "assets";
+    int repetitions = argc > 2 ? std::stoi(argv[2]) : 5;
+
+    std::vector<std::string> binaryFiles;
+    for (const auto &entry : fs::recursive_directory_iterator(assetsDir))
+    {
+        if (entry.is_regular_file() && entry.path().extension() == ".ppm")
+            binaryFiles.push_back(entry.path().string());
+    }
+    std::sort(binaryFiles.begin(), binaryFiles.end());
+    if (binaryFiles.empty())
+    {
+        std::cerr << "No .ppm file found under " << assetsDir << std::endl;
+        return 1;
+    }
+
+    // ASCII copies of the same images
+    fs::path asciiDir = fs::temp_directory_path() / "ppm_loader_bench";
+    fs::create_directories(asciiDir);
+    std::vector<std::string> asciiFiles;
+    for (size_t i = 0; i < binaryFiles.size(); ++i)
+    {
+        ppmLoader::ImageRGB img;
+        ppmLoader::load_ppm(img, binaryFiles[i]);
+        std::string asciiPath = (asciiDir / (std::to_string(i) + "_" + fs::path(binaryFiles[i]).filename().string())).string();
+        writeAscii(img, asciiPath);
+        asciiFiles.push_back(asciiPath);
+    }
+
+    runBenchmark("P6 (binary) assets", binaryFiles, repetitions);
+    runBenchmark("P3 (ASCII) copies", asciiFiles, repetitions);
+
+    fs::remove_all(asciiDir);
+    return 0;
+}
@@ -0,0 +1,59 @@
+// Ray sorting benchmark: traversal rays/sec of the wavefront path with and without
+// secondary-ray sorting, on a JSON scene and on a large mesh
+// Usage (from the repository root): ray_sorting_bench [scene.json] [mesh.off] [width] [height] [frames]
+#include <QCoreApplication>
+#include <iostream>
+#include <string>
+#include "../src/core/systems/RenderEngine/RenderEngine.h"
+#include "../src/core/systems/SceneManager/SceneManager.h"
+#include "../src/core/systems/FileManager/FileManager.h"
+
+static void runBenchmark(RenderEngine &renderEngine, const std::string &label, int width, int height, int frames)
+{
+    RaySortingStats unsortedStats;
+    RaySortingStats sortedStats;
+
+    std::cout << "=== " << label << " ===" << std::endl;
+    renderEngine.notifySceneChanged();
+    renderEngine.benchmarkRaySorting(width, height, frames, unsortedStats, sortedStats);
+
+    double speedup = unsortedStats.raysPerSecond() > 0.0 ? sortedStats.raysPerSecond() / unsortedStats.raysPerSecond() : 0.0;
+    double speedupWithSort = unsortedStats.raysPerSecond() > 0.0 ? sortedStats.raysPerSecondWithSort() / unsortedStats.raysPerSecond() : 0.0;
+    std::cout << "  traversal speedup: " << speedup << "x, end-to-end speedup: " << speedupWithSort << "x" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    std::string scenePath = argc > 1 ? argv[1] : "saves/exampleScenes/multiBoule.json";
+    std::string meshPath = argc > 2 ? argv[2] : "assets/models3D/SeaMonster.off";
+    int width = argc > 3 ? std::stoi(argv[3]) : 1280;
+    int height = argc > 4 ? std::stoi(argv[4]) : 720;
+    int frames = argc > 5 ? std::stoi(argv[5]) : 16;
+
+    try
+    {
+        // The SceneManager builds its first scene from the FileManager state
+        FileManager &fileManager = FileManager::getInstance();
+        fileManager.setIsNewProjectSelected(false);
+        fileManager.setActualProjectPath(scenePath);
+
+        SceneManager &sceneManager = SceneManager::getInstance();
+        RenderEngine renderEngine;
+        runBenchmark(renderEngine, scenePath, width, height, frames);
+
+        // Default scene with the mesh added on top, as done from the scene panel
+        fileManager.setIsNewProjectSelected(true);
+        sceneManager.buildScene();
+        sceneManager.addShape(new Mesh(meshPath));
+        runBenchmark(renderEngine, meshPath, width, height, frames);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Benchmark failed: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
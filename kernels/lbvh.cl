@@ -0,0 +1,257 @@
+// Linear BVH builder (Karras 2012, "Maximizing Parallelism in the Construction of BVHs, Octrees, and k-d Trees")
+// Builds the BVH of a mesh from the geometry already on the device, in the GPUBVHNode layout traced by intersect_bvh:
+// Morton codes of the triangle centroids -> radix sort (radixSort.cl) -> hierarchy -> bottom-up bounds
+// One triangle per leaf; the children of internal node i are stored at 1 + 2i and 2 + 2i, the root at 0
+// Host side: src/core/systems/RenderEngine/LBVHBuilder.cpp
+
+#define LBVH_GROUP_SIZE 256
+#define MORTON_AXIS_BITS 10
+
+// Must match VertexFormat (Defines.h)
+#define VERTEX_TRIANGLES 0
+#define VERTEX_FLOAT 1
+#define VERTEX_QUANTIZED 2
+
+// Match CPU-side Vec3, GPUTriangle and GPUBVHNode exactly (see rayTrace.cl)
+typedef struct {
+	float x, y, z;
+	float _padding;
+} Vec3;
+
+typedef struct __attribute__((aligned(16))) {
+	Vec3 v0;                // 16 bytes (offset 0)
+	Vec3 v1;                // 16 bytes (offset 16)
+	Vec3 v2;                // 16 bytes (offset 32)
+	int materialIndex;      // 4 bytes (offset 48)
+	float _padding[3];      // 12 bytes (offset 52)
+} GPUTriangle;  // Total: 64 bytes
+
+typedef struct __attribute__((aligned(16))) {
+	float boundingBoxMin[3]; // 12 bytes (offset 0)
+	float _padding1;         // 4 bytes (offset 12)
+	float boundingBoxMax[3]; // 12 bytes (offset 16)
+	float _padding2;         // 4 bytes (offset 28)
+	int startIndex;          // 4 bytes (offset 32)
+	int triangleCount;       // 4 bytes (offset 36)
+	float _padding3;         // 4 bytes (offset 40)
+	float _padding4;         // 4 bytes (offset 44)
+} GPUBVHNode;  // Total: 48 bytes
+
+// Geometry of the mesh being built, as described by its GPUBVH
+typedef struct {
+	__global const GPUTriangle* triangles; // VERTEX_TRIANGLES
+	__global const ushort* vertices;       // indexed layouts (float3 or 4 ushorts per vertex)
+	__global const uint* indices;          // indexed layouts
+	int triangleOffset;
+	int vertexOffset;
+	int vertexFormat;
+	float3 quantizationOrigin;
+	float3 quantizationStep;
+} MeshGeometry;
+
+float3 lbvh_vertex(const MeshGeometry* mesh, uint index)
+{
+	uint vertex = (uint)mesh->vertexOffset + index;
+	if (mesh->vertexFormat == VERTEX_QUANTIZED) {
+		return mesh->quantizationOrigin + convert_float3(vload4(vertex, mesh->vertices).xyz) * mesh->quantizationStep;
+	}
+	return vload3(vertex, (__global const float*)mesh->vertices);
+}
+
+// Vertices of a triangle of the mesh, as intersect_bvh reads them
+void lbvh_triangle(const MeshGeometry* mesh, uint triangle, float3* v0, float3* v1, float3* v2)
+{
+	uint index = (uint)mesh->triangleOffset + triangle;
+	if (mesh->vertexFormat == VERTEX_TRIANGLES) {
+		__global const GPUTriangle* t = &mesh->triangles[index];
+		*v0 = (float3)(t->v0.x, t->v0.y, t->v0.z);
+		*v1 = (float3)(t->v1.x, t->v1.y, t->v1.z);
+		*v2 = (float3)(t->v2.x, t->v2.y, t->v2.z);
+		return;
+	}
+	uint3 face = vload3(index, mesh->indices);
+	*v0 = lbvh_vertex(mesh, face.x);
+	*v1 = lbvh_vertex(mesh, face.y);
+	*v2 = lbvh_vertex(mesh, face.z);
+}
+
+#define MESH_GEOMETRY_ARGS \
+	__global const GPUTriangle* triangles, __global const ushort* vertices, __global const uint* indices, \
+	int triangleOffset, int vertexOffset, int vertexFormat, float4 quantizationOrigin, float4 quantizationStep
+
+#define MESH_GEOMETRY \
+	{ triangles, vertices, indices, triangleOffset, vertexOffset, vertexFormat, quantizationOrigin.xyz, quantizationStep.xyz }
+
+// Bounds of the triangle centroids, launched as a single work-group: bounds[0] = min, bounds[1] = max
+__kernel void lbvh_centroid_bounds(MESH_GEOMETRY_ARGS, int triangleCount, __global float4* bounds)
+{
+	__local float3 localMin[LBVH_GROUP_SIZE];
+	__local float3 localMax[LBVH_GROUP_SIZE];
+
+	const MeshGeometry mesh = MESH_GEOMETRY;
+	const int lid = get_local_id(0);
+	float3 centroidMin = (float3)(FLT_MAX);
+	float3 centroidMax = (float3)(-FLT_MAX);
+	for (int t = lid; t < triangleCount; t += LBVH_GROUP_SIZE) {
+		float3 v0, v1, v2;
+		lbvh_triangle(&mesh, (uint)t, &v0, &v1, &v2);
+		float3 centroid = (v0 + v1 + v2) / 3.0f;
+		centroidMin = fmin(centroidMin, centroid);
+		centroidMax = fmax(centroidMax, centroid);
+	}
+	localMin[lid] = centroidMin;
+	localMax[lid] = centroidMax;
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	for (int offset = LBVH_GROUP_SIZE / 2; offset > 0; offset >>= 1) {
+		if (lid < offset) {
+			localMin[lid] = fmin(localMin[lid], localMin[lid + offset]);
+			localMax[lid] = fmax(localMax[lid], localMax[lid + offset]);
+		}
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+
+	if (lid == 0) {
+		bounds[0] = (float4)(localMin[0], 0.0f);
+		bounds[1] = (float4)(localMax[0], 0.0f);
+	}
+}
+
+// Spread the low 10 bits of v to every third bit
+uint expand_bits(uint v)
+{
+	v = (v * 0x00010001u) & 0xFF0000FFu;
+	v = (v * 0x00000101u) & 0x0F00F00Fu;
+	v = (v * 0x00000011u) & 0xC30C30C3u;
+	v = (v * 0x00000005u) & 0x49249249u;
+	return v;
+}
+
+// 30-bit Morton code of each centroid within the centroid bounds, the triangle index as value
+__kernel void lbvh_morton_codes(MESH_GEOMETRY_ARGS, int triangleCount, __global const float4* bounds,
+                                __global uint* keys, __global uint* values)
+{
+	const int t = get_global_id(0);
+	if (t >= triangleCount) return;
+
+	const MeshGeometry mesh = MESH_GEOMETRY;
+	float3 v0, v1, v2;
+	lbvh_triangle(&mesh, (uint)t, &v0, &v1, &v2);
+	float3 centroid = (v0 + v1 + v2) / 3.0f;
+
+	float3 boundsMin = bounds[0].xyz;
+	float3 extent = bounds[1].xyz - boundsMin;
+	float3 normalized = select((float3)(0.0f), (centroid - boundsMin) / extent, isgreater(extent, (float3)(0.0f)));
+	const float scale = (float)(1 << MORTON_AXIS_BITS);
+	uint3 cell = convert_uint3(clamp(normalized * scale, 0.0f, scale - 1.0f));
+
+	keys[t] = (expand_bits(cell.x) << 2) | (expand_bits(cell.y) << 1) | expand_bits(cell.z);
+	values[t] = (uint)t;
+}
+
+// Length of the common prefix of sorted keys i and j, -1 out of range (equal keys fall back to their indices)
+int common_prefix(__global const uint* keys, int count, int i, int j)
+{
+	if (j < 0 || j >= count) return -1;
+	uint ki = keys[i];
+	uint kj = keys[j];
+	if (ki == kj) return 32 + clz((uint)i ^ (uint)j);
+	return clz(ki ^ kj);
+}
+
+// One work-item per internal node (count - 1 of them): find the range of leaves it covers and where it splits
+// parents/slots: internal node i at i, leaf j at count - 1 + j; the slot is the node's index in the output
+// Also clears the arrival counters of lbvh_bounds
+__kernel void lbvh_hierarchy(__global const uint* keys, int count, __global int* parents, __global int* slots,
+                             __global uint* counters)
+{
+	const int i = get_global_id(0);
+	if (i == 0) {
+		parents[0] = -1; // the root, internal node 0 (or leaf 0 of a single triangle)
+		slots[0] = 0;
+	}
+	if (i >= count - 1) return;
+	counters[i] = 0u;
+
+	// Direction of the range: towards the neighbour sharing the longer prefix
+	int d = common_prefix(keys, count, i, i + 1) - common_prefix(keys, count, i, i - 1) >= 0 ? 1 : -1;
+	int minPrefix = common_prefix(keys, count, i, i - d);
+
+	// Upper bound of the range length, then binary search of the other end
+	int maxLength = 2;
+	while (common_prefix(keys, count, i, i + maxLength * d) > minPrefix)
+		maxLength <<= 1;
+	int length = 0;
+	for (int step = maxLength >> 1; step >= 1; step >>= 1) {
+		if (common_prefix(keys, count, i, i + (length + step) * d) > minPrefix)
+			length += step;
+	}
+	int j = i + length * d;
+
+	// Split: last position sharing more than the range's common prefix with i
+	int nodePrefix = common_prefix(keys, count, i, j);
+	int split = 0;
+	int step = length;
+	do {
+		step = (step + 1) >> 1;
+		if (common_prefix(keys, count, i, i + (split + step) * d) > nodePrefix)
+			split += step;
+	} while (step > 1);
+	int gamma = i + split * d + min(d, 0);
+
+	// Children: leaves when they are the ends of the range, internal nodes otherwise
+	int left = min(i, j) == gamma ? count - 1 + gamma : gamma;
+	int right = max(i, j) == gamma + 1 ? count - 1 + gamma + 1 : gamma + 1;
+	parents[left] = i;
+	parents[right] = i;
+	slots[left] = 1 + 2 * i;
+	slots[right] = 2 + 2 * i;
+}
+
+void write_node(__global GPUBVHNode* node, float3 boxMin, float3 boxMax, int startIndex, int triangleCount)
+{
+	node->boundingBoxMin[0] = boxMin.x;
+	node->boundingBoxMin[1] = boxMin.y;
+	node->boundingBoxMin[2] = boxMin.z;
+	node->_padding1 = 0.0f;
+	node->boundingBoxMax[0] = boxMax.x;
+	node->boundingBoxMax[1] = boxMax.y;
+	node->boundingBoxMax[2] = boxMax.z;
+	node->_padding2 = 0.0f;
+	node->startIndex = startIndex;
+	node->triangleCount = triangleCount;
+	node->_padding3 = 0.0f;
+	node->_padding4 = 0.0f;
+}
+
+// One work-item per leaf: write the leaf, then climb towards the root. The second work-item to reach an
+// internal node (both children written) computes its bounds and goes on, the first one stops there
+__kernel void lbvh_bounds(MESH_GEOMETRY_ARGS, int count, __global const uint* values, __global const int* parents,
+                          __global const int* slots, __global volatile uint* counters, __global GPUBVHNode* nodes, int nodeOffset)
+{
+	const int leaf = get_global_id(0);
+	if (leaf >= count) return;
+
+	const MeshGeometry mesh = MESH_GEOMETRY;
+	const int triangle = (int)values[leaf];
+	float3 v0, v1, v2;
+	lbvh_triangle(&mesh, (uint)triangle, &v0, &v1, &v2);
+	float3 boxMin = fmin(fmin(v0, v1), v2);
+	float3 boxMax = fmax(fmax(v0, v1), v2);
+	write_node(&nodes[nodeOffset + slots[count - 1 + leaf]], boxMin, boxMax, triangle, 1);
+
+	int parent = parents[count - 1 + leaf];
+	while (parent >= 0) {
+		mem_fence(CLK_GLOBAL_MEM_FENCE); // the child written above must be visible before the counter
+		if (atomic_inc(&counters[parent]) == 0u) return;
+
+		volatile __global const GPUBVHNode* left = &nodes[nodeOffset + 1 + 2 * parent];
+		volatile __global const GPUBVHNode* right = left + 1;
+		boxMin = fmin((float3)(left->boundingBoxMin[0], left->boundingBoxMin[1], left->boundingBoxMin[2]),
+		              (float3)(right->boundingBoxMin[0], right->boundingBoxMin[1], right->boundingBoxMin[2]));
+		boxMax = fmax((float3)(left->boundingBoxMax[0], left->boundingBoxMax[1], left->boundingBoxMax[2]),
+		              (float3)(right->boundingBoxMax[0], right->boundingBoxMax[1], right->boundingBoxMax[2]));
+		write_node(&nodes[nodeOffset + slots[parent]], boxMin, boxMax, 1 + 2 * parent, 0);
+		parent = parents[parent];
+	}
+}
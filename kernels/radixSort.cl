@@ -0,0 +1,102 @@
+// LSD radix sort of (key, value) pairs of 32-bit unsigned integers
+// One pass sorts RADIX_BITS bits: histogram -> scan -> stable scatter
+// Host side: src/core/systems/RenderEngine/RadixSort.cpp
+
+#define RADIX_BITS 4
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define RADIX_MASK (RADIX_BUCKETS - 1)
+#define RADIX_GROUP_SIZE 256
+
+// Inclusive Hillis-Steele scan of RADIX_GROUP_SIZE values in local memory
+void local_inclusive_scan(__local uint* data, int lid)
+{
+	for (int offset = 1; offset < RADIX_GROUP_SIZE; offset <<= 1) {
+		uint addend = (lid >= offset) ? data[lid - offset] : 0u;
+		barrier(CLK_LOCAL_MEM_FENCE);
+		data[lid] += addend;
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+}
+
+// Per work-group digit counts, stored bucket-major: histograms[bucket * numGroups + group]
+// so that a single exclusive scan gives every (bucket, group) its global output offset
+__kernel void radix_histogram(__global const uint* keys, int numElements, int shift, __global uint* histograms)
+{
+	__local uint counts[RADIX_BUCKETS];
+
+	const int gid = get_global_id(0);
+	const int lid = get_local_id(0);
+	const int group = get_group_id(0);
+	const int numGroups = get_num_groups(0);
+
+	if (lid < RADIX_BUCKETS) counts[lid] = 0u;
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	if (gid < numElements) {
+		atomic_inc(&counts[(keys[gid] >> shift) & RADIX_MASK]);
+	}
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	if (lid < RADIX_BUCKETS) {
+		histograms[lid * numGroups + group] = counts[lid];
+	}
+}
+
+// In-place exclusive scan of the whole histogram table, launched as a single work-group
+__kernel void radix_scan(__global uint* histograms, int count)
+{
+	__local uint chunk[RADIX_GROUP_SIZE];
+
+	const int lid = get_local_id(0);
+	uint carry = 0u;
+
+	for (int base = 0; base < count; base += RADIX_GROUP_SIZE) {
+		const int index = base + lid;
+		const uint value = (index < count) ? histograms[index] : 0u;
+		chunk[lid] = value;
+		barrier(CLK_LOCAL_MEM_FENCE);
+
+		local_inclusive_scan(chunk, lid);
+
+		if (index < count) {
+			histograms[index] = carry + chunk[lid] - value;
+		}
+		carry += chunk[RADIX_GROUP_SIZE - 1];
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+}
+
+// Stable scatter: rank of an element = global offset of its (digit, group) + number of
+// elements with the same digit before it in the work-group
+__kernel void radix_scatter(__global const uint* keysIn, __global const uint* valuesIn, int numElements, int shift,
+                            __global const uint* histograms, __global uint* keysOut, __global uint* valuesOut)
+{
+	__local uint flags[RADIX_GROUP_SIZE];
+
+	const int gid = get_global_id(0);
+	const int lid = get_local_id(0);
+	const int group = get_group_id(0);
+	const int numGroups = get_num_groups(0);
+
+	const bool valid = gid < numElements;
+	const uint key = valid ? keysIn[gid] : 0u;
+	const uint digit = (key >> shift) & RADIX_MASK;
+	uint rank = 0u;
+
+	for (uint bucket = 0; bucket < RADIX_BUCKETS; bucket++) {
+		const uint flag = (valid && digit == bucket) ? 1u : 0u;
+		flags[lid] = flag;
+		barrier(CLK_LOCAL_MEM_FENCE);
+
+		local_inclusive_scan(flags, lid);
+
+		if (flag) rank = flags[lid] - 1u;
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+
+	if (valid) {
+		const uint dst = histograms[digit * numGroups + group] + rank;
+		keysOut[dst] = key;
+		valuesOut[dst] = valuesIn[gid];
+	}
+}
@@ -5,11 +5,29 @@
 #define BVH 5
 
 #define EPSILON 0.001f
+#define DIFFUSE_CONE_SPREAD 0.25f // extra ray cone spread (radians) after a diffuse bounce
+#define LOD_TRIANGLES_PER_FOOTPRINT 2.0f // mesh LOD: triangles wanted per ray footprint over the mesh's projected disc (half face away)
+#define SECONDARY_LOD_BIAS 1 // secondary rays use this many levels coarser than their cone asks for
+#define SHADOW_LOD_BIAS 1
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846f
 #endif
 
+#define TEXTURE_RGBA8 0
+#define TEXTURE_BC1 1
+#define TEXTURE_BC4 2
+#define TEXTURE_BC5 3
+#define TEXTURE_R8 4
+
+#define VERTEX_TRIANGLES 0
+#define VERTEX_FLOAT 1
+#define VERTEX_QUANTIZED 2
+
+// GPUMaterial.packed_maps flags (single-channel maps stored in the alpha of another map)
+#define PACK_METAL_IN_NORMAL_ALPHA 1
+#define PACK_EMISSIVE_IN_ALBEDO_ALPHA 2
+
 #define BUFFER_IMAGE 0
 #define BUFFER_ALBEDO 1
 #define BUFFER_DEPTH 2
@@ -41,6 +59,9 @@ float3 vec3_to_float3(Vec3 v) {
 struct Ray{
 	float3 origin;
 	float3 dir;
+	float coneWidth;  // width of the ray cone at the origin (world units), used for texture LOD
+	float coneSpread; // spread angle of the ray cone (radians)
+	int lodBias;      // mesh levels of detail to skip beyond what the cone selects
 };
 
 // Simple random number generator (PCG hash)
@@ -125,14 +146,23 @@ typedef struct __attribute__((aligned(16))) {
 } GPUTriangle;  // Total: 64 bytes
 
 // GPU-compatible BVH header structure (matches CPU-side GPUBVH)
+#define MAX_MESH_LODS 3
 typedef struct __attribute__((aligned(16))) {
-    int node_offset;      // 4 bytes (offset 0)
-    int triangle_offset;  // 4 bytes (offset 4)
-    int node_count;       // 4 bytes (offset 8)
-    int triangle_count;   // 4 bytes (offset 12)
-    int material_index;   // 4 bytes (offset 16)
-    float _padding[11];   // 44 bytes (offset 20)
-} GPUBVH;  // Total: 64 bytes
+    int node_offset;                         // 4 bytes (offset 0)
+    int triangle_offset;                     // 4 bytes (offset 4)
+    int node_count;                          // 4 bytes (offset 8)
+    int triangle_count;                      // 4 bytes (offset 12)
+    int material_index;                      // 4 bytes (offset 16)
+    int lod_count;                           // 4 bytes (offset 20)
+    int lod_node_offset[MAX_MESH_LODS];      // 12 bytes (offset 24)
+    int lod_triangle_offset[MAX_MESH_LODS];  // 12 bytes (offset 36)
+    int lod_triangle_count[MAX_MESH_LODS];   // 12 bytes (offset 48)
+    float lod_hit_offset[MAX_MESH_LODS];     // 12 bytes (offset 60)
+    int vertex_offset;                       // 4 bytes (offset 72)
+    int vertex_format;                       // 4 bytes (offset 76)
+    Vec3 quantization_origin;                // 16 bytes (offset 80)
+    Vec3 quantization_step;                  // 16 bytes (offset 96)
+} GPUBVH;  // Total: 112 bytes
 
 // GPU-compatible AABB structure
 typedef struct __attribute__((aligned(16))) {
@@ -154,6 +184,17 @@ typedef struct __attribute__((aligned(16))) {
 	float _padding4;          // 4 bytes (offset 44) - padding for 16-byte alignment
 } GPUBVHNode;  // Total: 48 bytes
 
+// Match CPU-side GPUTexture exactly: rectangle of one texture inside the atlas image
+typedef struct __attribute__((aligned(16))) {
+	int x;                     // 4 bytes (offset 0)  - first texel column (inside the gutter)
+	int y;                     // 4 bytes (offset 4)  - first texel row (inside the gutter)
+	int width;                 // 4 bytes (offset 8)
+	int height;                // 4 bytes (offset 12)
+	int level_count;           // 4 bytes (offset 16) - mip levels from this one down to 1x1, stored contiguously
+	int format;                // 4 bytes (offset 20) - TEXTURE_RGBA8 (atlas rectangle) or a BC format (x = first block)
+	int _padding[2];           // 8 bytes (offset 24)
+} GPUTexture;  // Total: 32 bytes
+
 typedef struct __attribute__((aligned(16))) {
 	Vec3 ambient;              // 16 bytes (offset 0)
 	Vec3 diffuse;              // 16 bytes (offset 16)
@@ -176,24 +217,25 @@ typedef struct __attribute__((aligned(16))) {
 	int texture_width;         // 4 bytes (offset 104)
 	int texture_height;        // 4 bytes (offset 108)
 
-	int texture_offset;        // 4 bytes (offset 112)
+	int texture_index;         // 4 bytes (offset 112) - index in the texture table, -1 if none
 	int has_normal_map;        // 4 bytes (offset 116)
 	int normal_map_width;      // 4 bytes (offset 120)
 	int normal_map_height;     // 4 bytes (offset 124)
 
-	int normal_map_offset;     // 4 bytes (offset 128)
+	int normal_map_index;      // 4 bytes (offset 128)
 	int has_metal_map;         // 4 bytes (offset 132)
 	int metal_map_width;       // 4 bytes (offset 136)
 	int metal_map_height;      // 4 bytes (offset 140)
 
-	int metal_map_offset;      // 4 bytes (offset 144)
+	int metal_map_index;       // 4 bytes (offset 144)
 	int has_emissive_map;      // 4 bytes (offset 148)
 	int emissive_map_width;    // 4 bytes (offset 152)
 	int emissive_map_height;   // 4 bytes (offset 156)
 
-	int emissive_map_offset;   // 4 bytes (offset 160)
-	int material_id;           // 4 bytes (offset 164)
-	int _padding2[2];          // 8 bytes (offset 168) - padding for 16-byte alignment
+	int emissive_map_index;    // 4 bytes (offset 160)
+	int material_id;           // 4 bytes (offset 164) - its slot in the array, -1 for an unused slot
+	int packed_maps;           // 4 bytes (offset 168) - PACK_* flags
+	int _padding2;             // 4 bytes (offset 172) - padding for 16-byte alignment
 } GPUMaterial;  // Total: 176 bytes
 
 struct Intersection {
@@ -202,6 +244,8 @@ struct Intersection {
 	float3 normal;
 	float2 uv;
 	int hitShapeIndex;
+	float uvDensity;   // UV units per world unit around the hit (from the shape parametrisation)
+	float uvFootprint; // width of the ray cone at the hit in UV units, see compute_texture_footprint
 };
 
 // Match CPU-side GPUShape exactly
@@ -217,103 +261,162 @@ typedef struct __attribute__((aligned(16))) {
 	// int materialID;
 } GPUShape;
 
+// Atlas texels are addressed in pixels; wrapping is done per texture before the fetch
+__constant sampler_t textureSampler = CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP_TO_EDGE | CLK_FILTER_LINEAR;
+
+// Bilinear fetch of one mip level of the atlas. Each rectangle is surrounded by a gutter holding
+// the texels of the opposite edges, so filtering across the seam matches a wrapping sampler
+float4 fetch_atlas_level(read_only image2d_t textureAtlas, GPUTexture level, float2 wrappedUV)
+{
+	float2 coord = (float2)((float)level.x, (float)level.y) + wrappedUV * (float2)((float)level.width, (float)level.height);
+	return read_imagef(textureAtlas, textureSampler, coord);
+}
+
+// BC1 texel: two RGB565 endpoints (x) and 16 2-bit indices (y)
+float3 decode_bc1(uint2 block, int texel)
+{
+	uint c0 = block.x & 0xFFFFu;
+	uint c1 = block.x >> 16;
+	float3 e0 = (float3)((float)(c0 >> 11), (float)((c0 >> 5) & 63u), (float)(c0 & 31u)) / (float3)(31.0f, 63.0f, 31.0f);
+	float3 e1 = (float3)((float)(c1 >> 11), (float)((c1 >> 5) & 63u), (float)(c1 & 31u)) / (float3)(31.0f, 63.0f, 31.0f);
+	uint index = (block.y >> (2 * texel)) & 3u;
+
+	if (c0 > c1) {
+		// 4-colour mode: endpoints and two thirds in between
+		float weights[4] = {0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f};
+		return mix(e0, e1, weights[index]);
+	}
+	if (index == 3u) return (float3)(0.0f, 0.0f, 0.0f);
+	float weights[3] = {0.0f, 1.0f, 0.5f};
+	return mix(e0, e1, weights[index]);
+}
+
+// BC4 texel: two 8-bit endpoints then 16 3-bit indices
+float decode_bc4(uint2 block, int texel)
+{
+	ulong bits = (ulong)block.x | ((ulong)block.y << 32);
+	float r0 = (float)(bits & 0xFFul) / 255.0f;
+	float r1 = (float)((bits >> 8) & 0xFFul) / 255.0f;
+	int index = (int)((bits >> (16 + 3 * texel)) & 7ul);
+
+	if (index == 0) return r0;
+	if (index == 1) return r1;
+	if (r0 > r1) return ((float)(8 - index) * r0 + (float)(index - 1) * r1) / 7.0f;
+	if (index == 6) return 0.0f;
+	if (index == 7) return 1.0f;
+	return ((float)(6 - index) * r0 + (float)(index - 1) * r1) / 5.0f;
+}
+
+// One texel of a level stored in the block buffer (tx, ty already wrapped)
+float4 fetch_block_texel(__global const uint2* textureBlocks, GPUTexture level, int tx, int ty)
+{
+	if (level.format == TEXTURE_R8) {
+		// Row-major bytes, 8 per uint2, little-endian within each word
+		int index = ty * level.width + tx;
+		uint2 pair = textureBlocks[level.x + (index >> 3)];
+		uint word = (index & 4) ? pair.y : pair.x;
+		float value = (float)((word >> (8 * (index & 3))) & 0xFFu) / 255.0f;
+		return (float4)(value, value, value, 1.0f);
+	}
+
+	int tile = (ty >> 2) * ((level.width + 3) >> 2) + (tx >> 2);
+	int texel = ((ty & 3) << 2) | (tx & 3);
+
+	if (level.format == TEXTURE_BC1) {
+		return (float4)(decode_bc1(textureBlocks[level.x + tile], texel), 1.0f);
+	}
+	if (level.format == TEXTURE_BC4) {
+		float value = decode_bc4(textureBlocks[level.x + tile], texel);
+		return (float4)(value, value, value, 1.0f);
+	}
+	// BC5: red and green blocks, blue rebuilt from the unit length of the normal
+	float r = decode_bc4(textureBlocks[level.x + 2 * tile], texel);
+	float g = decode_bc4(textureBlocks[level.x + 2 * tile + 1], texel);
+	float2 n = (float2)(r, g) * 2.0f - 1.0f;
+	float b = sqrt(fmax(1.0f - dot(n, n), 0.0f)) * 0.5f + 0.5f;
+	return (float4)(r, g, b, 1.0f);
+}
+
+// Bilinear fetch of a level stored in the block buffer, wrapping like the atlas gutters do
+float4 fetch_block_level(__global const uint2* textureBlocks, GPUTexture level, float2 wrappedUV)
+{
+	float2 p = wrappedUV * (float2)((float)level.width, (float)level.height) - 0.5f;
+	float2 base = floor(p);
+	float2 t = p - base;
+
+	int x0 = ((int)base.x + level.width) % level.width;
+	int y0 = ((int)base.y + level.height) % level.height;
+	int x1 = (x0 + 1) % level.width;
+	int y1 = (y0 + 1) % level.height;
+
+	float4 top = mix(fetch_block_texel(textureBlocks, level, x0, y0), fetch_block_texel(textureBlocks, level, x1, y0), t.x);
+	float4 bottom = mix(fetch_block_texel(textureBlocks, level, x0, y1), fetch_block_texel(textureBlocks, level, x1, y1), t.x);
+	return mix(top, bottom, t.y);
+}
+
+float4 fetch_texture_level(read_only image2d_t textureAtlas, __global const uint2* textureBlocks, GPUTexture level, float2 wrappedUV)
+{
+	if (level.format == TEXTURE_RGBA8) {
+		return fetch_atlas_level(textureAtlas, level, wrappedUV);
+	}
+	return fetch_block_level(textureBlocks, level, wrappedUV);
+}
+
+// Trilinear fetch: the mip level is chosen so that one texel covers the ray cone footprint
+float4 sample_atlas(read_only image2d_t textureAtlas, __global const GPUTexture* textures, __global const uint2* textureBlocks, int textureIndex, float2 uv, float uvFootprint)
+{
+	GPUTexture base = textures[textureIndex];
+	float2 wrapped = uv - floor(uv);
+
+	float texelFootprint = uvFootprint * sqrt((float)base.width * (float)base.height);
+	float lod = clamp(log2(fmax(texelFootprint, 1e-6f)), 0.0f, (float)(base.level_count - 1));
+	int level = (int)lod;
+	float blend = lod - (float)level;
+
+	float4 color = fetch_texture_level(textureAtlas, textureBlocks, textures[textureIndex + level], wrapped);
+	if (blend > 0.0f) {
+		color = mix(color, fetch_texture_level(textureAtlas, textureBlocks, textures[textureIndex + level + 1], wrapped), blend);
+	}
+	return color;
+}
+
 // Sample texture at UV coordinates
-float3 sample_texture(__global const unsigned char* textureData, int offset, int width, int height, float2 uv)
+float3 sample_texture(read_only image2d_t textureAtlas, __global const GPUTexture* textures, __global const uint2* textureBlocks, int textureIndex, float2 uv, float uvFootprint)
 {
-	if (offset < 0 || width <= 0 || height <= 0) {
+	if (textureIndex < 0) {
 		return (float3)(1.0f, 1.0f, 1.0f); // White default if no texture
 	}
-	
-	// Wrap UV coordinates to [0,1]
-	uv.x = uv.x - floor(uv.x);
-	uv.y = uv.y - floor(uv.y);
-	
-	// Convert UV to pixel coordinates
-	int x = (int)(uv.x * width) % width;
-	int y = (int)(uv.y * height) % height;
-	
-	// Calculate pixel index in texture buffer (RGB = 3 bytes per pixel)
-	int pixelIndex = offset + (y * width + x) * 3;
-	
-	// Read RGB values and normalize to [0,1]
-	float r = (float)textureData[pixelIndex + 0] / 255.0f;
-	float g = (float)textureData[pixelIndex + 1] / 255.0f;
-	float b = (float)textureData[pixelIndex + 2] / 255.0f;
-	
-	return (float3)(r, g, b);
+	return sample_atlas(textureAtlas, textures, textureBlocks, textureIndex, uv, uvFootprint).xyz;
 }
 
-// Sample normal map at UV coordinates
-float3 sample_normal_map(__global const unsigned char* textureData, int offset, int width, int height, float2 uv)
+// Sample normal map at UV coordinates, w keeps the alpha channel (packed metalness, see PACK_METAL_IN_NORMAL_ALPHA)
+float4 sample_normal_map(read_only image2d_t textureAtlas, __global const GPUTexture* textures, __global const uint2* textureBlocks, int textureIndex, float2 uv, float uvFootprint)
 {
-	if (offset < 0 || width <= 0 || height <= 0) {
-		return (float3)(0.0f, 0.0f, 1.0f); // Default normal pointing up
+	if (textureIndex < 0) {
+		return (float4)(0.0f, 0.0f, 1.0f, 1.0f); // Default normal pointing up
 	}
-	
-	// Wrap UV coordinates to [0,1]
-	uv.x = uv.x - floor(uv.x);
-	uv.y = uv.y - floor(uv.y);
-	
-	// Convert UV to pixel coordinates
-	int x = (int)(uv.x * width) % width;
-	int y = (int)(uv.y * height) % height;
-	
-	// Calculate pixel index in texture buffer (RGB = 3 bytes per pixel)
-	int pixelIndex = offset + (y * width + x) * 3;
-	
-	// Read RGB values and normalize to [0,1], then remap to [-1,1]
-	float r = ((float)textureData[pixelIndex + 0] / 255.0f) * 2.0f - 1.0f;
-	float g = ((float)textureData[pixelIndex + 1] / 255.0f) * 2.0f - 1.0f;
-	float b = ((float)textureData[pixelIndex + 2] / 255.0f) * 2.0f - 1.0f;
-	
-	return normalize((float3)(r, g, b));
+	// Remap [0,1] to [-1,1]
+	float4 texel = sample_atlas(textureAtlas, textures, textureBlocks, textureIndex, uv, uvFootprint);
+	return (float4)(normalize(texel.xyz * 2.0f - 1.0f), texel.w);
 }
 
 // Sample metal map at UV coordinates (returns metalness value [0,1])
-float sample_metal_map(__global const unsigned char* textureData, int offset, int width, int height, float2 uv)
+float sample_metal_map(read_only image2d_t textureAtlas, __global const GPUTexture* textures, __global const uint2* textureBlocks, int textureIndex, float2 uv, float uvFootprint)
 {
-	if (offset < 0 || width <= 0 || height <= 0) {
+	if (textureIndex < 0) {
 		return 0.0f; // Default metalness if no map
 	}
-	
-	// Wrap UV coordinates to [0,1]
-	uv.x = uv.x - floor(uv.x);
-	uv.y = uv.y - floor(uv.y);
-	
-	// Convert UV to pixel coordinates
-	int x = (int)(uv.x * width) % width;
-	int y = (int)(uv.y * height) % height;
-	
-	// Calculate pixel index in texture buffer (RGB = 3 bytes per pixel)
-	int pixelIndex = offset + (y * width + x) * 3;
-	
-	// Read red channel and normalize to [0,1] (metalness is typically stored in red channel)
-	float metalness = (float)textureData[pixelIndex + 0] / 255.0f;
-	
-	return metalness;
+	// Metalness is typically stored in red channel
+	return sample_atlas(textureAtlas, textures, textureBlocks, textureIndex, uv, uvFootprint).x;
 }
 
-float sample_emissive_map(__global const unsigned char* textureData, int offset, int width, int height, float2 uv)
+float sample_emissive_map(read_only image2d_t textureAtlas, __global const GPUTexture* textures, __global const uint2* textureBlocks, int textureIndex, float2 uv, float uvFootprint)
 {
-	if (offset < 0 || width <= 0 || height <= 0) {
+	if (textureIndex < 0) {
 		return 0.0f; // Default emissive if no map
 	}
-	
-	// Wrap UV coordinates to [0,1]
-	uv.x = uv.x - floor(uv.x);
-	uv.y = uv.y - floor(uv.y);
-	
-	// Convert UV to pixel coordinates
-	int x = (int)(uv.x * width) % width;
-	int y = (int)(uv.y * height) % height;
-	
-	// Calculate pixel index in texture buffer (RGB = 3 bytes per pixel)
-	int pixelIndex = offset + (y * width + x) * 3;
-	
-	// Read red channel and normalize to [0,1] (emissive is typically stored in red channel)
-	float emissive = (float)textureData[pixelIndex + 0] / 255.0f;
-	
-	return emissive;
+	// Emissive is typically stored in red channel
+	return sample_atlas(textureAtlas, textures, textureBlocks, textureIndex, uv, uvFootprint).x;
 }
 
 // Compute tangent space basis (TBN matrix) for normal mapping
@@ -361,7 +464,8 @@ void compute_tangent_space(__global const GPUShape* shape, struct Intersection i
 }
 
 // Get the final normal including normal map perturbation
-float3 get_perturbed_normal(__global const GPUShape* shape, struct Intersection inter, __global const GPUMaterial* material, __global const unsigned char* textureData)
+// When the metal map is packed in the normal map alpha, metalness is read from the same fetch
+float3 get_perturbed_normal(__global const GPUShape* shape, struct Intersection inter, __global const GPUMaterial* material, read_only image2d_t textureAtlas, __global const GPUTexture* textures, __global const uint2* textureBlocks, float* metalness)
 {
 	float3 geometric_normal = inter.normal;
 	
@@ -370,8 +474,11 @@ float3 get_perturbed_normal(__global const GPUShape* shape, struct Intersection
 	}
 	
 	// Sample normal from normal map (in tangent space)
-	float3 tangent_normal = sample_normal_map(textureData, material->normal_map_offset, 
-	                                         material->normal_map_width, material->normal_map_height, inter.uv);
+	float4 texel = sample_normal_map(textureAtlas, textures, textureBlocks, material->normal_map_index, inter.uv, inter.uvFootprint);
+	float3 tangent_normal = texel.xyz;
+	if (material->packed_maps & PACK_METAL_IN_NORMAL_ALPHA) {
+		*metalness = texel.w;
+	}
 	
 	// Compute tangent space basis
 	float3 tangent, bitangent, normal;
@@ -450,21 +557,21 @@ float fresnel_schlick(float cosI, float n1, float n2)
     return r0 + (1.0f - r0) * x*x*x*x*x;
 }
 
-float3 get_reflected_ray(float3 incident, struct Intersection inter, __global const GPUShape* shape, __global const GPUMaterial* material, __global const unsigned char* textureData, uint* seed)
+float3 get_reflected_ray(float3 incident, struct Intersection inter, __global const GPUShape* shape, __global const GPUMaterial* material, read_only image2d_t textureAtlas, __global const GPUTexture* textures, __global const uint2* textureBlocks, uint* seed)
 {
 	if (material == NULL) {
 		// Default to diffuse reflection
 		return random_hemisphere_direction(inter.normal, seed);
 	}
 	
-	// Get the perturbed normal (includes normal map if available)
-	float3 normal = get_perturbed_normal(shape, inter, material, textureData);
-	
 	// Get metalness value - use metal map if available, otherwise use material metalness
 	float metalness = material->metalness;
-	if (material->has_metal_map) {
-		metalness = sample_metal_map(textureData, material->metal_map_offset, 
-		                            material->metal_map_width, material->metal_map_height, inter.uv);
+
+	// Get the perturbed normal (includes normal map if available, and a packed metal map)
+	float3 normal = get_perturbed_normal(shape, inter, material, textureAtlas, textures, textureBlocks, &metalness);
+	
+	if (material->has_metal_map && !(material->packed_maps & PACK_METAL_IN_NORMAL_ALPHA)) {
+		metalness = sample_metal_map(textureAtlas, textures, textureBlocks, material->metal_map_index, inter.uv, inter.uvFootprint);
 	}
 	
 	// Continuous metalness: blend between diffuse and specular reflection
@@ -481,7 +588,7 @@ float3 get_reflected_ray(float3 incident, struct Intersection inter, __global co
 } 
 
 float3 get_shape_color(__global const GPUShape* shape, __global const GPUMaterial* materials, int numMaterials, 
-                       __global const unsigned char* textureData, float2 uv)
+                       read_only image2d_t textureAtlas, __global const GPUTexture* textures, __global const uint2* textureBlocks, float2 uv, float uvFootprint)
 {
 	int materialIndex = get_shape_material_index(shape, materials, numMaterials);
 	
@@ -494,23 +601,25 @@ float3 get_shape_color(__global const GPUShape* shape, __global const GPUMateria
 	}
 
 	float3 emissive = (material->light_intensity);
-
-	if (material->has_emissive_map) {
-		emissive *= sample_emissive_map(textureData, material->emissive_map_offset, 
-		                                material->emissive_map_width, material->emissive_map_height, uv);
-	}
-
-	emissive = max(emissive, 0.0f);
 	
-	// Get base color (albedo)
+	// Get base color (albedo), its alpha holds the emissive map when packed
 	float3 baseColor;
-	if (material->has_texture) {
-		baseColor = sample_texture(textureData, material->texture_offset, 
-		                          material->texture_width, material->texture_height, uv) + 0.00001f;
+	if (material->packed_maps & PACK_EMISSIVE_IN_ALBEDO_ALPHA) {
+		float4 albedo = sample_atlas(textureAtlas, textures, textureBlocks, material->texture_index, uv, uvFootprint);
+		baseColor = albedo.xyz + 0.00001f;
+		emissive *= albedo.w;
+	} else if (material->has_texture) {
+		baseColor = sample_texture(textureAtlas, textures, textureBlocks, material->texture_index, uv, uvFootprint) + 0.00001f;
 								  // + epsilon prevents invisible textures
 	} else {
 		baseColor = vec3_to_float3(material->diffuse);
 	}
+
+	if (material->has_emissive_map && !(material->packed_maps & PACK_EMISSIVE_IN_ALBEDO_ALPHA)) {
+		emissive *= sample_emissive_map(textureAtlas, textures, textureBlocks, material->emissive_map_index, uv, uvFootprint);
+	}
+
+	emissive = max(emissive, 0.0f);
 	
 	// Add emissive component to base color (emissive is additive, not multiplicative)
 	return baseColor / 2.0f + baseColor / 2.0f * emissive;
@@ -569,6 +678,7 @@ inline __attribute__((always_inline)) struct Intersection intersect_sphere(__glo
 	
 	result.uv = (float2)(0.5f + (atan2(result.normal.z, result.normal.x) / (2.0f * M_PI)),
 	                      0.5f - (asin(result.normal.y) / M_PI)); // Spherical UV mapping
+	result.uvDensity = 1.0f / (M_PI * sphere->radius * 1.41421356f); // u spans 2*PI*r, v spans PI*r
 	return result;
 }
 
@@ -625,19 +735,16 @@ inline __attribute__((always_inline)) struct Intersection intersect_square(__glo
     }
 
     result.uv = (float2)((u_dist / u_length) + 0.5f, 1.0f - ((v_dist / v_length) + 0.5f)); // UV coordinates in [0,1] range
+    result.uvDensity = rsqrt(u_length * v_length);
 
     return result;
 }
 
-inline __attribute__((always_inline)) struct Intersection intersect_triangle(__global const GPUTriangle* restrict triangle, const struct Ray* restrict ray, float* restrict t)
+inline __attribute__((always_inline)) struct Intersection intersect_triangle_vertices(float3 v0, float3 v1, float3 v2, const struct Ray* restrict ray, float* restrict t)
 {
 	struct Intersection result;
 	result.t = -1.0f; /* default to no intersection */
 
-	float3 v0 = vec3_to_float3(triangle->v0);
-	float3 v1 = vec3_to_float3(triangle->v1);
-	float3 v2 = vec3_to_float3(triangle->v2);
-
 	float3 edge1 = v1 - v0;
 	float3 edge2 = v2 - v0;
 	 float3 h = cross(ray->dir, edge2);
@@ -664,12 +771,31 @@ inline __attribute__((always_inline)) struct Intersection intersect_triangle(__g
 
 	result.t = *t;
 	result.hitpoint = ray->origin + ray->dir * (*t);
-	result.normal = normalize(cross(edge1, edge2));
+	float3 faceNormal = cross(edge1, edge2);
+	float doubleArea = length(faceNormal);
+	result.normal = faceNormal / doubleArea;
 	result.uv = (float2)(u, v); // Barycentric coordinates as UV
+	result.uvDensity = rsqrt(doubleArea); // barycentric UV triangle has area 1/2
 
 	return result;
 }
 
+inline __attribute__((always_inline)) struct Intersection intersect_triangle(__global const GPUTriangle* restrict triangle, const struct Ray* restrict ray, float* restrict t)
+{
+	return intersect_triangle_vertices(vec3_to_float3(triangle->v0), vec3_to_float3(triangle->v1), vec3_to_float3(triangle->v2), ray, t);
+}
+
+// Vertex of an indexed mesh (VERTEX_FLOAT or VERTEX_QUANTIZED), index relative to the mesh
+inline __attribute__((always_inline)) float3 fetch_mesh_vertex(__global const GPUBVH* restrict bvh, __global const ushort* restrict meshVertices, uint index)
+{
+	uint vertex = (uint)bvh->vertex_offset + index;
+	if (bvh->vertex_format == VERTEX_QUANTIZED) {
+		float3 q = convert_float3(vload4(vertex, meshVertices).xyz);
+		return vec3_to_float3(bvh->quantization_origin) + q * vec3_to_float3(bvh->quantization_step);
+	}
+	return vload3(vertex, (__global const float*)meshVertices);
+}
+
 inline __attribute__((always_inline)) float intersect_aabb(__global const GPUBVHNode* restrict node, const struct Ray* restrict ray)
 {
 	float3 invDir = 1.0f / ray->dir;
@@ -691,14 +817,56 @@ inline __attribute__((always_inline)) float intersect_aabb(__global const GPUBVH
 	}
 }
 
+// Level of detail of a mesh for a ray: the coarsest level that still has about LOD_TRIANGLES_PER_FOOTPRINT
+// triangles per ray cone footprint over the mesh's bounding sphere, made coarser by the ray's bias
+// Level 0 is the full mesh, levels 1 to lod_count its simplified versions
+inline int select_mesh_lod(__global const GPUBVH* restrict bvh, const GPUBVHNode* restrict root, const struct Ray* restrict ray)
+{
+	if (bvh->lod_count == 0) {
+		return 0;
+	}
+	float3 boxMin = (float3)(root->boundingBoxMin[0], root->boundingBoxMin[1], root->boundingBoxMin[2]);
+	float3 boxMax = (float3)(root->boundingBoxMax[0], root->boundingBoxMax[1], root->boundingBoxMax[2]);
+	float radius = 0.5f * length(boxMax - boxMin);
+	float distance = fmax(length(0.5f * (boxMin + boxMax) - ray->origin) - radius, 0.0f);
+	float footprint = ray->coneWidth + ray->coneSpread * distance;
+
+	int level = 0;
+	if (footprint > 0.0f) {
+		float ratio = radius / footprint;
+		float wanted = LOD_TRIANGLES_PER_FOOTPRINT * M_PI * ratio * ratio;
+		while (level < bvh->lod_count && (float)bvh->lod_triangle_count[level] >= wanted) {
+			level++;
+		}
+	}
+	return min(level + ray->lodBias, bvh->lod_count);
+}
+
 inline __attribute__((always_inline)) struct Intersection intersect_bvh(
 	__global const GPUBVH* restrict bvh,
 	__global const GPUBVHNode* restrict nodes,
 	__global const GPUTriangle* restrict triangles,
+	__global const ushort* restrict meshVertices,
+	__global const uint* restrict meshIndices,
 	const struct Ray* restrict ray)
 {
+	GPUBVHNode rootNode = nodes[bvh->node_offset];
+	int lod = select_mesh_lod(bvh, &rootNode, ray);
+	int nodeOffset = lod == 0 ? bvh->node_offset : bvh->lod_node_offset[lod - 1];
+	int triangleOffset = lod == 0 ? bvh->triangle_offset : bvh->lod_triangle_offset[lod - 1];
+
+	// A ray leaving the full-resolution surface may hit a coarser level just next to its origin: ignore hits
+	// closer than the level's deviation when the ray starts inside the mesh's bounds
+	float minHit = EPSILON;
+	if (lod > 0) {
+		float3 boxMin = (float3)(rootNode.boundingBoxMin[0], rootNode.boundingBoxMin[1], rootNode.boundingBoxMin[2]);
+		float3 boxMax = (float3)(rootNode.boundingBoxMax[0], rootNode.boundingBoxMax[1], rootNode.boundingBoxMax[2]);
+		if (all(ray->origin >= boxMin) && all(ray->origin <= boxMax)) {
+			minHit = fmax(EPSILON, bvh->lod_hit_offset[lod - 1]);
+		}
+	}
 
-	int root = bvh->node_offset;
+	int root = nodeOffset;
 
 	// Stack for iterative BVH traversal
 	int stack[64];
@@ -717,11 +885,19 @@ inline __attribute__((always_inline)) struct Intersection intersect_bvh(
 
 		if (node.triangleCount > 0) {
 			for (int i = 0; i < node.triangleCount; i++) {
-				int triIndex = bvh->triangle_offset + node.startIndex + i;
+				int triIndex = triangleOffset + node.startIndex + i;
 				float t_temp = 1e20;
-				struct Intersection intersection = intersect_triangle(&triangles[triIndex], ray, &t_temp);
+				struct Intersection intersection;
+				if (bvh->vertex_format == VERTEX_TRIANGLES) {
+					intersection = intersect_triangle(&triangles[triIndex], ray, &t_temp);
+				} else {
+					uint3 face = vload3(triIndex, meshIndices);
+					intersection = intersect_triangle_vertices(fetch_mesh_vertex(bvh, meshVertices, face.x),
+					                                           fetch_mesh_vertex(bvh, meshVertices, face.y),
+					                                           fetch_mesh_vertex(bvh, meshVertices, face.z), ray, &t_temp);
+				}
 
-				if (intersection.t > EPSILON && intersection.t < minDst) {
+				if (intersection.t > minHit && intersection.t < minDst) {
 					minDst = intersection.t;
 					hitTriangleIndex = triIndex;
 					closestIntersection = intersection;
@@ -730,8 +906,8 @@ inline __attribute__((always_inline)) struct Intersection intersect_bvh(
 		}
 		else
 		{
-			int leftChildIndex = bvh->node_offset + node.startIndex;
-			int rightChildIndex = bvh->node_offset + node.startIndex + 1;
+			int leftChildIndex = nodeOffset + node.startIndex;
+			int rightChildIndex = nodeOffset + node.startIndex + 1;
 
 			float dstA = intersect_aabb(&nodes[leftChildIndex], ray);
 			float dstB = intersect_aabb(&nodes[rightChildIndex], ray);
@@ -773,7 +949,9 @@ inline __attribute__((always_inline)) struct Intersection intersect_shape(
 	const struct Ray* restrict ray,
 	float* restrict t,
 	__global const GPUBVHNode* restrict nodes,
-	__global const GPUTriangle* restrict triangles)
+	__global const GPUTriangle* restrict triangles,
+	__global const ushort* restrict meshVertices,
+	__global const uint* restrict meshIndices)
 {
 	if (shape->type == SPHERE) {
 		return intersect_sphere(&shape->data.sphere, ray, t);
@@ -782,7 +960,7 @@ inline __attribute__((always_inline)) struct Intersection intersect_shape(
 	} else if (shape->type == TRIANGLE) {
 		return intersect_triangle(&shape->data.triangle, ray, t);
 	} else if (shape->type == MESH || shape->type == BVH) {
-		return intersect_bvh(&shape->data.bvh, nodes, triangles, ray);
+		return intersect_bvh(&shape->data.bvh, nodes, triangles, meshVertices, meshIndices, ray);
 	}
 	struct Intersection result;
 	result.t = -1.0f; /* default to no intersection */
@@ -794,7 +972,9 @@ inline __attribute__((always_inline)) struct Intersection compute_intersection(
 	int numShapes, 
 	const struct Ray* restrict ray,
 	__global const GPUBVHNode* restrict nodes,
-	__global const GPUTriangle* restrict triangles)
+	__global const GPUTriangle* restrict triangles,
+	__global const ushort* restrict meshVertices,
+	__global const uint* restrict meshIndices)
 {
 	float t = 1e20;
 	int hitShapeIndex = -1;
@@ -804,7 +984,7 @@ inline __attribute__((always_inline)) struct Intersection compute_intersection(
 	for (int i = 0; i < numShapes; i++){
 		float t_temp = 1e20;
 		struct Intersection intersection;
-		intersection = intersect_shape(&shapes[i], ray, &t_temp, nodes, triangles);
+		intersection = intersect_shape(&shapes[i], ray, &t_temp, nodes, triangles, meshVertices, meshIndices);
 
 		if (intersection.t > EPSILON && intersection.t < t){
 			t = intersection.t;
@@ -823,12 +1003,14 @@ inline __attribute__((always_inline)) bool compute_shadow(
 	const struct Ray* restrict shadowRay, 
 	float maxDistance,
 	__global const GPUBVHNode* restrict nodes,
-	__global const GPUTriangle* restrict triangles)
+	__global const GPUTriangle* restrict triangles,
+	__global const ushort* restrict meshVertices,
+	__global const uint* restrict meshIndices)
 {
 	for (int i = 0; i < numShapes; i++){
 		float t_temp = 1e20;
 		struct Intersection intersection;
-		intersection = intersect_shape(&shapes[i], shadowRay, &t_temp, nodes, triangles);
+		intersection = intersect_shape(&shapes[i], shadowRay, &t_temp, nodes, triangles, meshVertices, meshIndices);
 
 		if (intersection.t > EPSILON && intersection.t < maxDistance){
 			return true; /* in shadow */
@@ -838,6 +1020,139 @@ inline __attribute__((always_inline)) bool compute_shadow(
 	return false; /* not in shadow */
 }
 
+// Ray cone footprint at the hit converted to UV units, used to pick the texture mip level
+// Grazing angles stretch the footprint on the surface by 1/cos
+void compute_texture_footprint(const struct Ray* ray, struct Intersection* inter)
+{
+	float coneWidth = ray->coneWidth + ray->coneSpread * inter->t;
+	float cosTheta = fmax(fabs(dot(ray->dir, inter->normal)), 0.05f);
+	inter->uvFootprint = coneWidth * inter->uvDensity / cosTheta;
+}
+
+// Trace a single bounce of a path: intersect, shade and prepare the next ray in place
+// Returns false once the path is terminated (miss, negligible throughput or last bounce)
+// Shared by the megakernel (raytrace_iterative) and the wavefront path (wavefront_bounce)
+bool trace_bounce(
+	struct Ray* currentRay,
+	float3* throughput,
+	float3* accumulatedColor,
+	float* currentIOR,
+	int bounce,
+	int maxBounces,
+	__global const GPUShape* shapes, 
+	int numShapes, 
+	const struct Light* lights, 
+	int numLights, 
+	uint* seed, 
+	__global const GPUMaterial* materials, 
+	int numMaterials, 
+	read_only image2d_t textureAtlas, __global const GPUTexture* textures, __global const uint2* textureBlocks,
+	__global const GPUBVHNode* restrict nodes,
+	__global const GPUTriangle* restrict triangles,
+	__global const ushort* restrict meshVertices,
+	__global const uint* restrict meshIndices)
+{
+	struct Intersection intersection = compute_intersection(shapes, numShapes, currentRay, nodes, triangles, meshVertices, meshIndices);
+	
+	if (intersection.t < EPSILON) {
+		// No intersection, could add sky color here
+		return false;
+	}
+	compute_texture_footprint(currentRay, &intersection);
+	float hitConeWidth = currentRay->coneWidth + currentRay->coneSpread * intersection.t;
+
+	float3 diffuse = get_shape_color(&shapes[intersection.hitShapeIndex], materials, numMaterials, textureAtlas, textures, textureBlocks, intersection.uv, intersection.uvFootprint);
+	
+	// Direct lighting contribution
+	float3 directLight = (float3)(0.0f, 0.0f, 0.0f);
+	
+	// Ambient term
+	directLight += diffuse * 0.25f;
+
+	// Direct lighting from light sources
+	for (int i = 0; i < numLights; i++){
+		float3 lightDir = normalize(lights[i].pos - intersection.hitpoint);
+		float dotLN = dot(lightDir, intersection.normal);
+
+		if (dotLN > EPSILON) {
+			struct Ray shadowRay;
+			shadowRay.origin = intersection.hitpoint + intersection.normal * EPSILON * 10.0f;
+			shadowRay.dir = lightDir;
+			shadowRay.coneWidth = hitConeWidth;
+			shadowRay.coneSpread = currentRay->coneSpread;
+			shadowRay.lodBias = SHADOW_LOD_BIAS;
+			float lightDistance = length(lights[i].pos - intersection.hitpoint);
+			
+			if (!compute_shadow(shapes, numShapes, &shadowRay, lightDistance - EPSILON, nodes, triangles, meshVertices, meshIndices)) {
+				// Not in shadow - add full lighting
+				directLight += diffuse * lights[i].color * lights[i].intensity * dotLN;
+			} else {
+				// In shadow - add reduced lighting
+				directLight += diffuse * lights[i].color * lights[i].intensity * dotLN * 0.2f;
+			}
+		}
+	}
+
+	// Add direct lighting modulated by throughput
+	*accumulatedColor += *throughput * directLight;
+
+	// Russian roulette termination for efficiency
+	float maxThroughput = fmax(fmax(throughput->x, throughput->y), throughput->z);
+	if (maxThroughput < 0.01f) return false; // Stop if contribution is too small
+
+	// Last bounce: nothing left to prepare
+	if (bounce >= maxBounces - 1) return false;
+
+	// Prepare next ray
+	__global const GPUMaterial* material = get_material_by_index(get_shape_material_index(&shapes[intersection.hitShapeIndex], materials, numMaterials), materials, numMaterials);
+	if (material && material->transparency > 0.0f) {
+		// Dielectric material - refraction/reflection
+		float3 normal = intersection.normal;
+		float n1 = *currentIOR;
+		float n2 = material->index_medium;
+		bool entering = dot(currentRay->dir, normal) < 0;
+		if (!entering) {
+			normal = -normal;
+			float temp = n1;
+			n1 = n2;
+			n2 = temp;
+		}
+		float eta = n1 / n2;
+		float cosI = -dot(currentRay->dir, normal);
+		cosI = clamp(cosI, 0.0f, 1.0f);
+		float R = fresnel_schlick(cosI, n1, n2);
+		float rand = random_float(seed);
+		float3 newDir;
+		if (rand < R) {
+			// Reflect
+			newDir = reflect(currentRay->dir, normal);
+		} else {
+			// Refract
+			newDir = refract_direction(currentRay->dir, normal, eta);
+			if (length(newDir) < 0.1f) {
+				// Total internal reflection
+				newDir = reflect(currentRay->dir, normal);
+			} else {
+				*currentIOR = n2;
+			}
+		}
+		currentRay->dir = normalize(newDir);
+	} else {
+		// Opaque material - reflection
+		*throughput *= diffuse;
+		float3 newDir = get_reflected_ray(currentRay->dir, intersection, &shapes[intersection.hitShapeIndex], material, textureAtlas, textures, textureBlocks, seed);
+		currentRay->dir = newDir;
+		// Diffuse lobes blur what is seen next: widen the cone (metals keep it mostly as is)
+		float metalness = material ? material->metalness : 0.0f;
+		currentRay->coneSpread += DIFFUSE_CONE_SPREAD * (1.0f - metalness);
+	}
+	// The cone continues from the hit with the width it had reached
+	currentRay->coneWidth = hitConeWidth;
+	currentRay->lodBias = SECONDARY_LOD_BIAS;
+	currentRay->origin = intersection.hitpoint + currentRay->dir * EPSILON * 10.0f;
+	return true;
+}
+
 // Iterative version to avoid recursion issues with Rusticl driver
 // Uses hemisphere sampling for diffuse materials
 float3 raytrace_iterative(
@@ -850,9 +1165,11 @@ float3 raytrace_iterative(
 	uint* seed, 
 	__global const GPUMaterial* materials, 
 	int numMaterials, 
-	__global const unsigned char* textureData,
+	read_only image2d_t textureAtlas, __global const GPUTexture* textures, __global const uint2* textureBlocks,
 	__global const GPUBVHNode* restrict nodes,
-	__global const GPUTriangle* restrict triangles)
+	__global const GPUTriangle* restrict triangles,
+	__global const ushort* restrict meshVertices,
+	__global const uint* restrict meshIndices)
 {
 	float3 accumulatedColor = (float3)(0.0f, 0.0f, 0.0f);
 	float3 throughput = (float3)(1.0f, 1.0f, 1.0f); // Track how much light can pass through
@@ -860,93 +1177,10 @@ float3 raytrace_iterative(
 	struct Ray currentRay = *initialRay;
 	
 	for (int bounce = 0; bounce < maxBounces; bounce++) {
-		struct Intersection intersection = compute_intersection(shapes, numShapes, &currentRay, nodes, triangles);
-		
-		if (intersection.t < EPSILON) {
-			// No intersection, could add sky color here
+		if (!trace_bounce(&currentRay, &throughput, &accumulatedColor, &currentIOR, bounce, maxBounces,
+		                  shapes, numShapes, lights, numLights, seed, materials, numMaterials, textureAtlas, textures, textureBlocks, nodes, triangles, meshVertices, meshIndices)) {
 			break;
 		}
-
-		float3 diffuse = get_shape_color(&shapes[intersection.hitShapeIndex], materials, numMaterials, textureData, intersection.uv);
-		
-		// Direct lighting contribution
-		float3 directLight = (float3)(0.0f, 0.0f, 0.0f);
-		
-		// Ambient term
-		directLight += diffuse * 0.25f;
-
-		// Direct lighting from light sources
-		for (int i = 0; i < numLights; i++){
-			float3 lightDir = normalize(lights[i].pos - intersection.hitpoint);
-			float dotLN = dot(lightDir, intersection.normal);
-
-			if (dotLN > EPSILON) {
-				struct Ray shadowRay;
-				shadowRay.origin = intersection.hitpoint + intersection.normal * EPSILON * 10.0f;
-				shadowRay.dir = lightDir;
-				float lightDistance = length(lights[i].pos - intersection.hitpoint);
-				
-				if (!compute_shadow(shapes, numShapes, &shadowRay, lightDistance - EPSILON, nodes, triangles)) {
-					// Not in shadow - add full lighting
-					directLight += diffuse * lights[i].color * lights[i].intensity * dotLN;
-				} else {
-					// In shadow - add reduced lighting
-					directLight += diffuse * lights[i].color * lights[i].intensity * dotLN * 0.2f;
-				}
-			}
-		}
-
-		// Add direct lighting modulated by throughput
-		accumulatedColor += throughput * directLight;
-
-		// Russian roulette termination for efficiency
-		float maxThroughput = fmax(fmax(throughput.x, throughput.y), throughput.z);
-		if (maxThroughput < 0.01f) break; // Stop if contribution is too small
-
-		// Prepare next ray
-		if (bounce < maxBounces - 1) {
-			__global const GPUMaterial* material = get_material_by_index(get_shape_material_index(&shapes[intersection.hitShapeIndex], materials, numMaterials), materials, numMaterials);
-			if (material && material->transparency > 0.0f) {
-				// Dielectric material - refraction/reflection
-				float3 normal = intersection.normal;
-				float n1 = currentIOR;
-				float n2 = material->index_medium;
-				bool entering = dot(currentRay.dir, normal) < 0;
-				if (!entering) {
-					normal = -normal;
-					float temp = n1;
-					n1 = n2;
-					n2 = temp;
-				}
-				float eta = n1 / n2;
-				float cosI = -dot(currentRay.dir, normal);
-				cosI = clamp(cosI, 0.0f, 1.0f);
-				float R = fresnel_schlick(cosI, n1, n2);
-				float rand = random_float(seed);
-				float3 newDir;
-				if (rand < R) {
-					// Reflect
-					newDir = reflect(currentRay.dir, normal);
-				} else {
-					// Refract
-					newDir = refract_direction(currentRay.dir, normal, eta);
-					if (length(newDir) < 0.1f) {
-						// Total internal reflection
-						newDir = reflect(currentRay.dir, normal);
-					} else {
-						currentIOR = n2;
-					}
-				}
-				currentRay.dir = normalize(newDir);
-				throughput *= (float3)(1.0f, 1.0f, 1.0f);
-			} else {
-				// Opaque material - reflection
-				throughput *= diffuse;
-				float3 newDir = get_reflected_ray(currentRay.dir, intersection, &shapes[intersection.hitShapeIndex], material, textureData, seed);
-				currentRay.dir = newDir;
-			}
-			currentRay.origin = intersection.hitpoint + currentRay.dir * EPSILON * 10.0f;
-		}
 	}
 
 	return accumulatedColor;
@@ -985,19 +1219,66 @@ struct Ray createCamRay(const int x_coord, const int y_coord, const int width, c
 	struct Ray ray;
 	ray.origin = camera_origin;
 	ray.dir = ray_dir;
+	ray.coneWidth = 0.0f;
+	ray.coneSpread = 2.0f * tan_half_fov / (float)height; // angle covered by one pixel
+	ray.lodBias = 0;
 
 	return ray;
 }
 
+// Temporal accumulation and display write, shared by render_kernel and wavefront_resolve
+void write_pixel(__global float* output, __global float* accumBuffer, int work_item_id, float3 outputPixelColor, int frameCount, int denoise)
+{
+	// index *3 for RGB
+	int base_idx = work_item_id * 3;
+	
+	// Temporal accumulation: blend new sample with accumulated samples (only if denoise is enabled)
+	float3 accumulatedColor;
+	if (denoise) {
+		// Denoising enabled: use temporal accumulation
+		if (frameCount == 0) {
+			// First frame: just use current sample
+			accumulatedColor = outputPixelColor;
+		} else {
+			// Progressive accumulation using running average
+			float3 previousAccum = (float3)(accumBuffer[base_idx], 
+			                                 accumBuffer[base_idx + 1], 
+			                                 accumBuffer[base_idx + 2]);
+			
+			// Running average: new_avg = (old_avg * n + new_sample) / (n + 1)
+			float t = (float)frameCount / (float)(frameCount + 1);
+			accumulatedColor = previousAccum * t + outputPixelColor * (1.0f - t);
+		}
+		
+		// Store accumulated color (linear space)
+		accumBuffer[base_idx] = accumulatedColor.x;
+		accumBuffer[base_idx + 1] = accumulatedColor.y;
+		accumBuffer[base_idx + 2] = accumulatedColor.z;
+	} else {
+		// Denoising disabled: use current frame directly
+		accumulatedColor = outputPixelColor;
+	}
+	
+	// Apply post-processing for display
+	float3 displayColor = clamp(accumulatedColor, 0.0f, 1.0f);
+	// Apply gamma correction (gamma = 2.2)
+	//displayColor = pow(displayColor, (float3)(1.0f / 2.2f));
+	
+	output[base_idx] = displayColor.x;     // R
+	output[base_idx + 1] = displayColor.y; // G
+	output[base_idx + 2] = displayColor.z; // B
+}
+
 // __global output -> [R,G,B,R,G,B,...]
 // __global accumBuffer -> accumulates samples over frames [R,G,B,R,G,B,...]
 // frameCount -> number of frames accumulated so far (resets when camera/scene changes)
 __kernel void render_kernel(__global float* output, __global float* accumBuffer, int width, int height, int frameCount, 
                            __global GPUShape* shapes, int numShapes,
                            __global GPUCamera* camera, __global GPUMaterial* materials, int numMaterials,
-                           __global unsigned char* textureData,
+                           read_only image2d_t textureAtlas, __global const GPUTexture* textures, __global const uint2* textureBlocks,
 						   int numBVHNodes, __global const GPUBVHNode* bvhNodes,
-						   int numBVHTriangles, __global const GPUTriangle* bvhTriangles)
+						   int numBVHTriangles, __global const GPUTriangle* bvhTriangles,
+						   __global const ushort* meshVertices, __global const uint* meshIndices)
 {
 	const int work_item_id = get_global_id(0);		/* id of current pixel that we are working with */
 	int x_coord = work_item_id % width;					/* x-coordinate of the pixel */
@@ -1026,29 +1307,32 @@ __kernel void render_kernel(__global float* output, __global float* accumBuffer,
 	
 	float3 outputPixelColor = (float3)(0.0f, 0.0f, 0.0f);
 	if (camera->bufferType == BUFFER_IMAGE) {
-		outputPixelColor = raytrace_iterative(&camray, shapes, numShapes, lights, numLights, maxbounce, &seed, materials, numMaterials, textureData, bvhNodes, bvhTriangles);
+		outputPixelColor = raytrace_iterative(&camray, shapes, numShapes, lights, numLights, maxbounce, &seed, materials, numMaterials, textureAtlas, textures, textureBlocks, bvhNodes, bvhTriangles, meshVertices, meshIndices);
 
 		/* If no intersection found, return background colour */
 		if (outputPixelColor.x == 0.0f && outputPixelColor.y == 0.0f && outputPixelColor.z == 0.0f) {
 			outputPixelColor = (float3)(fy * 0.7f, fy * 0.3f, 0.3f);
 		}
 	} else if (camera->bufferType == BUFFER_ALBEDO) {
-		struct Intersection intersection = compute_intersection(shapes, numShapes, &camray, bvhNodes, bvhTriangles);
+		struct Intersection intersection = compute_intersection(shapes, numShapes, &camray, bvhNodes, bvhTriangles, meshVertices, meshIndices);
 		if (intersection.t > EPSILON) {
-			outputPixelColor = get_shape_color(&shapes[intersection.hitShapeIndex], materials, numMaterials, textureData, intersection.uv);
+			compute_texture_footprint(&camray, &intersection);
+			outputPixelColor = get_shape_color(&shapes[intersection.hitShapeIndex], materials, numMaterials, textureAtlas, textures, textureBlocks, intersection.uv, intersection.uvFootprint);
 		} else {
 			outputPixelColor = (float3)(0.0f, 0.0f, 0.0f);
 		}
 	} else if (camera->bufferType == BUFFER_NORMAL) {
-		struct Intersection intersection = compute_intersection(shapes, numShapes, &camray, bvhNodes, bvhTriangles);
+		struct Intersection intersection = compute_intersection(shapes, numShapes, &camray, bvhNodes, bvhTriangles, meshVertices, meshIndices);
 		if (intersection.t > EPSILON) {
-			float3 normal = get_perturbed_normal(&shapes[intersection.hitShapeIndex], intersection, get_material_by_index(get_shape_material_index(&shapes[intersection.hitShapeIndex], materials, numMaterials), materials, numMaterials), textureData);
+			compute_texture_footprint(&camray, &intersection);
+			float unusedMetalness;
+			float3 normal = get_perturbed_normal(&shapes[intersection.hitShapeIndex], intersection, get_material_by_index(get_shape_material_index(&shapes[intersection.hitShapeIndex], materials, numMaterials), materials, numMaterials), textureAtlas, textures, textureBlocks, &unusedMetalness);
 			outputPixelColor = normal * 0.5f + 0.5f; // Map from [-1,1] to [0,1]
 		} else {
 			outputPixelColor = (float3)(0.0f, 0.0f, 0.0f);
 		}
 	} else if (camera->bufferType == BUFFER_DEPTH) {
-		struct Intersection intersection = compute_intersection(shapes, numShapes, &camray, bvhNodes, bvhTriangles);
+		struct Intersection intersection = compute_intersection(shapes, numShapes, &camray, bvhNodes, bvhTriangles, meshVertices, meshIndices);
 		if (intersection.t > EPSILON) {
 			// Map depth to [0,1] range for visualization
 			float depth = intersection.t;
@@ -1060,43 +1344,189 @@ __kernel void render_kernel(__global float* output, __global float* accumBuffer,
 		}
 	}
 	
-	// index *3 for RGB
-	int base_idx = work_item_id * 3;
-	
-	// Temporal accumulation: blend new sample with accumulated samples (only if denoise is enabled)
-	float3 accumulatedColor;
-	if (camera->denoise) {
-		// Denoising enabled: use temporal accumulation
-		if (frameCount == 0) {
-			// First frame: just use current sample
-			accumulatedColor = outputPixelColor;
-		} else {
-			// Progressive accumulation using running average
-			float3 previousAccum = (float3)(accumBuffer[base_idx], 
-			                                 accumBuffer[base_idx + 1], 
-			                                 accumBuffer[base_idx + 2]);
-			
-			// Running average: new_avg = (old_avg * n + new_sample) / (n + 1)
-			float t = (float)frameCount / (float)(frameCount + 1);
-			accumulatedColor = previousAccum * t + outputPixelColor * (1.0f - t);
-		}
-		
-		// Store accumulated color (linear space)
-		accumBuffer[base_idx] = accumulatedColor.x;
-		accumBuffer[base_idx + 1] = accumulatedColor.y;
-		accumBuffer[base_idx + 2] = accumulatedColor.z;
-	} else {
-		// Denoising disabled: use current frame directly
-		accumulatedColor = outputPixelColor;
+	write_pixel(output, accumBuffer, work_item_id, outputPixelColor, frameCount, camera->denoise);
+}
+
+
+// ---------------------------------------------------------------------------
+// Wavefront path (optional): one kernel launch per bounce so that secondary
+// rays can be reordered between bounces for coherent BVH traversal
+// ---------------------------------------------------------------------------
+
+// Match CPU-side GPUPathState exactly
+typedef struct __attribute__((aligned(16))) {
+	float4 origin;      // 16 bytes (offset 0)  - xyz origin, w = current index of refraction
+	float4 dir;         // 16 bytes (offset 16) - xyz direction
+	float4 throughput;  // 16 bytes (offset 32) - xyz path throughput
+	float4 color;       // 16 bytes (offset 48) - xyz accumulated radiance
+	uint seed;          // 4 bytes (offset 64)  - per-path random state
+	int alive;          // 4 bytes (offset 68)  - 0 once the path has terminated
+	float coneWidth;    // 4 bytes (offset 72)  - ray cone state for texture LOD
+	float coneSpread;   // 4 bytes (offset 76)
+} PathState;  // Total: 80 bytes
+
+#define RAY_KEY_DEAD 0xFFFFFFu
+#define RAY_KEY_ORIGIN_BITS 6   // bits per axis for the origin Morton code (18 bits)
+#define RAY_KEY_DIR_BITS 3      // bits per octahedral axis for the direction (6 bits)
+
+// Spread the 6 low bits of v so that there are two zero bits between each
+uint morton_expand_6bits(uint v)
+{
+	v &= 0x3Fu;
+	v = (v | (v << 8)) & 0x0000F00Fu;
+	v = (v | (v << 4)) & 0x000C30C3u;
+	v = (v | (v << 2)) & 0x00249249u;
+	return v;
+}
+
+// Octahedral projection of a unit direction onto [-1,1]^2
+float2 octahedral_encode(float3 d)
+{
+	d /= (fabs(d.x) + fabs(d.y) + fabs(d.z));
+	float2 p = d.xy;
+	if (d.z < 0.0f) {
+		p = (1.0f - fabs(d.yx)) * (float2)(d.x >= 0.0f ? 1.0f : -1.0f, d.y >= 0.0f ? 1.0f : -1.0f);
 	}
-	
-	// Apply post-processing for display
-	float3 displayColor = clamp(accumulatedColor, 0.0f, 1.0f);
-	// Apply gamma correction (gamma = 2.2)
-	//displayColor = pow(displayColor, (float3)(1.0f / 2.2f));
-	
-	output[base_idx] = displayColor.x;     // R
-	output[base_idx + 1] = displayColor.y; // G
-	output[base_idx + 2] = displayColor.z; // B
+	return p;
+}
+
+// Create one primary path per pixel, in pixel order
+__kernel void wavefront_generate(__global PathState* paths, __global uint* rayIndices, int width, int height, int frameCount,
+                                 __global GPUCamera* camera)
+{
+	const int work_item_id = get_global_id(0);
+	if (work_item_id >= width * height) return;
+
+	int x_coord = work_item_id % width;
+	int y_coord = work_item_id / width;
+
+	struct Ray camray = createCamRay(x_coord, y_coord, width, height, camera);
+
+	PathState path;
+	path.origin = (float4)(camray.origin, 1.0f); // w = IOR of the medium the camera is in
+	path.dir = (float4)(camray.dir, 0.0f);
+	path.throughput = (float4)(1.0f, 1.0f, 1.0f, 0.0f);
+	path.color = (float4)(0.0f, 0.0f, 0.0f, 0.0f);
+	path.seed = (x_coord * 1973 + y_coord * 9277 + frameCount * 26699) | 1; // same seed as render_kernel
+	path.alive = 1;
+	path.coneWidth = camray.coneWidth;
+	path.coneSpread = camray.coneSpread;
+
+	paths[work_item_id] = path;
+	rayIndices[work_item_id] = work_item_id;
 }
 
+// Trace one bounce for every path, visiting paths in rayIndices order (sorted or not)
+__kernel void wavefront_bounce(__global PathState* paths, __global const uint* rayIndices, int numRays,
+                               int bounce, int maxBounces,
+                               __global GPUShape* shapes, int numShapes,
+                               __global GPUMaterial* materials, int numMaterials,
+                               read_only image2d_t textureAtlas, __global const GPUTexture* textures, __global const uint2* textureBlocks,
+                               __global const GPUBVHNode* bvhNodes, __global const GPUTriangle* bvhTriangles,
+                               __global const ushort* meshVertices, __global const uint* meshIndices)
+{
+	const int work_item_id = get_global_id(0);
+	if (work_item_id >= numRays) return;
+
+	const uint pathIndex = rayIndices[work_item_id];
+	if (!paths[pathIndex].alive) return;
+
+	PathState path = paths[pathIndex];
+
+	struct Ray ray;
+	ray.origin = path.origin.xyz;
+	ray.dir = path.dir.xyz;
+	ray.coneWidth = path.coneWidth;
+	ray.coneSpread = path.coneSpread;
+	ray.lodBias = bounce > 0 ? SECONDARY_LOD_BIAS : 0;
+	float3 throughput = path.throughput.xyz;
+	float3 color = path.color.xyz;
+	float currentIOR = path.origin.w;
+	uint seed = path.seed;
+
+	struct Light lights[1];
+	lights[0].pos = (float3)(0.0f, 0.2f, 0.0f);
+	lights[0].color = (float3)(1.0f, 1.0f, 1.0f);
+	lights[0].intensity = 1.0f;
+	int numLights = 0; // Disable direct lights for now (same as render_kernel)
+
+	bool alive = trace_bounce(&ray, &throughput, &color, &currentIOR, bounce, maxBounces,
+	                          shapes, numShapes, lights, numLights, &seed, materials, numMaterials, textureAtlas, textures, textureBlocks, bvhNodes, bvhTriangles, meshVertices, meshIndices);
+
+	path.origin = (float4)(ray.origin, currentIOR);
+	path.dir = (float4)(ray.dir, 0.0f);
+	path.throughput = (float4)(throughput, 0.0f);
+	path.color = (float4)(color, 0.0f);
+	path.seed = seed;
+	path.alive = alive ? 1 : 0;
+	path.coneWidth = ray.coneWidth;
+	path.coneSpread = ray.coneSpread;
+	paths[pathIndex] = path;
+}
+
+// Count the paths still alive, one atomic per work-group (ray statistics of the wavefront path)
+__kernel void count_active_paths(__global const PathState* paths, int numPaths, __global uint* count)
+{
+	__local uint groupCount;
+	if (get_local_id(0) == 0) groupCount = 0;
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	const int work_item_id = get_global_id(0);
+	if (work_item_id < numPaths && paths[work_item_id].alive)
+		atomic_inc(&groupCount);
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	if (get_local_id(0) == 0 && groupCount > 0)
+		atomic_add(count, groupCount);
+}
+
+// Build a 24-bit sort key per ray: quantised octahedral direction (high bits) then
+// Morton code of the origin inside the scene bounds. Terminated paths sort last.
+__kernel void compute_ray_keys(__global const PathState* paths, __global const uint* rayIndices, int numRays,
+                               float4 sceneMin, float4 sceneInvExtent,
+                               __global uint* keys, __global uint* values)
+{
+	const int work_item_id = get_global_id(0);
+	if (work_item_id >= numRays) return;
+
+	const uint pathIndex = rayIndices[work_item_id];
+	values[work_item_id] = pathIndex;
+
+	if (!paths[pathIndex].alive) {
+		keys[work_item_id] = RAY_KEY_DEAD;
+		return;
+	}
+
+	const float originCells = (float)(1 << RAY_KEY_ORIGIN_BITS);
+	float3 o = clamp((paths[pathIndex].origin.xyz - sceneMin.xyz) * sceneInvExtent.xyz, 0.0f, 1.0f);
+	uint ox = min((uint)(o.x * originCells), (uint)(originCells - 1.0f));
+	uint oy = min((uint)(o.y * originCells), (uint)(originCells - 1.0f));
+	uint oz = min((uint)(o.z * originCells), (uint)(originCells - 1.0f));
+	uint originCode = (morton_expand_6bits(ox) << 2) | (morton_expand_6bits(oy) << 1) | morton_expand_6bits(oz);
+
+	const float dirCells = (float)(1 << RAY_KEY_DIR_BITS);
+	float2 oct = octahedral_encode(paths[pathIndex].dir.xyz) * 0.5f + 0.5f;
+	uint du = min((uint)(oct.x * dirCells), (uint)(dirCells - 1.0f));
+	uint dv = min((uint)(oct.y * dirCells), (uint)(dirCells - 1.0f));
+	uint dirCode = (du << RAY_KEY_DIR_BITS) | dv;
+
+	keys[work_item_id] = (dirCode << (3 * RAY_KEY_ORIGIN_BITS)) | originCode;
+}
+
+// Final per-pixel write: background for paths that never hit anything, then accumulation
+__kernel void wavefront_resolve(__global const PathState* paths, __global float* output, __global float* accumBuffer,
+                                int width, int height, int frameCount, __global GPUCamera* camera)
+{
+	const int work_item_id = get_global_id(0);
+	if (work_item_id >= width * height) return;
+
+	float fy = (float)(work_item_id / width) / (float)height;
+	float3 outputPixelColor = paths[work_item_id].color.xyz;
+
+	/* If no intersection found, return background colour */
+	if (outputPixelColor.x == 0.0f && outputPixelColor.y == 0.0f && outputPixelColor.z == 0.0f) {
+		outputPixelColor = (float3)(fy * 0.7f, fy * 0.3f, 0.3f);
+	}
+
+	write_pixel(output, accumBuffer, work_item_id, outputPixelColor, frameCount, camera->denoise);
+}
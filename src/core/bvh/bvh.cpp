@@ -1,260 +1,933 @@
 #include "bvh.h"
 #include "../shapes/Mesh.h"
 #include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <omp.h>
+#include <sstream>
 
-float max(float a, float b) {
-    return (a > b) ? a : b;
+// Device triangle of a mesh face (mesh triangles have no material of their own, the mesh's is used)
+static GPUTriangle toGPUTriangle(const vec3 &v0, const vec3 &v1, const vec3 &v2)
+{
+    GPUTriangle gpuTri;
+    gpuTri.v0 = {v0.x, v0.y, v0.z, 0.0f};
+    gpuTri.v1 = {v1.x, v1.y, v1.z, 0.0f};
+    gpuTri.v2 = {v2.x, v2.y, v2.z, 0.0f};
+    gpuTri.materialIndex = -1;
+    gpuTri._padding[0] = 0.0f;
+    gpuTri._padding[1] = 0.0f;
+    gpuTri._padding[2] = 0.0f;
+    return gpuTri;
 }
 
-int ceilToInt(float f) {
-    int i = static_cast<int>(f);
-    if (f > static_cast<float>(i)) {
-        return i + 1;
-    }
-    return i;
+// Team size of the build: the caller's OpenMP thread budget (AssetLoader workers get a share of the cores),
+// one when built from inside a parallel region rather than a nested team left to the runtime's default
+static int buildThreadCount()
+{
+    return omp_in_parallel() ? 1 : omp_get_max_threads();
+}
+
+BVH::BVH(const Mesh &mesh, int qualityLevel) : BVH(mesh.getPositions(), mesh.getIndices(), qualityLevel)
+{
 }
 
-BVH::BVH(const Mesh &mesh, int qualityLevel) : quality(qualityLevel), Shape(true)
+// Bytes held by a vector
+template <typename T>
+static size_t vectorBytes(const std::vector<T> &vector)
+{
+    return vector.capacity() * sizeof(T);
+}
+
+BVH::BVH(const std::vector<vec3> &positions, const std::vector<unsigned int> &indices, int qualityLevel)
+    : quality(qualityLevel), Shape(true)
 {
     nodesList.index = 0;
 
-    buildTriangles.reserve(mesh.getTriangles().size());
+    auto buildStart = std::chrono::steady_clock::now();
+    size_t triangleCount = indices.size() / 3;
+    const int threads = buildThreadCount();
 
+    // Bounds and centroid of every triangle, in an arena released as soon as the tree is split
+    Arena arena(Arena::bytesFor<BVHTriangle>(triangleCount));
+    BVHTriangle *primitives = arena.allocate<BVHTriangle>(triangleCount);
     AABB globalBox;
-    int idx = 0;
-    for (const auto &tri : mesh.getTriangles()) {
-        buildTriangles.emplace_back(tri, idx++);
-        globalBox.GrowToInclude(tri);
+    AABB centroidBox;
+    for (size_t t = 0; t < triangleCount; ++t) {
+        const BVHTriangle *tri = new (&primitives[t])
+            BVHTriangle(positions[indices[3 * t]], positions[indices[3 * t + 1]], positions[indices[3 * t + 2]], static_cast<int>(t));
+        globalBox.GrowToInclude(tri->box.minPoint);
+        globalBox.GrowToInclude(tri->box.maxPoint);
+        centroidBox.GrowToInclude(tri->center);
     }
+    buildPrimitives = primitives;
+
+    // Leaves cover ranges of triangleOrder: the build partitions it in place, so it is the output as is
+    triangleOrder.resize(triangleCount);
+    for (size_t t = 0; t < triangleCount; ++t)
+        triangleOrder[t] = static_cast<uint32_t>(t);
 
+    // A binary tree over n leaves has at most 2n - 1 nodes, those under large nodes go to the lists of other tasks
+    nodesList.nodes.reserve(2 * std::min(triangleCount, static_cast<size_t>(BVH_TASK_MIN_TRIANGLES)));
     nodesList.add(Node(globalBox, -1, -1)); // root node
 
+    size_t splitBytes = 0;
     if (quality == QUALITY_DISABLED)
     {
         nodesList.nodes[0].startIndex = 0;
-        nodesList.nodes[0].triangleCount = static_cast<int>(buildTriangles.size());
+        nodesList.nodes[0].triangleCount = static_cast<int>(triangleCount);
+    }
+    else if (quality == QUALITY_SPATIAL)
+    {
+        // References start as copies of the triangles (clipped ones then get bounds of their own), the leaves' ones
+        // are gathered into buildTriangles
+        buildPositions = &positions;
+        buildIndices = &indices;
+        rootArea = globalBox.SurfaceArea();
+        int budget = static_cast<int>(SBVH_MAX_REFERENCE_GROWTH * static_cast<float>(triangleCount));
+        nodesList.pending.assign(primitives, primitives + triangleCount);
+        // The root's references and those of its children are alive together when it is split
+        splitBytes = (2 * triangleCount + budget) * sizeof(BVHTriangle);
+        #pragma omp parallel num_threads(threads)
+        #pragma omp single
+        this->splitSpatial(nodesList, 0, nodesList.pending, centroidBox, budget);
+        buildPositions = nullptr;
+        buildIndices = nullptr;
     }
     else {
-        this->split(0, 0, static_cast<int>(buildTriangles.size()));
-    }
-    
-    // Finalize data for GPU transfer
-    triangles.resize(buildTriangles.size());
-    const auto& meshTriangles = mesh.getTriangles();
-    for (size_t i = 0; i < buildTriangles.size(); ++i) {
-        triangles[i] = meshTriangles[buildTriangles[i].index];
-    }
-    
-    nodes = nodesList.nodes;
-    
-    std::cout << "BVH constructed: " << nodes.size() << " nodes, " << triangles.size() << " triangles" << std::endl;
+        // One thread starts at the root, the others pick up the binning and subtree tasks it spawns
+        #pragma omp parallel num_threads(threads)
+        #pragma omp single
+        this->split(nodesList, 0, 0, static_cast<int>(triangleCount), centroidBox);
+    }
+    splitBytes += arena.capacity() + vectorBytes(triangleOrder) + nodesList.totalBytes();
+    buildPrimitives = nullptr;
+    arena.release();
+
+    // Finalize data for GPU transfer: the lists of the tasks are released as they are spliced into the tree
+    gpuNodes.reserve(nodesList.totalNodeCount());
+    gpuNodes.resize(1);
+    size_t spliceBytes = nodesList.totalBytes() + vectorBytes(triangleOrder) + vectorBytes(gpuNodes);
+    appendNodes(nodesList, 0, quality == QUALITY_SPATIAL ? &buildTriangles : nullptr);
+    nodesList.subtrees.clear();
+    if (quality == QUALITY_SPATIAL)
+    {
+        spliceBytes += vectorBytes(buildTriangles);
+        triangleOrder.resize(buildTriangles.size());
+        for (size_t i = 0; i < buildTriangles.size(); ++i)
+            triangleOrder[i] = static_cast<uint32_t>(buildTriangles[i].index);
+        std::vector<BVHTriangle>().swap(buildTriangles);
+    }
+    gpuTriangles.resize(triangleOrder.size());
+    #pragma omp parallel for num_threads(threads)
+    for (size_t i = 0; i < triangleOrder.size(); ++i) {
+        const unsigned int *v = &indices[3 * static_cast<size_t>(triangleOrder[i])];
+        gpuTriangles[i] = toGPUTriangle(positions[v[0]], positions[v[1]], positions[v[2]]);
+    }
+    size_t treeBytes = vectorBytes(gpuNodes) + vectorBytes(triangleOrder) + vectorBytes(gpuTriangles);
+    peakBuildMemory = std::max(std::max(splitBytes, spliceBytes), treeBytes);
+    buildCost = sahCost();
+    double buildMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - buildStart).count();
+
+    std::cout << "BVH constructed: " << gpuNodes.size() << " nodes, " << triangleCount << " triangles";
+    if (triangleOrder.size() != triangleCount)
+        std::cout << " (" << triangleOrder.size() << " references, +"
+                  << 100.0 * (static_cast<double>(triangleOrder.size()) - triangleCount) / std::max(triangleCount, size_t(1)) << "%)";
+    std::cout << ", SAH cost " << buildCost << ", " << buildMilliseconds << " ms, peak memory "
+              << peakBuildMemory / (1024.0 * 1024.0) << " MB" << std::endl;
+}
+
+BVH::BVH(std::shared_ptr<const MappedFile> file, const GPUBVHNode *cachedNodes, size_t nodeCount, const uint32_t *cachedTriangleOrder,
+         const GPUTriangle *cachedTriangles, size_t triangleCount)
+    : Shape(true), quality(QUALITY_HIGH), cacheFile(std::move(file)), mappedNodes(cachedNodes), mappedNodeCount(nodeCount),
+      mappedTriangleOrder(cachedTriangleOrder), mappedTriangles(cachedTriangles), mappedTriangleCount(triangleCount)
+{
+    nodesList.index = 0;
+}
+
+float BVH::sahCost() const
+{
+    const GPUBVHNode *treeNodes = getGPUNodes();
+    size_t nodeCount = getGPUNodeCount();
+    if (nodeCount == 0 || (nodeCount == 1 && treeNodes[0].triangleCount == 0))
+        return 0.0f; // no triangles: the root has inverted bounds
+
+    auto area = [](const GPUBVHNode &node)
+    {
+        float dx = node.maxx - node.minx;
+        float dy = node.maxy - node.miny;
+        float dz = node.maxz - node.minz;
+        return 2.0f * (dx * dy + dy * dz + dz * dx);
+    };
+    float rootArea = area(treeNodes[0]);
+    if (rootArea <= 0.0f)
+        return 0.0f;
+
+    // Probability of a ray visiting a node is its area over the root's: one traversal step per inner node,
+    // one intersection test per triangle of a leaf
+    float cost = 0.0f;
+    for (size_t i = 0; i < nodeCount; ++i)
+    {
+        const GPUBVHNode &node = treeNodes[i];
+        cost += area(node) * (node.triangleCount > 0 ? static_cast<float>(node.triangleCount) : 1.0f);
+    }
+    return cost / rootArea;
+}
+
+void BVH::detachFromCache()
+{
+    if (!mappedNodes)
+        return;
+    gpuNodes.assign(mappedNodes, mappedNodes + mappedNodeCount);
+    triangleOrder.assign(mappedTriangleOrder, mappedTriangleOrder + mappedTriangleCount);
+    gpuTriangles.assign(mappedTriangles, mappedTriangles + mappedTriangleCount);
+    mappedNodes = nullptr;
+    mappedTriangleOrder = nullptr;
+    mappedTriangles = nullptr;
+    cacheFile.reset();
+}
+
+// A lone root is a leaf even without triangles (tree built from no triangles), any other node without
+// triangles has two children
+static inline bool isLeaf(const GPUBVHNode &node, size_t nodeCount)
+{
+    return node.triangleCount > 0 || nodeCount == 1;
+}
+
+static inline float nodeArea(const GPUBVHNode &node)
+{
+    float dx = node.maxx - node.minx;
+    float dy = node.maxy - node.miny;
+    float dz = node.maxz - node.minz;
+    return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+
+// Bounds of two nodes, in the first one's bounds (its other fields are left as they were)
+static inline GPUBVHNode nodeUnion(const GPUBVHNode &a, const GPUBVHNode &b)
+{
+    GPUBVHNode box = a;
+    box.minx = std::min(a.minx, b.minx);
+    box.miny = std::min(a.miny, b.miny);
+    box.minz = std::min(a.minz, b.minz);
+    box.maxx = std::max(a.maxx, b.maxx);
+    box.maxy = std::max(a.maxy, b.maxy);
+    box.maxz = std::max(a.maxz, b.maxz);
+    return box;
+}
+
+BVH::Report BVH::report() const
+{
+    Report result;
+    const GPUBVHNode *treeNodes = getGPUNodes();
+    result.nodeCount = getGPUNodeCount();
+    result.leafSizes.assign(BVH_REPORT_LEAF_SIZES, 0);
+    result.peakBuildMemory = peakBuildMemory;
+    if (result.nodeCount == 0)
+        return result;
+    result.sahCost = sahCost();
+
+    double depthSum = 0.0;
+    double overlapArea = 0.0;
+    double innerArea = 0.0;
+    std::vector<std::pair<int, int>> stack = {{0, 0}}; // (node, depth)
+    while (!stack.empty())
+    {
+        auto [index, depth] = stack.back();
+        stack.pop_back();
+        const GPUBVHNode &node = treeNodes[index];
+        if (isLeaf(node, result.nodeCount))
+        {
+            result.leafCount++;
+            result.referenceCount += node.triangleCount;
+            result.maxDepth = std::max(result.maxDepth, depth);
+            depthSum += depth;
+            if (node.triangleCount > 0)
+                result.leafSizes[std::min(node.triangleCount, BVH_REPORT_LEAF_SIZES) - 1]++;
+            continue;
+        }
+        const GPUBVHNode &left = treeNodes[node.startIndex];
+        const GPUBVHNode &right = treeNodes[node.startIndex + 1];
+        float dx = std::min(left.maxx, right.maxx) - std::max(left.minx, right.minx);
+        float dy = std::min(left.maxy, right.maxy) - std::max(left.miny, right.miny);
+        float dz = std::min(left.maxz, right.maxz) - std::max(left.minz, right.minz);
+        if (dx >= 0.0f && dy >= 0.0f && dz >= 0.0f)
+            overlapArea += 2.0f * (dx * dy + dy * dz + dz * dx);
+        innerArea += nodeArea(node);
+        stack.push_back({node.startIndex, depth + 1});
+        stack.push_back({node.startIndex + 1, depth + 1});
+    }
+    result.averageDepth = result.leafCount > 0 ? static_cast<float>(depthSum / result.leafCount) : 0.0f;
+    result.overlapRatio = innerArea > 0.0 ? static_cast<float>(overlapArea / innerArea) : 0.0f;
+    return result;
+}
+
+std::string BVH::Report::toString() const
+{
+    std::ostringstream text;
+    text << "SAH cost " << sahCost << ", " << nodeCount << " nodes, " << leafCount << " leaves, " << referenceCount << " triangles\n"
+         << "Depth: max " << maxDepth << ", average " << averageDepth << "\n"
+         << "Child overlap: " << 100.0f * overlapRatio << "% of inner node area\n"
+         << "Leaf sizes:";
+    for (size_t k = 0; k < leafSizes.size(); ++k)
+    {
+        if (leafSizes[k] > 0)
+            text << " " << k + 1 << (k + 1 == leafSizes.size() ? "+" : "") << ": " << leafSizes[k];
+    }
+    if (peakBuildMemory > 0)
+        text << "\nPeak build memory: " << peakBuildMemory / (1024.0 * 1024.0) << " MB";
+    return text.str();
+}
+
+float BVH::optimize(int maxPasses)
+{
+    detachFromCache();
+    float cost = sahCost();
+    float initialCost = cost;
+    auto start = std::chrono::steady_clock::now();
+    int passes = 0;
+    while (passes < maxPasses && gpuNodes.size() > 3)
+    {
+        passes++;
+        // Parents before children in the layout: walking backwards visits the lower nodes first
+        for (size_t i = gpuNodes.size(); i-- > 0;)
+        {
+            const GPUBVHNode &node = gpuNodes[i];
+            if (node.triangleCount > 0)
+                continue;
+            // Candidate swaps (x under parent px, y under py): a child with a grandchild under its sibling, or a
+            // grandchild under each child. Each parent then bounds the other node and the child it kept, only
+            // the parents below the node change area
+            struct Swap
+            {
+                int x, px, y, py;
+            };
+            Swap swaps[6];
+            int swapCount = 0;
+            int left = node.startIndex;
+            int right = left + 1;
+            bool leftInner = gpuNodes[left].triangleCount == 0;
+            bool rightInner = gpuNodes[right].triangleCount == 0;
+            for (int g = 0; g < 2; ++g)
+            {
+                if (rightInner)
+                    swaps[swapCount++] = {left, static_cast<int>(i), gpuNodes[right].startIndex + g, right};
+                if (leftInner)
+                    swaps[swapCount++] = {right, static_cast<int>(i), gpuNodes[left].startIndex + g, left};
+                if (leftInner && rightInner) // a1 with b0 would make the same two pairs as a0 with b1
+                    swaps[swapCount++] = {gpuNodes[left].startIndex, left, gpuNodes[right].startIndex + g, right};
+            }
+            auto sibling = [this](int child, int parent) { return 2 * gpuNodes[parent].startIndex + 1 - child; };
+            auto parentGain = [&](int parent, int out, int in)
+            {
+                if (parent == static_cast<int>(i))
+                    return 0.0f;
+                return nodeArea(gpuNodes[parent]) - nodeArea(nodeUnion(gpuNodes[in], gpuNodes[sibling(out, parent)]));
+            };
+            int best = -1;
+            float bestGain = FLT_EPSILON * nodeArea(node);
+            for (int k = 0; k < swapCount; ++k)
+            {
+                const Swap &swap = swaps[k];
+                float gain = parentGain(swap.px, swap.x, swap.y) + parentGain(swap.py, swap.y, swap.x);
+                if (gain > bestGain)
+                {
+                    bestGain = gain;
+                    best = k;
+                }
+            }
+            if (best < 0)
+                continue;
+            const Swap &swap = swaps[best];
+            std::swap(gpuNodes[swap.x], gpuNodes[swap.y]);
+            for (int parent : {swap.px, swap.py})
+            {
+                if (parent == static_cast<int>(i))
+                    continue;
+                GPUBVHNode &parentNode = gpuNodes[parent];
+                GPUBVHNode bounds = nodeUnion(gpuNodes[parentNode.startIndex], gpuNodes[parentNode.startIndex + 1]);
+                parentNode.minx = bounds.minx;
+                parentNode.miny = bounds.miny;
+                parentNode.minz = bounds.minz;
+                parentNode.maxx = bounds.maxx;
+                parentNode.maxy = bounds.maxy;
+                parentNode.maxz = bounds.maxz;
+            }
+        }
+
+        // Lay the nodes out depth first again: swapped subtrees broke the parent before children order refit needs
+        std::vector<GPUBVHNode> ordered;
+        ordered.reserve(gpuNodes.size());
+        ordered.push_back(gpuNodes[0]);
+        std::vector<int> stack = {0};
+        while (!stack.empty())
+        {
+            int index = stack.back();
+            stack.pop_back();
+            if (ordered[index].triangleCount > 0)
+                continue;
+            int children = static_cast<int>(ordered.size());
+            ordered.push_back(gpuNodes[ordered[index].startIndex]);
+            ordered.push_back(gpuNodes[ordered[index].startIndex + 1]);
+            ordered[index].startIndex = children;
+            stack.push_back(children + 1);
+            stack.push_back(children);
+        }
+        gpuNodes.swap(ordered);
+
+        float passCost = sahCost();
+        bool converged = cost - passCost < BVH_OPTIMIZE_MIN_GAIN * cost;
+        cost = passCost;
+        if (converged)
+            break;
+    }
+
+    // A new topology: uploaded copies are stale, refits measure their growth from here
+    topologyId = nextTopologyId++;
+    buildCost = cost;
+    double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "BVH optimized: SAH cost " << initialCost << " -> " << cost << " in " << passes << " passes, " << milliseconds << " ms"
+              << std::endl;
+    return cost;
+}
+
+bool BVH::refit(const Mesh &mesh)
+{
+    return refit(mesh.getPositions(), mesh.getIndices());
+}
+
+bool BVH::refit(const std::vector<vec3> &positions, const std::vector<unsigned int> &indices)
+{
+    if (buildCost < 0.0f)
+        buildCost = sahCost(); // tree read from the cache
+
+    detachFromCache();
+
+    // Not the mesh this tree was built for (an SBVH references some triangles twice, but each one at least once)
+    size_t meshTriangles = indices.size() / 3;
+    if (triangleOrder.size() < meshTriangles ||
+        std::any_of(triangleOrder.begin(), triangleOrder.end(), [meshTriangles](uint32_t t) { return t >= meshTriangles; }))
+        return false;
+
+    // SBVH leaves get the bounds of their whole triangles back: the clipping is lost until the next build
+
+    // Children are stored after their parent: walking the nodes backwards visits every child before its parent
+    for (size_t i = gpuNodes.size(); i-- > 0;)
+    {
+        GPUBVHNode &node = gpuNodes[i];
+        AABB box;
+        if (isLeaf(node, gpuNodes.size()))
+        {
+            for (int t = node.startIndex; t < node.startIndex + node.triangleCount; ++t)
+            {
+                const unsigned int *v = &indices[3 * static_cast<size_t>(triangleOrder[t])];
+                gpuTriangles[t] = toGPUTriangle(positions[v[0]], positions[v[1]], positions[v[2]]);
+                box.GrowToInclude(positions[v[0]]);
+                box.GrowToInclude(positions[v[1]]);
+                box.GrowToInclude(positions[v[2]]);
+            }
+        }
+        else
+        {
+            for (int c = node.startIndex; c <= node.startIndex + 1; ++c)
+            {
+                box.GrowToInclude(vec3(gpuNodes[c].minx, gpuNodes[c].miny, gpuNodes[c].minz));
+                box.GrowToInclude(vec3(gpuNodes[c].maxx, gpuNodes[c].maxy, gpuNodes[c].maxz));
+            }
+        }
+        node.minx = box.minPoint.x;
+        node.miny = box.minPoint.y;
+        node.minz = box.minPoint.z;
+        node.maxx = box.maxPoint.x;
+        node.maxy = box.maxPoint.y;
+        node.maxz = box.maxPoint.z;
+    }
+    boundsVersion++;
+
+    float cost = sahCost();
+    if (cost > buildCost * REFIT_MAX_SAH_GROWTH)
+    {
+        std::cout << "BVH refit degraded its SAH cost from " << buildCost << " to " << cost << ", rebuild needed" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Bin of a centroid along an axis, clamped (the maximum lands in the last bin)
+static inline int binOf(float centroid, float binMin, float binScale, int bins)
+{
+    int bin = static_cast<int>((centroid - binMin) * binScale);
+    return std::min(std::max(bin, 0), bins - 1);
+}
+
+static inline float axisOf(const vec3 &v, int axis)
+{
+    return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
 }
 
-void BVH::split(int parentIndex, int triGlobalStart, int triNum, int depth) {
-    Node* parentNode = &nodesList.nodes[parentIndex];
+// Bounds and triangle count of a bin (plain floats: a node clears 3 * SAH_BINS of them)
+struct SAHBin
+{
+    float min[3];
+    float max[3];
+    int count;
 
-    vec3 size = parentNode->boundingBox.maxPoint - parentNode->boundingBox.minPoint;
+    void clear()
+    {
+        min[0] = min[1] = min[2] = FLT_MAX;
+        max[0] = max[1] = max[2] = -FLT_MAX;
+        count = 0;
+    }
 
-    float parentCost = NodeCost(size, triNum);
+    void grow(const SAHBin &other)
+    {
+        for (int k = 0; k < 3; ++k) {
+            min[k] = std::min(min[k], other.min[k]);
+            max[k] = std::max(max[k], other.max[k]);
+        }
+        count += other.count;
+    }
 
-    Split split = chooseSplit(*parentNode, triGlobalStart, triNum);
+    float area() const
+    {
+        if (count == 0)
+            return 0.0f;
+        float dx = max[0] - min[0], dy = max[1] - min[1], dz = max[2] - min[2];
+        return 2.0f * (dx * dy + dy * dz + dz * dx);
+    }
 
-    if (split.cost < parentCost && depth < MAX_DEPTH) {
-        AABB leftBox;
-        AABB rightBox;
+    AABB box() const { return AABB(vec3(min[0], min[1], min[2]), vec3(max[0], max[1], max[2])); }
+};
 
-        int numOnLeft = 0;
+// Triangles of a node in an object build: its range of triangleOrder, indexing the per-triangle build data
+struct OrderedTriangles
+{
+    const BVH::BVHTriangle *primitives;
+    const uint32_t *order;
 
-        for (int i = triGlobalStart; i < triGlobalStart + triNum; ++i) {
-            BVHTriangle tri = buildTriangles[i];
-            float c;
-            switch(split.axis) {
-                case 0:
-                    c = tri.center.x;
-                    break;
-                case 1:
-                    c = tri.center.y;
-                    break;
-                case 2:
-                    c = tri.center.z;
-                    break;
+    inline const BVH::BVHTriangle &operator[](int i) const { return primitives[order[i]]; }
+};
+
+// Drop the triangles [start, end) into the bins of the three axes (binned[axis * SAH_BINS + bin], cleared by the caller)
+// Triangles is OrderedTriangles, or a BVHTriangle pointer for the references of an SBVH
+template <typename Triangles>
+static void binTriangles(Triangles triangles, int start, int end, const float binMin[3], const float binScale[3],
+                         int bins, SAHBin *binned)
+{
+    for (int i = start; i < end; ++i) {
+        const BVH::BVHTriangle &tri = triangles[i];
+        const float triMin[3] = {tri.box.minPoint.x, tri.box.minPoint.y, tri.box.minPoint.z};
+        const float triMax[3] = {tri.box.maxPoint.x, tri.box.maxPoint.y, tri.box.maxPoint.z};
+        for (int axis = 0; axis < 3; ++axis) {
+            SAHBin &bin = binned[axis * SAH_BINS + binOf(axisOf(tri.center, axis), binMin[axis], binScale[axis], bins)];
+            for (int k = 0; k < 3; ++k) {
+                bin.min[k] = std::min(bin.min[k], triMin[k]);
+                bin.max[k] = std::max(bin.max[k], triMax[k]);
             }
+            bin.count++;
+        }
+    }
+}
 
-            if (c < split.pos) {
-                if (tri.box.minPoint.x < leftBox.minPoint.x) leftBox.minPoint.x = tri.box.minPoint.x;
-                if (tri.box.minPoint.y < leftBox.minPoint.y) leftBox.minPoint.y = tri.box.minPoint.y;
-                if (tri.box.minPoint.z < leftBox.minPoint.z) leftBox.minPoint.z = tri.box.minPoint.z;
-                if (tri.box.maxPoint.x > leftBox.maxPoint.x) leftBox.maxPoint.x = tri.box.maxPoint.x;
-                if (tri.box.maxPoint.y > leftBox.maxPoint.y) leftBox.maxPoint.y = tri.box.maxPoint.y;
-                if (tri.box.maxPoint.z > leftBox.maxPoint.z) leftBox.maxPoint.z = tri.box.maxPoint.z;
-                
-                BVHTriangle swap = buildTriangles[numOnLeft + triGlobalStart];
-                buildTriangles[numOnLeft + triGlobalStart] = tri;
-                buildTriangles[i] = swap;
-                numOnLeft++;
+void BVH::split(NodeList &list, int parentIndex, int triGlobalStart, int triNum, const AABB &centroidBox, int depth) {
+    float parentArea = list.nodes[parentIndex].boundingBox.SurfaceArea();
+    uint32_t *order = triangleOrder.data();
+    OrderedTriangles triangles = {buildPrimitives, order + triGlobalStart};
+    Split split = triNum > 1 && depth < MAX_DEPTH ? chooseSplit(triangles, triNum, centroidBox) : Split();
+
+    // Split only if traversing the node and its two children is expected to cost less than testing every triangle
+    float leafCost = parentArea * static_cast<float>(triNum);
+    if (split.axis >= 0 && SAH_TRAVERSAL_COST * parentArea + split.cost < leafCost) {
+        int bins = split.bins;
+        float binMin = axisOf(centroidBox.minPoint, split.axis);
+        float binScale = bins / (axisOf(centroidBox.maxPoint, split.axis) - binMin);
+
+        // In-place partition (Hoare) of the triangle indices, gathering the centroid bounds of both sides on the way
+        AABB leftCentroids;
+        AABB rightCentroids;
+        int left = triGlobalStart;
+        int right = triGlobalStart + triNum - 1;
+        while (left <= right) {
+            const vec3 &center = buildPrimitives[order[left]].center;
+            if (binOf(axisOf(center, split.axis), binMin, binScale, bins) < split.bin) {
+                leftCentroids.GrowToInclude(center);
+                left++;
             } else {
-                if (tri.box.minPoint.x < rightBox.minPoint.x) rightBox.minPoint.x = tri.box.minPoint.x;
-                if (tri.box.minPoint.y < rightBox.minPoint.y) rightBox.minPoint.y = tri.box.minPoint.y;
-                if (tri.box.minPoint.z < rightBox.minPoint.z) rightBox.minPoint.z = tri.box.minPoint.z;
-                if (tri.box.maxPoint.x > rightBox.maxPoint.x) rightBox.maxPoint.x = tri.box.maxPoint.x;
-                if (tri.box.maxPoint.y > rightBox.maxPoint.y) rightBox.maxPoint.y = tri.box.maxPoint.y;
-                if (tri.box.maxPoint.z > rightBox.maxPoint.z) rightBox.maxPoint.z = tri.box.maxPoint.z;
+                rightCentroids.GrowToInclude(center);
+                std::swap(order[left], order[right]);
+                right--;
             }
         }
 
+        int numOnLeft = left - triGlobalStart;
         int numOnRight = triNum - numOnLeft;
-        int triStartLeft = triGlobalStart + 0;
+        int triStartLeft = triGlobalStart;
         int triStartRight = triGlobalStart + numOnLeft;
 
         // Split parent into two children
-        Node childLeft = Node(leftBox, triStartLeft, 0);
-        Node childRight = Node(rightBox, triStartRight, 0);
-    
-        int childIndexLeft = nodesList.add(childLeft);
-        int childIndexRight = nodesList.add(childRight);
-
-        // Update parent
-        parentNode->startIndex = childIndexLeft;
-        nodesList.nodes[parentIndex] = *parentNode;
-
-        // Recursively split children
-        this->split(childIndexLeft, triStartLeft, numOnLeft, depth + 1);
-        this->split(childIndexRight, triStartRight, numOnRight, depth + 1);
+        int childIndexLeft = list.add(Node(split.leftBox, triStartLeft, 0));
+        list.add(Node(split.rightBox, triStartRight, 0));
+
+        // Update parent (through its index: adding the children may have moved the nodes)
+        list.nodes[parentIndex].startIndex = childIndexLeft;
+
+        // Recursively split children: large ones in a task of their own (the two triangle ranges are disjoint),
+        // small ones right away in this list
+        const int childStart[2] = {triStartLeft, triStartRight};
+        const int childCount[2] = {numOnLeft, numOnRight};
+        const AABB childCentroids[2] = {leftCentroids, rightCentroids};
+        for (int c = 0; c < 2; ++c) {
+            if (childCount[c] >= BVH_TASK_MIN_TRIANGLES) {
+                list.subtrees.emplace_back(childIndexLeft + c, std::make_shared<NodeList>());
+                NodeList *subtree = list.subtrees.back().second.get();
+                subtree->index = 0;
+                subtree->add(list.nodes[childIndexLeft + c]);
+                int start = childStart[c];
+                int count = childCount[c];
+                AABB centroids = childCentroids[c];
+                #pragma omp task firstprivate(subtree, start, count, centroids, depth)
+                this->split(*subtree, 0, start, count, centroids, depth + 1);
+            }
+            else {
+                this->split(list, childIndexLeft + c, childStart[c], childCount[c], childCentroids[c], depth + 1);
+            }
+        }
     }
     else
     {
         // Parent is a leaf, assign triangles to it
-        parentNode->startIndex = triGlobalStart;
-        parentNode->triangleCount = triNum;
-        nodesList.nodes[parentIndex] = *parentNode;
+        list.nodes[parentIndex].startIndex = triGlobalStart;
+        list.nodes[parentIndex].triangleCount = triNum;
     }
 }
 
-float BVH::NodeCost(vec3 size, int numTris) {
-    if (numTris == 0) return 0.0f;
-    float area = size.x * size.x + size.y * size.y + size.z * size.z;
-    return area * static_cast<float>(numTris);
-}
-
-float BVH::evaluateSplit(int splitAxis, float splitPos, int start, int count) {
-    int numOnLeft = 0;
-    int numOnRight = 0;
-
-    AABB leftBox;
-    AABB rightBox;
+// Binned SAH: one pass drops every centroid into its bin on the three axes, then a sweep per axis evaluates the
+// cost of each of the bins - 1 planes from prefix (left) and suffix (right) bounds and counts
+template <typename Triangles>
+BVH::Split BVH::chooseSplit(Triangles triangles, int count, const AABB &centroidBox) const {
+    // Small nodes get fewer bins: clearing and sweeping them would otherwise cost more than binning the triangles
+    const int bins = std::min(binCount(), SAH_BINS_MIN + count / SAH_TRIANGLES_PER_BIN);
+    SAHBin binned[3 * SAH_BINS];
+    float binMin[3];
+    float binScale[3];
+    bool splittable[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        binMin[axis] = axisOf(centroidBox.minPoint, axis);
+        float extent = axisOf(centroidBox.maxPoint, axis) - binMin[axis];
+        splittable[axis] = extent > 0.0f;
+        binScale[axis] = splittable[axis] ? bins / extent : 0.0f;
+        for (int b = 0; b < bins; ++b)
+            binned[axis * SAH_BINS + b].clear();
+    }
 
-    int end = start + count;
+    if (count >= BVH_PARALLEL_BINNING_MIN_TRIANGLES) {
+        // One task per chunk, merged afterwards: bounds and counts do not depend on the merge order
+        int chunks = (count + BVH_BINNING_CHUNK - 1) / BVH_BINNING_CHUNK;
+        std::vector<SAHBin> chunkBins(static_cast<size_t>(chunks) * 3 * SAH_BINS);
+        for (int chunk = 0; chunk < chunks; ++chunk) {
+            SAHBin *local = &chunkBins[static_cast<size_t>(chunk) * 3 * SAH_BINS];
+            int chunkStart = chunk * BVH_BINNING_CHUNK;
+            int chunkEnd = std::min(chunkStart + BVH_BINNING_CHUNK, count);
+            #pragma omp task firstprivate(local, chunkStart, chunkEnd) shared(binMin, binScale)
+            {
+                for (int b = 0; b < 3 * SAH_BINS; ++b)
+                    local[b].clear();
+                binTriangles(triangles, chunkStart, chunkEnd, binMin, binScale, bins, local);
+            }
+        }
+        #pragma omp taskwait
+        for (int chunk = 0; chunk < chunks; ++chunk) {
+            for (int b = 0; b < 3 * SAH_BINS; ++b)
+                binned[b].grow(chunkBins[static_cast<size_t>(chunk) * 3 * SAH_BINS + b]);
+        }
+    }
+    else {
+        binTriangles(triangles, 0, count, binMin, binScale, bins, binned);
+    }
 
-    for (int i = start; i < end; ++i) {
-        const BVHTriangle &tri = buildTriangles[i];
-        float c;
-        switch(splitAxis) {
-            case 0:
-                c = tri.center.x;
-                break;
-            case 1:
-                c = tri.center.y;
-                break;
-            case 2:
-                c = tri.center.z;
-                break;
+    Split best;
+    best.bins = bins;
+    SAHBin bestLeft;
+    for (int axis = 0; axis < 3; ++axis) {
+        if (!splittable[axis])
+            continue;
+        const SAHBin *axisBins = &binned[axis * SAH_BINS];
+
+        // Suffix sweep: area and count of everything right of each plane
+        float rightArea[SAH_BINS];
+        int rightCount[SAH_BINS];
+        SAHBin right;
+        right.clear();
+        for (int b = bins - 1; b > 0; --b) {
+            right.grow(axisBins[b]);
+            rightArea[b] = right.area();
+            rightCount[b] = right.count;
         }
-        if (c < splitPos) {
-            if (tri.box.minPoint.x < leftBox.minPoint.x) leftBox.minPoint.x = tri.box.minPoint.x;
-            if (tri.box.minPoint.y < leftBox.minPoint.y) leftBox.minPoint.y = tri.box.minPoint.y;
-            if (tri.box.minPoint.z < leftBox.minPoint.z) leftBox.minPoint.z = tri.box.minPoint.z;
-            if (tri.box.maxPoint.x > leftBox.maxPoint.x) leftBox.maxPoint.x = tri.box.maxPoint.x;
-            if (tri.box.maxPoint.y > leftBox.maxPoint.y) leftBox.maxPoint.y = tri.box.maxPoint.y;
-            if (tri.box.maxPoint.z > leftBox.maxPoint.z) leftBox.maxPoint.z = tri.box.maxPoint.z;
-            numOnLeft++;
-        } else {
-            if (tri.box.minPoint.x < rightBox.minPoint.x) rightBox.minPoint.x = tri.box.minPoint.x;
-            if (tri.box.minPoint.y < rightBox.minPoint.y) rightBox.minPoint.y = tri.box.minPoint.y;
-            if (tri.box.minPoint.z < rightBox.minPoint.z) rightBox.minPoint.z = tri.box.minPoint.z;
-            if (tri.box.maxPoint.x > rightBox.maxPoint.x) rightBox.maxPoint.x = tri.box.maxPoint.x;
-            if (tri.box.maxPoint.y > rightBox.maxPoint.y) rightBox.maxPoint.y = tri.box.maxPoint.y;
-            if (tri.box.maxPoint.z > rightBox.maxPoint.z) rightBox.maxPoint.z = tri.box.maxPoint.z;
-            numOnRight++;
+
+        // Prefix sweep: the plane before bin b has bins [0, b) on its left
+        SAHBin left;
+        left.clear();
+        for (int b = 1; b < bins; ++b) {
+            left.grow(axisBins[b - 1]);
+            if (left.count == 0 || rightCount[b] == 0)
+                continue;
+            float cost = left.area() * left.count + rightArea[b] * rightCount[b];
+            if (cost < best.cost) {
+                best.axis = axis;
+                best.bin = b;
+                best.cost = cost;
+                bestLeft = left;
+            }
         }
     }
 
-    float costA = NodeCost(leftBox.maxPoint - leftBox.minPoint, numOnLeft);
-    float costB = NodeCost(rightBox.maxPoint - rightBox.minPoint, numOnRight);
+    if (best.axis >= 0) {
+        SAHBin right;
+        right.clear();
+        for (int b = best.bin; b < bins; ++b)
+            right.grow(binned[best.axis * SAH_BINS + b]);
+        best.leftBox = bestLeft.box();
+        best.rightBox = right.box();
+    }
+    return best;
+}
 
-    return costA + costB;
+static inline bool isEmpty(const AABB &box)
+{
+    return box.minPoint.x > box.maxPoint.x || box.minPoint.y > box.maxPoint.y || box.minPoint.z > box.maxPoint.z;
 }
 
-BVH::Split BVH::chooseSplit(Node node, int start, int count) {
-    Split bestSplit;
-    bestSplit.cost = FLT_MAX;
-    bestSplit.axis = 0;
-    bestSplit.pos = 0.0f;
-    if (count <= 1) {
-        return bestSplit;
-    }
-
-    vec3 size = node.boundingBox.maxPoint - node.boundingBox.minPoint;
-
-    if (quality == QUALITY_LOW) {
-        int largestAxisIndex = size[0] > size[1] && size[0] > size[2] ? 0 : (size[1] > size[2] ? 1 : 2);
-        float pos;
-        if (largestAxisIndex == 0) {
-            pos = node.boundingBox.minPoint.x + size.x * 0.5f;
-        } else if (largestAxisIndex == 1) {
-            pos = node.boundingBox.minPoint.y + size.y * 0.5f;
-        } else {
-            pos = node.boundingBox.minPoint.z + size.z * 0.5f;
+// SBVH (Stich et al.): the object split is tried first, the spatial one only where its children overlap. References
+// straddling a spatial plane are cut in two, so a node's references are moved into per-child vectors instead of
+// being partitioned in place
+void BVH::splitSpatial(NodeList &list, int parentIndex, std::vector<BVHTriangle> &refs, const AABB &centroidBox, int budget, int depth)
+{
+    const AABB nodeBox = list.nodes[parentIndex].boundingBox;
+    float parentArea = nodeBox.SurfaceArea();
+    int count = static_cast<int>(refs.size());
+    Split split = count > 1 && depth < MAX_DEPTH ? chooseSplit(refs.data(), count, centroidBox) : Split();
+
+    SpatialSplit spatial;
+    if (split.axis >= 0 && budget > 0) {
+        AABB overlap(vec3(std::max(split.leftBox.minPoint.x, split.rightBox.minPoint.x), std::max(split.leftBox.minPoint.y, split.rightBox.minPoint.y),
+                          std::max(split.leftBox.minPoint.z, split.rightBox.minPoint.z)),
+                     vec3(std::min(split.leftBox.maxPoint.x, split.rightBox.maxPoint.x), std::min(split.leftBox.maxPoint.y, split.rightBox.maxPoint.y),
+                          std::min(split.leftBox.maxPoint.z, split.rightBox.maxPoint.z)));
+        if (!isEmpty(overlap) && overlap.SurfaceArea() > SBVH_OVERLAP_RATIO * rootArea)
+            spatial = chooseSpatialSplit(refs, nodeBox);
+    }
+    bool useSpatial = spatial.axis >= 0 && spatial.cost < split.cost && spatial.duplicates <= budget;
+
+    auto makeLeaf = [&list, parentIndex](std::vector<BVHTriangle> &leafRefs)
+    {
+        list.nodes[parentIndex].startIndex = static_cast<int>(list.references.size());
+        list.nodes[parentIndex].triangleCount = static_cast<int>(leafRefs.size());
+        list.references.insert(list.references.end(), leafRefs.begin(), leafRefs.end());
+        std::vector<BVHTriangle>().swap(leafRefs);
+    };
+    float leafCost = parentArea * static_cast<float>(count);
+    if (split.axis < 0 || SAH_TRAVERSAL_COST * parentArea + (useSpatial ? spatial.cost : split.cost) >= leafCost) {
+        makeLeaf(refs);
+        return;
+    }
+
+    std::vector<BVHTriangle> childRefs[2];
+    AABB childBoxes[2];
+    AABB childCentroids[2];
+    auto place = [&](int side, const BVHTriangle &ref)
+    {
+        childRefs[side].push_back(ref);
+        childBoxes[side].GrowToInclude(ref.box.minPoint);
+        childBoxes[side].GrowToInclude(ref.box.maxPoint);
+        childCentroids[side].GrowToInclude(ref.center);
+    };
+    if (useSpatial) {
+        int axis = spatial.axis;
+        float binMin = nodeBox.minPoint[axis];
+        float binScale = spatial.bins / (nodeBox.maxPoint[axis] - binMin);
+        for (const BVHTriangle &ref : refs) {
+            if (binOf(ref.box.maxPoint[axis], binMin, binScale, spatial.bins) < spatial.bin) {
+                place(0, ref);
+            } else if (binOf(ref.box.minPoint[axis], binMin, binScale, spatial.bins) >= spatial.bin) {
+                place(1, ref);
+            } else {
+                // Each side references the part of the triangle on its side of the plane
+                BVHTriangle parts[2] = {ref, ref};
+                parts[0].box = clipReference(ref, axis, ref.box.minPoint[axis], spatial.position);
+                parts[1].box = clipReference(ref, axis, spatial.position, ref.box.maxPoint[axis]);
+                bool placed = false;
+                for (int side = 0; side < 2; ++side) {
+                    if (isEmpty(parts[side].box))
+                        continue; // the triangle only touches the plane
+                    parts[side].center = (parts[side].box.minPoint + parts[side].box.maxPoint) * 0.5f;
+                    place(side, parts[side]);
+                    placed = true;
+                }
+                if (!placed)
+                    place(axisOf(ref.center, axis) < spatial.position ? 0 : 1, ref);
+            }
         }
-        bestSplit.axis = largestAxisIndex;
-        bestSplit.pos = pos;
-        // cost is not used in low quality
-        return bestSplit;
+    } else {
+        float binMin = axisOf(centroidBox.minPoint, split.axis);
+        float binScale = split.bins / (axisOf(centroidBox.maxPoint, split.axis) - binMin);
+        for (const BVHTriangle &ref : refs)
+            place(binOf(axisOf(ref.center, split.axis), binMin, binScale, split.bins) < split.bin ? 0 : 1, ref);
+    }
+    std::vector<BVHTriangle>().swap(refs);
+    if (childRefs[0].empty() || childRefs[1].empty()) {
+        makeLeaf(childRefs[0].empty() ? childRefs[1] : childRefs[0]); // every cut part fell on one side
+        return;
     }
 
-    float bestPos = 0.0f;
-    int bestAxis = 0;
-    int maxTests = count < 10 ? 3 : 5;
-    float maxAxis = max(size.x, max(size.y, size.z));
-    float bestCost = FLT_MAX;
+    // What is left of the budget is shared by the children in proportion to their references (not first come,
+    // first served: the tree does not depend on the order tasks run in)
+    int sizes[2] = {static_cast<int>(childRefs[0].size()), static_cast<int>(childRefs[1].size())};
+    int remaining = std::max(budget - (sizes[0] + sizes[1] - count), 0);
+    int leftBudget = static_cast<int>(static_cast<int64_t>(remaining) * sizes[0] / (sizes[0] + sizes[1]));
+    const int childBudget[2] = {leftBudget, remaining - leftBudget};
+
+    int childIndexLeft = list.add(Node(childBoxes[0], 0, 0));
+    list.add(Node(childBoxes[1], 0, 0));
+    list.nodes[parentIndex].startIndex = childIndexLeft;
+    for (int c = 0; c < 2; ++c) {
+        if (sizes[c] >= BVH_TASK_MIN_TRIANGLES) {
+            list.subtrees.emplace_back(childIndexLeft + c, std::make_shared<NodeList>());
+            NodeList *subtree = list.subtrees.back().second.get();
+            subtree->index = 0;
+            subtree->add(list.nodes[childIndexLeft + c]);
+            subtree->pending.swap(childRefs[c]);
+            AABB centroids = childCentroids[c];
+            int subtreeBudget = childBudget[c];
+            #pragma omp task firstprivate(subtree, centroids, subtreeBudget, depth)
+            this->splitSpatial(*subtree, 0, subtree->pending, centroids, subtreeBudget, depth + 1);
+        }
+        else {
+            this->splitSpatial(list, childIndexLeft + c, childRefs[c], childCentroids[c], childBudget[c], depth + 1);
+        }
+    }
+}
 
+// Spatial binning over the node bounds: a reference enters the bin of its minimum and exits the one of its maximum,
+// and grows every bin in between by the part of its triangle inside it. A plane then has the references entering
+// before it on its left and those exiting after it on its right, those counted on both sides being duplicated
+BVH::SpatialSplit BVH::chooseSpatialSplit(const std::vector<BVHTriangle> &refs, const AABB &nodeBox) const
+{
+    const int count = static_cast<int>(refs.size());
+    const int bins = std::min(binCount(), SAH_BINS_MIN + count / SAH_TRIANGLES_PER_BIN);
+    SpatialSplit best;
+    best.bins = bins;
     for (int axis = 0; axis < 3; ++axis) {
-        float axisSize;
-        float axisMin;
-        
-        switch(axis) {
-            case 0:
-                axisSize = size.x;
-                axisMin = node.boundingBox.minPoint.x;
-                break;
-            case 1:
-                axisSize = size.y;
-                axisMin = node.boundingBox.minPoint.y;
-                break;
-            case 2:
-                axisSize = size.z;
-                axisMin = node.boundingBox.minPoint.z;
-                break;
+        float binMin = nodeBox.minPoint[axis];
+        float extent = nodeBox.maxPoint[axis] - binMin;
+        if (extent <= 0.0f)
+            continue;
+        float binScale = bins / extent;
+        float binWidth = extent / bins;
+
+        SAHBin binned[SAH_BINS];
+        int enter[SAH_BINS] = {};
+        int exit[SAH_BINS] = {};
+        for (int b = 0; b < bins; ++b)
+            binned[b].clear();
+        for (const BVHTriangle &ref : refs) {
+            int first = binOf(ref.box.minPoint[axis], binMin, binScale, bins);
+            int last = binOf(ref.box.maxPoint[axis], binMin, binScale, bins);
+            enter[first]++;
+            exit[last]++;
+            for (int b = first; b <= last; ++b) {
+                AABB part = first == last ? ref.box : clipReference(ref, axis, binMin + b * binWidth, binMin + (b + 1) * binWidth);
+                if (isEmpty(part))
+                    continue;
+                SAHBin &bin = binned[b];
+                for (int k = 0; k < 3; ++k) {
+                    bin.min[k] = std::min(bin.min[k], part.minPoint[k]);
+                    bin.max[k] = std::max(bin.max[k], part.maxPoint[k]);
+                }
+                bin.count++;
+            }
         }
 
-        int numSplitTests = ceilToInt(maxTests * (axisSize / maxAxis));
-        numSplitTests = max(numSplitTests, 2);
-
-        for (int i = 0; i < numSplitTests; ++i) {
-            float splitT = (i + 1) / static_cast<float>(numSplitTests + 1);
-            float splitPos = axisMin + axisSize * splitT;
-            float cost = evaluateSplit(axis, splitPos, start, count);
-            if (cost < bestCost) {
-                bestCost = cost;
-                bestPos = splitPos;
-                bestAxis = axis;
+        float rightArea[SAH_BINS];
+        int rightCount[SAH_BINS];
+        SAHBin right;
+        right.clear();
+        int exits = 0;
+        for (int b = bins - 1; b > 0; --b) {
+            right.grow(binned[b]);
+            exits += exit[b];
+            rightArea[b] = right.area();
+            rightCount[b] = exits;
+        }
+
+        SAHBin left;
+        left.clear();
+        int enters = 0;
+        for (int b = 1; b < bins; ++b) {
+            left.grow(binned[b - 1]);
+            enters += enter[b - 1];
+            if (enters == 0 || rightCount[b] == 0)
+                continue;
+            float cost = left.area() * enters + rightArea[b] * rightCount[b];
+            if (cost < best.cost) {
+                best.axis = axis;
+                best.bin = b;
+                best.position = binMin + b * binWidth;
+                best.cost = cost;
+                best.duplicates = enters + rightCount[b] - count;
             }
         }
     }
+    return best;
+}
 
-    bestSplit.axis = bestAxis;
-    bestSplit.pos = bestPos;
-    bestSplit.cost = bestCost;
+AABB BVH::clipReference(const BVHTriangle &ref, int axis, float lo, float hi) const
+{
+    const unsigned int *v = &(*buildIndices)[3 * static_cast<size_t>(ref.index)];
+    const vec3 p[3] = {(*buildPositions)[v[0]], (*buildPositions)[v[1]], (*buildPositions)[v[2]]};
+
+    // Vertices inside the slab and the points where the edges cross its planes
+    AABB part;
+    for (int k = 0; k < 3; ++k) {
+        const vec3 &a = p[k];
+        const vec3 &b = p[(k + 1) % 3];
+        float da = a[axis];
+        float db = b[axis];
+        if (da >= lo && da <= hi)
+            part.GrowToInclude(a);
+        for (float plane : {lo, hi}) {
+            if ((da < plane && plane < db) || (db < plane && plane < da)) {
+                vec3 crossing = a + (b - a) * ((plane - da) / (db - da));
+                crossing[axis] = plane;
+                part.GrowToInclude(crossing);
+            }
+        }
+    }
+    for (int k = 0; k < 3; ++k) {
+        part.minPoint[k] = std::max(part.minPoint[k], ref.box.minPoint[k]);
+        part.maxPoint[k] = std::min(part.maxPoint[k], ref.box.maxPoint[k]);
+    }
+    return part;
+}
 
-    return bestSplit;
+void BVH::appendNodes(NodeList &list, int rootSlot, std::vector<BVHTriangle> *references)
+{
+    // Local node i > 0 lands at base + i - 1, after every node appended so far (children stay after their parent)
+    int base = static_cast<int>(gpuNodes.size());
+    int referenceBase = references ? static_cast<int>(references->size()) : 0;
+    auto slot = [&](int local) { return local == 0 ? rootSlot : base + local - 1; };
+    gpuNodes.resize(gpuNodes.size() + list.nodes.size() - 1);
+    for (int i = 0; i < list.nodeCount(); ++i) {
+        GPUBVHNode &node = gpuNodes[slot(i)];
+        node = list.nodes[i].toGPU();
+        if (node.triangleCount == 0)
+            node.startIndex = slot(node.startIndex);
+        else
+            node.startIndex += referenceBase;
+    }
+    std::vector<Node>().swap(list.nodes);
+    if (references)
+        references->insert(references->end(), list.references.begin(), list.references.end());
+    std::vector<BVHTriangle>().swap(list.references);
+    for (auto &subtree : list.subtrees) {
+        appendNodes(*subtree.second, slot(subtree.first), references);
+        subtree.second.reset();
+    }
 }
\ No newline at end of file
@@ -1,6 +1,13 @@
 #pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
 #include <vector>
 #include "../shapes/Triangle.h"
+#include "../utils/mappedFile/MappedFile.h"
+#include "../utils/arena/Arena.h"
 #include "../math/aabb.h"
 #include "../defines/Defines.h"
 
@@ -10,14 +17,44 @@ class Mesh;
 #define QUALITY_DISABLED -1
 #define QUALITY_LOW 0
 #define QUALITY_HIGH 2
+// Spatial split BVH (SBVH): nodes whose object split leaves overlapping children also try splitting space,
+// a triangle straddling the plane then being referenced by both children (clipped to each side)
+#define QUALITY_SPATIAL 3
+// Constants below that change the tree are part of the mesh cache key: add new ones to Mesh::cacheKey too
 #define MAX_DEPTH 32
+// Binned SAH builder: centroid bins per axis (QUALITY_LOW uses fewer for faster, slightly worse trees)
+#define SAH_BINS 32
+#define SAH_BINS_LOW 8
+// Nodes use SAH_BINS_MIN bins plus one per SAH_TRIANGLES_PER_BIN triangles, up to the above
+#define SAH_BINS_MIN 4
+#define SAH_TRIANGLES_PER_BIN 4
+// Parallel build (OpenMP tasks): children with at least this many triangles are built by their own task,
+// nodes with at least BVH_PARALLEL_BINNING_MIN_TRIANGLES bin their triangles in chunks of BVH_BINNING_CHUNK
+// The tree does not depend on the thread count: tasks are spliced back in the order they were spawned
+// The build uses the caller's OpenMP team size, and a single thread when called inside a parallel region
+#define BVH_TASK_MIN_TRIANGLES 2048
+#define BVH_PARALLEL_BINNING_MIN_TRIANGLES 32768
+#define BVH_BINNING_CHUNK 8192
+// Cost of visiting an inner node relative to intersecting one triangle (the same weights as sahCost)
+#define SAH_TRAVERSAL_COST 1.0f
+// SBVH: spatial splits are searched when the children of the object split overlap by more than this fraction
+// of the root area, and may duplicate up to this fraction of the triangle count in references overall
+#define SBVH_OVERLAP_RATIO 1e-5f
+#define SBVH_MAX_REFERENCE_GROWTH 0.3f
+// Node rotations after the build: at most this many passes over the tree, stopping once a pass lowers the SAH
+// cost by less than BVH_OPTIMIZE_MIN_GAIN (relative)
+#define BVH_OPTIMIZE_PASSES 8
+#define BVH_OPTIMIZE_MIN_GAIN 0.001f
+// Leaf size histogram of a report: leaves of 1 to BVH_REPORT_LEAF_SIZES triangles, the last bucket counting larger ones too
+#define BVH_REPORT_LEAF_SIZES 16
+// A refitted tree is rebuilt once its SAH cost exceeds this factor times its cost when built
+#define REFIT_MAX_SAH_GROWTH 1.5f
 
 class BVH : public Shape
 {
 public:
     ~BVH() {
-        nodes.clear();
-        triangles.clear();
+        triangleOrder.clear();
         buildTriangles.clear();
     }
 
@@ -55,20 +92,27 @@ public:
         AABB box;
         int index;
 
-        BVHTriangle(const Triangle &tri, int idx)
+        BVHTriangle(const vec3 &v0, const vec3 &v1, const vec3 &v2, int idx)
         {
-            center = (tri.getV0() + tri.getV1() + tri.getV2()) / 3.0f;
-            box.GrowToInclude(tri);
+            center = (v0 + v1 + v2) / 3.0f;
+            box.GrowToInclude(v0);
+            box.GrowToInclude(v1);
+            box.GrowToInclude(v2);
             index = idx;
         }
-
-        
     };
 
+    // Nodes built by one task. Node 0 is the task's root, a copy of a node reserved in the parent list
+    // Child indices are local; children whose subtree was handed to another task are listed in subtrees
     struct NodeList
     {
         std::vector<Node> nodes;
         int index;
+        std::vector<std::pair<int, std::shared_ptr<NodeList>>> subtrees; // (local node index, its subtree)
+        // SBVH only: the references of the task's leaves (leaf start indices are local to it), and those of its
+        // root until it is split
+        std::vector<BVHTriangle> references;
+        std::vector<BVHTriangle> pending;
 
         int add(Node node)
         {
@@ -77,29 +121,150 @@ public:
         }
 
         int nodeCount() const { return static_cast<int>(nodes.size()); }
+
+        // Nodes of the whole subtree (the roots of nested lists are counted once, in their parent)
+        size_t totalNodeCount() const
+        {
+            size_t count = nodes.size();
+            for (const auto &subtree : subtrees)
+                count += subtree.second->totalNodeCount() - 1;
+            return count;
+        }
+
+        // Memory held by the lists of the whole subtree
+        size_t totalBytes() const
+        {
+            size_t bytes = nodes.capacity() * sizeof(Node) + (references.capacity() + pending.capacity()) * sizeof(BVHTriangle);
+            for (const auto &subtree : subtrees)
+                bytes += subtree.second->totalBytes();
+            return bytes;
+        }
     };
 
+    // Best binned split of a node: bins [0, bin) of the axis go left
     struct Split
     {
-        int axis;
-        float pos;
-        float cost;
+        int axis = -1; // -1 if no split is possible (all centroids in one bin)
+        int bin = 0;
+        int bins = 0; // bin count used for the node
+        float cost = FLT_MAX; // SAH cost of the two children, without the traversal of the node
+        AABB leftBox;
+        AABB rightBox;
+    };
+
+    // Best spatial split of a node: references are cut by the plane at position along axis
+    struct SpatialSplit
+    {
+        int axis = -1;
+        int bin = 0;
+        int bins = 0;
+        float position = 0.0f;
+        float cost = FLT_MAX;
+        int duplicates = 0; // references added by cutting the straddling triangles in two
     };
 
 
+    // Quality of a finished tree
+    struct Report
+    {
+        float sahCost = 0.0f;
+        size_t nodeCount = 0;
+        size_t leafCount = 0;
+        size_t referenceCount = 0; // triangles in the leaves, more than the mesh's for an SBVH
+        int maxDepth = 0;
+        float averageDepth = 0.0f; // of the leaves
+        // Area where the two children of a node overlap (rays through it visit both), over the area of the node,
+        // summed over the inner nodes
+        float overlapRatio = 0.0f;
+        std::vector<size_t> leafSizes; // leafSizes[k]: leaves of k + 1 triangles (see BVH_REPORT_LEAF_SIZES)
+        size_t peakBuildMemory = 0;    // 0 for a tree read from the cache
+
+        // Multi-line summary for the logs and the UI
+        std::string toString() const;
+    };
+
 public:
-    std::vector<Triangle> triangles;
-    std::vector<Node> nodes;
+    // Mesh triangle index of each BVH triangle: leaves cover ranges of this order
+    std::vector<uint32_t> triangleOrder;
 
+    // Build state, released once the tree is built
     NodeList nodesList;
-    std::vector<BVHTriangle> buildTriangles;
+    std::vector<BVHTriangle> buildTriangles; // SBVH: the references of the leaves, gathered in tree order
     int quality;
 
     BVH(const Mesh &mesh, int qualityLevel = QUALITY_HIGH);
+    // Tree over an index buffer of the given positions (a mesh level of detail shares its mesh's positions)
+    BVH(const std::vector<vec3> &positions, const std::vector<unsigned int> &indices, int qualityLevel = QUALITY_HIGH);
+    // Tree read from a mapped .rtmesh cache: the GPU arrays point into the mapping (no build, no copy)
+    BVH(std::shared_ptr<const MappedFile> cacheFile, const GPUBVHNode *cachedNodes, size_t nodeCount, const uint32_t *cachedTriangleOrder,
+        const GPUTriangle *cachedTriangles, size_t triangleCount);
+
+    // Update the node bounds bottom-up from the mesh's current vertices, keeping the tree topology (O(n))
+    // For deformations (scale, animation): returns false when the refitted tree got too costly to trace
+    // (see REFIT_MAX_SAH_GROWTH) and should be rebuilt
+    bool refit(const Mesh &mesh);
+    bool refit(const std::vector<vec3> &positions, const std::vector<unsigned int> &indices);
+    // Surface area heuristic cost of the tree, relative to its root area
+    float sahCost() const;
+    Report report() const;
+    // Lower the SAH cost of the built tree by node rotations (Kensler 2008): a child of a node trades places with
+    // a grandchild under its sibling whenever that shrinks the sibling. Leaves and their triangles are kept, the
+    // nodes are laid out again afterwards. Costs about a tenth of a build, for a percent or so of SAH cost
+    // Returns the SAH cost reached
+    float optimize(int maxPasses = BVH_OPTIMIZE_PASSES);
+    // A topology is identified per build; the bounds version counts its refits
+    inline uint64_t getTopologyId() const { return topologyId; }
+    inline uint32_t getBoundsVersion() const { return boundsVersion; }
+    // Most memory the build held at once (scratch, node lists and the finished arrays), estimated from the
+    // capacities of its buffers at the end of each phase
+    inline size_t getPeakBuildMemory() const { return peakBuildMemory; }
+
+    // Finished tree in the layout uploaded to the device
+    inline const GPUBVHNode *getGPUNodes() const { return mappedNodes ? mappedNodes : gpuNodes.data(); }
+    inline size_t getGPUNodeCount() const { return mappedNodes ? mappedNodeCount : gpuNodes.size(); }
+    inline const uint32_t *getTriangleOrder() const { return mappedTriangleOrder ? mappedTriangleOrder : triangleOrder.data(); }
+    inline const GPUTriangle *getGPUTriangles() const { return mappedTriangles ? mappedTriangles : gpuTriangles.data(); }
+    inline size_t getGPUTriangleCount() const { return mappedTriangles ? mappedTriangleCount : gpuTriangles.size(); }
 
 private:
-    void split(int parentIndex, int triGlobalStart, int triNum, int depth=0);
-    Split chooseSplit(Node node, int start, int count);
-    float evaluateSplit(int splitAxis, float splitPos, int start, int count);
-    float NodeCost(vec3 size, int numTris);
+    inline static std::atomic<uint64_t> nextTopologyId{1}; // trees are built on loader threads too
+    uint64_t topologyId = nextTopologyId++;
+    uint32_t boundsVersion = 0;
+    float buildCost = -1.0f; // SAH cost after the build, computed on first refit for a cached tree
+    size_t peakBuildMemory = 0;
+
+    // Object build state: bounds and centroid of each mesh triangle, in the build's arena
+    const BVHTriangle *buildPrimitives = nullptr;
+
+    // SBVH build state: the clipped triangles, and the area the overlap threshold is relative to
+    const std::vector<vec3> *buildPositions = nullptr;
+    const std::vector<unsigned int> *buildIndices = nullptr;
+    float rootArea = 0.0f;
+
+    std::vector<GPUBVHNode> gpuNodes;
+    std::vector<GPUTriangle> gpuTriangles;
+    std::shared_ptr<const MappedFile> cacheFile;
+    const GPUBVHNode *mappedNodes = nullptr;
+    size_t mappedNodeCount = 0;
+    const uint32_t *mappedTriangleOrder = nullptr;
+    const GPUTriangle *mappedTriangles = nullptr;
+    size_t mappedTriangleCount = 0;
+
+    // A tree mapped from the cache becomes a copy before it is modified
+    void detachFromCache();
+    // centroidBox bounds the centers of the node's triangles, the binning range
+    void split(NodeList &list, int parentIndex, int triGlobalStart, int triNum, const AABB &centroidBox, int depth = 0);
+    // triangles[i] is the i-th triangle of the node (see OrderedTriangles in bvh.cpp)
+    template <typename Triangles>
+    Split chooseSplit(Triangles triangles, int count, const AABB &centroidBox) const;
+    // SBVH: the node's references are handed over (and released once partitioned), budget bounds the references
+    // its subtree may add
+    void splitSpatial(NodeList &list, int parentIndex, std::vector<BVHTriangle> &refs, const AABB &centroidBox, int budget, int depth = 0);
+    SpatialSplit chooseSpatialSplit(const std::vector<BVHTriangle> &refs, const AABB &nodeBox) const;
+    // Bounds of the part of a reference's triangle between lo and hi along axis, within the reference's bounds
+    AABB clipReference(const BVHTriangle &ref, int axis, float lo, float hi) const;
+    // Append the nodes of a task to the finished tree, its root going to rootSlot (and, for an SBVH, its leaf
+    // references to references); the list is released once spliced
+    void appendNodes(NodeList &list, int rootSlot, std::vector<BVHTriangle> *references = nullptr);
+    int binCount() const { return quality == QUALITY_LOW ? SAH_BINS_LOW : SAH_BINS; }
 };
\ No newline at end of file
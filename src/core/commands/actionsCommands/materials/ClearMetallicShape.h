@@ -9,7 +9,7 @@
 class ClearMetallicShape : public ICommand {
 private:
     Shape* shape;
-    ppmLoader::ImageRGB previousMetallic;
+    LazyImage previousMetallic;
     int commandID;
     inline static int nextCommandID = 0;
 public:
@@ -18,20 +18,21 @@ public:
         Material* mat = shape->getMaterial();
         if (mat) {
             try {
-                previousMetallic = mat->getMetallic();
+                previousMetallic = mat->getMetallicMap();
             } catch (...) {
                 // If getting previous metallic fails, initialize to empty
-                previousMetallic = ppmLoader::ImageRGB{0, 0, {}};
+                previousMetallic = LazyImage();
             }
         } else { // Create a new material if none exists
-            shape->setMaterial(new Material());
+            SceneManager::getInstance().setShapeMaterial(shape, new Material());
             try {
-                previousMetallic = shape->getMaterial()->getMetallic();
+                previousMetallic = shape->getMaterial()->getMetallicMap();
             } catch (...) {
                 // If getting previous metallic fails, initialize to empty
-                previousMetallic = ppmLoader::ImageRGB{0, 0, {}};
+                previousMetallic = LazyImage();
             }
         }
+        previousMetallic.release(); // keep the path, not the pixels, on the undo stack
     }
     void execute() override {
         shape->getMaterial()->removeMetallic();
@@ -9,7 +9,7 @@
 class ClearNormalShape : public ICommand {
 private:
     Shape* shape;
-    ppmLoader::ImageRGB previousNormal;
+    LazyImage previousNormal;
     int commandID;
     inline static int nextCommandID = 0;
 public:
@@ -18,20 +18,21 @@ public:
         Material* mat = shape->getMaterial();
         if (mat) {
             try {
-                previousNormal = mat->getNormals();
+                previousNormal = mat->getNormalsMap();
             } catch (...) {
                 // If getting previous normal fails, initialize to empty
-                previousNormal = ppmLoader::ImageRGB{0, 0, {}};
+                previousNormal = LazyImage();
             }
         } else { // Create a new material if none exists
-            shape->setMaterial(new Material());
+            SceneManager::getInstance().setShapeMaterial(shape, new Material());
             try {
-                previousNormal = shape->getMaterial()->getNormals();
+                previousNormal = shape->getMaterial()->getNormalsMap();
             } catch (...) {
                 // If getting previous normal fails, initialize to empty
-                previousNormal = ppmLoader::ImageRGB{0, 0, {}};
+                previousNormal = LazyImage();
             }
         }
+        previousNormal.release(); // keep the path, not the pixels, on the undo stack
     }
     void execute() override {
         shape->getMaterial()->removeNormals();
@@ -9,7 +9,7 @@
 class ClearTextureShape : public ICommand {
 private:
     Shape* shape;
-    ppmLoader::ImageRGB previousTexture;
+    LazyImage previousTexture;
     int commandID;
     inline static int nextCommandID = 0;
 public:
@@ -18,20 +18,21 @@ public:
         Material* mat = shape->getMaterial();
         if (mat) {
             try {
-                previousTexture = mat->getImage();
+                previousTexture = mat->getImageMap();
             } catch (...) {
                 // If getting previous texture fails, initialize to empty
-                previousTexture = ppmLoader::ImageRGB{0, 0, {}};
+                previousTexture = LazyImage();
             }
         } else { // Create a new material if none exists
-            shape->setMaterial(new Material());
+            SceneManager::getInstance().setShapeMaterial(shape, new Material());
             try {
-                previousTexture = shape->getMaterial()->getImage();
+                previousTexture = shape->getMaterial()->getImageMap();
             } catch (...) {
                 // If getting previous texture fails, initialize to empty
-                previousTexture = ppmLoader::ImageRGB{0, 0, {}};
+                previousTexture = LazyImage();
             }
         }
+        previousTexture.release(); // keep the path, not the pixels, on the undo stack
     }
     void execute() override {
         shape->getMaterial()->remove_texture();
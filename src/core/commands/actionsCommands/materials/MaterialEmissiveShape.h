@@ -9,31 +9,32 @@
 class SetEmissiveShape : public ICommand {
 private:
     Shape* shape;
-    ppmLoader::ImageRGB previousEmissive;
-    ppmLoader::ImageRGB newEmissive;
+    LazyImage previousEmissive;
+    LazyImage newEmissive;
     int commandID;
     inline static int nextCommandID = 0;
     std::string pathFileEmissive;
 public:
-    SetEmissiveShape(Shape* shape, ppmLoader::ImageRGB newEmissive, const std::string& pathFileEmissive)
+    SetEmissiveShape(Shape* shape, const LazyImage &newEmissive, const std::string& pathFileEmissive)
         : shape(shape), newEmissive(newEmissive), commandID(nextCommandID++), pathFileEmissive(pathFileEmissive) {
         Material* mat = shape->getMaterial();
         if (mat) {
             try {
-                previousEmissive = mat->getEmissive();
+                previousEmissive = mat->getEmissiveMap();
             } catch (...) {
                 // If getting previous emissive fails, initialize to empty
-                previousEmissive = ppmLoader::ImageRGB{0, 0, {}};
+                previousEmissive = LazyImage();
             }
         } else { // Create a new material if none exists
-            shape->setMaterial(new Material());
+            SceneManager::getInstance().setShapeMaterial(shape, new Material());
             try {
-                previousEmissive = shape->getMaterial()->getEmissive();
+                previousEmissive = shape->getMaterial()->getEmissiveMap();
             } catch (...) {
                 // If getting previous emissive fails, initialize to empty
-                previousEmissive = ppmLoader::ImageRGB{0, 0, {}};
+                previousEmissive = LazyImage();
             }
         }
+        previousEmissive.release(); // keep the path, not the pixels, on the undo stack
     }
     void execute() override {
         shape->getMaterial()->setEmissive(newEmissive);
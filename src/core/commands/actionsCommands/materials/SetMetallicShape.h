@@ -9,31 +9,32 @@
 class SetMetallicShape : public ICommand {
 private:
     Shape* shape;
-    ppmLoader::ImageRGB previousMetallic;
-    ppmLoader::ImageRGB newMetallic;
+    LazyImage previousMetallic;
+    LazyImage newMetallic;
     int commandID;
     inline static int nextCommandID = 0;
     std::string pathFileMetal;
 public:
-    SetMetallicShape(Shape* shape, ppmLoader::ImageRGB newMetal, const std::string& pathFileMetal)
+    SetMetallicShape(Shape* shape, const LazyImage &newMetal, const std::string& pathFileMetal)
         : shape(shape), newMetallic(newMetal), commandID(nextCommandID++), pathFileMetal(pathFileMetal) {
         Material* mat = shape->getMaterial();
         if (mat) {
             try {
-                previousMetallic = mat->getMetallic();
+                previousMetallic = mat->getMetallicMap();
             } catch (...) {
                 // If getting previous metallic fails, initialize to empty
-                previousMetallic = ppmLoader::ImageRGB{0, 0, {}};
+                previousMetallic = LazyImage();
             }
         } else { // Create a new material if none exists
-            shape->setMaterial(new Material());
+            SceneManager::getInstance().setShapeMaterial(shape, new Material());
             try {
-                previousMetallic = shape->getMaterial()->getMetallic();
+                previousMetallic = shape->getMaterial()->getMetallicMap();
             } catch (...) {
                 // If getting previous metallic fails, initialize to empty
-                previousMetallic = ppmLoader::ImageRGB{0, 0, {}};
+                previousMetallic = LazyImage();
             }
         }
+        previousMetallic.release(); // keep the path, not the pixels, on the undo stack
     }
     void execute() override {
         shape->getMaterial()->setMetallic(newMetallic);
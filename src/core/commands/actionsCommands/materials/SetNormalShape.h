@@ -9,31 +9,32 @@
 class SetNormalShape : public ICommand {
 private:
     Shape* shape;
-    ppmLoader::ImageRGB previousNormal;
-    ppmLoader::ImageRGB newNormal;
+    LazyImage previousNormal;
+    LazyImage newNormal;
     int commandID;
     std::string pathFileNormalMap;
     inline static int nextCommandID = 0;
 public:
-    SetNormalShape(Shape* shape, ppmLoader::ImageRGB newNorm, const std::string& pathFile)
+    SetNormalShape(Shape* shape, const LazyImage &newNorm, const std::string& pathFile)
         : shape(shape), newNormal(newNorm), commandID(nextCommandID++), pathFileNormalMap(pathFile) {
         Material* mat = shape->getMaterial();
         if (mat) {
             try {
-                previousNormal = mat->getNormals();
+                previousNormal = mat->getNormalsMap();
             } catch (...) {
                 // If getting previous normal fails, initialize to empty
-                previousNormal = ppmLoader::ImageRGB{0, 0, {}};
+                previousNormal = LazyImage();
             }
         } else { // Create a new material if none exists
-            shape->setMaterial(new Material());
+            SceneManager::getInstance().setShapeMaterial(shape, new Material());
             try {
-                previousNormal = shape->getMaterial()->getNormals();
+                previousNormal = shape->getMaterial()->getNormalsMap();
             } catch (...) {
                 // If getting previous normal fails, initialize to empty
-                previousNormal = ppmLoader::ImageRGB{0, 0, {}};
+                previousNormal = LazyImage();
             }
         }
+        previousNormal.release(); // keep the path, not the pixels, on the undo stack
     }
     void execute() override {
         shape->getMaterial()->setNormals(newNormal);
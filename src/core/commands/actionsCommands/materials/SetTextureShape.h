@@ -9,31 +9,32 @@
 class SetTextureShape : public ICommand {
 private:
     Shape* shape;
-    ppmLoader::ImageRGB previousTexture;
-    ppmLoader::ImageRGB newTexture;
+    LazyImage previousTexture;
+    LazyImage newTexture;
     int commandID;
     std::string pathFileTexture;
     inline static int nextCommandID = 0;
 public:
-    SetTextureShape(Shape* shape, ppmLoader::ImageRGB newTex, const std::string& pathFile)
+    SetTextureShape(Shape* shape, const LazyImage &newTex, const std::string& pathFile)
         : shape(shape), newTexture(newTex), commandID(nextCommandID++), pathFileTexture(pathFile) {
         Material* mat = shape->getMaterial();
         if (mat) {
             try {
-                previousTexture = mat->getImage();
+                previousTexture = mat->getImageMap();
             } catch (...) {
                 // If getting previous texture fails, initialize to empty
-                previousTexture = ppmLoader::ImageRGB{0, 0, {}};
+                previousTexture = LazyImage();
             }
         } else { // Create a new material if none exists
-            shape->setMaterial(new Material());
+            SceneManager::getInstance().setShapeMaterial(shape, new Material());
             try {
-                previousTexture = shape->getMaterial()->getImage();
+                previousTexture = shape->getMaterial()->getImageMap();
             } catch (...) {
                 // If getting previous texture fails, initialize to empty
-                previousTexture = ppmLoader::ImageRGB{0, 0, {}};
+                previousTexture = LazyImage();
             }
         }
+        previousTexture.release(); // keep the path, not the pixels, on the undo stack
     }
     void execute() override {
         shape->getMaterial()->set_texture(newTexture);
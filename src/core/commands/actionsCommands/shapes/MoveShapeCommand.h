@@ -51,8 +51,7 @@ public:
             {
                 Mesh *mesh = static_cast<Mesh *>(shape);
                 mesh->translate(newPosition - previousPosition); // Move all vertices
-                mesh->generateCpuTriangles();
-                mesh->rebuildBVH();
+                mesh->updateBVH();
             }
             CommandsManager::getInstance().notifyShapesChanged();
         }
@@ -69,9 +68,7 @@ public:
             {
                 Mesh *mesh = static_cast<Mesh *>(shape);
                 mesh->translate(previousPosition - oldPos); // Move all vertices
-                mesh->generateCpuTriangles();
-
-                mesh->rebuildBVH();
+                mesh->updateBVH();
             }
             CommandsManager::getInstance().notifyShapesChanged();
         }
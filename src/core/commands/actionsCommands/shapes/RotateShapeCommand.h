@@ -45,8 +45,7 @@ public:
         {
             Mesh *mesh = static_cast<Mesh *>(shape);
             mesh->rotate(newRotation - previousRotation); // Rotate all vertices
-            mesh->generateCpuTriangles();
-            mesh->rebuildBVH();
+            mesh->updateBVH();
         }
         if (shape) CommandsManager::getInstance().notifyShapesChanged();
     }
@@ -60,8 +59,7 @@ public:
         {
             Mesh *mesh = static_cast<Mesh *>(shape);
             mesh->rotate(previousRotation - newRotation); // Rotate all vertices
-            mesh->generateCpuTriangles();
-            mesh->rebuildBVH();
+            mesh->updateBVH();
         }
         if (shape) CommandsManager::getInstance().notifyShapesChanged();
     }
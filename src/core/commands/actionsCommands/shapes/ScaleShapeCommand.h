@@ -46,8 +46,7 @@ public:
             Mesh *mesh = static_cast<Mesh *>(shape);
             vec3 scaleFactor(newScale.x / previousScale.x, newScale.y / previousScale.y, newScale.z / previousScale.z);
             mesh->scale(scaleFactor);
-            mesh->generateCpuTriangles();
-            mesh->rebuildBVH();
+            mesh->updateBVH();
         }
         if (shape) CommandsManager::getInstance().notifyShapesChanged();
     }
@@ -61,8 +60,7 @@ public:
             Mesh *mesh = static_cast<Mesh *>(shape);
             vec3 scaleFactor(previousScale.x / newScale.x, previousScale.y / newScale.y, previousScale.z / newScale.z);
             mesh->scale(scaleFactor);
-            mesh->generateCpuTriangles();
-            mesh->rebuildBVH();
+            mesh->updateBVH();
         }
         if (shape) CommandsManager::getInstance().notifyShapesChanged();
     }
@@ -54,15 +54,34 @@ struct __attribute__((aligned(16))) GPUTriangle
     float _padding[3]; // 12 bytes (offset 52)
 }; // Total: 64 bytes
 
+// Coarser levels of detail a mesh can have besides its full-resolution BVH
+#define MAX_MESH_LODS 3
+
+// Device storage of mesh geometry (GPUBVH::vertex_format)
+enum VertexFormat
+{
+    VERTEX_TRIANGLES = 0, // a GPUTriangle (three padded positions) per BVH triangle
+    VERTEX_FLOAT = 1,     // packed float3 vertices + 3 indices per BVH triangle
+    VERTEX_QUANTIZED = 2  // 16-bit vertices relative to the mesh bounds (4 ushorts) + 3 indices per BVH triangle
+};
+
 struct __attribute__((aligned(16))) GPUBVH
 {
-    int node_offset;      // 4 bytes (offset 0)
-    int triangle_offset;  // 4 bytes (offset 4)
-    int node_count;       // 4 bytes (offset 8)
-    int triangle_count;   // 4 bytes (offset 12)
-    int material_index;   // 4 bytes (offset 16)
-    float _padding[11];   // 44 bytes (offset 20)
-}; // Total: 64 bytes
+    int node_offset;                         // 4 bytes (offset 0)
+    int triangle_offset;                     // 4 bytes (offset 4)
+    int node_count;                          // 4 bytes (offset 8)
+    int triangle_count;                      // 4 bytes (offset 12)
+    int material_index;                      // 4 bytes (offset 16)
+    int lod_count;                           // 4 bytes (offset 20) - coarser levels in use
+    int lod_node_offset[MAX_MESH_LODS];      // 12 bytes (offset 24)
+    int lod_triangle_offset[MAX_MESH_LODS];  // 12 bytes (offset 36)
+    int lod_triangle_count[MAX_MESH_LODS];   // 12 bytes (offset 48)
+    float lod_hit_offset[MAX_MESH_LODS];     // 12 bytes (offset 60) - hits closer than this to a ray starting on the mesh are ignored
+    int vertex_offset;                       // 4 bytes (offset 72) - first vertex of the mesh in the vertex buffer
+    int vertex_format;                       // 4 bytes (offset 76) - VertexFormat
+    Vec3 quantization_origin;                // 16 bytes (offset 80) - VERTEX_QUANTIZED: position = origin + q * step
+    Vec3 quantization_step;                  // 16 bytes (offset 96)
+}; // Total: 112 bytes
 
 // Struct GPU-compatible (for the kernel)
 typedef struct __attribute__((aligned(16)))
@@ -84,6 +103,37 @@ enum TextureType
     Texture_Image = 1
 };
 
+// Storage of a texture level on the GPU (GPUTexture::format)
+enum TextureFormat
+{
+    TEXTURE_RGBA8 = 0, // rectangle of the RGBA8 atlas image, hardware filtered
+    TEXTURE_BC1 = 1,   // 4x4 blocks, RGB 5:6:5 endpoints (albedo)
+    TEXTURE_BC4 = 2,   // 4x4 blocks, one channel (metal, emissive)
+    TEXTURE_BC5 = 3,   // 4x4 blocks, two channels (normal maps, blue rebuilt)
+    TEXTURE_R8 = 4     // one byte per texel in the block buffer (single-channel maps that could not be packed)
+};
+
+// GPUMaterial::packed_maps flags: a single-channel map stored in the alpha of another map of the same size
+// so that one fetch returns both
+enum MaterialPacking
+{
+    PACK_METAL_IN_NORMAL_ALPHA = 1,
+    PACK_EMISSIVE_IN_ALBEDO_ALPHA = 2
+};
+
+// GPU-compatible texture descriptor: one mip level, either a rectangle of the atlas image
+// or a run of compressed blocks
+struct __attribute__((aligned(16))) GPUTexture
+{
+    int x;           // 4 bytes (offset 0)  - first texel column (inside the gutter), or first block for BC formats
+    int y;           // 4 bytes (offset 4)  - first texel row (inside the gutter)
+    int width;       // 4 bytes (offset 8)
+    int height;      // 4 bytes (offset 12)
+    int level_count; // 4 bytes (offset 16) - mip levels from this one down to 1x1, stored contiguously
+    int format;      // 4 bytes (offset 20) - TextureFormat
+    int _padding[2]; // 8 bytes (offset 24)
+}; // Total: 32 bytes
+
 struct __attribute__((aligned(16))) GPUMaterial
 {
     Vec3 ambient;  // 16 bytes (offset 0)
@@ -107,24 +157,25 @@ struct __attribute__((aligned(16))) GPUMaterial
     int texture_width;     // 4 bytes (offset 104)
     int texture_height;    // 4 bytes (offset 108)
 
-    int texture_offset;    // 4 bytes (offset 112)
+    int texture_index;     // 4 bytes (offset 112) - index in the texture table, -1 if none
     int has_normal_map;    // 4 bytes (offset 116)
     int normal_map_width;  // 4 bytes (offset 120)
     int normal_map_height; // 4 bytes (offset 124)
 
-    int normal_map_offset; // 4 bytes (offset 128)
+    int normal_map_index;  // 4 bytes (offset 128)
     int has_metal_map;     // 4 bytes (offset 132)
     int metal_map_width;   // 4 bytes (offset 136)
     int metal_map_height;  // 4 bytes (offset 140)
 
-    int metal_map_offset;    // 4 bytes (offset 144)
+    int metal_map_index;     // 4 bytes (offset 144)
     int has_emissive_map;    // 4 bytes (offset 148)
     int emissive_map_width;  // 4 bytes (offset 152)
     int emissive_map_height; // 4 bytes (offset 156)
 
-    int emissive_map_offset; // 4 bytes (offset 160)
-    int material_id;         // 4 bytes (offset 164)
-    int _padding2[2];        // 8 bytes (offset 168) - padding for 16-byte alignment
+    int emissive_map_index;  // 4 bytes (offset 160)
+    int material_id;         // 4 bytes (offset 164) - slot of the material in the array (GPU index), -1 if unused
+    int packed_maps;         // 4 bytes (offset 168) - MaterialPacking flags
+    int _padding2;           // 4 bytes (offset 172) - padding for 16-byte alignment
 }; // Total: 176 bytes
 
 // GPU-compatible AABB structure
@@ -142,4 +193,17 @@ struct __attribute__((aligned(16))) GPUBVHNode
     int startIndex;                    // 4 bytes (offset 32)
     int triangleCount;                 // 4 bytes (offset 36)
     int _padding3[2];                  // 8 bytes (offset 40) -
-}; // Total: 48 bytes
\ No newline at end of file
+}; // Total: 48 bytes
+
+// GPU-compatible path state for the wavefront path (one per pixel, lives between bounce launches)
+struct __attribute__((aligned(16))) GPUPathState
+{
+    float origin[4];     // 16 bytes (offset 0)  - xyz origin, w = current index of refraction
+    float dir[4];        // 16 bytes (offset 16)
+    float throughput[4]; // 16 bytes (offset 32)
+    float color[4];      // 16 bytes (offset 48)
+    unsigned int seed;   // 4 bytes (offset 64)
+    int alive;           // 4 bytes (offset 68)
+    float coneWidth;     // 4 bytes (offset 72)  - ray cone state for texture LOD
+    float coneSpread;    // 4 bytes (offset 76)
+}; // Total: 80 bytes
@@ -30,51 +30,17 @@ Material::Material()
 // Constructor with texture only
 Material::Material(const std::string &pathFileTexture) : Material()
 {
-    ppmLoader::load_ppm(image, pathFileTexture); // load texture and set result to image
+    // Map the texture, its pixels are decoded when the material is first bound
+    has_texture = image.setPath(pathFileTexture);
     this->pathFileTexture = pathFileTexture;
-
-    // If texture loading failed, ensure image dimensions are 0
-    if (image.data.empty())
-    {
-        image.w = 0;
-        image.h = 0;
-        has_texture = false;
-    }
-    else
-    {
-        has_texture = true;
-    }
 }
 
 // Constructor with texture and normal map
 Material::Material(const std::string &pathFileTexture, const std::string &pathFileNormalMap) : Material()
 {
-    ppmLoader::load_ppm(image, pathFileTexture);     // load texture and set result to image
-    ppmLoader::load_ppm(normals, pathFileNormalMap); // load normal map and set result to normals
-
-    // If texture loading failed, ensure image dimensions are 0
-    if (image.data.empty())
-    {
-        image.w = 0;
-        image.h = 0;
-        has_texture = false;
-    }
-    else
-    {
-        has_texture = true;
-    }
-
-    // If normal map loading failed or no data, disable normal map
-    if (normals.data.empty())
-    {
-        normals.w = 0;
-        normals.h = 0;
-        has_normal_map = false;
-    }
-    else
-    {
-        has_normal_map = true;
-    }
+    // Map both files, their pixels are decoded when the material is first bound
+    has_texture = image.setPath(pathFileTexture);
+    has_normal_map = normals.setPath(pathFileNormalMap);
 
     this->pathFileTexture = pathFileTexture;
     this->pathFileNormalMap = pathFileNormalMap;
@@ -149,7 +115,7 @@ struct __attribute__((aligned(16))) GPUMaterial {
 
 GPUMaterial Material::toGPU() const
 {
-    GPUMaterial gpuMat;
+    GPUMaterial gpuMat = {}; // zeroed padding: uploads compare materials bytewise
 
     // Ambient
     gpuMat.ambient.x = ambient_material.x;
@@ -188,32 +154,32 @@ GPUMaterial Material::toGPU() const
     gpuMat.light_intensity = light_intensity;
 
     // Texture properties
-    gpuMat.has_texture = (!image.data.empty()) ? 1 : 0;
-    gpuMat.texture_width = image.w;
-    gpuMat.texture_height = image.h;
-    gpuMat.texture_offset = 0;
+    gpuMat.has_texture = (!image.empty()) ? 1 : 0;
+    gpuMat.texture_width = image.getWidth();
+    gpuMat.texture_height = image.getHeight();
+    gpuMat.texture_index = -1;
 
-    // Texture offsets will be set by RenderEngine when building the texture buffer
+    // Texture indices will be set by RenderEngine when building the texture atlas
 
     gpuMat.has_normal_map = has_normal_map ? 1 : 0;
-    gpuMat.normal_map_width = normals.w;
-    gpuMat.normal_map_height = normals.h;
-    gpuMat.normal_map_offset = 0;
+    gpuMat.normal_map_width = normals.getWidth();
+    gpuMat.normal_map_height = normals.getHeight();
+    gpuMat.normal_map_index = -1;
 
-    gpuMat.has_metal_map = (!metalicityMap.data.empty()) ? 1 : 0;
-    gpuMat.metal_map_height = metalicityMap.h;
-    gpuMat.metal_map_width = metalicityMap.w;
-    gpuMat.metal_map_offset = 0;
+    gpuMat.has_metal_map = (!metalicityMap.empty()) ? 1 : 0;
+    gpuMat.metal_map_height = metalicityMap.getHeight();
+    gpuMat.metal_map_width = metalicityMap.getWidth();
+    gpuMat.metal_map_index = -1;
 
-    gpuMat.has_emissive_map = (!emissionMap.data.empty()) ? 1 : 0;
-    gpuMat.emissive_map_height = emissionMap.h;
-    gpuMat.emissive_map_width = emissionMap.w;
-    gpuMat.emissive_map_offset = 0;
+    gpuMat.has_emissive_map = (!emissionMap.empty()) ? 1 : 0;
+    gpuMat.emissive_map_height = emissionMap.getHeight();
+    gpuMat.emissive_map_width = emissionMap.getWidth();
+    gpuMat.emissive_map_index = -1;
 
     // Material ID
-    gpuMat.material_id = material_id;
-    gpuMat._padding2[0] = 0; // Padding for 16-byte alignment
-    gpuMat._padding2[1] = 0;
+    gpuMat.material_id = gpu_index; // the kernel checks that a material sits at its own slot
+    gpuMat.packed_maps = 0; // Set by RenderEngine when maps are packed together
+    gpuMat._padding2 = 0;   // Padding for 16-byte alignment
 
     return gpuMat;
 }
@@ -288,15 +254,12 @@ Material::Material(const nlohmann::json &j) : Material()
         std::string texturePath = j["texture"];
         if (!texturePath.empty())
         {
-            ppmLoader::load_ppm(image, texturePath);
+            has_texture = image.setPath(texturePath);
             pathFileTexture = texturePath;
-            has_texture = !image.data.empty();
 
-            if (image.data.empty())
+            if (!has_texture)
             {
                 std::cerr << "Warning: Failed to load texture from: " << texturePath << std::endl;
-                image.w = 0;
-                image.h = 0;
             }
         }
     }
@@ -307,16 +270,12 @@ Material::Material(const nlohmann::json &j) : Material()
         std::string normalMapPath = j["normal_map"];
         if (!normalMapPath.empty())
         {
-            ppmLoader::load_ppm(normals, normalMapPath);
+            has_normal_map = normals.setPath(normalMapPath);
             pathFileNormalMap = normalMapPath;
-            has_normal_map = !normals.data.empty();
 
-            if (normals.data.empty())
+            if (!has_normal_map)
             {
                 std::cerr << "Warning: Failed to load normal map from: " << normalMapPath << std::endl;
-                normals.w = 0;
-                normals.h = 0;
-                has_normal_map = false;
             }
         }
     }
@@ -327,16 +286,12 @@ Material::Material(const nlohmann::json &j) : Material()
         std::string metalMapPath = j["metal_map"];
         if (!metalMapPath.empty())
         {
-            ppmLoader::load_ppm(metalicityMap, metalMapPath);
+            has_metal_map = metalicityMap.setPath(metalMapPath);
             pathFileMetalMap = metalMapPath;
-            has_metal_map = !metalicityMap.data.empty();
 
-            if (metalicityMap.data.empty())
+            if (!has_metal_map)
             {
                 std::cerr << "Warning: Failed to load metal map from: " << metalMapPath << std::endl;
-                metalicityMap.w = 0;
-                metalicityMap.h = 0;
-                has_metal_map = false;
             }
         }
     }
@@ -347,16 +302,12 @@ Material::Material(const nlohmann::json &j) : Material()
         std::string emissiveMapPath = j["emissive_map"];
         if (!emissiveMapPath.empty())
         {
-            ppmLoader::load_ppm(emissionMap, emissiveMapPath);
+            has_emissive_map = emissionMap.setPath(emissiveMapPath);
             pathFileEmissiveMap = emissiveMapPath;
-            has_emissive_map = !emissionMap.data.empty();
 
-            if (emissionMap.data.empty())
+            if (!has_emissive_map)
             {
                 std::cerr << "Warning: Failed to load emissive map from: " << emissiveMapPath << std::endl;
-                emissionMap.w = 0;
-                emissionMap.h = 0;
-                has_emissive_map = false;
             }
         }
     }
@@ -1,10 +1,12 @@
 #pragma once
 
 #include "../utils/imageLoader/ImageLoader.h"
+#include "../utils/imageLoader/LazyImage.h"
 #include "../math/vec3.h"
 #include "../defines/Defines.h"
 #include "../../../external/json/single_include/nlohmann/json.hpp"
 #include <QString>
+#include <atomic>
 
 class MaterialId
 {
@@ -16,7 +18,7 @@ public:
     }
 
 private:
-    int id = 0;
+    std::atomic<int> id{0}; // materials are also created on loader threads
     MaterialId() {}
 
 public:
@@ -33,10 +35,10 @@ public:
     Material(const vec3 &diffuse_color);
     ~Material()
     {
-        image.data.clear();
-        normals.data.clear();
-        emissionMap.data.clear();
-        metalicityMap.data.clear();
+        image.clear();
+        normals.clear();
+        emissionMap.clear();
+        metalicityMap.clear();
     }
 
     // Getters
@@ -54,10 +56,24 @@ public:
     inline bool hasEmissiveMap() const { return has_emissive_map; }
     inline bool hasMetalMap() const { return has_metal_map; }
     inline bool hasMetallicMap() const { return has_metal_map; }
-    inline const ppmLoader::ImageRGB &getImage() const { return image; }
-    inline const ppmLoader::ImageRGB &getNormals() const { return normals; }
-    inline const ppmLoader::ImageRGB &getMetallic() const { return metalicityMap; }
-    inline const ppmLoader::ImageRGB &getEmissive() const { return emissionMap; }
+    // Map getters decode the mapped file on first access
+    inline const ppmLoader::ImageRGB &getImage() const { return image.get(); }
+    inline const ppmLoader::ImageRGB &getNormals() const { return normals.get(); }
+    inline const ppmLoader::ImageRGB &getMetallic() const { return metalicityMap.get(); }
+    inline const ppmLoader::ImageRGB &getEmissive() const { return emissionMap.get(); }
+    // The maps themselves, copies share their pixels through the TextureCache
+    inline const LazyImage &getImageMap() const { return image; }
+    inline const LazyImage &getNormalsMap() const { return normals; }
+    inline const LazyImage &getMetallicMap() const { return metalicityMap; }
+    inline const LazyImage &getEmissiveMap() const { return emissionMap; }
+    // Free the decoded pixels of maps loaded from files (they are decoded again when needed)
+    inline void releaseDecodedMaps() const
+    {
+        image.release();
+        normals.release();
+        metalicityMap.release();
+        emissionMap.release();
+    }
     inline void setDiffuseFromRGB(int r, int g, int b)
     {
         float fr = r / 255.0f;
@@ -66,6 +82,13 @@ public:
         diffuse_material = vec3(fr, fg, fb);
     }
     inline int getMaterialId() const { return material_id; }
+    // Slot in the device material array, -1 while the material is not in the scene (see SceneManager)
+    inline int getGPUIndex() const { return gpu_index; }
+    inline void setGPUIndex(int index) { gpu_index = index; }
+    // Bumped whenever a map is set or removed: other edits leave the uploaded textures as they are
+    inline uint32_t getMapsVersion() const { return mapsVersion; }
+    // Unique over the whole run, unlike the address or the ID: tells a new material from a deleted one
+    inline uint64_t getSerial() const { return serial; }
     inline bool hasTexture() const { return  has_texture; }
     inline std::string getPathFileTexture() const { return pathFileTexture; }
     inline std::string getPathFileNormalMap() const { return pathFileNormalMap; }
@@ -92,75 +115,107 @@ public:
 
     inline void set_texture(const ppmLoader::ImageRGB &img)
     {
+        mapsVersion++;
         has_texture = true;
-        image = img;
+        image.set(img);
+    }
+    inline void set_texture(const LazyImage &map)
+    {
+        mapsVersion++;
+        image = map;
+        has_texture = !map.empty();
+        if (!map.getPath().empty())
+            pathFileTexture = map.getPath();
     }
     inline void remove_texture()
     {
-        image.data.clear();
-        image.w = 0;
-        image.h = 0;
+        mapsVersion++;
+        image.clear();
         has_texture = false;
     }
     inline void removeNormals()
     {
-        normals.data.clear();
-        normals.w = 0;
-        normals.h = 0;
+        mapsVersion++;
+        normals.clear();
         has_normal_map = false;
     }
     inline void setNormals(const ppmLoader::ImageRGB &img)
     {
-        normals = img;
+        mapsVersion++;
+        normals.set(img);
         has_normal_map = true;
     }
+    inline void setNormals(const LazyImage &map)
+    {
+        mapsVersion++;
+        normals = map;
+        has_normal_map = !map.empty();
+        if (!map.getPath().empty())
+            pathFileNormalMap = map.getPath();
+    }
     inline void setNormalsFromPath(const std::string &path)
     {
-        ppmLoader::load_ppm(normals, path);
-        if (!normals.data.empty())
+        if (normals.setPath(path))
         {
+            mapsVersion++;
             has_normal_map = true;
             pathFileNormalMap = path;
         }
     }
     inline void removeMetallic()
     {
-        metalicityMap.data.clear();
-        metalicityMap.w = 0;
-        metalicityMap.h = 0;
+        mapsVersion++;
+        metalicityMap.clear();
         has_metal_map = false;
     }
     inline void removeEmissive()
     {
-        emissionMap.data.clear();
-        emissionMap.w = 0;
-        emissionMap.h = 0;
+        mapsVersion++;
+        emissionMap.clear();
         has_emissive_map = false;
     }
     inline void setMetallic(const ppmLoader::ImageRGB &img)
     {
-        metalicityMap = img;
+        mapsVersion++;
+        metalicityMap.set(img);
         has_metal_map = true;
     }
+    inline void setMetallic(const LazyImage &map)
+    {
+        mapsVersion++;
+        metalicityMap = map;
+        has_metal_map = !map.empty();
+        if (!map.getPath().empty())
+            pathFileMetalMap = map.getPath();
+    }
     inline void setMetallicFromPath(const std::string &path)
     {
-        ppmLoader::load_ppm(metalicityMap, path);
-        if (!metalicityMap.data.empty())
+        if (metalicityMap.setPath(path))
         {
+            mapsVersion++;
             has_metal_map = true;
             pathFileMetalMap = path;
         }
     }
     inline void setEmissive(const ppmLoader::ImageRGB &img)
     {
-        emissionMap = img;
+        mapsVersion++;
+        emissionMap.set(img);
         has_emissive_map = true;
     }
+    inline void setEmissive(const LazyImage &map)
+    {
+        mapsVersion++;
+        emissionMap = map;
+        has_emissive_map = !map.empty();
+        if (!map.getPath().empty())
+            pathFileEmissiveMap = map.getPath();
+    }
     inline void setEmissiveFromPath(const std::string &path)
     {
-        ppmLoader::load_ppm(emissionMap, path);
-        if (!emissionMap.data.empty())
+        if (emissionMap.setPath(path))
         {
+            mapsVersion++;
             has_emissive_map = true;
             pathFileEmissiveMap = path;
         }
@@ -171,9 +226,21 @@ public:
     void setPathFileNormalMap(const std::string &path) { pathFileNormalMap = path; }
     void setPathFileEmissiveMap(const std::string &path) { pathFileEmissiveMap = path; }
     void setPathFileMetalMap(const std::string &path) { pathFileMetalMap = path; }
-    void setHasNormalMap(bool has) { has_normal_map = has; }
-    void setHasMetalMap(bool has) { has_metal_map = has; }
-    void setHasEmissiveMap(bool has) { has_emissive_map = has; }
+    void setHasNormalMap(bool has)
+    {
+        has_normal_map = has;
+        mapsVersion++;
+    }
+    void setHasMetalMap(bool has)
+    {
+        has_metal_map = has;
+        mapsVersion++;
+    }
+    void setHasEmissiveMap(bool has)
+    {
+        has_emissive_map = has;
+        mapsVersion++;
+    }
 
     GPUMaterial toGPU() const;
 
@@ -188,17 +255,21 @@ private:
     float metalness;
     vec3 light_color;
     float light_intensity = 1.0f;
-    ppmLoader::ImageRGB image;
-    ppmLoader::ImageRGB normals;
-    ppmLoader::ImageRGB emissionMap;
-    ppmLoader::ImageRGB metalicityMap;
+    LazyImage image;
+    LazyImage normals;
+    LazyImage emissionMap;
+    LazyImage metalicityMap;
     float texture_scale_x = 1.;
     float texture_scale_y = 1.;
     bool has_normal_map = false;
     bool has_texture = false;
     bool has_emissive_map = false;
     bool has_metal_map = false;
-    int material_id = MaterialId::getInstance().getNewId();
+    int material_id = MaterialId::getInstance().getNewId(); // persistent (saved with the scene)
+    int gpu_index = -1;
+    uint32_t mapsVersion = 0;
+    inline static std::atomic<uint64_t> nextSerial{1}; // materials are also created on loader threads
+    uint64_t serial = nextSerial++;
     std::string pathFileTexture = "";
     std::string pathFileNormalMap = "";
     std::string pathFileEmissiveMap = "";
@@ -7,12 +7,12 @@
 class AABB
 {
 public:
-    AABB() : minPoint(vec3(FLT_MAX, FLT_MAX, FLT_MAX)), maxPoint(vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX)), center(vec3(0, 0, 0)) {}
-    AABB(const vec3 &min, const vec3 &max) : minPoint(min), maxPoint(max), center((min + max) * 0.5f) {}
+    AABB() : minPoint(vec3(FLT_MAX, FLT_MAX, FLT_MAX)), maxPoint(vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX)) {}
+    AABB(const vec3 &min, const vec3 &max) : minPoint(min), maxPoint(max) {}
 
+    // Two corners only: BVH builds keep one box per triangle and per node
     vec3 minPoint;
     vec3 maxPoint;
-    vec3 center;
 
     // Expand the AABB to include a given point
     void GrowToInclude(const vec3 &point)
@@ -1,69 +1,499 @@
 #include "Mesh.h"
 
 #include <iostream>
-#include <fstream>
-#include <sstream>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <omp.h>
+#include "../utils/mappedFile/MappedFile.h"
+#include "../utils/meshCache/MeshCache.h"
+#include "../utils/meshSimplification/MeshSimplification.h"
 
-void Mesh::loadOFF(const std::string &filename)
+// OFF parsing: the file is memory-mapped, the header read sequentially, then the data lines are located
+// and the vertex and face sections parsed with std::from_chars in parallel
+// Faces with more than 3 vertices are split in a fan around their first vertex, per-face colors are ignored
+
+// Skip spaces on the current line
+static const char *skip_blanks(const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+        p++;
+    return p;
+}
+
+// Skip whitespace, line breaks and '#' comments (header fields may span lines)
+static const char *skip_space(const char *p, const char *end)
+{
+    while (p < end)
+    {
+        if (*p == '#')
+        {
+            const char *newline = static_cast<const char *>(memchr(p, '\n', end - p));
+            p = newline ? newline : end;
+        }
+        else if (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+            p++;
+        else
+            break;
+    }
+    return p;
+}
+
+static bool read_uint(const char *&p, const char *end, unsigned int &value)
+{
+    p = skip_blanks(p, end);
+    std::from_chars_result result = std::from_chars(p, end, value);
+    if (result.ec != std::errc())
+        return false;
+    p = result.ptr;
+    return true;
+}
+
+static bool read_float(const char *&p, const char *end, float &value)
 {
-    std::ifstream in(filename.c_str());
-    if (!in)
-        exit(EXIT_FAILURE);
+    p = skip_blanks(p, end);
+    if (p < end && *p == '+') // from_chars does not accept an explicit plus sign
+        p++;
+    std::from_chars_result result = std::from_chars(p, end, value);
+    if (result.ec != std::errc())
+        return false;
+    p = result.ptr;
+    return true;
+}
+
+// Start of every data line (not blank, not a comment) in [begin, end), found by parallel chunks
+static std::vector<const char *> find_data_lines(const char *begin, const char *end)
+{
+    const size_t minChunk = 256 * 1024;
+    size_t size = static_cast<size_t>(end - begin);
+    int chunkCount = static_cast<int>(std::max<size_t>(1, std::min<size_t>(omp_get_max_threads(), size / minChunk)));
+    std::vector<std::vector<const char *>> chunkLines(chunkCount);
+
+#pragma omp parallel for schedule(static)
+    for (int c = 0; c < chunkCount; ++c)
+    {
+        const char *chunkBegin = begin + size * c / chunkCount;
+        const char *chunkEnd = begin + size * (c + 1) / chunkCount;
+
+        // A line belongs to the chunk holding its first character
+        const char *p = chunkBegin;
+        if (p > begin && p[-1] != '\n')
+        {
+            const char *newline = static_cast<const char *>(memchr(p, '\n', end - p));
+            p = newline ? newline + 1 : end;
+        }
+        while (p < chunkEnd)
+        {
+            const char *content = skip_blanks(p, end);
+            if (content < end && *content != '\n' && *content != '#')
+                chunkLines[c].push_back(content);
+            const char *newline = static_cast<const char *>(memchr(content, '\n', end - content));
+            p = newline ? newline + 1 : end;
+        }
+    }
+
+    std::vector<const char *> lines;
+    size_t total = 0;
+    for (const auto &chunk : chunkLines)
+        total += chunk.size();
+    lines.reserve(total);
+    for (const auto &chunk : chunkLines)
+        lines.insert(lines.end(), chunk.begin(), chunk.end());
+    return lines;
+}
+
+bool Mesh::loadOFF(const std::string &filename)
+{
+    positions.clear();
+    normals.clear();
+    indices.clear();
+
+    MappedFile file;
+    if (!file.open(filename))
+        return false;
+    const char *begin = reinterpret_cast<const char *>(file.data());
+    const char *end = begin + file.size();
+
+    // Header: "OFF" then the vertex, face and edge counts
+    const char *p = skip_space(begin, end);
+    if (end - p < 3 || std::strncmp(p, "OFF", 3) != 0)
+    {
+        std::cerr << "Not an OFF file: " << filename << std::endl;
+        return false;
+    }
+    p += 3;
+    unsigned int sizeV = 0, sizeF = 0, sizeE = 0;
+    p = skip_space(p, end);
+    if (!read_uint(p, end, sizeV) || (p = skip_space(p, end), !read_uint(p, end, sizeF)) || (p = skip_space(p, end), !read_uint(p, end, sizeE)))
+    {
+        std::cerr << "Invalid OFF header in " << filename << std::endl;
+        return false;
+    }
+    const char *newline = static_cast<const char *>(memchr(p, '\n', end - p));
+    p = newline ? newline + 1 : end;
 
-    std::string offString;
-    unsigned int sizeV, sizeT, tmp;
-    in >> offString >> sizeV >> sizeT >> tmp;
-    vertices.resize(sizeV);
-    triangles.resize(sizeT);
+    std::vector<const char *> lines = find_data_lines(p, end);
+    if (lines.size() < static_cast<size_t>(sizeV) + sizeF)
+    {
+        std::cerr << "Truncated OFF file " << filename << ": " << lines.size() << " data lines for "
+                  << sizeV << " vertices and " << sizeF << " faces" << std::endl;
+        return false;
+    }
 
-    for (unsigned int i = 0; i < sizeV; ++i)
+    positions.resize(sizeV);
+    int badVertices = 0;
+#pragma omp parallel for schedule(static) reduction(+ : badVertices)
+    for (long long i = 0; i < static_cast<long long>(sizeV); ++i)
     {
+        const char *line = lines[i];
         float x, y, z;
-        in >> x >> y >> z;
-        vec3 position = {x, y, z};
-        vertices[i].position = position;
+        if (read_float(line, end, x) && read_float(line, end, y) && read_float(line, end, z))
+            positions[i] = vec3(x, y, z);
+        else
+            badVertices++;
+    }
+
+    // Vertex count of every face, then each face's first triangle once the counts are summed
+    std::vector<unsigned int> firstTriangle(static_cast<size_t>(sizeF) + 1, 0);
+    int badFaces = 0;
+#pragma omp parallel for schedule(static) reduction(+ : badFaces)
+    for (long long f = 0; f < static_cast<long long>(sizeF); ++f)
+    {
+        const char *line = lines[sizeV + f];
+        unsigned int count = 0;
+        if (read_uint(line, end, count) && count >= 3)
+            firstTriangle[f + 1] = count - 2;
+        else
+            badFaces++;
+    }
+    for (unsigned int f = 0; f < sizeF; ++f)
+        firstTriangle[f + 1] += firstTriangle[f];
+
+    indices.resize(3 * static_cast<size_t>(firstTriangle[sizeF]));
+#pragma omp parallel for schedule(static) reduction(+ : badFaces)
+    for (long long f = 0; f < static_cast<long long>(sizeF); ++f)
+    {
+        unsigned int triangleCount = firstTriangle[f + 1] - firstTriangle[f];
+        if (triangleCount == 0)
+            continue;
+        const char *line = lines[sizeV + f];
+        unsigned int count, first, previous, current;
+        read_uint(line, end, count);
+        if (!read_uint(line, end, first) || !read_uint(line, end, previous) || first >= sizeV || previous >= sizeV)
+        {
+            badFaces++;
+            continue;
+        }
+        bool bad = false;
+        for (unsigned int t = 0; t < triangleCount; ++t)
+        {
+            if (!read_uint(line, end, current) || current >= sizeV)
+            {
+                bad = true;
+                current = previous; // degenerate, the mesh is rejected below
+            }
+            size_t index = 3 * static_cast<size_t>(firstTriangle[f] + t);
+            indices[index] = first;
+            indices[index + 1] = previous;
+            indices[index + 2] = current;
+            previous = current;
+        }
+        if (bad)
+            badFaces++;
     }
 
-    for (unsigned int i = 0; i < sizeT; ++i)
+    if (badVertices > 0 || badFaces > 0)
     {
-        unsigned int v0, v1, v2;
-        in >> tmp >> v0 >> v1 >> v2; // tmp is the number of vertices per face (should be 3)
-        triangles[i] = MeshTriangle(v0, v1, v2, i);
-        
-        // Ignore per face attributes
-        std::string restOfLine;
-        std::getline(in, restOfLine);
+        std::cerr << "Invalid OFF file " << filename << ": " << badVertices << " bad vertices, " << badFaces << " bad faces" << std::endl;
+        positions.clear();
+        indices.clear();
+        return false;
     }
+    return true;
+}
+
+Mesh::Mesh(const std::string &filename, const vec3 &placement, const vec3 &angles, const vec3 &factors, int quality)
+    : Shape(extractFilename(filename) + " " + std::to_string(nextID))
+{
+    this->filename = filename;
+    bvhQuality = quality;
+    uint64_t key = cacheKey(filename, placement, angles, factors, bvhQuality);
+    std::string cachePath = MeshCache::pathFor(filename, key);
+    if (key == 0 || !loadCache(cachePath, key))
+    {
+        if (!loadOFF(filename))
+            return; // left empty, see empty()
+        recomputeNormals();
+        setPosition(vec3(0.0f));
+        scaleToUnit();
+        scale(factors);
+        rotate(angles);
+        translate(placement);
+        // Build BVH after mesh is fully loaded and placed
+        bvh.emplace(*this, bvhQuality);
+        generateLODs();
+        if (key != 0)
+            saveCache(cachePath, key);
+    }
+    Shape::setPosition(placement);
+    setRotation(angles);
+    setScale(factors);
+}
+
+// Key of the cached result: source bytes, placement, BVH build parameters and cache layout (0 if the source cannot be read)
+uint64_t Mesh::cacheKey(const std::string &filename, const vec3 &placement, const vec3 &angles, const vec3 &factors, int quality)
+{
+    std::error_code error;
+    MappedFile source;
+    if (!std::filesystem::is_regular_file(filename, error) || !source.open(filename))
+        return 0; // loadOFF reports it
+
+    struct
+    {
+        uint64_t sourceHash;
+        uint64_t sourceSize;
+        float placement[9];
+        int32_t bvhQuality;
+        int32_t bvhMaxDepth;
+        int32_t bvhBins[4];
+        float bvhCosts[3];
+        int32_t lodParameters[4];
+        uint32_t version;
+        uint32_t nodeSize;
+        uint32_t triangleSize;
+    } parameters;
+    std::memset(&parameters, 0, sizeof(parameters)); // padding bytes are hashed too
+    parameters.sourceHash = MeshCache::hash(source.data(), source.size());
+    parameters.sourceSize = source.size();
+    const vec3 *transform[3] = {&placement, &angles, &factors};
+    for (int i = 0; i < 3; ++i)
+    {
+        parameters.placement[3 * i] = transform[i]->x;
+        parameters.placement[3 * i + 1] = transform[i]->y;
+        parameters.placement[3 * i + 2] = transform[i]->z;
+    }
+    parameters.bvhQuality = quality;
+    parameters.bvhMaxDepth = MAX_DEPTH;
+    // Every constant the tree depends on (those of the parallel build and the optimizer don't change it)
+    parameters.bvhBins[0] = SAH_BINS;
+    parameters.bvhBins[1] = SAH_BINS_LOW;
+    parameters.bvhBins[2] = SAH_BINS_MIN;
+    parameters.bvhBins[3] = SAH_TRIANGLES_PER_BIN;
+    parameters.bvhCosts[0] = SAH_TRAVERSAL_COST;
+    parameters.bvhCosts[1] = SBVH_OVERLAP_RATIO;
+    parameters.bvhCosts[2] = SBVH_MAX_REFERENCE_GROWTH;
+    parameters.lodParameters[0] = MAX_MESH_LODS;
+    parameters.lodParameters[1] = MESH_LOD_SOURCE_TRIANGLES;
+    parameters.lodParameters[2] = MESH_LOD_MIN_TRIANGLES;
+    parameters.lodParameters[3] = MESH_LOD_REDUCTION;
+    parameters.version = MeshCache::VERSION;
+    parameters.nodeSize = sizeof(GPUBVHNode);
+    parameters.triangleSize = sizeof(GPUTriangle);
+    uint64_t key = MeshCache::hash(&parameters, sizeof(parameters));
+    return key != 0 ? key : 1;
+}
+
+bool Mesh::loadCache(const std::string &cachePath, uint64_t key)
+{
+    MeshCache::View view;
+    if (!MeshCache::open(cachePath, key, view) || view.triangleCount == 0)
+        return false;
+
+    positions.resize(view.vertexCount);
+    normals.resize(view.normals ? view.vertexCount : 0);
+    for (size_t i = 0; i < view.vertexCount; ++i)
+    {
+        const float *p = view.positions + 3 * i;
+        positions[i] = vec3(p[0], p[1], p[2]);
+        if (view.normals)
+            normals[i] = vec3(view.normals[3 * i], view.normals[3 * i + 1], view.normals[3 * i + 2]);
+    }
+    indices.assign(view.indices, view.indices + 3 * view.triangleCount);
+
+    // The BVHs are used in place from the mapping
+    bvh.emplace(view.file, view.nodes, view.nodeCount, view.triangleOrder, view.bvhTriangles, view.bvhTriangleCount);
+    lods.clear();
+    lods.resize(std::min<size_t>(view.lods.size(), MAX_MESH_LODS));
+    for (size_t i = 0; i < lods.size(); ++i)
+    {
+        const MeshCache::LODView &level = view.lods[i];
+        lods[i].indices.assign(level.indices, level.indices + 3 * level.triangleCount);
+        lods[i].bvh.emplace(view.file, level.nodes, level.nodeCount, level.triangleOrder, level.bvhTriangles, level.triangleCount);
+        lods[i].hitOffset = meanEdgeLength(lods[i].indices);
+    }
+    std::cout << "Mesh loaded from cache: " << cachePath << " (" << view.bvhTriangleCount << " triangles, " << view.nodeCount
+              << " BVH nodes, " << lods.size() << " LODs)" << std::endl;
+    return true;
+}
+
+void Mesh::saveCache(const std::string &cachePath, uint64_t key) const
+{
+    static_assert(sizeof(vec3) == 3 * sizeof(float), "vec3 arrays are written as three floats per vertex");
+    MeshCache::View content;
+    content.positions = reinterpret_cast<const float *>(positions.data());
+    content.normals = normals.empty() ? nullptr : reinterpret_cast<const float *>(normals.data());
+    content.vertexCount = positions.size();
+    content.indices = indices.data();
+    content.triangleCount = getTriangleCount();
+    content.nodes = bvh->getGPUNodes();
+    content.nodeCount = bvh->getGPUNodeCount();
+    content.triangleOrder = bvh->getTriangleOrder();
+    content.bvhTriangles = bvh->getGPUTriangles();
+    content.bvhTriangleCount = bvh->getGPUTriangleCount();
+    for (const LOD &lod : lods)
+    {
+        MeshCache::LODView level;
+        level.indices = lod.indices.data();
+        level.triangleCount = lod.indices.size() / 3;
+        level.nodes = lod.bvh->getGPUNodes();
+        level.nodeCount = lod.bvh->getGPUNodeCount();
+        level.triangleOrder = lod.bvh->getTriangleOrder();
+        level.bvhTriangles = lod.bvh->getGPUTriangles();
+        content.lods.push_back(level);
+    }
+    MeshCache::write(cachePath, key, content);
+}
+
+void Mesh::generateLODs()
+{
+    lods.clear();
+    if (getTriangleCount() < MESH_LOD_SOURCE_TRIANGLES)
+        return;
+    lods.reserve(MAX_MESH_LODS); // a BVH must not be copied (a Shape owns its material): levels never move
+
+    // Each level simplifies the previous one, so every level is a simplification of the finer ones
+    const std::vector<unsigned int> *source = &indices;
+    while (lods.size() < MAX_MESH_LODS)
+    {
+        size_t sourceTriangles = source->size() / 3;
+        size_t target = sourceTriangles / MESH_LOD_REDUCTION;
+        if (target < MESH_LOD_MIN_TRIANGLES)
+            break;
+        float error = 0.0f;
+        std::vector<unsigned int> simplified = meshSimplification::simplify(positions, *source, target, &error);
+        // Stop once collapses are mostly refused (open or non-manifold meshes): the level would not be cheaper
+        if (simplified.size() / 3 > sourceTriangles * 6 / 10)
+            break;
+
+        LOD &lod = lods.emplace_back();
+        lod.indices = std::move(simplified);
+        lod.bvh.emplace(positions, lod.indices);
+        lod.hitOffset = meanEdgeLength(lod.indices);
+        source = &lod.indices;
+        std::cout << "Mesh LOD " << lods.size() << ": " << lod.indices.size() / 3 << " triangles (max quadric error " << error << ")" << std::endl;
+    }
+}
+
+float Mesh::meanEdgeLength(const std::vector<unsigned int> &triangles) const
+{
+    if (triangles.empty())
+        return 0.0f;
+    double total = 0.0;
+    for (size_t i = 0; i < triangles.size(); i += 3)
+    {
+        const vec3 &a = positions[triangles[i]];
+        const vec3 &b = positions[triangles[i + 1]];
+        const vec3 &c = positions[triangles[i + 2]];
+        total += (b - a).length() + (c - b).length() + (a - c).length();
+    }
+    return static_cast<float>(total / triangles.size());
+}
+
+void Mesh::rebuildBVH()
+{
+    bvh.emplace(*this, bvhQuality);
+    for (LOD &lod : lods)
+        lod.bvh.emplace(positions, lod.indices);
+    if (bvhOptimized)
+        optimizeBVH();
+}
+
+void Mesh::optimizeBVH()
+{
+    bvhOptimized = true;
+    if (bvh)
+        bvh->optimize();
+    for (LOD &lod : lods)
+    {
+        if (lod.bvh)
+            lod.bvh->optimize();
+    }
+}
+
+void Mesh::updateBVH()
+{
+    geometryVersion++;
+    for (LOD &lod : lods)
+        lod.hitOffset = meanEdgeLength(lod.indices); // scaling changes it
+    if (deviceBVH)
+        return;
+
+    if (!bvh || !bvh->refit(*this))
+    {
+        bvh.emplace(*this, bvhQuality);
+        if (bvhOptimized)
+            bvh->optimize();
+    }
+    for (LOD &lod : lods)
+    {
+        if (!lod.bvh || !lod.bvh->refit(positions, lod.indices))
+        {
+            lod.bvh.emplace(positions, lod.indices);
+            if (bvhOptimized)
+                lod.bvh->optimize();
+        }
+    }
+}
+
+void Mesh::setBVHQuality(int quality)
+{
+    if (quality == bvhQuality)
+        return;
+    bvhQuality = quality;
+    if (!empty())
+    {
+        bvh.emplace(*this, bvhQuality);
+        if (bvhOptimized)
+            bvh->optimize();
+    }
+}
+
+void Mesh::setDeviceBVH(bool enabled)
+{
+    if (enabled == deviceBVH)
+        return;
+    deviceBVH = enabled;
+    if (!enabled)
+        updateBVH();
 }
 
 void Mesh::recomputeNormals()
 {
-    for (unsigned int i = 0; i < vertices.size(); i++)
-        vertices[i].normal = vec3(0.0, 0.0, 0.0);
-    for (unsigned int i = 0; i < triangles.size(); i++)
+    normals.assign(positions.size(), vec3(0.0f, 0.0f, 0.0f));
+    for (size_t i = 0; i < indices.size(); i += 3)
     {
-        vec3 e01 = vertices[triangles[i].v[1]].position - vertices[triangles[i].v[0]].position;
-        vec3 e02 = vertices[triangles[i].v[2]].position - vertices[triangles[i].v[0]].position;
+        vec3 e01 = positions[indices[i + 1]] - positions[indices[i]];
+        vec3 e02 = positions[indices[i + 2]] - positions[indices[i]];
         vec3 n = vec3::cross(e01, e02);
         n.normalize();
         for (unsigned int j = 0; j < 3; j++)
-            vertices[triangles[i].v[j]].normal += n;
+            normals[indices[i + j]] += n;
     }
-    for (unsigned int i = 0; i < vertices.size(); i++)
-        vertices[i].normal.normalize();
+    for (auto &normal : normals)
+        normal.normalize();
 }
 
 AABB Mesh::computeAABB()
 {
-    if (vertices.empty())
+    if (positions.empty())
         return AABB();
 
-    vec3 minPoint = vertices[0].position;
-    vec3 maxPoint = vertices[0].position;
+    vec3 minPoint = positions[0];
+    vec3 maxPoint = positions[0];
 
-    for (const auto &vertex : vertices)
+    for (const vec3 &pos : positions)
     {
-        const vec3 &pos = vertex.position;
         if (pos.x < minPoint.x)
             minPoint.x = pos.x;
         if (pos.y < minPoint.y)
@@ -88,32 +518,32 @@ void Mesh::scaleToUnit()
     vec3 size = aabb.maxPoint - aabb.minPoint;
     if (size.x > 0)
     {
-        for (auto &vertex : vertices)
+        for (auto &position : positions)
         {
-            vertex.position.x /= size.x;
+            position.x /= size.x;
         }
     }
     if (size.y > 0)
     {
-        for (auto &vertex : vertices)
+        for (auto &position : positions)
         {
-            vertex.position.y /= size.y;
+            position.y /= size.y;
         }
     }
     if (size.z > 0)
     {
-        for (auto &vertex : vertices)
+        for (auto &position : positions)
         {
-            vertex.position.z /= size.z;
+            position.z /= size.z;
         }
     }
 }
 
 void Mesh::applyTransformationMatrix(Mat3 &mat)
 {
-    for (auto &vertex : vertices)
+    for (auto &position : positions)
     {
-        vertex.position = mat * vertex.position;
+        position = mat * position;
     }
 }
 
@@ -135,9 +565,9 @@ void Mesh::setPosition(const vec3 &pos)
 
 void Mesh::translate(const vec3 &offset)
 {
-    for (auto &vertex : vertices)
+    for (auto &position : positions)
     {
-        vertex.position += offset;
+        position += offset;
     }
 }
 
@@ -148,62 +578,14 @@ void Mesh::rotate(const vec3 &angles)
     vec3 center = getCenterPos();
     translate(vec3(-center.x, -center.y, -center.z));
 
-    for (auto &vertex : vertices)
+    for (auto &position : positions)
     {
-        vertex.position = rotationMatrix * vertex.position;
+        position = rotationMatrix * position;
     }
 
     translate(center);
 }
 
-// MeshVertex implementations
-MeshVertex::MeshVertex() {}
-MeshVertex::MeshVertex(const vec3 &_p) : position(_p), u(0), v(0) {}
-MeshVertex::MeshVertex(const MeshVertex &vertex) : position(vertex.position), u(vertex.u), v(vertex.v) {}
-MeshVertex::~MeshVertex() {}
-MeshVertex &MeshVertex::operator=(const MeshVertex &vertex)
-{
-    position = vertex.position;
-    u = vertex.u;
-    v = vertex.v;
-    return *this;
-}
-
-// MeshTriangle implementations
-MeshTriangle::MeshTriangle() { v[0] = v[1] = v[2] = v[3] = 0; }
-MeshTriangle::MeshTriangle(const MeshTriangle &t)
-{
-    v[0] = t.v[0];
-    v[1] = t.v[1];
-    v[2] = t.v[2];
-    v[3] = t.v[3];
-}
-MeshTriangle::MeshTriangle(unsigned int v0, unsigned int v1, unsigned int v2)
-{
-    v[0] = v0;
-    v[1] = v1;
-    v[2] = v2;
-    v[3] = 0;
-}
-MeshTriangle::MeshTriangle(unsigned int v0, unsigned int v1, unsigned int v2, unsigned int index)
-{
-    v[0] = v0;
-    v[1] = v1;
-    v[2] = v2;
-    v[3] = index;
-}
-unsigned int &MeshTriangle::operator[](unsigned int iv) { return v[iv]; }
-unsigned int MeshTriangle::operator[](unsigned int iv) const { return v[iv]; }
-MeshTriangle::~MeshTriangle() {}
-MeshTriangle &MeshTriangle::operator=(const MeshTriangle &t)
-{
-    v[0] = t.v[0];
-    v[1] = t.v[1];
-    v[2] = t.v[2];
-    v[3] = t.v[3];
-    return *this;
-}
-
 // Mesh::extractFilename implementation
 std::string Mesh::extractFilename(const std::string &filepath)
 {
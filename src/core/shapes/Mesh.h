@@ -2,98 +2,107 @@
 #include "Shape.h"
 #include "../defines/Defines.h"
 
+#include <atomic>
 #include <vector>
 #include <optional>
-#include "Triangle.h"
+#include <cstdint>
 
 #include "../math/aabb.h"
 #include "../math/vec3.h"
 #include "../math/mat3.h"
 #include "../bvh/bvh.h"
 
-struct MeshVertex
-{
-    MeshVertex();
-    MeshVertex(const vec3 &_p);
-    MeshVertex(const MeshVertex &vertex);
-    virtual ~MeshVertex();
-    MeshVertex &operator=(const MeshVertex &vertex);
-    vec3 position;
-    vec3 normal = vec3(0.0f, 0.0f, 0.0f);
-    float u, v;
-};
-
-struct MeshTriangle
-{
-    MeshTriangle();
-    MeshTriangle(const MeshTriangle &t);
-    MeshTriangle(unsigned int v0, unsigned int v1, unsigned int v2);
-    MeshTriangle(unsigned int v0, unsigned int v1, unsigned int v2, unsigned int index);
-    unsigned int &operator[](unsigned int iv);
-    unsigned int operator[](unsigned int iv) const;
-    virtual ~MeshTriangle();
-    MeshTriangle &operator=(const MeshTriangle &t);
-    unsigned int v[4];
-};
+// Levels of detail: meshes from this many triangles get up to MAX_MESH_LODS simplified versions, each with
+// MESH_LOD_REDUCTION times fewer triangles than the previous one, down to MESH_LOD_MIN_TRIANGLES
+#define MESH_LOD_SOURCE_TRIANGLES 2048
+#define MESH_LOD_MIN_TRIANGLES 256
+#define MESH_LOD_REDUCTION 4
 
 class Mesh : public Shape
 {
+public:
+    // Simplified version of the mesh: fewer triangles over the same positions, with its own BVH
+    struct LOD
+    {
+        std::vector<unsigned int> indices;
+        std::optional<BVH> bvh;
+        float hitOffset = 0.0f; // mean edge length, how far this level may lie from the full surface
+    };
+
 private:
-    std::vector<MeshVertex> vertices;
-    std::vector<MeshTriangle> triangles;
-    std::vector<Triangle> cpuTriangles;
+    // Structure of arrays: one position (and normal once computed) per vertex, three vertex indices per triangle
+    std::vector<vec3> positions;
+    std::vector<vec3> normals;
+    std::vector<unsigned int> indices;
     std::string filename;
     std::optional<BVH> bvh;
+    std::vector<LOD> lods; // finest first
+    bool deviceBVH = false;      // BVHs built on the device from the uploaded vertices, the host ones left stale
+    uint32_t geometryVersion = 0; // bumped by every vertex edit
+    int bvhQuality = QUALITY_HIGH; // of the mesh's own BVH, levels of detail are always built at QUALITY_HIGH
+    bool bvhOptimized = false;     // BVHs rebuilt later are optimized again
+    inline static std::atomic<int> defaultBVHQuality{QUALITY_HIGH}; // set by the UI, read by loader threads
+
+    static uint64_t cacheKey(const std::string &filename, const vec3 &placement, const vec3 &angles, const vec3 &factors, int quality);
+    bool loadCache(const std::string &cachePath, uint64_t key);
+    void saveCache(const std::string &cachePath, uint64_t key) const;
+    // Simplify the placed mesh into its levels of detail (quadric error edge collapses) and build their BVHs
+    void generateLODs();
+    float meanEdgeLength(const std::vector<unsigned int> &triangles) const;
 
 public:
-    Mesh(const std::string &filename) : Shape(extractFilename(filename) + " " + std::to_string(nextID))
-    {
-        loadOFF(filename);
-        recomputeNormals();
-        setPosition(vec3(0.0f));
-        scaleToUnit();
-        generateCpuTriangles();
-        this->filename = filename;
-        // Build BVH after mesh is fully loaded
-        bvh.emplace(*this);
-    }
+    Mesh(const std::string &filename) : Mesh(filename, getDefaultBVHQuality()) {}
+    Mesh(const std::string &filename, int quality) : Mesh(filename, vec3(0.0f), vec3(0.0f), vec3(1.0f), quality) {}
+    Mesh(const std::string &filename, const vec3 &placement, const vec3 &angles, const vec3 &factors)
+        : Mesh(filename, placement, angles, factors, getDefaultBVHQuality()) {}
+    // Load an OFF file placed in the scene (scaled, rotated then translated) with its BVH built once at the given
+    // quality; loader jobs get the quality when they are queued, not from the default as it is when they run
+    // The result is cached in a .rtmesh file next to the source, read back when nothing changed
+    Mesh(const std::string &filename, const vec3 &placement, const vec3 &angles, const vec3 &factors, int quality);
     ShapeType getType() const override { return ShapeType::MESH; }
 
     // Extract filename from path (removes path and extension)
     static std::string extractFilename(const std::string &filepath);
-    void loadOFF(const std::string &filename);
+    // Parse an OFF file (polygons are triangulated), false and an empty mesh if it cannot be read
+    bool loadOFF(const std::string &filename);
+    // True if the file could not be loaded: the mesh has no triangles and no BVH
+    inline bool empty() const { return indices.empty(); }
     void recomputeNormals();
-    void generateCpuTriangles()
-    {
-        cpuTriangles.clear();
-        for (const auto &tri : triangles)
-        {
-            const vec3 &v0 = vertices[tri.v[0]].position;
-            const vec3 &v1 = vertices[tri.v[1]].position;
-            const vec3 &v2 = vertices[tri.v[2]].position;
-            // don´t increment ID for mesh triangles
-            cpuTriangles.emplace_back(v0, v1, v2, true);
-        }
-    }
 
-    void rebuildBVH()
-    {
-        bvh.emplace(*this);
-    }
+    // Rebuild the BVHs of the mesh and of its levels of detail
+    void rebuildBVH();
+    // After the vertices moved: refit the BVHs, or rebuild those that refitting degraded too much
+    void updateBVH();
+    // Dynamic meshes get their BVHs built on the device at each upload (LBVHBuilder) instead of refitted or rebuilt
+    // on the host after each edit; turning it off brings the host BVHs up to date
+    void setDeviceBVH(bool enabled);
+    inline bool hasDeviceBVH() const { return deviceBVH; }
+    // Build quality of the mesh's BVH (QUALITY_SPATIAL for an SBVH), rebuilt if it changes; meshes loaded
+    // afterwards are built at the default quality
+    void setBVHQuality(int quality);
+    inline int getBVHQuality() const { return bvhQuality; }
+    static void setDefaultBVHQuality(int quality) { defaultBVHQuality = quality; }
+    static int getDefaultBVHQuality() { return defaultBVHQuality; }
+    // Run BVH::optimize on the BVHs of the mesh and of its levels of detail, now and after every later rebuild
+    // (not cached: the .rtmesh keeps the trees as built)
+    void optimizeBVH();
+    inline bool isBVHOptimized() const { return bvhOptimized; }
+    inline uint32_t getGeometryVersion() const { return geometryVersion; }
 
-    const std::vector<Triangle> &getTriangles() const
-    {
-        return cpuTriangles;
-    }
+    inline size_t getVertexCount() const { return positions.size(); }
+    inline const vec3 &getVertexPosition(size_t index) const { return positions[index]; }
+    inline size_t getTriangleCount() const { return indices.size() / 3; }
+    inline const std::vector<vec3> &getPositions() const { return positions; }
+    inline const std::vector<unsigned int> &getIndices() const { return indices; }
 
     vec3 getCenterPos() const
     {
         vec3 center(0.0f, 0.0f, 0.0f);
-        for (const auto &vertex : vertices)
+        for (const auto &position : positions)
         {
-            center += vertex.position;
+            center += position;
         }
-        center /= static_cast<float>(vertices.size());
+        center /= static_cast<float>(positions.size());
         return center;
     }
     void applyTransformationMatrix(Mat3 &mat);
@@ -106,6 +115,9 @@ public:
     // Uses angles in radians
     void rotate(const vec3 &angles);
     BVH &getBVH() { return *bvh; }
+    inline size_t getLODCount() const { return lods.size(); }
+    // Level 1 to getLODCount(), from finest to coarsest (level 0 is the mesh itself)
+    inline const LOD &getLOD(size_t level) const { return lods[level - 1]; }
 
     std::string getFilename() const { return filename; }
 };
\ No newline at end of file
@@ -1,4 +1,5 @@
 #pragma once
+#include <atomic>
 #include "../math/vec3.h"
 #include "../defines/Defines.h"
 #include "../material/Material.h"
@@ -22,15 +23,18 @@ public:
     inline int getID() const { return id; }
     inline const std::string &getName() const { return shapeName; }
     inline Material *getMaterial() const { return material; }
+    // Bumped by every setter, tells the SceneStore which shapes to read again
+    inline uint32_t getVersion() const { return version; }
     // Setters
-    inline void setPosition(const vec3 &pos) { position = pos; }
-    inline void setScale(const vec3 &s) { scale = s; }
-    inline void setRotation(const vec3 &rot) { rotation = rot; }
+    inline void setPosition(const vec3 &pos) { position = pos; version++; }
+    inline void setScale(const vec3 &s) { scale = s; version++; }
+    inline void setRotation(const vec3 &rot) { rotation = rot; version++; }
     inline void setMaterial(Material *mat) {
         if (material != nullptr) {
             delete material;
         }
         material = mat;
+        version++;
     }
 
     Shape() : position(0.0f, 0.0f, 0.0f), scale(1.0f, 1.0f, 1.0f), rotation(0.0f, 0.0f, 0.0f), id(nextID++), shapeName("Shape " + std::to_string(id)), material(new Material()) {
@@ -69,7 +73,8 @@ protected:
     vec3 scale;                   // Scale of the shape (default: 1,1,1)
     vec3 rotation;                // Rotation of the shape (Euler angles)
     int id;                       // Unique identifier for the shape
-    inline static int nextID = 0; // Header definition to allow a static variable trackable across all Shape instances
+    inline static std::atomic<int> nextID = 0; // Header definition to allow a static variable trackable across all Shape instances, atomic as meshes are built on loader threads
     std::string shapeName;
     Material *material; // Material associated with the shape
+    uint32_t version = 0;
 };
\ No newline at end of file
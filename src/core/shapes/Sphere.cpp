@@ -23,7 +23,7 @@ GPUSphere Sphere::toGPU() const
     gpuSphere.pos._padding = 0.0f;
     
     // Material index
-    gpuSphere.materialIndex = (material != nullptr) ? material->getMaterialId() : -1;
+    gpuSphere.materialIndex = (material != nullptr) ? material->getGPUIndex() : -1;
     gpuSphere._padding2[0] = 0.0f;
     gpuSphere._padding2[1] = 0.0f;
     gpuSphere._padding2[2] = 0.0f;
@@ -31,7 +31,7 @@ public:
 
     
     // Setters spécifiques à Sphere
-    void setRadius(float r) { radius = r; }
+    void setRadius(float r) { radius = r; version++; }
 
     std::string toString() const;
 
@@ -41,7 +41,7 @@ GPUSquare Square::toGPU() const
     gpuSquare.normal._padding = 0.0f;
     
     // Material index
-    gpuSquare.materialIndex = (material != nullptr) ? material->getMaterialId() : -1;
+    gpuSquare.materialIndex = (material != nullptr) ? material->getGPUIndex() : -1;
     gpuSquare._padding[0] = 0.0f;
     gpuSquare._padding[1] = 0.0f;
     gpuSquare._padding[2] = 0.0f;
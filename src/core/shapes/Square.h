@@ -35,9 +35,9 @@ public:
     const vec3 &getNormal() const { return normal; }
 
     // Setters spécifiques à Square
-    void setUVector(const vec3 &u) { u_vec = u; }
-    void setVVector(const vec3 &v) { v_vec = v; }
-    void setNormal(const vec3 &n) { normal = n; }
+    void setUVector(const vec3 &u) { u_vec = u; version++; }
+    void setVVector(const vec3 &v) { v_vec = v; version++; }
+    void setNormal(const vec3 &n) { normal = n; version++; }
 
     std::string toString() const;
 
@@ -43,7 +43,7 @@ GPUTriangle Triangle::toGPU() const
     gpuTri.v2._padding = 0.0f;
     
     // Material index
-    gpuTri.materialIndex = (material != nullptr) ? material->getMaterialId() : -1;
+    gpuTri.materialIndex = (material != nullptr) ? material->getGPUIndex() : -1;
     gpuTri._padding[0] = 0.0f;
     gpuTri._padding[1] = 0.0f;
     gpuTri._padding[2] = 0.0f;
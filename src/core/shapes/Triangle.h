@@ -50,9 +50,9 @@ public:
     const vec3 &getV2() const { return v2; }
 
     // Setters
-    void setV0(const vec3 &vv) { v0 = vv; }
-    void setV1(const vec3 &vv) { v1 = vv; }
-    void setV2(const vec3 &vv) { v2 = vv; }
+    void setV0(const vec3 &vv) { v0 = vv; version++; }
+    void setV1(const vec3 &vv) { v1 = vv; version++; }
+    void setV2(const vec3 &vv) { v2 = vv; version++; }
 
     std::string toString() const;
 
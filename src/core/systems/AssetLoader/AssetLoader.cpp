@@ -0,0 +1,89 @@
+#include "AssetLoader.h"
+#include <algorithm>
+#include <omp.h>
+
+AssetLoader &AssetLoader::getInstance()
+{
+    static AssetLoader instance;
+    return instance;
+}
+
+AssetLoader::AssetLoader()
+{
+    // Leave a core to the GUI thread
+    unsigned int cores = std::thread::hardware_concurrency();
+    unsigned int count = cores > 1 ? cores - 1 : 1;
+    coreBudget = static_cast<int>(count);
+    for (unsigned int i = 0; i < count; ++i)
+        workers.emplace_back(&AssetLoader::workerLoop, this);
+}
+
+AssetLoader::~AssetLoader()
+{
+    {
+        // Jobs that have not started are dropped, running ones are waited for
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        std::queue<std::function<void()>>().swap(jobs);
+    }
+    jobAvailable.notify_all();
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+void AssetLoader::workerLoop()
+{
+    while (true)
+    {
+        std::function<void()> job;
+        int teamSize = 1;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobAvailable.wait(lock, [this]()
+                              { return stopping || !jobs.empty(); });
+            if (stopping)
+                return;
+            job = std::move(jobs.front());
+            jobs.pop();
+            // Share the cores with the jobs running and those about to start, without going over the threads
+            // still free: the OpenMP regions of the job would otherwise each open a team as large as the machine
+            // Teams can't shrink once started, so a batch peaks under twice the budget instead of workers x cores
+            busyWorkers++;
+            size_t sharing = std::min(static_cast<size_t>(busyWorkers) + jobs.size(), static_cast<size_t>(coreBudget));
+            teamSize = std::max(1, std::min(coreBudget / static_cast<int>(sharing), coreBudget - threadsInUse));
+            threadsInUse += teamSize;
+        }
+        omp_set_num_threads(teamSize); // this worker's teams only
+        job(); // exceptions are stored in the job's future
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            busyWorkers--;
+            threadsInUse -= teamSize;
+        }
+    }
+}
+
+int AssetLoader::poll()
+{
+    // Callbacks may submit new jobs: walk a detached list of the jobs pending when polling started
+    std::vector<PendingJob> polled;
+    polled.swap(pending);
+    int finished = 0;
+    for (PendingJob &job : polled)
+    {
+        if (job.finish())
+            finished++;
+        else
+            pending.push_back(std::move(job));
+    }
+
+    if (pending.empty())
+        batchSize = 0;
+    return finished;
+}
+
+bool AssetLoader::isPending(const std::string &label) const
+{
+    return std::any_of(pending.begin(), pending.end(), [&label](const PendingJob &job)
+                       { return job.label == label; });
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Background loading of scene assets: a pool of worker threads parses meshes, builds their BVH and
+// decodes textures while the GUI keeps rendering
+// Jobs and their completion callbacks are submitted from the GUI thread; a callback runs on that
+// thread too, from poll() (called once per frame), so results only reach the scene from there
+// Jobs use OpenMP themselves (mesh parsing, BVH builds, image decoding): each one gets a share of the cores
+// as its team size, so that a lone job uses them all and a batch does not run workers x cores threads
+class AssetLoader
+{
+public:
+    static AssetLoader &getInstance();
+
+    AssetLoader(const AssetLoader &) = delete;
+    AssetLoader &operator=(const AssetLoader &) = delete;
+
+    ~AssetLoader();
+
+    // Run job on a worker and hand its result to onReady from poll() once it is done
+    // label names the asset (its file path) for progress reports and isPending()
+    template <typename Result>
+    void load(const std::string &label, std::function<Result()> job, std::function<void(Result)> onReady)
+    {
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::move(job));
+        std::shared_future<Result> result = task->get_future().share();
+
+        pending.push_back({label, [label, result, onReady]()
+                           {
+                               if (result.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                                   return false;
+                               try
+                               {
+                                   Result value = result.get();
+                                   onReady(value);
+                               }
+                               catch (const std::exception &e)
+                               {
+                                   std::cerr << "Failed to load " << label << ": " << e.what() << std::endl;
+                               }
+                               return true;
+                           }});
+        batchSize++;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push([task]()
+                      { (*task)(); });
+        }
+        jobAvailable.notify_one();
+    }
+
+    // Run the callbacks of the finished jobs, returns how many finished
+    int poll();
+
+    // True while a job with this label has not been handed back yet
+    bool isPending(const std::string &label) const;
+
+    // Progress of the current batch: jobs submitted since the loader was last idle, and those still pending
+    inline int getBatchSize() const { return batchSize; }
+    inline int getPendingCount() const { return static_cast<int>(pending.size()); }
+    inline bool isIdle() const { return pending.empty(); }
+    inline int getWorkerCount() const { return static_cast<int>(workers.size()); }
+
+private:
+    AssetLoader();
+    void workerLoop();
+
+    struct PendingJob
+    {
+        std::string label;
+        std::function<bool()> finish; // runs the callback and returns true once the job is done
+    };
+
+    // GUI thread only
+    std::vector<PendingJob> pending;
+    int batchSize = 0;
+
+    // Shared with the workers
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    std::queue<std::function<void()>> jobs;
+    bool stopping = false;
+    int busyWorkers = 0;  // workers running a job
+    int threadsInUse = 0; // OpenMP threads of the jobs running
+    int coreBudget = 1;   // threads the jobs share (the cores left to the GUI thread)
+    std::vector<std::thread> workers;
+};
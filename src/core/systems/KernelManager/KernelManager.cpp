@@ -17,10 +17,36 @@ void KernelManager::preloadAllKernels()
 {
     loadKernel("hello", "kernels/hello.cl"); // <name, path>
     loadKernel("render_kernel", "kernels/rayTrace.cl");
+
+    // Wavefront path used by the optional secondary-ray sorting stage
+    loadKernel("wavefront_generate", "kernels/rayTrace.cl");
+    loadKernel("wavefront_bounce", "kernels/rayTrace.cl");
+    loadKernel("wavefront_resolve", "kernels/rayTrace.cl");
+    loadKernel("compute_ray_keys", "kernels/rayTrace.cl");
+    loadKernel("count_active_paths", "kernels/rayTrace.cl");
+    loadKernel("radix_histogram", "kernels/radixSort.cl");
+    loadKernel("radix_scan", "kernels/radixSort.cl");
+    loadKernel("radix_scatter", "kernels/radixSort.cl");
+
+    // Device BVH builder of dynamic meshes (sorts with the radix sort kernels above)
+    loadKernel("lbvh_centroid_bounds", "kernels/lbvh.cl");
+    loadKernel("lbvh_morton_codes", "kernels/lbvh.cl");
+    loadKernel("lbvh_hierarchy", "kernels/lbvh.cl");
+    loadKernel("lbvh_bounds", "kernels/lbvh.cl");
 }
 
 void KernelManager::loadKernel(const std::string &name, const std::string &filePath)
 {
+    // Several kernels live in the same file: build each program only once
+    auto cached = programsByFile.find(filePath);
+    if (cached != programsByFile.end())
+    {
+        programs[name] = cached->second;
+        kernels[name] = cl::Kernel(cached->second, name.c_str());
+        std::cout << "Loaded kernel: " << name << " from already built " << filePath << std::endl;
+        return;
+    }
+
     // Try to read kernel file from multiple possible locations
     std::ifstream kernelFile;
     std::string actualFilePath;
@@ -68,6 +94,7 @@ void KernelManager::loadKernel(const std::string &name, const std::string &fileP
     // Store program and kernel
     programs[name] = program;
     kernels[name] = kernel;
+    programsByFile[filePath] = program;
 
     std::cout << "Loaded and built kernel: " << name << " from " << actualFilePath << std::endl;
 }
\ No newline at end of file
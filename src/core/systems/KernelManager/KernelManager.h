@@ -10,6 +10,7 @@ private:
     static KernelManager *instance;
     std::unordered_map<std::string, cl::Kernel> kernels; // <name, kernel>
     std::unordered_map<std::string, cl::Program> programs; // <name, program>
+    std::unordered_map<std::string, cl::Program> programsByFile; // <path, program> to build shared files once
 
     void loadKernel(const std::string &name, const std::string &filePath);
     
@@ -0,0 +1,84 @@
+#include "LBVHBuilder.h"
+#include "../KernelManager/KernelManager.h"
+#include "../DeviceManager/DeviceManager.h"
+
+void LBVHBuilder::ensureCapacity(size_t count)
+{
+    cl::Context context = DeviceManager::getInstance()->getContext();
+
+    if (count > capacity)
+    {
+        bounds = cl::Buffer(context, CL_MEM_READ_WRITE, 2 * sizeof(cl_float4));
+        keys = cl::Buffer(context, CL_MEM_READ_WRITE, count * sizeof(cl_uint));
+        values = cl::Buffer(context, CL_MEM_READ_WRITE, count * sizeof(cl_uint));
+        parents = cl::Buffer(context, CL_MEM_READ_WRITE, (2 * count - 1) * sizeof(cl_int));
+        nodeSlots = cl::Buffer(context, CL_MEM_READ_WRITE, (2 * count - 1) * sizeof(cl_int));
+        counters = cl::Buffer(context, CL_MEM_READ_WRITE, count * sizeof(cl_uint));
+        capacity = count;
+    }
+}
+
+void LBVHBuilder::build(const GPUBVH &mesh, int triangleOffset, int triangleCount, const cl::Buffer &triangles, const cl::Buffer &vertices,
+                        const cl::Buffer &indices, cl::Buffer &nodes, int nodeOffset)
+{
+    if (triangleCount <= 0)
+        return;
+
+    KernelManager &kernelManager = KernelManager::getInstance();
+    cl::CommandQueue queue = DeviceManager::getInstance()->getCommandQueue();
+    ensureCapacity(triangleCount);
+
+    size_t globalSize = ((static_cast<size_t>(triangleCount) + GROUP_SIZE - 1) / GROUP_SIZE) * GROUP_SIZE;
+    cl_float4 quantizationOrigin = {{mesh.quantization_origin.x, mesh.quantization_origin.y, mesh.quantization_origin.z, 0.0f}};
+    cl_float4 quantizationStep = {{mesh.quantization_step.x, mesh.quantization_step.y, mesh.quantization_step.z, 0.0f}};
+
+    // The first arguments of the geometry kernels describe the mesh (MESH_GEOMETRY_ARGS)
+    auto setGeometry = [&](cl::Kernel &kernel)
+    {
+        kernel.setArg(0, triangles);
+        kernel.setArg(1, vertices);
+        kernel.setArg(2, indices);
+        kernel.setArg(3, triangleOffset);
+        kernel.setArg(4, mesh.vertex_offset);
+        kernel.setArg(5, mesh.vertex_format);
+        kernel.setArg(6, quantizationOrigin);
+        kernel.setArg(7, quantizationStep);
+    };
+
+    // Single work-group walks every centroid
+    cl::Kernel boundsKernel = kernelManager.getKernel("lbvh_centroid_bounds");
+    setGeometry(boundsKernel);
+    boundsKernel.setArg(8, triangleCount);
+    boundsKernel.setArg(9, bounds);
+    queue.enqueueNDRangeKernel(boundsKernel, cl::NullRange, cl::NDRange(GROUP_SIZE), cl::NDRange(GROUP_SIZE));
+
+    cl::Kernel mortonKernel = kernelManager.getKernel("lbvh_morton_codes");
+    setGeometry(mortonKernel);
+    mortonKernel.setArg(8, triangleCount);
+    mortonKernel.setArg(9, bounds);
+    mortonKernel.setArg(10, keys);
+    mortonKernel.setArg(11, values);
+    queue.enqueueNDRangeKernel(mortonKernel, cl::NullRange, cl::NDRange(globalSize), cl::NDRange(GROUP_SIZE));
+
+    // Sorted in place: keys/values hold the sorted pairs on return
+    radixSort.sort(keys, values, triangleCount, MORTON_BITS);
+
+    cl::Kernel hierarchyKernel = kernelManager.getKernel("lbvh_hierarchy");
+    hierarchyKernel.setArg(0, keys);
+    hierarchyKernel.setArg(1, triangleCount);
+    hierarchyKernel.setArg(2, parents);
+    hierarchyKernel.setArg(3, nodeSlots);
+    hierarchyKernel.setArg(4, counters);
+    queue.enqueueNDRangeKernel(hierarchyKernel, cl::NullRange, cl::NDRange(globalSize), cl::NDRange(GROUP_SIZE));
+
+    cl::Kernel nodesKernel = kernelManager.getKernel("lbvh_bounds");
+    setGeometry(nodesKernel);
+    nodesKernel.setArg(8, triangleCount);
+    nodesKernel.setArg(9, values);
+    nodesKernel.setArg(10, parents);
+    nodesKernel.setArg(11, nodeSlots);
+    nodesKernel.setArg(12, counters);
+    nodesKernel.setArg(13, nodes);
+    nodesKernel.setArg(14, nodeOffset);
+    queue.enqueueNDRangeKernel(nodesKernel, cl::NullRange, cl::NDRange(globalSize), cl::NDRange(GROUP_SIZE));
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <CL/opencl.hpp>
+#include "RadixSort.h"
+#include "../../defines/Defines.h"
+
+// GPU linear BVH builder (Karras), kernels in kernels/lbvh.cl
+// Builds the tree of a mesh (or of one of its levels of detail) from the geometry already in the device buffers
+// straight into a range of the BVH node buffer, in the GPUBVHNode layout traced by intersect_bvh: the geometry
+// never goes back to the host. One triangle per leaf, referencing the triangle's position in the mesh's range;
+// the children of internal node i sit at 1 + 2i and 2 + 2i (adjacent, but not always after their parent)
+// Scratch buffers are kept between calls and only grow
+class LBVHBuilder
+{
+public:
+    static constexpr int GROUP_SIZE = 256; // must match LBVH_GROUP_SIZE in lbvh.cl
+    static constexpr int MORTON_BITS = 30;
+
+    LBVHBuilder() = default;
+    ~LBVHBuilder() = default;
+
+    // Nodes written for a mesh of triangleCount triangles (a binary tree over one triangle per leaf)
+    static int nodeCount(int triangleCount) { return triangleCount > 0 ? 2 * triangleCount - 1 : 0; }
+
+    // Build over triangles [triangleOffset, triangleOffset + triangleCount) of the geometry buffers, read the way
+    // mesh describes them (vertex format, vertex offset, quantization), into nodes [nodeOffset, + nodeCount)
+    void build(const GPUBVH &mesh, int triangleOffset, int triangleCount, const cl::Buffer &triangles, const cl::Buffer &vertices,
+               const cl::Buffer &indices, cl::Buffer &nodes, int nodeOffset);
+
+private:
+    RadixSort radixSort;
+    cl::Buffer keys;     // Morton codes, sorted in place
+    cl::Buffer values;   // triangle of each code
+    cl::Buffer parents;  // internal nodes then leaves: internal parent of each (-1 for the root)
+    cl::Buffer nodeSlots; // internal nodes then leaves: index of each in the output
+    cl::Buffer counters; // per internal node: children whose bounds are done
+    cl::Buffer bounds;   // centroid bounds (min, max)
+    size_t capacity = 0; // triangles the scratch buffers can hold
+
+    void ensureCapacity(size_t count);
+};
@@ -0,0 +1,82 @@
+#include "RadixSort.h"
+#include <utility>
+#include "../KernelManager/KernelManager.h"
+#include "../DeviceManager/DeviceManager.h"
+
+void RadixSort::ensureCapacity(size_t count, size_t numGroups)
+{
+    cl::Context context = DeviceManager::getInstance()->getContext();
+
+    if (count > scratchCapacity)
+    {
+        scratchKeys = cl::Buffer(context, CL_MEM_READ_WRITE, count * sizeof(cl_uint));
+        scratchValues = cl::Buffer(context, CL_MEM_READ_WRITE, count * sizeof(cl_uint));
+        scratchCapacity = count;
+    }
+
+    size_t histogramSize = numGroups * RADIX_BUCKETS;
+    if (histogramSize > histogramCapacity)
+    {
+        histograms = cl::Buffer(context, CL_MEM_READ_WRITE, histogramSize * sizeof(cl_uint));
+        histogramCapacity = histogramSize;
+    }
+}
+
+void RadixSort::sort(cl::Buffer &keys, cl::Buffer &values, int count, int keyBits)
+{
+    if (count <= 1 || keyBits <= 0)
+        return;
+
+    KernelManager &kernelManager = KernelManager::getInstance();
+    cl::CommandQueue queue = DeviceManager::getInstance()->getCommandQueue();
+
+    size_t numGroups = (static_cast<size_t>(count) + GROUP_SIZE - 1) / GROUP_SIZE;
+    size_t globalSize = numGroups * GROUP_SIZE;
+    int histogramCount = static_cast<int>(numGroups * RADIX_BUCKETS);
+    ensureCapacity(count, numGroups);
+
+    cl::Kernel histogramKernel = kernelManager.getKernel("radix_histogram");
+    cl::Kernel scanKernel = kernelManager.getKernel("radix_scan");
+    cl::Kernel scatterKernel = kernelManager.getKernel("radix_scatter");
+
+    int passes = (keyBits + RADIX_BITS - 1) / RADIX_BITS;
+    for (int pass = 0; pass < passes; ++pass)
+    {
+        int shift = pass * RADIX_BITS;
+
+        histogramKernel.setArg(0, keys);
+        histogramKernel.setArg(1, count);
+        histogramKernel.setArg(2, shift);
+        histogramKernel.setArg(3, histograms);
+        queue.enqueueNDRangeKernel(histogramKernel, cl::NullRange, cl::NDRange(globalSize), cl::NDRange(GROUP_SIZE));
+
+        // Single work-group walks the whole table
+        scanKernel.setArg(0, histograms);
+        scanKernel.setArg(1, histogramCount);
+        queue.enqueueNDRangeKernel(scanKernel, cl::NullRange, cl::NDRange(GROUP_SIZE), cl::NDRange(GROUP_SIZE));
+
+        scatterKernel.setArg(0, keys);
+        scatterKernel.setArg(1, values);
+        scatterKernel.setArg(2, count);
+        scatterKernel.setArg(3, shift);
+        scatterKernel.setArg(4, histograms);
+        scatterKernel.setArg(5, scratchKeys);
+        scatterKernel.setArg(6, scratchValues);
+        queue.enqueueNDRangeKernel(scatterKernel, cl::NullRange, cl::NDRange(globalSize), cl::NDRange(GROUP_SIZE));
+
+        // Ping-pong: sorted output becomes the input of the next pass
+        std::swap(keys, scratchKeys);
+        std::swap(values, scratchValues);
+    }
+
+    // After an odd number of passes the sorted pairs sit in the scratch buffers: give the caller
+    // its own buffers back and copy the result into them, so the scratch slot keeps its capacity
+    if (passes % 2 == 1)
+    {
+        std::swap(keys, scratchKeys);
+        std::swap(values, scratchValues);
+        size_t bytes = static_cast<size_t>(count) * sizeof(cl_uint);
+        queue.enqueueCopyBuffer(scratchKeys, keys, 0, 0, bytes);
+        queue.enqueueCopyBuffer(scratchValues, values, 0, 0, bytes);
+    }
+}
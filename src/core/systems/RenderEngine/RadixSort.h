@@ -0,0 +1,28 @@
+#pragma once
+#include <CL/opencl.hpp>
+
+// GPU LSD radix sort of (uint key, uint value) pairs, kernels in kernels/radixSort.cl
+// Scratch buffers are kept between calls and only grow
+class RadixSort
+{
+public:
+    static constexpr int RADIX_BITS = 4;
+    static constexpr int RADIX_BUCKETS = 1 << RADIX_BITS;
+    static constexpr int GROUP_SIZE = 256; // must match RADIX_GROUP_SIZE in radixSort.cl
+
+    RadixSort() = default;
+    ~RadixSort() = default;
+
+    // Sort the first count pairs by the low keyBits bits of the keys (stable)
+    // On return the caller's keys/values buffers hold the sorted pairs
+    void sort(cl::Buffer &keys, cl::Buffer &values, int count, int keyBits);
+
+private:
+    cl::Buffer scratchKeys;
+    cl::Buffer scratchValues;
+    cl::Buffer histograms;
+    size_t scratchCapacity = 0;   // elements in scratchKeys / scratchValues
+    size_t histogramCapacity = 0; // entries in histograms
+
+    void ensureCapacity(size_t count, size_t numGroups);
+};
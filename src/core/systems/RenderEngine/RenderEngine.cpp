@@ -1,9 +1,14 @@
 #include "RenderEngine.h"
 #include <iostream>
 #include <cstring>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <utility>
 #include "../../defines/Defines.h"
 #include "../../shapes/Triangle.h"
 #include "../../shapes/Mesh.h"
+#include "../AssetLoader/AssetLoader.h"
 
 RenderEngine::RenderEngine()
 {
@@ -37,6 +42,23 @@ void RenderEngine::setupBuffers(int width, int height)
         queue.enqueueWriteBuffer(accumBuffer, CL_TRUE, 0, imageSize, zeros.data());
     }
 
+    // A material entering or leaving the scene takes or frees a material slot, which the shapes refer to
+    uint64_t materialsVersion = SceneManager::getInstance().getMaterialsVersion();
+    if (materialsVersion != uploadedMaterialsVersion)
+    {
+        shapesBufferDirty = true;
+        materialBufferDirty = true;
+        uploadedMaterialsVersion = materialsVersion;
+
+        // A reloaded scene replaces every material: never carry texture indices over from the previous one
+        int sceneGeneration = SceneManager::getInstance().getSceneGeneration();
+        if (sceneGeneration != uploadedSceneGeneration)
+        {
+            textureBufferDirty = true;
+            uploadedSceneGeneration = sceneGeneration;
+        }
+    }
+
     // Setup shapes buffer only if it's dirty (shapes changed) or first time
     if (shapesBufferDirty)
     {
@@ -77,34 +99,45 @@ void RenderEngine::render(int width, int height)
                                   sizeof(GPUCamera),
                                   &gpu_camera);
 
-        // Set kernel arguments with camera buffer
-        kernel.setArg(0, outputBuffer);
-        kernel.setArg(1, accumBuffer);
-        kernel.setArg(2, width);
-        kernel.setArg(3, height);
-        kernel.setArg(4, frameCount);
-        kernel.setArg(5, shapesBuffer);
-        // Pass the actual number of GPU shapes stored in the shapes buffer
-        kernel.setArg(6, shapesCount);
-        kernel.setArg(7, cameraBuffer);        // Use camera buffer instead of direct parameters , somehow it's giving better performance
-        kernel.setArg(8, materialBuffer);      // Buffer containing all the material data
-        kernel.setArg(9, materialCount);       // Number of materials in the scene
-        kernel.setArg(10, textureBuffer);      // Buffer containing all texture data
-        kernel.setArg(11, bvhCount);           // Number of BVH in the scene
-        kernel.setArg(12, bvhNodesBuffer);     // BVH nodes buffer (flattened)
-        kernel.setArg(13, bvhTrianglesCount); // Number of BVH triangles
-        kernel.setArg(14, bvhTrianglesBuffer); // BVH triangles buffer
-
-        // Use optimal work-group size for better GPU performance
-        size_t globalSize = width * height;
-        size_t localSize = 256; // Typical optimal size for modern GPUs
-
-        // Round up to nearest multiple of localSize
-        size_t adjustedGlobalSize = ((globalSize + localSize - 1) / localSize) * localSize;
-
-        queue.enqueueNDRangeKernel(kernel, cl::NullRange,
-                                   cl::NDRange(adjustedGlobalSize),
-                                   cl::NDRange(localSize));
+        if (raySortingEnabled && gpu_camera.bufferType == IMAGE)
+        {
+            renderWavefront(width, height, gpu_camera.nbBounces, true);
+        }
+        else
+        {
+            // Set kernel arguments with camera buffer
+            kernel.setArg(0, outputBuffer);
+            kernel.setArg(1, accumBuffer);
+            kernel.setArg(2, width);
+            kernel.setArg(3, height);
+            kernel.setArg(4, frameCount);
+            kernel.setArg(5, shapesBuffer);
+            // Pass the actual number of GPU shapes stored in the shapes buffer
+            kernel.setArg(6, shapesCount);
+            kernel.setArg(7, cameraBuffer);        // Use camera buffer instead of direct parameters , somehow it's giving better performance
+            kernel.setArg(8, materialBuffer);      // Buffer containing all the material data
+            kernel.setArg(9, materialCount);       // Number of materials in the scene
+            kernel.setArg(10, textureAtlasImage);  // Image containing all texture data
+            kernel.setArg(11, textureDescriptorBuffer); // Rectangle of each texture in the atlas
+            kernel.setArg(12, textureBlocksBuffer); // Block-compressed textures
+            kernel.setArg(13, bvhCount);           // Number of BVH in the scene
+            kernel.setArg(14, bvhNodesBuffer);     // BVH nodes buffer (flattened)
+            kernel.setArg(15, bvhTrianglesCount); // Number of BVH triangles
+            kernel.setArg(16, bvhTrianglesBuffer); // BVH triangles buffer
+            kernel.setArg(17, meshVerticesBuffer); // Mesh vertices (indexed layouts)
+            kernel.setArg(18, meshIndicesBuffer);  // Mesh faces in BVH order (indexed layouts)
+
+            // Use optimal work-group size for better GPU performance
+            size_t globalSize = width * height;
+            size_t localSize = 256; // Typical optimal size for modern GPUs
+
+            // Round up to nearest multiple of localSize
+            size_t adjustedGlobalSize = ((globalSize + localSize - 1) / localSize) * localSize;
+
+            queue.enqueueNDRangeKernel(kernel, cl::NullRange,
+                                       cl::NDRange(adjustedGlobalSize),
+                                       cl::NDRange(localSize));
+        }
 
         // Map buffer for zero-copy read (faster than enqueueReadBuffer)
         float *mappedPtr = (float *)queue.enqueueMapBuffer(outputBuffer, CL_TRUE, CL_MAP_READ, 0,
@@ -135,6 +168,73 @@ void RenderEngine::render(int width, int height)
     }
 }
 
+// Dequantization of a mesh's 16-bit vertices: its bounds split in 65535 steps per axis
+static void meshQuantization(const std::vector<vec3> &positions, Vec3 &origin, Vec3 &step)
+{
+    vec3 minPoint(FLT_MAX), maxPoint(-FLT_MAX);
+    for (const vec3 &p : positions)
+    {
+        minPoint = vec3(std::min(minPoint.x, p.x), std::min(minPoint.y, p.y), std::min(minPoint.z, p.z));
+        maxPoint = vec3(std::max(maxPoint.x, p.x), std::max(maxPoint.y, p.y), std::max(maxPoint.z, p.z));
+    }
+    if (positions.empty())
+        minPoint = maxPoint = vec3(0.0f);
+    origin = {minPoint.x, minPoint.y, minPoint.z, 0.0f};
+    step = {(maxPoint.x - minPoint.x) / 65535.0f, (maxPoint.y - minPoint.y) / 65535.0f, (maxPoint.z - minPoint.z) / 65535.0f, 0.0f};
+}
+
+static void appendMeshVertices(const std::vector<vec3> &positions, VertexFormat format, const Vec3 &origin, const Vec3 &step,
+                               std::vector<cl_ushort> &quantized, std::vector<cl_float> &packed)
+{
+    if (format == VERTEX_FLOAT)
+    {
+        for (const vec3 &p : positions)
+            packed.insert(packed.end(), {p.x, p.y, p.z});
+        return;
+    }
+    auto quantize = [](float value, float origin, float step)
+    {
+        return static_cast<cl_ushort>(step > 0.0f ? std::clamp(std::lround((value - origin) / step), 0l, 65535l) : 0);
+    };
+    for (const vec3 &p : positions)
+        quantized.insert(quantized.end(), {quantize(p.x, origin.x, step.x), quantize(p.y, origin.y, step.y), quantize(p.z, origin.z, step.z), 0});
+}
+
+// BVH nodes in device layout, grown by padding: dequantized vertices may lie up to half a step outside the exact bounds
+static void appendPaddedNodes(const BVH &bvh, float padding, std::vector<GPUBVHNode> &nodes)
+{
+    size_t first = nodes.size();
+    nodes.insert(nodes.end(), bvh.getGPUNodes(), bvh.getGPUNodes() + bvh.getGPUNodeCount());
+    if (padding <= 0.0f)
+        return;
+    for (size_t i = first; i < nodes.size(); ++i)
+    {
+        nodes[i].minx -= padding;
+        nodes[i].miny -= padding;
+        nodes[i].minz -= padding;
+        nodes[i].maxx += padding;
+        nodes[i].maxy += padding;
+        nodes[i].maxz += padding;
+    }
+}
+
+// Device triangles of faces in index buffer order: the layout of device-built BVHs, whose leaves index faces directly
+static void appendFaceTriangles(const std::vector<vec3> &positions, const std::vector<unsigned int> &indices, std::vector<GPUTriangle> &triangles)
+{
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        GPUTriangle triangle = {};
+        const vec3 &v0 = positions[indices[i]];
+        const vec3 &v1 = positions[indices[i + 1]];
+        const vec3 &v2 = positions[indices[i + 2]];
+        triangle.v0 = {v0.x, v0.y, v0.z, 0.0f};
+        triangle.v1 = {v1.x, v1.y, v1.z, 0.0f};
+        triangle.v2 = {v2.x, v2.y, v2.z, 0.0f};
+        triangle.materialIndex = -1;
+        triangles.push_back(triangle);
+    }
+}
+
 // setup the bugger containing all GPU shapes
 void RenderEngine::setupShapesBuffer()
 {
@@ -146,89 +246,187 @@ void RenderEngine::setupShapesBuffer()
     std::vector<GPUShape> gpu_shapes;
     std::vector<GPUBVHNode> gpu_bvh_nodes;
     std::vector<GPUTriangle> gpu_bvh_triangles;
+    std::vector<GPUBVHNode> gpu_bvh_roots; // root of each mesh BVH, in shape order
+    std::vector<cl_ushort> gpu_mesh_vertices_quantized; // indexed layouts: the vertices of every mesh
+    std::vector<cl_float> gpu_mesh_vertices_float;
+    std::vector<cl_uint> gpu_mesh_indices; // indexed layouts: 3 vertex indices per BVH triangle
+    bool indexed = meshVertexFormat != VERTEX_TRIANGLES;
 
     bool containsBVH = false;
 
-    // Pre-calculate total size needed to avoid reallocations
-    size_t estimatedShapes = 0;
-    size_t estimatedBVHNodes = 0;
-    size_t estimatedBVHTriangles = 0;
+    // Spheres, squares and triangles are packed by the scene store, only the changed ones again
+    SceneStore &store = sceneManager.getStore();
+    store.sync(sceneManager.getMaterialsVersion());
+
+    // Layout of the BVH buffers: every mesh's BVH followed by the BVHs of its levels of detail, in shape order
+    size_t meshCount = 0;
+    struct MeshBVH
+    {
+        const BVH *bvh;                           // host tree (stale for device-built ones)
+        Mesh *mesh;
+        const std::vector<unsigned int> *indices; // the mesh's or its level of detail's
+        float padding;                            // of the node bounds, see appendPaddedNodes
+        bool onDevice;                            // built by lbvhBuilder once the geometry is uploaded
+        int nodeCount;
+        int triangleCount;
+        uint32_t version; // see UploadedBVH::boundsVersion
+    };
+    std::vector<MeshBVH> meshBVHs;
+    std::vector<UploadedBVH> bvhLayout;
+    std::vector<std::pair<Vec3, Vec3>> meshQuantizations; // origin and step of each mesh, in shape order
+    int nodeOffset = 0;
+    int triangleOffset = 0;
 
     for (auto *shape : shapes)
     {
         if (shape->getType() == MESH)
         {
             Mesh *mesh = static_cast<Mesh *>(shape);
-            estimatedBVHTriangles += mesh->getTriangles().size();
-            estimatedBVHNodes += log2(mesh->getTriangles().size());
+            mesh->setBVHQuality(meshBVHQuality);
+            mesh->setDeviceBVH(deviceMeshBVH);
+            meshCount++;
+            Vec3 origin = {}, step = {};
+            if (meshVertexFormat == VERTEX_QUANTIZED)
+                meshQuantization(mesh->getPositions(), origin, step);
+            meshQuantizations.push_back({origin, step});
+            float padding = std::max(step.x, std::max(step.y, step.z));
+            for (size_t level = 0; level <= mesh->getLODCount(); ++level)
+            {
+                const BVH &bvh = level == 0 ? mesh->getBVH() : *mesh->getLOD(level).bvh;
+                const std::vector<unsigned int> &levelIndices = level == 0 ? mesh->getIndices() : mesh->getLOD(level).indices;
+                bool onDevice = mesh->hasDeviceBVH();
+                // An SBVH has more triangle references than its mesh has faces
+                int levelTriangles = onDevice ? static_cast<int>(levelIndices.size() / 3) : static_cast<int>(bvh.getGPUTriangleCount());
+                int levelNodes = onDevice ? LBVHBuilder::nodeCount(levelTriangles) : static_cast<int>(bvh.getGPUNodeCount());
+                uint32_t version = onDevice ? mesh->getGeometryVersion() : bvh.getBoundsVersion();
+                meshBVHs.push_back({&bvh, mesh, &levelIndices, padding, onDevice, levelNodes, levelTriangles, version});
+                bvhLayout.push_back({bvh.getTopologyId(), version, nodeOffset, triangleOffset, onDevice});
+                nodeOffset += levelNodes;
+                triangleOffset += levelTriangles;
+            }
         }
+    }
+
+    // Same meshes with the same BVH topologies as the last upload (only refitted since): the BVH buffers keep
+    // their layout and only the refitted ranges are rewritten
+    bool refitOnly = !meshBVHs.empty() && bvhLayout.size() == uploadedBVHs.size();
+    for (size_t i = 0; refitOnly && i < bvhLayout.size(); ++i)
+        refitOnly = bvhLayout[i].topologyId == uploadedBVHs[i].topologyId && bvhLayout[i].onDevice == uploadedBVHs[i].onDevice;
+
+    gpu_shapes.reserve(store.primitiveCount() + meshCount);
+    gpu_bvh_roots.reserve(meshCount);
+    if (!refitOnly)
+    {
+        gpu_bvh_nodes.reserve(nodeOffset);
+        if (indexed)
+            gpu_mesh_indices.reserve(3 * static_cast<size_t>(triangleOffset));
         else
+            gpu_bvh_triangles.reserve(triangleOffset);
+        for (const MeshBVH &meshBVH : meshBVHs)
+        {
+            const BVH &bvh = *meshBVH.bvh;
+            if (meshBVH.onDevice)
+            {
+                // The device builder fills the nodes, its leaves reference the faces in index order
+                gpu_bvh_nodes.resize(gpu_bvh_nodes.size() + meshBVH.nodeCount, GPUBVHNode{});
+                if (indexed)
+                    gpu_mesh_indices.insert(gpu_mesh_indices.end(), meshBVH.indices->begin(), meshBVH.indices->end());
+                else
+                    appendFaceTriangles(meshBVH.mesh->getPositions(), *meshBVH.indices, gpu_bvh_triangles);
+                continue;
+            }
+            appendPaddedNodes(bvh, meshBVH.padding, gpu_bvh_nodes);
+            if (!indexed)
+            {
+                gpu_bvh_triangles.insert(gpu_bvh_triangles.end(), bvh.getGPUTriangles(), bvh.getGPUTriangles() + bvh.getGPUTriangleCount());
+                continue;
+            }
+            // Faces in the BVH's triangle order, indexing the mesh's vertices
+            const uint32_t *order = bvh.getTriangleOrder();
+            for (size_t i = 0; i < bvh.getGPUTriangleCount(); ++i)
+            {
+                const unsigned int *face = meshBVH.indices->data() + 3 * static_cast<size_t>(order[i]);
+                gpu_mesh_indices.insert(gpu_mesh_indices.end(), {face[0], face[1], face[2]});
+            }
+        }
+    }
+    // Vertices are rewritten by refits too (they are cheap next to the faces)
+    if (indexed)
+    {
+        size_t meshIndex = 0;
+        for (auto *shape : shapes)
         {
-            estimatedShapes++;
+            if (shape->getType() != MESH)
+                continue;
+            const std::pair<Vec3, Vec3> &quantization = meshQuantizations[meshIndex++];
+            appendMeshVertices(static_cast<Mesh *>(shape)->getPositions(), meshVertexFormat, quantization.first, quantization.second,
+                               gpu_mesh_vertices_quantized, gpu_mesh_vertices_float);
         }
     }
-    gpu_shapes.reserve(estimatedShapes);
-    gpu_bvh_nodes.reserve(estimatedBVHNodes);
-    gpu_bvh_triangles.reserve(estimatedBVHTriangles);
+    size_t nextBVH = 0;
+    size_t nextMesh = 0;
+    int vertexOffset = 0;
+    std::vector<std::pair<size_t, size_t>> deviceBuilds; // (BVH of meshBVHs, its mesh in gpu_shapes)
 
+    // Primitives first, one pool after the other, then the meshes in shape order
+    store.appendPrimitives(gpu_shapes);
     for (auto *shape : shapes)
     {
-        GPUShape gpu_shape;
-        ShapeType type = shape->getType();
-        gpu_shape.type = type;
-
-        switch (type)
-        {
-        case SPHERE:
+        if (shape->getType() != MESH)
+            continue;
+        GPUShape gpu_shape = {};
+        gpu_shape.type = MESH;
+        Mesh *mesh = static_cast<Mesh *>(shape);
+        GPUBVH bvh_gpu = {};
+        bvh_gpu.material_index = mesh->getMaterial() ? mesh->getMaterial()->getGPUIndex() : -1;
+
+        // Store offsets and counts (nodes and triangles are already in the BVH buffers, in GPU layout,
+        // possibly mapped from the mesh cache)
+        const MeshBVH &meshBVH = meshBVHs[nextBVH];
+        bvh_gpu.node_offset = bvhLayout[nextBVH].nodeOffset;
+        bvh_gpu.triangle_offset = bvhLayout[nextBVH].triangleOffset;
+        bvh_gpu.node_count = meshBVH.nodeCount;
+        bvh_gpu.triangle_count = meshBVH.triangleCount;
+        if (meshBVH.onDevice)
         {
-            Sphere *sphere = static_cast<Sphere *>(shape);
-            gpu_shape.data.sphere = sphere->toGPU();
-            break;
+            // The host root is stale: bound the scene with the mesh's current vertices
+            AABB box = mesh->computeAABB();
+            GPUBVHNode root = {};
+            root.minx = box.minPoint.x;
+            root.miny = box.minPoint.y;
+            root.minz = box.minPoint.z;
+            root.maxx = box.maxPoint.x;
+            root.maxy = box.maxPoint.y;
+            root.maxz = box.maxPoint.z;
+            gpu_bvh_roots.push_back(root);
         }
-        case SQUARE:
+        else if (bvh_gpu.node_count > 0)
         {
-            Square *square = static_cast<Square *>(shape);
-            gpu_shape.data.square = square->toGPU();
-            break;
+            gpu_bvh_roots.push_back(meshBVH.bvh->getGPUNodes()[0]);
         }
-        case TRIANGLE:
+
+        bvh_gpu.lod_count = static_cast<int>(mesh->getLODCount());
+        for (int level = 0; level <= bvh_gpu.lod_count; ++level, ++nextBVH)
         {
-            Triangle *triangle = static_cast<Triangle *>(shape);
-            gpu_shape.data.triangle = triangle->toGPU();
-            break;
+            if (meshBVHs[nextBVH].onDevice)
+                deviceBuilds.push_back({nextBVH, gpu_shapes.size()});
+            if (level == 0)
+                continue;
+            bvh_gpu.lod_node_offset[level - 1] = bvhLayout[nextBVH].nodeOffset;
+            bvh_gpu.lod_triangle_offset[level - 1] = bvhLayout[nextBVH].triangleOffset;
+            bvh_gpu.lod_triangle_count[level - 1] = meshBVHs[nextBVH].triangleCount;
+            bvh_gpu.lod_hit_offset[level - 1] = mesh->getLOD(level).hitOffset;
         }
-        case MESH:
-        {
-            Mesh *mesh = static_cast<Mesh *>(shape);
-            GPUBVH bvh_gpu;
-            bvh_gpu.material_index = mesh->getMaterial() ? mesh->getMaterial()->getMaterialId() : -1;
-
-            // Store offsets and counts
-            bvh_gpu.node_offset = static_cast<int>(gpu_bvh_nodes.size());
-            bvh_gpu.triangle_offset = static_cast<int>(gpu_bvh_triangles.size());
-            bvh_gpu.node_count = mesh->getBVH().nodes.size();
-            bvh_gpu.triangle_count = mesh->getBVH().triangles.size();   
-
-            // Append BVH nodes
-            for (const auto &node : mesh->getBVH().nodes)
-            {
-                gpu_bvh_nodes.push_back(node.toGPU());
-            }
 
-            // Append BVH triangles (use BVH's reordered triangles, not original mesh triangles)
-            for (const auto &tri : mesh->getBVH().triangles)
-            {
-                gpu_bvh_triangles.push_back(tri.toGPU());
-            }
+        bvh_gpu.vertex_format = meshVertexFormat;
+        bvh_gpu.vertex_offset = vertexOffset;
+        bvh_gpu.quantization_origin = meshQuantizations[nextMesh].first;
+        bvh_gpu.quantization_step = meshQuantizations[nextMesh].second;
+        vertexOffset += static_cast<int>(mesh->getVertexCount());
+        nextMesh++;
 
-            gpu_shape.data.bvh = bvh_gpu;
-            containsBVH = true;
-            break;
-        }
-        default:
-            std::cerr << "Unknown shape type encountered in setupShapesBuffer: " << type << std::endl;
-            break;
-        }
+        gpu_shape.data.bvh = bvh_gpu;
+        containsBVH = true;
 
         gpu_shapes.push_back(gpu_shape);
     }
@@ -236,11 +434,32 @@ void RenderEngine::setupShapesBuffer()
     size_t shape_buffer_size = gpu_shapes.size() * sizeof(GPUShape);
     size_t bvh_nodes_buffer_size = gpu_bvh_nodes.size() * sizeof(GPUBVHNode);
     size_t bvh_triangles_buffer_size = gpu_bvh_triangles.size() * sizeof(GPUTriangle);
+    size_t mesh_vertices_buffer_size = meshVertexFormat == VERTEX_QUANTIZED ? gpu_mesh_vertices_quantized.size() * sizeof(cl_ushort)
+                                                                            : gpu_mesh_vertices_float.size() * sizeof(cl_float);
+    const void *mesh_vertices_data = meshVertexFormat == VERTEX_QUANTIZED ? static_cast<const void *>(gpu_mesh_vertices_quantized.data())
+                                                                          : static_cast<const void *>(gpu_mesh_vertices_float.data());
+    size_t mesh_indices_buffer_size = gpu_mesh_indices.size() * sizeof(cl_uint);
+
+    // Kernel arguments cannot be null: unused geometry buffers get a placeholder element
+    auto placeholder = [&context](size_t size)
+    {
+        return cl::Buffer(context, CL_MEM_READ_ONLY, size);
+    };
+
+    // Device-built BVHs are written once their geometry is in the buffers
+    auto buildOnDevice = [&](size_t bvh, size_t shape)
+    {
+        lbvhBuilder.build(gpu_shapes[shape].data.bvh, bvhLayout[bvh].triangleOffset, meshBVHs[bvh].triangleCount, bvhTrianglesBuffer,
+                          meshVerticesBuffer, meshIndicesBuffer, bvhNodesBuffer, bvhLayout[bvh].nodeOffset);
+    };
+
+    // Scene bounds are only needed to quantise ray origins when sorting rays
+    updateSceneBounds(gpu_shapes, gpu_bvh_roots);
 
     // Update shapesCount for kernel use
     shapesCount = static_cast<int>(gpu_shapes.size());
-    bvhCount = static_cast<int>(gpu_bvh_nodes.size() > 0 ? 1 : 0); // For now, we consider one BVH if there are any nodes
-    bvhTrianglesCount = static_cast<int>(gpu_bvh_triangles.size());
+    bvhCount = static_cast<int>(nodeOffset > 0 ? 1 : 0); // For now, we consider one BVH if there are any nodes
+    bvhTrianglesCount = triangleOffset;
 
     if (shape_buffer_size > 0)
     {
@@ -248,15 +467,95 @@ void RenderEngine::setupShapesBuffer()
                                   shape_buffer_size,
                                   gpu_shapes.data());
         std::cout << "Buffer created or updated successfully! (" << shapesCount << " shapes)" << std::endl;
-        if (containsBVH)
+        if (containsBVH && refitOnly)
         {
-            bvhNodesBuffer = cl::Buffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+            // Rewrite the node bounds and triangle vertices of the refitted BVHs in place (indexed layouts keep
+            // their faces: the vertex buffer is rewritten instead). Device-built BVHs only get their geometry
+            // rewritten, then are rebuilt on the device
+            int rewritten = 0;
+            std::vector<char> changed(meshBVHs.size(), 0);
+            std::vector<GPUBVHNode> paddedNodes;
+            std::vector<GPUTriangle> faceTriangles;
+            for (size_t i = 0; i < meshBVHs.size(); ++i)
+            {
+                const MeshBVH &meshBVH = meshBVHs[i];
+                const BVH &bvh = *meshBVH.bvh;
+                UploadedBVH &uploaded = uploadedBVHs[i];
+                if (meshBVH.version == uploaded.boundsVersion)
+                    continue;
+                if (meshBVH.onDevice)
+                {
+                    if (!indexed)
+                    {
+                        faceTriangles.clear();
+                        appendFaceTriangles(meshBVH.mesh->getPositions(), *meshBVH.indices, faceTriangles);
+                        queue.enqueueWriteBuffer(bvhTrianglesBuffer, CL_TRUE, uploaded.triangleOffset * sizeof(GPUTriangle),
+                                                 faceTriangles.size() * sizeof(GPUTriangle), faceTriangles.data());
+                    }
+                }
+                else
+                {
+                    paddedNodes.clear();
+                    appendPaddedNodes(bvh, meshBVH.padding, paddedNodes);
+                    queue.enqueueWriteBuffer(bvhNodesBuffer, CL_TRUE, uploaded.nodeOffset * sizeof(GPUBVHNode),
+                                             paddedNodes.size() * sizeof(GPUBVHNode), paddedNodes.data());
+                    if (!indexed)
+                        queue.enqueueWriteBuffer(bvhTrianglesBuffer, CL_TRUE, uploaded.triangleOffset * sizeof(GPUTriangle),
+                                                 bvh.getGPUTriangleCount() * sizeof(GPUTriangle), bvh.getGPUTriangles());
+                }
+                uploaded.boundsVersion = meshBVH.version;
+                changed[i] = 1;
+                rewritten++;
+            }
+            if (indexed && rewritten > 0)
+                queue.enqueueWriteBuffer(meshVerticesBuffer, CL_TRUE, 0, mesh_vertices_buffer_size, mesh_vertices_data);
+            int deviceBuilt = 0;
+            for (const std::pair<size_t, size_t> &build : deviceBuilds)
+            {
+                if (changed[build.first])
+                {
+                    buildOnDevice(build.first, build.second);
+                    deviceBuilt++;
+                }
+            }
+            if (rewritten > 0)
+                std::cout << "BVH Buffers refitted in place (" << rewritten - deviceBuilt << " BVH, " << deviceBuilt << " rebuilt on the device)" << std::endl;
+        }
+        else if (containsBVH)
+        {
+            // The device builder writes into the node buffer
+            bvhNodesBuffer = cl::Buffer(context, (deviceBuilds.empty() ? CL_MEM_READ_ONLY : CL_MEM_READ_WRITE) | CL_MEM_COPY_HOST_PTR,
                                         bvh_nodes_buffer_size,
                                         gpu_bvh_nodes.data());
-            bvhTrianglesBuffer = cl::Buffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
-                                            bvh_triangles_buffer_size,
-                                            gpu_bvh_triangles.data());
-            std::cout << "BVH Buffers created or updated successfully! (" << bvhCount << " BVH, " << bvhTrianglesCount << " triangles)" << std::endl;
+            if (indexed)
+            {
+                bvhTrianglesBuffer = placeholder(sizeof(GPUTriangle));
+                meshVerticesBuffer = cl::Buffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                                mesh_vertices_buffer_size,
+                                                const_cast<void *>(mesh_vertices_data));
+                meshIndicesBuffer = cl::Buffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                               mesh_indices_buffer_size,
+                                               gpu_mesh_indices.data());
+            }
+            else
+            {
+                bvhTrianglesBuffer = cl::Buffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                                bvh_triangles_buffer_size,
+                                                gpu_bvh_triangles.data());
+                meshVerticesBuffer = placeholder(4 * sizeof(cl_float));
+                meshIndicesBuffer = placeholder(3 * sizeof(cl_uint));
+            }
+            size_t geometryBytes = indexed ? mesh_vertices_buffer_size + mesh_indices_buffer_size : bvh_triangles_buffer_size;
+            std::cout << "BVH Buffers created or updated successfully! (" << bvhCount << " BVH, " << bvhTrianglesCount << " triangles, "
+                      << geometryBytes / (1024.0 * 1024.0) << " MB of "
+                      << (meshVertexFormat == VERTEX_QUANTIZED ? "quantized indexed" : indexed ? "indexed" : "triangle") << " geometry)" << std::endl;
+
+            for (const std::pair<size_t, size_t> &build : deviceBuilds)
+                buildOnDevice(build.first, build.second);
+            if (!deviceBuilds.empty())
+                std::cout << "BVH built on the device for " << deviceBuilds.size() << " BVH" << std::endl;
+
+            uploadedBVHs = std::move(bvhLayout);
         }
         else
         {
@@ -268,8 +567,11 @@ void RenderEngine::setupShapesBuffer()
             bvhTrianglesBuffer = cl::Buffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
                                             sizeof(GPUTriangle),
                                             nullptr);
+            meshVerticesBuffer = placeholder(4 * sizeof(cl_float));
+            meshIndicesBuffer = placeholder(3 * sizeof(cl_uint));
             bvhCount = 0;
             bvhTrianglesCount = 0;
+            uploadedBVHs.clear();
             std::cout << "No GPU BVH - created dummy buffers" << std::endl;
         }
     }
@@ -291,20 +593,24 @@ void RenderEngine::setupShapesBuffer()
         bvhTrianglesBuffer = cl::Buffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
                                         sizeof(GPUTriangle),
                                         nullptr);
+        meshVerticesBuffer = placeholder(4 * sizeof(cl_float));
+        meshIndicesBuffer = placeholder(3 * sizeof(cl_uint));
         bvhCount = 0;
         bvhTrianglesCount = 0;
+        uploadedBVHs.clear();
         std::cout << "No GPU BVH - created dummy buffers" << std::endl;
     }
 }
 
 // setup the buffer that contain all the material
-// Materials are stored at their material_id index for O(1) direct access on GPU
+// Materials are stored at their GPU index for O(1) direct access on GPU; SceneManager hands out these indices
+// from a free list, so the array stays about as large as the number of materials in the scene
+// Textures are only stored again when a map was set or removed, a material holding maps was added or removed,
+// or markTexturesDirty was called: other edits (colors, metalness...) only rewrite the slots that changed
 void RenderEngine::setupMaterialBuffer()
 {
     SceneManager &sceneManager = SceneManager::getInstance();
-    sceneManager.updateUniqueMaterials(); // update the materials list to have only unique materials
-    const std::vector<Material *> &materials = sceneManager.getMaterials();
-    cl::CommandQueue queue = deviceManager->getCommandQueue();
+    const std::vector<Material *> &materials = sceneManager.getMaterials(); // each material once
     cl::Context context = deviceManager->getContext();
 
     if (materials.empty())
@@ -316,23 +622,18 @@ void RenderEngine::setupMaterialBuffer()
                                     sizeof(GPUMaterial),
                                     &dummyMaterial);
         materialCount = 0;
+        materialCapacity = 0;
+        gpuMaterials.clear();
+        uploadedMaterials.clear();
         std::cout << "No GPU materials - created dummy buffer" << std::endl;
         return;
     }
 
-    // Find the maximum material_id to determine array size
-    int maxMaterialId = -1;
-    for (auto *material : materials)
-    {
-        if (material && material->getMaterialId() > maxMaterialId)
-        {
-            maxMaterialId = material->getMaterialId();
-        }
-    }
-
-    // Create array sized to hold all materials at their material_id index
+    // Create array sized to hold all materials at their GPU index
     // This enables O(1) direct access: materials[materialIndex] instead of linear search
-    std::vector<GPUMaterial> gpu_materials(maxMaterialId + 1);
+    int slotCount = sceneManager.getMaterialSlotCount();
+    std::vector<GPUMaterial> gpu_materials(slotCount);
+    std::vector<UploadedMaterial> slotMaterials(slotCount);
 
     // Initialize all slots with invalid material_id (-1)
     for (auto &mat : gpu_materials)
@@ -340,7 +641,7 @@ void RenderEngine::setupMaterialBuffer()
         mat.material_id = -1;
     }
 
-    // Place each material at its material_id index
+    // Place each material at its GPU index
     for (auto *material : materials)
     {
         if (!material)
@@ -348,72 +649,136 @@ void RenderEngine::setupMaterialBuffer()
             std::cerr << "Warning: Null material pointer in materials vector, skipping..." << std::endl;
             continue;
         }
-        int matId = material->getMaterialId();
-        if (matId >= 0 && matId <= maxMaterialId)
+        int slot = material->getGPUIndex();
+        if (slot >= 0 && slot < slotCount)
         {
-            gpu_materials[matId] = material->toGPU();
+            GPUMaterial &gpu_material = gpu_materials[slot];
+            gpu_material = material->toGPU();
+            bool hasMaps = gpu_material.has_texture || gpu_material.has_normal_map || gpu_material.has_metal_map || gpu_material.has_emissive_map;
+            slotMaterials[slot] = UploadedMaterial(*material, hasMaps);
         }
     }
 
-    // Setup texture buffer and update texture offsets in gpu_materials
-    setupTextureBuffer(gpu_materials);
-
-    size_t buffer_size = gpu_materials.size() * sizeof(GPUMaterial);
-    // Update materialCount for kernel use (now represents array size, not just count of valid materials)
-    materialCount = static_cast<int>(gpu_materials.size());
-
-    materialBuffer = cl::Buffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
-                                buffer_size,
-                                gpu_materials.data());
-    std::cout << "Material buffer created or updated successfully! (" << materialCount << " material slots)" << std::endl;
-}
-
-// Setup texture buffer containing all texture image data
-// gpu_materials is indexed by material_id, so we iterate through the actual materials
-// and update the corresponding slot in gpu_materials
-void RenderEngine::setupTextureBuffer(std::vector<GPUMaterial> &gpu_materials)
-{
-    SceneManager &sceneManager = SceneManager::getInstance();
-    const std::vector<Material *> &materials = sceneManager.getMaterials();
-    cl::Context context = deviceManager->getContext();
+    // The atlas only depends on the maps: find out whether any of them changed since the last upload
+    bool texturesChanged = textureBufferDirty || UploadedMaterial::mapsChanged(uploadedMaterials, slotMaterials);
 
-    // Pre-calculate total size needed for all texture data
-    size_t totalSize = 0;
-    for (auto *material : materials)
+    if (texturesChanged)
     {
-        if (material)
+        // Setup texture atlas and update texture indices in gpu_materials
+        setupTextureBuffer(gpu_materials);
+        textureBufferDirty = false;
+    }
+    else
+    {
+        // Same maps: the uploaded materials keep the textures they were bound to, new ones have none
+        for (size_t slot = 0; slot < slotMaterials.size(); ++slot)
         {
-            const ppmLoader::ImageRGB &image = material->getImage();
-            const ppmLoader::ImageRGB &normals = material->getNormals();
-            const ppmLoader::ImageRGB &metallic = material->getMetallic();
-            const ppmLoader::ImageRGB &emissive = material->getEmissive();
-
-            if (!image.data.empty() && image.w > 0 && image.h > 0)
+            if (!slotMaterials[slot].serial)
+                continue;
+            GPUMaterial &gpu_material = gpu_materials[slot];
+            if (slot < uploadedMaterials.size() && uploadedMaterials[slot].serial == slotMaterials[slot].serial)
             {
-                totalSize += image.data.size() * 3; // RGB: 3 bytes per pixel
+                const GPUMaterial &uploaded = gpuMaterials[slot];
+                gpu_material.has_texture = uploaded.has_texture;
+                gpu_material.has_normal_map = uploaded.has_normal_map;
+                gpu_material.has_metal_map = uploaded.has_metal_map;
+                gpu_material.has_emissive_map = uploaded.has_emissive_map;
+                gpu_material.texture_index = uploaded.texture_index;
+                gpu_material.normal_map_index = uploaded.normal_map_index;
+                gpu_material.metal_map_index = uploaded.metal_map_index;
+                gpu_material.emissive_map_index = uploaded.emissive_map_index;
+                gpu_material.packed_maps = uploaded.packed_maps;
             }
-
-            if (material->hasNormalMap() && !normals.data.empty() && normals.w > 0 && normals.h > 0)
+            else
             {
-                totalSize += normals.data.size() * 3; // RGB: 3 bytes per pixel
+                gpu_material.texture_index = -1;
+                gpu_material.normal_map_index = -1;
+                gpu_material.metal_map_index = -1;
+                gpu_material.emissive_map_index = -1;
+                gpu_material.packed_maps = 0;
             }
+        }
+    }
 
-            if (material->hasMetallicMap() && !metallic.data.empty() && metallic.w > 0 && metallic.h > 0)
-            {
-                totalSize += metallic.data.size() * 3; // RGB: 3 bytes per pixel
-            }
+    writeMaterialSlots(gpu_materials);
+    gpuMaterials = std::move(gpu_materials);
+    uploadedMaterials = std::move(slotMaterials);
+}
 
-            if (material->hasEmissiveMap() && !emissive.data.empty() && emissive.w > 0 && emissive.h > 0)
-            {
-                totalSize += emissive.data.size() * 3; // RGB: 3 bytes per pixel
-            }
+// Write the slots that differ from the last upload, in runs of consecutive slots
+// The buffer is only reallocated when it has to grow (to twice the slots needed)
+void RenderEngine::writeMaterialSlots(const std::vector<GPUMaterial> &gpu_materials)
+{
+    cl::CommandQueue queue = deviceManager->getCommandQueue();
+    cl::Context context = deviceManager->getContext();
+    int count = static_cast<int>(gpu_materials.size());
+    // Update materialCount for kernel use (array size: free slots included)
+    materialCount = count;
+
+    if (count > materialCapacity)
+    {
+        materialCapacity = 2 * count;
+        std::vector<GPUMaterial> buffer(materialCapacity);
+        std::copy(gpu_materials.begin(), gpu_materials.end(), buffer.begin());
+        for (int slot = count; slot < materialCapacity; ++slot)
+            buffer[slot].material_id = -1;
+        materialBuffer = cl::Buffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                    buffer.size() * sizeof(GPUMaterial),
+                                    buffer.data());
+        std::cout << "Material buffer created successfully! (" << materialCount << " material slots)" << std::endl;
+        return;
+    }
+
+    auto unchanged = [&](int slot)
+    {
+        return slot < static_cast<int>(gpuMaterials.size()) &&
+               std::memcmp(&gpu_materials[slot], &gpuMaterials[slot], sizeof(GPUMaterial)) == 0;
+    };
+    for (int slot = 0; slot < count;)
+    {
+        if (unchanged(slot))
+        {
+            ++slot;
+            continue;
         }
+        int end = slot + 1;
+        while (end < count && !unchanged(end))
+            ++end;
+        queue.enqueueWriteBuffer(materialBuffer, CL_TRUE, slot * sizeof(GPUMaterial),
+                                 (end - slot) * sizeof(GPUMaterial), &gpu_materials[slot]);
+        slot = end;
     }
+}
+
+// Setup the texture atlas image containing all texture image data
+// gpu_materials is indexed by GPU index, so we iterate through the actual materials
+// and store in the corresponding slot the index of each map in the texture table
+void RenderEngine::setupTextureBuffer(std::vector<GPUMaterial> &gpu_materials)
+{
+    SceneManager &sceneManager = SceneManager::getInstance();
+    const std::vector<Material *> &materials = sceneManager.getMaterials();
+    cl::Context context = deviceManager->getContext();
+    cl::Device device = deviceManager->getDevice();
 
-    // Collect all texture data into a single buffer with pre-allocated space
-    std::vector<unsigned char> allTextureData;
-    allTextureData.reserve(totalSize);
-    int currentOffset = 0;
+    textureAtlas.clear();
+
+    // One map to store: the material field receiving its index and how it is stored
+    // Images are only decoded in the second pass, once the residency plan is known
+    using ImageGetter = const ppmLoader::ImageRGB &(Material::*)() const;
+    struct PendingMap
+    {
+        const Material *material;
+        int gpuIndex;
+        int GPUMaterial::*indexField;
+        ImageGetter image;
+        ImageGetter alpha; // map packed in the alpha channel, nullptr if none
+        int format;
+        int width;
+        int height;
+        std::string key;
+        bool bound; // the material's maps changed since the last upload (or it is new)
+    };
+    std::vector<PendingMap> pendingMaps;
 
     for (auto *material : materials)
     {
@@ -423,136 +788,430 @@ void RenderEngine::setupTextureBuffer(std::vector<GPUMaterial> &gpu_materials)
             continue;
         }
 
+        int gpuIndex = material->getGPUIndex();
         int matId = material->getMaterialId();
-        if (matId < 0 || matId >= static_cast<int>(gpu_materials.size()))
+        if (gpuIndex < 0 || gpuIndex >= static_cast<int>(gpu_materials.size()))
         {
-            std::cerr << "Warning: Invalid material_id " << matId << ", skipping..." << std::endl;
+            std::cerr << "Warning: Invalid GPU index " << gpuIndex << " of material " << matId << ", skipping..." << std::endl;
             continue;
         }
 
-        try
-        {
-            const ppmLoader::ImageRGB &image = material->getImage();
-            const ppmLoader::ImageRGB &normals = material->getNormals();
+        // Sizes come from the mapped file headers, nothing is decoded yet
+        GPUMaterial &gpu_material = gpu_materials[gpuIndex];
+        gpu_material.packed_maps = 0;
+        gpu_material.texture_index = -1;
+        gpu_material.normal_map_index = -1;
+        gpu_material.metal_map_index = -1;
+        gpu_material.emissive_map_index = -1;
+        // Maps whose file is still being decoded in the background are left out (the material's
+        // constants are used meanwhile), the material is uploaded again once they are ready
+        if (gpu_material.has_texture && !requestDecodedMap(material->getImageMap()))
+            gpu_material.has_texture = 0;
+        if (gpu_material.has_normal_map && !requestDecodedMap(material->getNormalsMap()))
+            gpu_material.has_normal_map = 0;
+        if (gpu_material.has_metal_map && !requestDecodedMap(material->getMetallicMap()))
+            gpu_material.has_metal_map = 0;
+        if (gpu_material.has_emissive_map && !requestDecodedMap(material->getEmissiveMap()))
+            gpu_material.has_emissive_map = 0;
+        bool hasAlbedo = gpu_material.has_texture && gpu_material.texture_width > 0;
+        bool hasNormals = gpu_material.has_normal_map && gpu_material.normal_map_width > 0;
+        bool hasMetal = gpu_material.has_metal_map && gpu_material.metal_map_width > 0;
+        bool hasEmissive = gpu_material.has_emissive_map && gpu_material.emissive_map_width > 0;
+
+        // Uncompressed: metal and emissive only use their red channel, so they ride in the alpha of the
+        // normal map / albedo when sizes match (one fetch for both), otherwise they are stored as R8
+        // With compression, each kind of map gets the block format matching the channels it uses
+        bool compress = textureCompressionEnabled;
+        bool packMetal = !compress && hasMetal && hasNormals &&
+                         gpu_material.metal_map_width == gpu_material.normal_map_width && gpu_material.metal_map_height == gpu_material.normal_map_height;
+        bool packEmissive = !compress && hasEmissive && hasAlbedo &&
+                            gpu_material.emissive_map_width == gpu_material.texture_width && gpu_material.emissive_map_height == gpu_material.texture_height;
+        if (packMetal)
+            gpu_material.packed_maps |= PACK_METAL_IN_NORMAL_ALPHA;
+        if (packEmissive)
+            gpu_material.packed_maps |= PACK_EMISSIVE_IN_ALBEDO_ALPHA;
+
+        // Maps set or changed since the last upload make their textures the most recently used
+        bool bound = gpuIndex >= static_cast<int>(uploadedMaterials.size()) || !uploadedMaterials[gpuIndex].sameMaps(*material);
+
+        // Maps set from memory have no file, key them by material
+        uint64_t serial = material->getSerial();
+        auto keyOf = [serial](const std::string &path, const char *slot)
+        { return path.empty() ? "material " + std::to_string(serial) + " " + slot : path; };
+
+        if (hasAlbedo)
+            pendingMaps.push_back({material, gpuIndex, &GPUMaterial::texture_index, &Material::getImage, packEmissive ? &Material::getEmissive : nullptr,
+                                   compress ? TEXTURE_BC1 : TEXTURE_RGBA8, gpu_material.texture_width, gpu_material.texture_height, keyOf(material->getPathFileTexture(), "albedo"), bound});
+        if (hasNormals)
+            pendingMaps.push_back({material, gpuIndex, &GPUMaterial::normal_map_index, &Material::getNormals, packMetal ? &Material::getMetallic : nullptr,
+                                   compress ? TEXTURE_BC5 : TEXTURE_RGBA8, gpu_material.normal_map_width, gpu_material.normal_map_height, keyOf(material->getPathFileNormalMap(), "normal"), bound});
+        if (hasMetal && !packMetal)
+            pendingMaps.push_back({material, gpuIndex, &GPUMaterial::metal_map_index, &Material::getMetallic, nullptr,
+                                   compress ? TEXTURE_BC4 : TEXTURE_R8, gpu_material.metal_map_width, gpu_material.metal_map_height, keyOf(material->getPathFileMetalMap(), "metal"), bound});
+        if (hasEmissive && !packEmissive)
+            pendingMaps.push_back({material, gpuIndex, &GPUMaterial::emissive_map_index, &Material::getEmissive, nullptr,
+                                   compress ? TEXTURE_BC4 : TEXTURE_R8, gpu_material.emissive_map_width, gpu_material.emissive_map_height, keyOf(material->getPathFileEmissiveMap(), "emissive"), bound});
+    }
 
-            // Add texture data if exists
-            if (!image.data.empty() && image.w > 0 && image.h > 0)
-            {
-                gpu_materials[matId].texture_offset = currentOffset;
+    // Keep the most recently bound textures at full resolution within the device budget
+    for (const PendingMap &map : pendingMaps)
+    {
+        textureResidency.request(map.key, TextureAtlas::chainBytes(map.width, map.height, map.format),
+                                 TextureAtlas::chainBytes(map.width, map.height, map.format, TextureResidency::FALLBACK_SIZE), map.bound);
+    }
+    textureResidency.plan();
 
-                // Optimized: Copy RGB data with direct buffer insertion (3 bytes per pixel)
-                size_t pixelCount = image.data.size();
-                size_t oldSize = allTextureData.size();
-                allTextureData.resize(oldSize + pixelCount * 3);
+    // Decode and store the maps (first access to each image decodes its mapped file)
+    for (const PendingMap &map : pendingMaps)
+    {
+        int maxDimension = textureResidency.isFullResolution(map.key) ? 0 : TextureResidency::FALLBACK_SIZE;
+        const ppmLoader::ImageRGB *alpha = map.alpha ? &(map.material->*map.alpha)() : nullptr;
+        gpu_materials[map.gpuIndex].*map.indexField = textureAtlas.addTexture((map.material->*map.image)(), map.format, map.key, alpha, maxDimension);
+    }
+    for (auto &gpu_material : gpu_materials)
+    {
+        if (gpu_material.packed_maps & PACK_METAL_IN_NORMAL_ALPHA)
+            gpu_material.metal_map_index = gpu_material.normal_map_index;
+        if (gpu_material.packed_maps & PACK_EMISSIVE_IN_ALBEDO_ALPHA)
+            gpu_material.emissive_map_index = gpu_material.texture_index;
+    }
 
-                // Direct indexing for better performance - avoid push_back overhead
-                unsigned char *dest = allTextureData.data() + oldSize;
-                for (size_t i = 0; i < pixelCount; ++i)
-                {
-                    const auto &pixel = image.data[i];
-                    dest[i * 3] = pixel.r;
-                    dest[i * 3 + 1] = pixel.g;
-                    dest[i * 3 + 2] = pixel.b;
-                }
+    int maxWidth = static_cast<int>(device.getInfo<CL_DEVICE_IMAGE2D_MAX_WIDTH>());
+    int maxHeight = static_cast<int>(device.getInfo<CL_DEVICE_IMAGE2D_MAX_HEIGHT>());
+    if (!textureAtlas.pack(maxWidth, maxHeight))
+    {
+        std::cerr << "Textures do not fit in a " << maxWidth << "x" << maxHeight << " atlas, rendering without textures" << std::endl;
+        textureAtlas.clear();
+        for (auto &gpu_material : gpu_materials)
+        {
+            gpu_material.texture_index = -1;
+            gpu_material.normal_map_index = -1;
+            gpu_material.metal_map_index = -1;
+            gpu_material.emissive_map_index = -1;
+            gpu_material.packed_maps = 0;
+        }
+    }
 
-                currentOffset += pixelCount * 3; // 3 bytes per pixel (RGB)
-            }
-            else
-            {
-                gpu_materials[matId].texture_offset = -1; // No texture
-            }
+    // Always create an image, a table and a block buffer even if empty (OpenCL requires valid memory objects)
+    cl::ImageFormat format(CL_RGBA, CL_UNORM_INT8);
+    if (textureAtlas.getWidth() > 0)
+    {
+        textureAtlasImage = cl::Image2D(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, format,
+                                        textureAtlas.getWidth(), textureAtlas.getHeight(), 0,
+                                        const_cast<unsigned char *>(textureAtlas.getPixels().data()));
+        std::cout << "Texture atlas created successfully! (" << textureAtlas.getWidth() << "x" << textureAtlas.getHeight() << " RGBA8)" << std::endl;
+    }
+    else
+    {
+        // Create a dummy 1x1 image to avoid null image issues
+        unsigned char dummyTexel[4] = {255, 255, 255, 255};
+        textureAtlasImage = cl::Image2D(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, format,
+                                        1, 1, 0, dummyTexel);
+    }
 
-            // Add normal map data if exists
-            if (material->hasNormalMap() && !normals.data.empty() && normals.w > 0 && normals.h > 0)
-            {
-                gpu_materials[matId].normal_map_offset = currentOffset;
+    if (!textureAtlas.getBlocks().empty())
+    {
+        textureBlocksBuffer = cl::Buffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                         textureAtlas.getBlocks().size() * sizeof(uint32_t),
+                                         const_cast<uint32_t *>(textureAtlas.getBlocks().data()));
+        std::cout << "Texture block buffer created successfully! (" << textureAtlas.getBlocks().size() * sizeof(uint32_t) << " bytes)" << std::endl;
+    }
+    else
+    {
+        uint32_t dummyBlock[2] = {0, 0};
+        textureBlocksBuffer = cl::Buffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                         sizeof(dummyBlock),
+                                         dummyBlock);
+    }
 
-                // Optimized: Copy RGB data for normal map with direct buffer insertion
-                size_t pixelCount = normals.data.size();
-                size_t oldSize = allTextureData.size();
-                allTextureData.resize(oldSize + pixelCount * 3);
+    if (!textureAtlas.empty())
+    {
+        textureDescriptorBuffer = cl::Buffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                             textureAtlas.getDescriptors().size() * sizeof(GPUTexture),
+                                             const_cast<GPUTexture *>(textureAtlas.getDescriptors().data()));
+        std::cout << "Texture table created successfully! (" << textureAtlas.getDescriptors().size() << " texture levels)" << std::endl;
+    }
+    else
+    {
+        GPUTexture dummyDescriptor = {};
+        textureDescriptorBuffer = cl::Buffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                             sizeof(GPUTexture),
+                                             &dummyDescriptor);
+        std::cout << "No texture data - created dummy atlas" << std::endl;
+    }
 
-                // Direct indexing for better performance - avoid push_back overhead
-                unsigned char *dest = allTextureData.data() + oldSize;
-                for (size_t i = 0; i < pixelCount; ++i)
-                {
-                    const auto &pixel = normals.data[i];
-                    dest[i * 3] = pixel.r;
-                    dest[i * 3 + 1] = pixel.g;
-                    dest[i * 3 + 2] = pixel.b;
-                }
+    // The device holds its own copy now: drop the decoded pixels of maps that can be decoded again from their files
+    textureAtlas.clear();
+    for (auto *material : materials)
+    {
+        if (material)
+            material->releaseDecodedMaps();
+    }
+    backgroundDecodedMaps.clear();
+}
 
-                currentOffset += pixelCount * 3; // 3 bytes per pixel (RGB)
-            }
-            else
-            {
-                gpu_materials[matId].normal_map_offset = -1; // No normal map
-            }
+// True if the map's pixels are available without decoding on this thread, otherwise decode its file on
+// a loader thread and mark the materials dirty once done
+bool RenderEngine::requestDecodedMap(const LazyImage &map)
+{
+    if (map.isDecoded() || TextureCache::getInstance().isDecoded(map.getFile()))
+        return true;
 
-            // Add metal map data if exists
-            if (material->hasMetallicMap() && !material->getMetallic().data.empty())
+    AssetLoader &assetLoader = AssetLoader::getInstance();
+    TextureFileHandle file = map.getFile();
+    if (!assetLoader.isPending(file->path))
+    {
+        assetLoader.load<ImageHandle>(
+            file->path,
+            [file]()
+            { return TextureCache::getInstance().load(file); },
+            [this](ImageHandle image)
             {
-                gpu_materials[matId].metal_map_offset = currentOffset;
+                if (!image)
+                    return;
+                // Holding the handle keeps the pixels in the TextureCache until the upload reads them
+                backgroundDecodedMaps.push_back(image);
+                markTexturesDirty();
+            });
+    }
+    return false;
+}
 
-                // Copy RGB data for metal map
-                for (const auto &pixel : material->getMetallic().data)
-                {
-                    allTextureData.push_back(pixel.r);
-                    allTextureData.push_back(pixel.g);
-                    allTextureData.push_back(pixel.b);
-                }
+// Scene AABB computed from the GPU shapes (mesh bounds come from their BVH root node)
+void RenderEngine::updateSceneBounds(const std::vector<GPUShape> &gpu_shapes, const std::vector<GPUBVHNode> &gpu_bvh_roots)
+{
+    float minP[3] = {INFINITY, INFINITY, INFINITY};
+    float maxP[3] = {-INFINITY, -INFINITY, -INFINITY};
 
-                currentOffset += material->getMetallic().data.size() * 3; // 3 bytes per pixel (RGB)
-            }
-            else
+    auto grow = [&](float x, float y, float z, float ex, float ey, float ez)
+    {
+        minP[0] = std::min(minP[0], x - ex);
+        minP[1] = std::min(minP[1], y - ey);
+        minP[2] = std::min(minP[2], z - ez);
+        maxP[0] = std::max(maxP[0], x + ex);
+        maxP[1] = std::max(maxP[1], y + ey);
+        maxP[2] = std::max(maxP[2], z + ez);
+    };
+
+    size_t meshIndex = 0;
+    for (const GPUShape &shape : gpu_shapes)
+    {
+        switch (shape.type)
+        {
+        case SPHERE:
+        {
+            const GPUSphere &sphere = shape.data.sphere;
+            grow(sphere.pos.x, sphere.pos.y, sphere.pos.z, sphere.radius, sphere.radius, sphere.radius);
+            break;
+        }
+        case SQUARE:
+        {
+            // Square is centered on pos, spanning half of u_vec and v_vec on each side
+            const GPUSquare &square = shape.data.square;
+            grow(square.pos.x, square.pos.y, square.pos.z,
+                 0.5f * (std::fabs(square.u_vec.x) + std::fabs(square.v_vec.x)),
+                 0.5f * (std::fabs(square.u_vec.y) + std::fabs(square.v_vec.y)),
+                 0.5f * (std::fabs(square.u_vec.z) + std::fabs(square.v_vec.z)));
+            break;
+        }
+        case TRIANGLE:
+        {
+            const GPUTriangle &triangle = shape.data.triangle;
+            grow(triangle.v0.x, triangle.v0.y, triangle.v0.z, 0.0f, 0.0f, 0.0f);
+            grow(triangle.v1.x, triangle.v1.y, triangle.v1.z, 0.0f, 0.0f, 0.0f);
+            grow(triangle.v2.x, triangle.v2.y, triangle.v2.z, 0.0f, 0.0f, 0.0f);
+            break;
+        }
+        case MESH:
+        {
+            if (meshIndex < gpu_bvh_roots.size() && shape.data.bvh.node_count > 0)
             {
-                gpu_materials[matId].metal_map_offset = -1; // No metal map
+                const GPUBVHNode &root = gpu_bvh_roots[meshIndex++];
+                grow(root.minx, root.miny, root.minz, 0.0f, 0.0f, 0.0f);
+                grow(root.maxx, root.maxy, root.maxz, 0.0f, 0.0f, 0.0f);
             }
+            break;
+        }
+        default:
+            break;
+        }
+    }
 
-            // Add emissive map data if exists
-            if (material->hasEmissiveMap() && !material->getEmissive().data.empty())
-            {
-                gpu_materials[matId].emissive_map_offset = currentOffset;
+    if (minP[0] > maxP[0])
+    {
+        // Empty scene: any bounds will do
+        sceneBoundsMin = {{0.0f, 0.0f, 0.0f, 0.0f}};
+        sceneBoundsInvExtent = {{1.0f, 1.0f, 1.0f, 0.0f}};
+        return;
+    }
 
-                // Copy RGB data for emissive map
-                for (const auto &pixel : material->getEmissive().data)
-                {
-                    allTextureData.push_back(pixel.r);
-                    allTextureData.push_back(pixel.g);
-                    allTextureData.push_back(pixel.b);
-                }
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        float extent = std::max(maxP[axis] - minP[axis], 1e-6f);
+        sceneBoundsMin.s[axis] = minP[axis];
+        sceneBoundsInvExtent.s[axis] = 1.0f / extent;
+    }
+    sceneBoundsMin.s[3] = 0.0f;
+    sceneBoundsInvExtent.s[3] = 0.0f;
+}
 
-                currentOffset += material->getEmissive().data.size() * 3; // 3 bytes per pixel (RGB)
-            }
-            else
+// Allocate the per-path buffers of the wavefront path (grow only)
+void RenderEngine::setupWavefrontBuffers(size_t numRays)
+{
+    if (numRays <= wavefrontCapacity)
+        return;
+
+    cl::Context context = deviceManager->getContext();
+    pathBuffer = cl::Buffer(context, CL_MEM_READ_WRITE, numRays * sizeof(GPUPathState));
+    rayIndicesBuffer = cl::Buffer(context, CL_MEM_READ_WRITE, numRays * sizeof(cl_uint));
+    rayValuesBuffer = cl::Buffer(context, CL_MEM_READ_WRITE, numRays * sizeof(cl_uint));
+    rayKeysBuffer = cl::Buffer(context, CL_MEM_READ_WRITE, numRays * sizeof(cl_uint));
+    activePathsBuffer = cl::Buffer(context, CL_MEM_READ_WRITE, sizeof(cl_uint));
+    wavefrontCapacity = numRays;
+}
+
+// Wavefront path: one launch per bounce, optionally reordering the surviving rays by
+// direction and origin between bounces so that neighbouring work-items traverse the same BVH nodes
+// When stats is given, the queue is drained around each stage to time traversal and sorting separately
+void RenderEngine::renderWavefront(int width, int height, int maxBounces, bool sortRays, RaySortingStats *stats)
+{
+    const int numRays = width * height;
+    setupWavefrontBuffers(numRays);
+
+    cl::CommandQueue queue = deviceManager->getCommandQueue();
+    size_t localSize = 256;
+    cl::NDRange globalRange(((numRays + localSize - 1) / localSize) * localSize);
+    cl::NDRange localRange(localSize);
+
+    cl::Kernel generateKernel = kernelManager->getKernel("wavefront_generate");
+    generateKernel.setArg(0, pathBuffer);
+    generateKernel.setArg(1, rayIndicesBuffer);
+    generateKernel.setArg(2, width);
+    generateKernel.setArg(3, height);
+    generateKernel.setArg(4, frameCount);
+    generateKernel.setArg(5, cameraBuffer);
+    queue.enqueueNDRangeKernel(generateKernel, cl::NullRange, globalRange, localRange);
+
+    cl::Kernel keysKernel = kernelManager->getKernel("compute_ray_keys");
+    cl::Kernel bounceKernel = kernelManager->getKernel("wavefront_bounce");
+    cl::Kernel countKernel = kernelManager->getKernel("count_active_paths");
+    const int rayKeyBits = 24; // 6 bits of direction + 18 bits of origin Morton code
+
+    using clock = std::chrono::high_resolution_clock;
+    if (stats)
+        queue.finish();
+
+    for (int bounce = 0; bounce < maxBounces; ++bounce)
+    {
+        // Primary rays are already coherent in pixel order: only secondary rays are sorted
+        if (sortRays && bounce > 0)
+        {
+            auto sortStart = clock::now();
+
+            keysKernel.setArg(0, pathBuffer);
+            keysKernel.setArg(1, rayIndicesBuffer);
+            keysKernel.setArg(2, numRays);
+            keysKernel.setArg(3, sceneBoundsMin);
+            keysKernel.setArg(4, sceneBoundsInvExtent);
+            keysKernel.setArg(5, rayKeysBuffer);
+            keysKernel.setArg(6, rayValuesBuffer);
+            queue.enqueueNDRangeKernel(keysKernel, cl::NullRange, globalRange, localRange);
+
+            radixSort.sort(rayKeysBuffer, rayValuesBuffer, numRays, rayKeyBits);
+            std::swap(rayIndicesBuffer, rayValuesBuffer);
+
+            if (stats)
             {
-                gpu_materials[matId].emissive_map_offset = -1; // No emissive map
+                queue.finish();
+                stats->sortSeconds += std::chrono::duration<double>(clock::now() - sortStart).count();
             }
         }
-        catch (const std::exception &e)
+
+        // Only the rays still alive are traced, dead paths return at once: count those for the
+        // rays/sec figures, before the traversal timer starts
+        if (stats)
         {
-            std::cerr << "Error processing material " << matId << ": " << e.what() << std::endl;
-            gpu_materials[matId].texture_offset = -1;
-            gpu_materials[matId].normal_map_offset = -1;
+            cl_uint activePaths = 0;
+            queue.enqueueFillBuffer(activePathsBuffer, activePaths, 0, sizeof(cl_uint));
+            countKernel.setArg(0, pathBuffer);
+            countKernel.setArg(1, numRays);
+            countKernel.setArg(2, activePathsBuffer);
+            queue.enqueueNDRangeKernel(countKernel, cl::NullRange, globalRange, localRange);
+            queue.enqueueReadBuffer(activePathsBuffer, CL_TRUE, 0, sizeof(cl_uint), &activePaths);
+            stats->raysLaunched += activePaths;
+        }
+
+        auto traversalStart = clock::now();
+
+        bounceKernel.setArg(0, pathBuffer);
+        bounceKernel.setArg(1, rayIndicesBuffer);
+        bounceKernel.setArg(2, numRays);
+        bounceKernel.setArg(3, bounce);
+        bounceKernel.setArg(4, maxBounces);
+        bounceKernel.setArg(5, shapesBuffer);
+        bounceKernel.setArg(6, shapesCount);
+        bounceKernel.setArg(7, materialBuffer);
+        bounceKernel.setArg(8, materialCount);
+        bounceKernel.setArg(9, textureAtlasImage);
+        bounceKernel.setArg(10, textureDescriptorBuffer);
+        bounceKernel.setArg(11, textureBlocksBuffer);
+        bounceKernel.setArg(12, bvhNodesBuffer);
+        bounceKernel.setArg(13, bvhTrianglesBuffer);
+        bounceKernel.setArg(14, meshVerticesBuffer);
+        bounceKernel.setArg(15, meshIndicesBuffer);
+        queue.enqueueNDRangeKernel(bounceKernel, cl::NullRange, globalRange, localRange);
+
+        if (stats)
+        {
+            queue.finish();
+            stats->traversalSeconds += std::chrono::duration<double>(clock::now() - traversalStart).count();
         }
     }
 
-    // Create texture buffer - always create a buffer even if empty (OpenCL requires valid buffer)
-    if (!allTextureData.empty())
+    cl::Kernel resolveKernel = kernelManager->getKernel("wavefront_resolve");
+    resolveKernel.setArg(0, pathBuffer);
+    resolveKernel.setArg(1, outputBuffer);
+    resolveKernel.setArg(2, accumBuffer);
+    resolveKernel.setArg(3, width);
+    resolveKernel.setArg(4, height);
+    resolveKernel.setArg(5, frameCount);
+    resolveKernel.setArg(6, cameraBuffer);
+    queue.enqueueNDRangeKernel(resolveKernel, cl::NullRange, globalRange, localRange);
+}
+
+// Render the same frames through the wavefront path with and without ray sorting
+// Rays/sec only counts the bounce kernels; the "with sort" figure charges the sort time too
+void RenderEngine::benchmarkRaySorting(int width, int height, int frames, RaySortingStats &unsortedStats, RaySortingStats &sortedStats)
+{
+    try
     {
-        size_t buffer_size = allTextureData.size() * sizeof(unsigned char);
-        textureBuffer = cl::Buffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
-                                   buffer_size,
-                                   allTextureData.data());
-        std::cout << "Texture buffer created successfully! (" << allTextureData.size() << " bytes)" << std::endl;
+        setupBuffers(width, height);
+
+        GPUCamera gpu_camera = Camera::getInstance().toGPU();
+        cameraBuffer = cl::Buffer(deviceManager->getContext(),
+                                  CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                  sizeof(GPUCamera),
+                                  &gpu_camera);
+
+        // Warm-up frame so buffer allocation and first launches are not measured
+        renderWavefront(width, height, gpu_camera.nbBounces, true);
+        deviceManager->getCommandQueue().finish();
+
+        for (int frame = 0; frame < frames; ++frame)
+        {
+            renderWavefront(width, height, gpu_camera.nbBounces, false, &unsortedStats);
+            renderWavefront(width, height, gpu_camera.nbBounces, true, &sortedStats);
+        }
+        frameCount = 0;
+
+        std::cout << "Ray sorting benchmark (" << width << "x" << height << ", " << gpu_camera.nbBounces << " bounces, " << frames << " frames)" << std::endl;
+        std::cout << "  unsorted: " << unsortedStats.raysPerSecond() / 1e6 << " Mrays/s traversal" << std::endl;
+        std::cout << "  sorted:   " << sortedStats.raysPerSecond() / 1e6 << " Mrays/s traversal, "
+                  << sortedStats.raysPerSecondWithSort() / 1e6 << " Mrays/s including sort ("
+                  << sortedStats.sortSeconds * 1000.0 / frames << " ms sort per frame)" << std::endl;
     }
-    else
+    catch (const std::exception &e)
     {
-        // Create a dummy 1-byte buffer to avoid null buffer issues
-        unsigned char dummyData[1] = {0};
-        textureBuffer = cl::Buffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
-                                   sizeof(dummyData),
-                                   dummyData);
-        std::cout << "No texture data - created dummy buffer" << std::endl;
+        std::cerr << "Error in ray sorting benchmark: " << e.what() << std::endl;
     }
-}
\ No newline at end of file
+}
@@ -5,6 +5,22 @@
 #include "../DeviceManager/DeviceManager.h"
 #include "../SceneManager/SceneManager.h"
 #include "../../camera/Camera.h"
+#include "RadixSort.h"
+#include "LBVHBuilder.h"
+#include "TextureAtlas.h"
+#include "TextureResidency.h"
+#include "UploadedMaterial.h"
+
+// Timings of the wavefront path, filled when rendering with stats enabled
+struct RaySortingStats
+{
+    double traversalSeconds = 0.0; // time spent in the bounce kernels
+    double sortSeconds = 0.0;      // time spent computing ray keys and sorting
+    size_t raysLaunched = 0;       // rays still alive at the start of each bounce, over all bounces
+
+    double raysPerSecond() const { return traversalSeconds > 0.0 ? raysLaunched / traversalSeconds : 0.0; }
+    double raysPerSecondWithSort() const { return (traversalSeconds + sortSeconds) > 0.0 ? raysLaunched / (traversalSeconds + sortSeconds) : 0.0; }
+};
 
 class RenderEngine
 {
@@ -33,7 +49,12 @@ public:
     {
         materialBufferDirty = true;
         frameCount = 0;
-    } // Call when a material is modified
+    } // Call when a material is modified (only the changed slots are rewritten, textures only if a map changed)
+    void markTexturesDirty()
+    {
+        textureBufferDirty = true;
+        markMaterialDirty();
+    } // Call when every texture must be stored again
     void notifySceneChanged()
     {
         shapesBufferDirty = true;
@@ -47,6 +68,63 @@ public:
     } // Call when a mesh is added/removed/modified
     // TODO Later
 
+    // Secondary-ray sorting (wavefront path, image buffer only)
+    void setRaySorting(bool enabled)
+    {
+        raySortingEnabled = enabled;
+        frameCount = 0;
+    }
+    bool isRaySortingEnabled() const { return raySortingEnabled; }
+
+    // Block-compressed texture storage (rebuilds the texture data)
+    void setTextureCompression(bool enabled)
+    {
+        textureCompressionEnabled = enabled;
+        markTexturesDirty();
+    }
+    bool isTextureCompressionEnabled() const { return textureCompressionEnabled; }
+
+    // Device layout of mesh geometry: a GPUTriangle per face, or shared (possibly 16-bit quantized) vertices
+    // and an index buffer (rebuilds the BVH buffers)
+    void setMeshVertexFormat(VertexFormat format)
+    {
+        meshVertexFormat = format;
+        uploadedBVHs.clear();
+        markShapesDirty();
+    }
+    VertexFormat getMeshVertexFormat() const { return meshVertexFormat; }
+
+    // Build the BVHs of meshes on the device (LBVH) from their uploaded geometry, for meshes edited often:
+    // edits then skip the host refit and rebuild, at the cost of trees slower to trace than the host SAH ones
+    void setDeviceMeshBVH(bool enabled)
+    {
+        deviceMeshBVH = enabled;
+        uploadedBVHs.clear();
+        markShapesDirty();
+    }
+    bool isDeviceMeshBVH() const { return deviceMeshBVH; }
+
+    // Build quality of the mesh BVHs: QUALITY_SPATIAL (SBVH) duplicates references to straddling triangles for
+    // trees with less overlap, slower to build; meshes loaded afterwards are built at it too
+    void setMeshBVHQuality(int quality)
+    {
+        meshBVHQuality = quality;
+        Mesh::setDefaultBVHQuality(quality);
+        markShapesDirty();
+    }
+    int getMeshBVHQuality() const { return meshBVHQuality; }
+
+    // Device memory allowed for textures, least recently bound ones fall back to a low-res mip beyond it
+    void setTextureBudget(size_t bytes)
+    {
+        textureResidency.setBudget(bytes);
+        markTexturesDirty();
+    }
+    size_t getTextureBudget() const { return textureResidency.getBudget(); }
+
+    // Render frames with and without ray sorting and print traversal rays/sec for both
+    void benchmarkRaySorting(int width, int height, int frames, RaySortingStats &unsortedStats, RaySortingStats &sortedStats);
+
 private:
     KernelManager *kernelManager;
     DeviceManager *deviceManager;
@@ -56,9 +134,18 @@ private:
     cl::Buffer shapesBuffer;
     cl::Buffer cameraBuffer;
     cl::Buffer materialBuffer;
-    cl::Buffer textureBuffer;      // Buffer containing all texture data (RGB pixels)
+    cl::Image2D textureAtlasImage; // RGBA8 image holding every material map
+    cl::Buffer textureDescriptorBuffer; // GPUTexture table: rectangle of each map in the atlas
+    cl::Buffer textureBlocksBuffer; // Block-compressed maps (BC1/BC4/BC5), when compression is enabled
     cl::Buffer bvhNodesBuffer;     // Buffer containing all flattened BVH nodes
     cl::Buffer bvhTrianglesBuffer; // Buffer containing all BVH triangles
+    cl::Buffer meshVerticesBuffer; // Vertices of every mesh (indexed layouts)
+    cl::Buffer meshIndicesBuffer;  // Vertex indices of every BVH triangle (indexed layouts)
+    cl::Buffer pathBuffer;         // Wavefront path states (one per pixel)
+    cl::Buffer rayIndicesBuffer;   // Order in which paths are traced for the next bounce
+    cl::Buffer rayValuesBuffer;    // Scratch for the reordered indices
+    cl::Buffer rayKeysBuffer;      // Sort keys of the rays (direction + origin)
+    cl::Buffer activePathsBuffer;  // Number of alive paths, only counted for ray statistics
 
     std::vector<float> imageData;
 
@@ -70,10 +157,37 @@ private:
     int shapesCount = 0;           // Number of GPU shapes stored in shapesBuffer
     bool materialBufferDirty = true;
     int materialCount = 0;          // Number of GPU material stored in materialBuffer
+    int materialCapacity = 0;       // Number of GPU material materialBuffer can hold
     bool textureBufferDirty = true; // Track if texture buffer needs update
+    std::vector<GPUMaterial> gpuMaterials;             // Copy of materialBuffer, texture indices resolved
+    std::vector<UploadedMaterial> uploadedMaterials;   // Material in each slot of materialBuffer, to skip texture uploads
+    uint64_t uploadedMaterialsVersion = 0;             // SceneManager materials version the buffers were set up for
+    int uploadedSceneGeneration = -1;                  // SceneManager scene the textures were set up for
+    TextureAtlas textureAtlas;      // CPU-side atlas layout, rebuilt with the materials
+    TextureResidency textureResidency; // Which textures get their full mip chain under the budget
+    std::vector<ImageHandle> backgroundDecodedMaps; // Maps decoded by the AssetLoader, kept until their upload
+    bool textureCompressionEnabled = false; // Store maps as BC blocks decoded in the kernel
     bool bvhBufferDirty = true;     // Track if BVH buffer needs update (when a mesh is added/removed/modified)
     int bvhCount = 0;               // Number of BVH stored stored in bvhBuffer
     int bvhTrianglesCount = 0;     // Number of triangles stored in bvhTrianglesBuffer
+    VertexFormat meshVertexFormat = VERTEX_TRIANGLES;
+    bool deviceMeshBVH = false;     // Mesh BVHs built by lbvhBuilder instead of uploaded from the host
+    int meshBVHQuality = QUALITY_HIGH;
+    struct UploadedBVH
+    {
+        uint64_t topologyId;
+        uint32_t boundsVersion; // host BVH bounds version, or mesh geometry version for device BVHs
+        int nodeOffset;
+        int triangleOffset;
+        bool onDevice;
+    };
+    std::vector<UploadedBVH> uploadedBVHs; // Mesh and LOD BVHs in the BVH buffers, in shape order, to rewrite refits in place
+    bool raySortingEnabled = false; // Use the wavefront path with ray sorting between bounces
+    size_t wavefrontCapacity = 0;   // Number of paths the wavefront buffers can hold
+    cl_float4 sceneBoundsMin = {{0.0f, 0.0f, 0.0f, 0.0f}}; // Scene bounds used to quantise ray origins
+    cl_float4 sceneBoundsInvExtent = {{1.0f, 1.0f, 1.0f, 0.0f}};
+    RadixSort radixSort;
+    LBVHBuilder lbvhBuilder;
 
     Camera sceneCamera;
 
@@ -81,4 +195,9 @@ private:
     void setupShapesBuffer();
     void setupMaterialBuffer();
     void setupTextureBuffer(std::vector<GPUMaterial> &gpu_materials);
+    void writeMaterialSlots(const std::vector<GPUMaterial> &gpu_materials);
+    bool requestDecodedMap(const LazyImage &map);
+    void setupWavefrontBuffers(size_t numRays);
+    void updateSceneBounds(const std::vector<GPUShape> &gpu_shapes, const std::vector<GPUBVHNode> &gpu_bvh_roots);
+    void renderWavefront(int width, int height, int maxBounces, bool sortRays, RaySortingStats *stats = nullptr);
 };
\ No newline at end of file
@@ -0,0 +1,287 @@
+#include "TextureAtlas.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include "../../utils/blockCompression/BlockCompression.h"
+
+void TextureAtlas::clear()
+{
+    images.clear();
+    alphas.clear();
+    mipLevels.clear();
+    descriptors.clear();
+    blocks.clear();
+    pixels.clear();
+    width = 0;
+    height = 0;
+}
+
+int TextureAtlas::addTexture(const ppmLoader::ImageRGB &image, int format, const std::string &name,
+                             const ppmLoader::ImageRGB *alpha, int maxDimension)
+{
+    if (image.data.empty() || image.w <= 0 || image.h <= 0)
+        return -1;
+    if (alpha && (format != TEXTURE_RGBA8 || alpha->w != image.w || alpha->h != image.h))
+    {
+        std::cerr << "Alpha channel of " << (name.empty() ? "<unnamed>" : name) << " ignored (format or size mismatch)" << std::endl;
+        alpha = nullptr;
+    }
+
+    int baseIndex = static_cast<int>(descriptors.size());
+    int levelCount = 1;
+    for (int w = image.w, h = image.h; w > 1 || h > 1; w = std::max(1, w / 2), h = std::max(1, h / 2))
+        levelCount++;
+    int firstLevel = firstLevelWithin(image.w, image.h, maxDimension);
+
+    const ppmLoader::ImageRGB *level = &image;
+    const ppmLoader::ImageRGB *alphaLevel = alpha;
+    for (int i = 0; i < levelCount; ++i)
+    {
+        if (i > 0)
+        {
+            mipLevels.push_back(downsample(*level));
+            level = &mipLevels.back();
+            if (alphaLevel)
+            {
+                mipLevels.push_back(downsample(*alphaLevel));
+                alphaLevel = &mipLevels.back();
+            }
+        }
+        if (i < firstLevel)
+            continue;
+        images.push_back(level);
+        alphas.push_back(alphaLevel);
+        descriptors.push_back({0, 0, level->w, level->h, levelCount - i, format, {0, 0}});
+        if (format != TEXTURE_RGBA8)
+            encodeLevel(*level, descriptors.back());
+    }
+
+    if (format != TEXTURE_RGBA8)
+    {
+        // Quality/size report on the first stored level against the RGBA8 storage it replaces
+        const GPUTexture &base = descriptors[baseIndex];
+        const ppmLoader::ImageRGB &stored = *images[baseIndex];
+        size_t rawBytes = static_cast<size_t>(stored.w) * stored.h * 4;
+        if (format == TEXTURE_R8)
+        {
+            std::cout << "Stored texture " << (name.empty() ? "<unnamed>" : name) << " (" << stored.w << "x" << stored.h << ") as R8: "
+                      << rawBytes / 1024 << " KB -> " << rawBytes / 4 / 1024 << " KB" << std::endl;
+            return baseIndex;
+        }
+        ppmLoader::ImageRGB decoded = blockCompression::decode(blocks, static_cast<size_t>(base.x) * 2, stored.w, stored.h, format);
+        int channels = format == TEXTURE_BC1 ? 3 : (format == TEXTURE_BC5 ? 2 : 1);
+        size_t compressedBytes = blockCompression::blockWords(stored.w, stored.h, format) * sizeof(uint32_t);
+        const char *formatName = format == TEXTURE_BC1 ? "BC1" : (format == TEXTURE_BC4 ? "BC4" : "BC5");
+        std::cout << "Compressed texture " << (name.empty() ? "<unnamed>" : name) << " (" << stored.w << "x" << stored.h << ") as " << formatName
+                  << ": " << rawBytes / 1024 << " KB -> " << compressedBytes / 1024 << " KB ("
+                  << static_cast<double>(rawBytes) / compressedBytes << "x), PSNR " << blockCompression::psnr(stored, decoded, channels) << " dB" << std::endl;
+    }
+    return baseIndex;
+}
+
+int TextureAtlas::firstLevelWithin(int width, int height, int maxDimension)
+{
+    int level = 0;
+    while (maxDimension > 0 && std::max(width, height) > maxDimension)
+    {
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+        level++;
+    }
+    return level;
+}
+
+size_t TextureAtlas::chainBytes(int width, int height, int format, int maxDimension)
+{
+    if (width <= 0 || height <= 0)
+        return 0;
+    for (int level = firstLevelWithin(width, height, maxDimension); level > 0; --level)
+    {
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+
+    size_t bytes = 0;
+    while (true)
+    {
+        size_t texels = static_cast<size_t>(width) * height;
+        if (format == TEXTURE_RGBA8)
+            bytes += static_cast<size_t>(width + 2 * GUTTER) * (height + 2 * GUTTER) * 4;
+        else if (format == TEXTURE_R8)
+            bytes += (texels + 7) / 8 * 8;
+        else
+            bytes += blockCompression::blockWords(width, height, format) * sizeof(uint32_t);
+        if (width == 1 && height == 1)
+            break;
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+    return bytes;
+}
+
+// Append the blocks of one level, descriptor.x becomes the index of its first 8-byte block
+void TextureAtlas::encodeLevel(const ppmLoader::ImageRGB &level, GPUTexture &descriptor)
+{
+    descriptor.x = static_cast<int>(blocks.size() / 2);
+    descriptor.y = 0;
+    switch (descriptor.format)
+    {
+    case TEXTURE_BC1:
+        blockCompression::encodeBC1(level, blocks);
+        break;
+    case TEXTURE_BC4:
+        blockCompression::encodeBC4(level, 0, blocks);
+        break;
+    case TEXTURE_BC5:
+        blockCompression::encodeBC5(level, blocks);
+        break;
+    case TEXTURE_R8:
+    {
+        // Red channel, 4 texels per word (little-endian), padded to a whole 8-byte unit
+        size_t texels = level.data.size();
+        size_t first = blocks.size();
+        blocks.resize(first + ((texels + 7) / 8) * 2, 0);
+        for (size_t i = 0; i < texels; ++i)
+            blocks[first + i / 4] |= static_cast<uint32_t>(level.data[i].r) << (8 * (i % 4));
+        break;
+    }
+    default:
+        std::cerr << "Unknown texture format " << descriptor.format << std::endl;
+        break;
+    }
+}
+
+// Next mip level: each texel averages the source texels it covers (handles odd sizes)
+ppmLoader::ImageRGB TextureAtlas::downsample(const ppmLoader::ImageRGB &image)
+{
+    ppmLoader::ImageRGB result;
+    result.w = std::max(1, image.w / 2);
+    result.h = std::max(1, image.h / 2);
+    result.data.resize(static_cast<size_t>(result.w) * result.h);
+
+    for (int y = 0; y < result.h; ++y)
+    {
+        int y0 = y * image.h / result.h;
+        int y1 = std::max(y0 + 1, (y + 1) * image.h / result.h);
+        for (int x = 0; x < result.w; ++x)
+        {
+            int x0 = x * image.w / result.w;
+            int x1 = std::max(x0 + 1, (x + 1) * image.w / result.w);
+
+            unsigned int r = 0, g = 0, b = 0;
+            for (int sy = y0; sy < y1; ++sy)
+            {
+                for (int sx = x0; sx < x1; ++sx)
+                {
+                    const ppmLoader::RGB &pixel = image.data[static_cast<size_t>(sy) * image.w + sx];
+                    r += pixel.r;
+                    g += pixel.g;
+                    b += pixel.b;
+                }
+            }
+            unsigned int count = static_cast<unsigned int>((y1 - y0) * (x1 - x0));
+            result.data[static_cast<size_t>(y) * result.w + x] = {static_cast<unsigned char>((r + count / 2) / count),
+                                                                  static_cast<unsigned char>((g + count / 2) / count),
+                                                                  static_cast<unsigned char>((b + count / 2) / count)};
+        }
+    }
+    return result;
+}
+
+bool TextureAtlas::pack(int maxWidth, int maxHeight)
+{
+    pixels.clear();
+    width = 0;
+    height = 0;
+    if (images.empty())
+        return true;
+
+    // Atlas width: roughly square, at least as wide as the widest texture
+    size_t totalArea = 0;
+    int widest = 0;
+    for (const GPUTexture &descriptor : descriptors)
+    {
+        if (descriptor.format != TEXTURE_RGBA8)
+            continue;
+        int paddedWidth = descriptor.width + 2 * GUTTER;
+        int paddedHeight = descriptor.height + 2 * GUTTER;
+        totalArea += static_cast<size_t>(paddedWidth) * paddedHeight;
+        widest = std::max(widest, paddedWidth);
+    }
+    if (totalArea == 0)
+        return true; // every texture is block compressed
+    if (widest > maxWidth)
+        return false;
+
+    int atlasWidth = 1;
+    while (atlasWidth < static_cast<int>(std::ceil(std::sqrt(static_cast<double>(totalArea)))))
+        atlasWidth <<= 1;
+    atlasWidth = std::min(std::max(atlasWidth, widest), maxWidth);
+
+    // Shelf packing, tallest textures first so each shelf wastes little height
+    std::vector<size_t> order;
+    for (size_t i = 0; i < descriptors.size(); ++i)
+    {
+        if (descriptors[i].format == TEXTURE_RGBA8)
+            order.push_back(i);
+    }
+    std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b)
+                     { return descriptors[a].height > descriptors[b].height; });
+
+    int shelfX = 0;
+    int shelfY = 0;
+    int shelfHeight = 0;
+    for (size_t index : order)
+    {
+        GPUTexture &descriptor = descriptors[index];
+        int paddedWidth = descriptor.width + 2 * GUTTER;
+        int paddedHeight = descriptor.height + 2 * GUTTER;
+
+        if (shelfX + paddedWidth > atlasWidth)
+        {
+            shelfY += shelfHeight;
+            shelfX = 0;
+            shelfHeight = 0;
+        }
+
+        descriptor.x = shelfX + GUTTER;
+        descriptor.y = shelfY + GUTTER;
+        shelfX += paddedWidth;
+        shelfHeight = std::max(shelfHeight, paddedHeight);
+    }
+
+    int atlasHeight = shelfY + shelfHeight;
+    if (atlasHeight > maxHeight)
+        return false;
+
+    width = atlasWidth;
+    height = atlasHeight;
+    pixels.assign(static_cast<size_t>(width) * height * 4, 0);
+
+    for (size_t index : order)
+    {
+        copyWithGutter(*images[index], alphas[index], descriptors[index]);
+    }
+    return true;
+}
+
+// Copy an RGB image as RGBA (alpha from the red channel of alpha if any), including the wrapped gutter texels
+void TextureAtlas::copyWithGutter(const ppmLoader::ImageRGB &image, const ppmLoader::ImageRGB *alpha, const GPUTexture &descriptor)
+{
+    for (int y = -GUTTER; y < image.h + GUTTER; ++y)
+    {
+        int srcY = (y + image.h) % image.h;
+        unsigned char *dest = pixels.data() + (static_cast<size_t>(descriptor.y + y) * width + (descriptor.x - GUTTER)) * 4;
+        for (int x = -GUTTER; x < image.w + GUTTER; ++x)
+        {
+            int srcX = (x + image.w) % image.w;
+            size_t src = static_cast<size_t>(srcY) * image.w + srcX;
+            const ppmLoader::RGB &pixel = image.data[src];
+            dest[0] = pixel.r;
+            dest[1] = pixel.g;
+            dest[2] = pixel.b;
+            dest[3] = alpha ? alpha->data[src].r : 255;
+            dest += 4;
+        }
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <string>
+#include <cstdint>
+#include "../../defines/Defines.h"
+#include "../../utils/imageLoader/ImageLoader.h"
+
+// Packs every material map and its mip chain into a single RGBA8 image (shelf packing)
+// Each texture is surrounded by a gutter copied from its opposite edges so that
+// bilinear filtering in the kernel wraps like a repeat sampler
+// Maps added with a BC format or TEXTURE_R8 are stored in a separate block buffer instead of the image
+class TextureAtlas
+{
+public:
+    static constexpr int GUTTER = 1; // texels around each texture
+
+    void clear();
+
+    // Register an image and its mip levels (box filtered down to 1x1) stored in the given TextureFormat
+    // Returns the index of level 0 in the descriptor table, the other levels follow it (-1 if the image is empty)
+    // For BC formats, name is used in the quality/size report printed after encoding
+    // For TEXTURE_RGBA8, the red channel of alpha (same size as image) fills the alpha channel, 255 otherwise
+    // With maxDimension > 0, levels larger than maxDimension texels on a side are not stored
+    int addTexture(const ppmLoader::ImageRGB &image, int format = TEXTURE_RGBA8, const std::string &name = "",
+                   const ppmLoader::ImageRGB *alpha = nullptr, int maxDimension = 0);
+
+    // Device bytes used by the mip chain addTexture would store for an image of this size
+    static size_t chainBytes(int width, int height, int format, int maxDimension = 0);
+
+    // Place the registered textures and fill the atlas pixels
+    // Returns false if they do not fit in maxWidth x maxHeight
+    bool pack(int maxWidth, int maxHeight);
+
+    inline int getWidth() const { return width; }
+    inline int getHeight() const { return height; }
+    inline const std::vector<unsigned char> &getPixels() const { return pixels; } // RGBA8, row-major
+    inline const std::vector<GPUTexture> &getDescriptors() const { return descriptors; }
+    inline const std::vector<uint32_t> &getBlocks() const { return blocks; } // BC blocks and R8 texels, in 8-byte units
+    inline bool empty() const { return images.empty(); }
+
+private:
+    std::vector<const ppmLoader::ImageRGB *> images; // registered images, same order as descriptors
+    std::vector<const ppmLoader::ImageRGB *> alphas; // alpha source of each image, nullptr if opaque
+    std::deque<ppmLoader::ImageRGB> mipLevels;       // generated levels (deque keeps the pointers above valid)
+    std::vector<GPUTexture> descriptors;
+    std::vector<uint32_t> blocks;
+    std::vector<unsigned char> pixels;
+    int width = 0;
+    int height = 0;
+
+    void encodeLevel(const ppmLoader::ImageRGB &level, GPUTexture &descriptor);
+    static int firstLevelWithin(int width, int height, int maxDimension);
+    static ppmLoader::ImageRGB downsample(const ppmLoader::ImageRGB &image);
+    void copyWithGutter(const ppmLoader::ImageRGB &image, const ppmLoader::ImageRGB *alpha, const GPUTexture &descriptor);
+};
@@ -0,0 +1,68 @@
+#include "TextureResidency.h"
+#include <iostream>
+
+void TextureResidency::request(const std::string &key, size_t fullBytes, size_t fallbackBytes, bool bound)
+{
+    // A texture shared by several maps is uploaded once per use
+    Request &entry = requests[key];
+    entry.fullBytes += fullBytes;
+    entry.fallbackBytes += fallbackBytes;
+
+    auto position = positions.find(key);
+    if (position == positions.end())
+    {
+        recency.push_front(key);
+        positions[key] = recency.begin();
+    }
+    else if (bound)
+    {
+        recency.splice(recency.begin(), recency, position->second);
+    }
+}
+
+void TextureResidency::plan()
+{
+    // Forget textures that are no longer bound
+    for (auto it = recency.begin(); it != recency.end();)
+    {
+        if (requests.find(*it) == requests.end())
+        {
+            positions.erase(*it);
+            it = recency.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    // Start with everything at full resolution, then demote from the least recently bound end
+    size_t total = 0;
+    fullResolution.clear();
+    for (const auto &entry : requests)
+    {
+        total += entry.second.fullBytes;
+        fullResolution.insert(entry.first);
+    }
+
+    int demoted = 0;
+    for (auto it = recency.rbegin(); it != recency.rend() && total > budget; ++it)
+    {
+        const Request &entry = requests[*it];
+        total -= entry.fullBytes - entry.fallbackBytes;
+        fullResolution.erase(*it);
+        demoted++;
+    }
+
+    residentBytes = total;
+    if (demoted > 0)
+    {
+        std::cout << "Texture budget of " << budget / (1024 * 1024) << " MB exceeded: " << demoted << " of " << requests.size()
+                  << " textures use their " << FALLBACK_SIZE << "px fallback (" << total / 1024 << " KB resident)" << std::endl;
+    }
+    if (total > budget)
+    {
+        std::cerr << "Warning: fallback textures alone exceed the texture budget (" << total / 1024 << " KB)" << std::endl;
+    }
+    requests.clear();
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+// Decides which textures keep their full mip chain on the device under a memory budget
+// Textures are identified by a key (their file path) and ordered by the last time they were bound to a material
+// (set on it, or on a material added to the scene); when the full chains do not fit, the least recently bound
+// ones only keep their mips up to FALLBACK_SIZE texels
+// The plan is all or nothing: there is no per-texture eviction, the atlas is packed and uploaded again whenever
+// the textures change, and it is the next plan that promotes a fallback texture once space frees up
+class TextureResidency
+{
+public:
+    static constexpr int FALLBACK_SIZE = 64;                             // largest side of a fallback level
+    static constexpr size_t DEFAULT_BUDGET = size_t(512) * 1024 * 1024; // bytes
+
+    inline void setBudget(size_t bytes) { budget = bytes; }
+    inline size_t getBudget() const { return budget; }
+
+    // Declare a texture used in the scene being uploaded, with its device size at full and fallback resolution
+    // bound: it was just bound to a material (or is new), which makes it the most recently used
+    void request(const std::string &key, size_t fullBytes, size_t fallbackBytes, bool bound);
+
+    // Choose the full resolution textures among those requested since the last plan
+    // Textures that were not requested again are no longer bound and are forgotten
+    void plan();
+
+    inline bool isFullResolution(const std::string &key) const { return fullResolution.count(key) != 0; }
+    inline size_t getResidentBytes() const { return residentBytes; }
+
+private:
+    struct Request
+    {
+        size_t fullBytes = 0;
+        size_t fallbackBytes = 0;
+    };
+
+    size_t budget = DEFAULT_BUDGET;
+    size_t residentBytes = 0;
+    std::list<std::string> recency; // most recently bound first
+    std::unordered_map<std::string, std::list<std::string>::iterator> positions;
+    std::unordered_map<std::string, Request> requests;
+    std::unordered_set<std::string> fullResolution;
+};
@@ -0,0 +1,35 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "../../material/Material.h"
+
+// What a slot of the device material array held at the last upload, to skip texture uploads while no map changed
+// Materials are told apart by their serial: a material of a newly loaded scene can get the address and the slot
+// of a deleted one, with the same maps version
+struct UploadedMaterial
+{
+    uint64_t serial = 0; // 0 for a free slot
+    uint32_t mapsVersion = 0;
+    bool hasMaps = false;
+
+    UploadedMaterial() = default;
+    UploadedMaterial(const Material &material, bool hasMaps)
+        : serial(material.getSerial()), mapsVersion(material.getMapsVersion()), hasMaps(hasMaps) {}
+
+    inline bool holds(const Material &material) const { return serial == material.getSerial(); }
+    inline bool sameMaps(const Material &material) const { return holds(material) && mapsVersion == material.getMapsVersion(); }
+
+    // True if a slot holding maps before or after got another material or other maps
+    static bool mapsChanged(const std::vector<UploadedMaterial> &before, const std::vector<UploadedMaterial> &after)
+    {
+        for (size_t slot = 0; slot < std::max(before.size(), after.size()); ++slot)
+        {
+            UploadedMaterial was = slot < before.size() ? before[slot] : UploadedMaterial();
+            UploadedMaterial is = slot < after.size() ? after[slot] : UploadedMaterial();
+            if ((was.hasMaps || is.hasMaps) && (was.serial != is.serial || was.mapsVersion != is.mapsVersion))
+                return true;
+        }
+        return false;
+    }
+};
@@ -1,6 +1,8 @@
 #include "SceneManager.h"
 #include <algorithm>
 #include "../FileManager/FileManager.h"
+#include "../AssetLoader/AssetLoader.h"
+#include "../../commands/CommandsManager.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/quaternion.hpp>
@@ -33,16 +35,79 @@ SceneManager::~SceneManager()
 void SceneManager::addShape(Shape *shape)
 {
     shapes.push_back(shape);
+    if (shape->getID() >= 0)
+        shapesByID[shape->getID()] = shape;
+    addMaterialUser(shape->getMaterial());
+    store.add(shape);
 }
 void SceneManager::deleteShape(Shape *shape)
 {
-    shapes.erase(std::remove(shapes.begin(), shapes.end(), shape), shapes.end());
+    auto end = std::remove(shapes.begin(), shapes.end(), shape);
+    if (end == shapes.end())
+        return;
+    shapes.erase(end, shapes.end());
+    auto registered = shapesByID.find(shape->getID());
+    if (registered != shapesByID.end() && registered->second == shape)
+        shapesByID.erase(registered);
+    removeMaterialUser(shape->getMaterial());
+    store.remove(shape);
+}
+
+void SceneManager::setShapeMaterial(Shape *shape, Material *material)
+{
+    bool inScene = getShapeByID(shape->getID()) == shape;
+    if (inScene)
+        removeMaterialUser(shape->getMaterial());
+    shape->setMaterial(material);
+    if (inScene)
+        addMaterialUser(material);
+}
+
+void SceneManager::addMaterialUser(Material *material)
+{
+    if (!material)
+        return;
+    auto inserted = materialEntries.try_emplace(material, MaterialEntry{materials.size(), 0});
+    if (inserted.second)
+    {
+        materials.push_back(material);
+        material->setGPUIndex(materialSlots.allocate());
+        materialsVersion++;
+    }
+    inserted.first->second.users++;
+}
+
+// The last material of the list takes the place of a material no longer used
+void SceneManager::removeMaterialUser(Material *material)
+{
+    auto entry = materialEntries.find(material);
+    if (entry == materialEntries.end() || --entry->second.users > 0)
+        return;
+    size_t index = entry->second.index;
+    materialEntries.erase(entry);
+    materialSlots.free(material->getGPUIndex());
+    material->setGPUIndex(-1);
+    materialsVersion++;
+    if (index + 1 < materials.size())
+    {
+        materials[index] = materials.back();
+        materialEntries[materials[index]].index = index;
+    }
+    materials.pop_back();
 }
 
 void SceneManager::clearShapes()
 {
+    // Meshes still loading for the previous scene are dropped when they arrive
+    sceneGeneration++;
+
     // Clear materials vector first to avoid dangling pointers
     materials.clear();
+    materialEntries.clear();
+    materialSlots.clear();
+    materialsVersion++;
+    store.clear();
+    shapesByID.clear();
 
     // Now delete shapes (which will also delete their materials)
     for (Shape *shape : shapes)
@@ -88,36 +153,8 @@ Shape *SceneManager::getShapesBuffer() const
 
 Shape *SceneManager::getShapeByID(const int &shapeID) const
 {
-    std::cout << "Getting shape by ID: " << shapeID << std::endl;
-    if (shapeID < 0)
-    {
-        return nullptr; // Invalid ID
-    }
-    
-    // Iterate through shapes to find the one with matching ID
-    for (Shape* shape : shapes)
-    {
-        if (shape && shape->getID() == shapeID)
-        {
-            return shape;
-        }
-    }
-    
-    return nullptr; // Shape with this ID not found
-}
-
-// push all the unique materials used to avoid duplications in GPU
-void SceneManager::updateUniqueMaterials()
-{
-    materials.clear();
-    for (const auto &shape : shapes)
-    {
-        Material *mat = shape->getMaterial();
-        if (mat != nullptr && std::find(materials.begin(), materials.end(), mat) == materials.end())
-        {
-            materials.push_back(mat);
-        }
-    }
+    auto shape = shapesByID.find(shapeID);
+    return shape != shapesByID.end() ? shape->second : nullptr; // nullptr if no shape has this ID
 }
 
 void SceneManager::buildScene(const std::string &path)
@@ -144,7 +181,7 @@ void SceneManager::buildScene(const std::string &path)
 
         Shape *shape = nullptr;
         Material *material = nullptr;
-        if (hasMaterial)
+        if (hasMaterial && shapeType != ShapeType::MESH) // meshes create theirs on the loader thread
         {
             material = new Material(shapeJson["material"]);
         }
@@ -175,15 +212,40 @@ void SceneManager::buildScene(const std::string &path)
         }
         else if (shapeType == ShapeType::MESH)
         {
-            Mesh *mesh = new Mesh(shapeJson["file_path"]);
-            // specify transformations for mesh
-            mesh->scale(scale);
-            mesh->rotate(rotation);
-            mesh->translate(position);
-            mesh->generateCpuTriangles();
-            mesh->setMaterial(material);
-            mesh->rebuildBVH();
-            shape = mesh;
+            // Parsed and its BVH built on a loader thread, the mesh joins the scene once ready
+            std::string meshPath = shapeJson["file_path"];
+            nlohmann::json materialJson = hasMaterial ? shapeJson["material"] : nlohmann::json();
+            int generation = sceneGeneration;
+            int quality = Mesh::getDefaultBVHQuality();
+            AssetLoader::getInstance().load<Mesh *>(
+                meshPath,
+                [meshPath, materialJson, position, rotation, scale, quality]()
+                {
+                    // Placed and its BVH built (or read from its cache) by the constructor
+                    Mesh *mesh = new Mesh(meshPath, position, rotation, scale, quality);
+                    if (mesh->empty())
+                    {
+                        delete mesh;
+                        return static_cast<Mesh *>(nullptr);
+                    }
+                    if (!materialJson.is_null())
+                        mesh->setMaterial(new Material(materialJson));
+                    return mesh;
+                },
+                [this, generation](Mesh *mesh)
+                {
+                    if (!mesh)
+                        return;
+                    // Another scene was built meanwhile
+                    if (generation != sceneGeneration)
+                    {
+                        delete mesh;
+                        return;
+                    }
+                    addShape(mesh);
+                    CommandsManager::getInstance().notifyShapesChanged();
+                });
+            continue;
         }
         else
         {
@@ -297,7 +359,8 @@ void SceneManager::cornellScene()
         "Right Wall",             // name
         brickwallMat));
 
-    // Create a second brickwall material for the other wall (to avoid double-free)
+    // Each shape owns (and deletes) its material, so the other wall gets its own;
+    // both point at the same pixels through the TextureCache
     Material *brickwallMat2 = new Material(std::string("../assets/textures/brickwall.ppm"));
     brickwallMat2->setNormalsFromPath(std::string("../assets/normals/brickwall_n.ppm"));
 
@@ -337,6 +400,10 @@ void SceneManager::cornellScene()
    // mesh->scale(vec3(0.4f));
    // mesh->translate(vec3(-0.3f, 0.0f, -0.1f));
     //mesh->rotate(vec3(180.0f * 0.0174533f, 0.0f, 0.0f));
-    mesh->generateCpuTriangles();
+    if (mesh->empty())
+    {
+        delete mesh;
+        return;
+    }
     addShape(mesh);
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #pragma once
+#include <unordered_map>
 #include <vector>
 #include "../../shapes/Shape.h"
 #include "../../shapes/Sphere.h"
@@ -6,6 +7,8 @@
 #include "../../shapes/Triangle.h"
 #include "../../shapes/Mesh.h"
 #include "../../bvh/bvh.h"
+#include "../../utils/slotAllocator/SlotAllocator.h"
+#include "SceneStore.h"
 class SceneManager
 {
 public:
@@ -20,9 +23,18 @@ public:
 
     void addShape(Shape *shape);
     void deleteShape(Shape *shape);
+    void setShapeMaterial(Shape *shape, Material *material); // replaces (and deletes) the shape's material
     inline const std::vector<Shape *> &getShapes() { return shapes; }
+    // Pooled copy of the shapes for the renderer, see SceneStore
+    inline SceneStore &getStore() { return store; }
+    // Materials of the shapes in the scene, each once (in no particular order)
     inline const std::vector<Material *> &getMaterials() const { return materials; }
-    void updateUniqueMaterials();
+    // Size of the device material array: materials are stored at their GPU index, freed indices are reused
+    inline int getMaterialSlotCount() const { return materialSlots.size(); }
+    // Bumped whenever a material enters or leaves the scene
+    inline uint64_t getMaterialsVersion() const { return materialsVersion; }
+    // Bumped whenever the scene is cleared to load another one
+    inline int getSceneGeneration() const { return sceneGeneration; }
     void buildScene();
     void buildScene(const std::string &path);
     void defaultScene();
@@ -38,5 +50,19 @@ private:
     SceneManager(); // Private constructor
     std::vector<Shape *> shapes;
     std::vector<Material *> materials;
+    // Registries kept up to date by addShape/deleteShape/setShapeMaterial
+    struct MaterialEntry
+    {
+        size_t index; // position in materials
+        int users;    // shapes of the scene using it
+    };
+    std::unordered_map<int, Shape *> shapesByID;
+    std::unordered_map<const Material *, MaterialEntry> materialEntries;
+    SlotAllocator materialSlots;
+    SceneStore store;
+    uint64_t materialsVersion = 0;
+    int sceneGeneration = 0; // bumped by clearShapes, meshes loaded for an older scene are discarded
     void clearShapes();
+    void addMaterialUser(Material *material);
+    void removeMaterialUser(Material *material);
 };
\ No newline at end of file
@@ -0,0 +1,218 @@
+#include "SceneStore.h"
+#include <iostream>
+#include "../../shapes/Sphere.h"
+#include "../../shapes/Square.h"
+#include "../../shapes/Triangle.h"
+
+void SceneStore::add(Shape *shape)
+{
+    if (!shape || entities.count(shape))
+        return;
+    int entity = static_cast<int>(shapes.size());
+    entities[shape] = entity;
+    shapes.push_back(shape);
+    types.push_back(shape->getType());
+    versions.push_back(shape->getVersion());
+    materialHandles.push_back(-1);
+    records.push_back(-1);
+
+    int record = -1;
+    switch (types[entity])
+    {
+    case SPHERE:
+        record = static_cast<int>(spheres.records.size());
+        spheres.records.emplace_back();
+        spheres.entities.push_back(entity);
+        break;
+    case SQUARE:
+        record = static_cast<int>(squares.records.size());
+        squares.records.emplace_back();
+        squares.entities.push_back(entity);
+        break;
+    case TRIANGLE:
+        record = static_cast<int>(triangles.records.size());
+        triangles.records.emplace_back();
+        triangles.entities.push_back(entity);
+        break;
+    case MESH:
+        break;
+    default:
+        std::cerr << "Unknown shape type added to the scene store: " << types[entity] << std::endl;
+        break;
+    }
+    records[entity] = record;
+    pack(entity);
+}
+
+// The last record of the pool takes the place of the removed one
+template <typename Record>
+void SceneStore::removeRecord(Pool<Record> &pool, int record)
+{
+    int last = static_cast<int>(pool.records.size()) - 1;
+    if (record != last)
+    {
+        pool.records[record] = pool.records[last];
+        pool.entities[record] = pool.entities[last];
+        records[pool.entities[record]] = record;
+    }
+    pool.records.pop_back();
+    pool.entities.pop_back();
+}
+
+void SceneStore::remove(Shape *shape)
+{
+    auto found = entities.find(shape);
+    if (found == entities.end())
+        return;
+    int entity = found->second;
+    entities.erase(found);
+
+    if (records[entity] >= 0)
+    {
+        switch (types[entity])
+        {
+        case SPHERE:
+            removeRecord(spheres, records[entity]);
+            break;
+        case SQUARE:
+            removeRecord(squares, records[entity]);
+            break;
+        case TRIANGLE:
+            removeRecord(triangles, records[entity]);
+            break;
+        default:
+            break;
+        }
+    }
+
+    // The last entity takes the place of the removed one, its record points back to its new index
+    int last = static_cast<int>(shapes.size()) - 1;
+    if (entity != last)
+    {
+        shapes[entity] = shapes[last];
+        types[entity] = types[last];
+        versions[entity] = versions[last];
+        materialHandles[entity] = materialHandles[last];
+        records[entity] = records[last];
+        entities[shapes[entity]] = entity;
+        switch (types[entity])
+        {
+        case SPHERE:
+            spheres.entities[records[entity]] = entity;
+            break;
+        case SQUARE:
+            squares.entities[records[entity]] = entity;
+            break;
+        case TRIANGLE:
+            triangles.entities[records[entity]] = entity;
+            break;
+        default:
+            break;
+        }
+    }
+    shapes.pop_back();
+    types.pop_back();
+    versions.pop_back();
+    materialHandles.pop_back();
+    records.pop_back();
+}
+
+void SceneStore::clear()
+{
+    shapes.clear();
+    types.clear();
+    versions.clear();
+    materialHandles.clear();
+    records.clear();
+    entities.clear();
+    spheres = {};
+    squares = {};
+    triangles = {};
+}
+
+// Write the device record of the entity from its shape
+void SceneStore::pack(int entity)
+{
+    Shape *shape = shapes[entity];
+    versions[entity] = shape->getVersion();
+    materialHandles[entity] = shape->getMaterial() ? shape->getMaterial()->getGPUIndex() : -1;
+    int record = records[entity];
+    switch (types[entity])
+    {
+    case SPHERE:
+        spheres.records[record] = static_cast<Sphere *>(shape)->toGPU();
+        break;
+    case SQUARE:
+        squares.records[record] = static_cast<Square *>(shape)->toGPU();
+        break;
+    case TRIANGLE:
+        triangles.records[record] = static_cast<Triangle *>(shape)->toGPU();
+        break;
+    default:
+        break;
+    }
+}
+
+void SceneStore::setMaterialHandle(int entity, int handle)
+{
+    materialHandles[entity] = handle;
+    int record = records[entity];
+    switch (types[entity])
+    {
+    case SPHERE:
+        spheres.records[record].materialIndex = handle;
+        break;
+    case SQUARE:
+        squares.records[record].materialIndex = handle;
+        break;
+    case TRIANGLE:
+        triangles.records[record].materialIndex = handle;
+        break;
+    default:
+        break;
+    }
+}
+
+void SceneStore::sync(uint64_t materialsVersion)
+{
+    for (size_t entity = 0; entity < shapes.size(); ++entity)
+    {
+        if (shapes[entity]->getVersion() != versions[entity])
+            pack(static_cast<int>(entity));
+    }
+    if (materialsVersion == syncedMaterialsVersion)
+        return;
+    syncedMaterialsVersion = materialsVersion;
+    for (size_t entity = 0; entity < shapes.size(); ++entity)
+    {
+        const Material *material = shapes[entity]->getMaterial();
+        int handle = material ? material->getGPUIndex() : -1;
+        if (handle != materialHandles[entity])
+            setMaterialHandle(static_cast<int>(entity), handle);
+    }
+}
+
+void SceneStore::appendPrimitives(std::vector<GPUShape> &gpu_shapes) const
+{
+    size_t first = gpu_shapes.size();
+    gpu_shapes.resize(first + primitiveCount(), GPUShape{});
+    GPUShape *out = gpu_shapes.data() + first;
+    for (const GPUSphere &sphere : spheres.records)
+    {
+        out->type = SPHERE;
+        out->data.sphere = sphere;
+        ++out;
+    }
+    for (const GPUSquare &square : squares.records)
+    {
+        out->type = SQUARE;
+        out->data.square = square;
+        ++out;
+    }
+    for (const GPUTriangle &triangle : triangles.records)
+    {
+        out->type = TRIANGLE;
+        out->data.triangle = triangle;
+        ++out;
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "../../defines/Defines.h"
+#include "../../shapes/Shape.h"
+
+// Data-oriented copy of the scene for the renderer: an entity per shape, with contiguous pools indexed by
+// entity (kind, material handle, shape version held) and one pool of device records per kind of primitive,
+// so that filling the shapes buffer is a linear copy of each pool
+// Shapes stay the objects the editor works on: sync() reads again the ones whose version moved
+// Meshes only get an entity, their BVHs are laid out by the RenderEngine
+class SceneStore
+{
+public:
+    void add(Shape *shape);
+    void remove(Shape *shape);
+    void clear();
+
+    // Read again the shapes changed since the last call, and every material handle when materials were added
+    // to or removed from the scene (their GPU indices may have moved)
+    void sync(uint64_t materialsVersion);
+
+    // Append the spheres, squares and triangles to gpu_shapes, one pool after the other
+    void appendPrimitives(std::vector<GPUShape> &gpu_shapes) const;
+
+    inline size_t size() const { return shapes.size(); }
+    inline size_t primitiveCount() const { return spheres.records.size() + squares.records.size() + triangles.records.size(); }
+
+private:
+    // Device records of one kind of primitive and the entity of each
+    template <typename Record>
+    struct Pool
+    {
+        std::vector<Record> records;
+        std::vector<int> entities;
+    };
+
+    // Entity pools, all removed by swapping in the last entity
+    std::vector<Shape *> shapes;
+    std::vector<ShapeType> types;
+    std::vector<uint32_t> versions;   // shape version the records were packed from
+    std::vector<int> materialHandles; // GPU index of the material, -1 if none
+    std::vector<int> records;         // index in the pool of its kind, -1 for meshes
+    std::unordered_map<const Shape *, int> entities;
+
+    Pool<GPUSphere> spheres;
+    Pool<GPUSquare> squares;
+    Pool<GPUTriangle> triangles;
+    uint64_t syncedMaterialsVersion = 0;
+
+    void pack(int entity);
+    void setMaterialHandle(int entity, int handle);
+    template <typename Record>
+    void removeRecord(Pool<Record> &pool, int record);
+};
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+// Bump allocator for scratch memory that lives as long as one job (a BVH build): arrays are carved out of a
+// single block sized upfront, nothing is freed on its own and release() frees the whole block at once
+// Only trivially destructible types are stored (no destructor is ever run)
+class Arena
+{
+public:
+    Arena() = default;
+    explicit Arena(size_t bytes) { reserve(bytes); }
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    // Allocate the block (before any allocation); a larger block replaces an empty one
+    void reserve(size_t bytes)
+    {
+        if (used > 0 || bytes <= size)
+            return;
+        block.reset(new unsigned char[bytes]);
+        size = bytes;
+    }
+
+    // Uninitialized array of count T, nullptr if the block is too small
+    template <typename T>
+    T *allocate(size_t count)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "arena arrays are never destroyed");
+        size_t offset = (used + alignof(T) - 1) & ~(alignof(T) - 1);
+        if (!block || offset > size || count > (size - offset) / sizeof(T))
+            return nullptr;
+        used = offset + count * sizeof(T);
+        return reinterpret_cast<T *>(block.get() + offset);
+    }
+
+    // Bytes needed for count T however the block is aligned so far
+    template <typename T>
+    static size_t bytesFor(size_t count) { return count * sizeof(T) + alignof(T) - 1; }
+
+    void release()
+    {
+        block.reset();
+        size = 0;
+        used = 0;
+    }
+
+    inline size_t capacity() const { return size; }
+    inline size_t bytesUsed() const { return used; }
+
+private:
+    std::unique_ptr<unsigned char[]> block;
+    size_t size = 0;
+    size_t used = 0;
+};
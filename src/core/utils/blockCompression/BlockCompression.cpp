@@ -0,0 +1,291 @@
+#include "BlockCompression.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "../../defines/Defines.h"
+
+namespace blockCompression
+{
+    namespace
+    {
+        struct Color
+        {
+            int r, g, b;
+        };
+
+        // Texel of the 4x4 tile (clamped to the image for partial tiles)
+        const ppmLoader::RGB &tileTexel(const ppmLoader::ImageRGB &image, int tileX, int tileY, int i)
+        {
+            int x = std::min(tileX * 4 + (i & 3), image.w - 1);
+            int y = std::min(tileY * 4 + (i >> 2), image.h - 1);
+            return image.data[static_cast<size_t>(y) * image.w + x];
+        }
+
+        int channelOf(const ppmLoader::RGB &pixel, int channel)
+        {
+            return channel == 0 ? pixel.r : (channel == 1 ? pixel.g : pixel.b);
+        }
+
+        uint16_t packRGB565(const Color &c)
+        {
+            return static_cast<uint16_t>(((c.r * 31 + 127) / 255) << 11 | ((c.g * 63 + 127) / 255) << 5 | ((c.b * 31 + 127) / 255));
+        }
+
+        Color unpackRGB565(uint16_t c)
+        {
+            int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+            return {(r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2)};
+        }
+
+        void bc1Palette(uint16_t c0, uint16_t c1, Color palette[4])
+        {
+            palette[0] = unpackRGB565(c0);
+            palette[1] = unpackRGB565(c1);
+            if (c0 > c1)
+            {
+                palette[2] = {(2 * palette[0].r + palette[1].r) / 3, (2 * palette[0].g + palette[1].g) / 3, (2 * palette[0].b + palette[1].b) / 3};
+                palette[3] = {(palette[0].r + 2 * palette[1].r) / 3, (palette[0].g + 2 * palette[1].g) / 3, (palette[0].b + 2 * palette[1].b) / 3};
+            }
+            else
+            {
+                palette[2] = {(palette[0].r + palette[1].r) / 2, (palette[0].g + palette[1].g) / 2, (palette[0].b + palette[1].b) / 2};
+                palette[3] = {0, 0, 0};
+            }
+        }
+
+        void bc4Palette(int r0, int r1, int palette[8])
+        {
+            palette[0] = r0;
+            palette[1] = r1;
+            if (r0 > r1)
+            {
+                for (int i = 2; i < 8; ++i)
+                    palette[i] = ((8 - i) * r0 + (i - 1) * r1) / 7;
+            }
+            else
+            {
+                for (int i = 2; i < 6; ++i)
+                    palette[i] = ((6 - i) * r0 + (i - 1) * r1) / 5;
+                palette[6] = 0;
+                palette[7] = 255;
+            }
+        }
+
+        void encodeBC1Block(const Color texels[16], uint32_t out[2])
+        {
+            // Bounding box of the tile, corners picked along the dominant correlation of the channels
+            Color lo = {255, 255, 255}, hi = {0, 0, 0};
+            double mean[3] = {0, 0, 0};
+            for (int i = 0; i < 16; ++i)
+            {
+                lo = {std::min(lo.r, texels[i].r), std::min(lo.g, texels[i].g), std::min(lo.b, texels[i].b)};
+                hi = {std::max(hi.r, texels[i].r), std::max(hi.g, texels[i].g), std::max(hi.b, texels[i].b)};
+                mean[0] += texels[i].r / 16.0;
+                mean[1] += texels[i].g / 16.0;
+                mean[2] += texels[i].b / 16.0;
+            }
+            double covRG = 0, covRB = 0;
+            for (int i = 0; i < 16; ++i)
+            {
+                covRG += (texels[i].r - mean[0]) * (texels[i].g - mean[1]);
+                covRB += (texels[i].r - mean[0]) * (texels[i].b - mean[2]);
+            }
+            if (covRG < 0)
+                std::swap(lo.g, hi.g);
+            if (covRB < 0)
+                std::swap(lo.b, hi.b);
+
+            uint16_t c0 = packRGB565(hi);
+            uint16_t c1 = packRGB565(lo);
+            if (c0 < c1)
+                std::swap(c0, c1); // always use the 4-colour mode
+
+            Color palette[4];
+            bc1Palette(c0, c1, palette);
+
+            uint32_t indices = 0;
+            for (int i = 0; i < 16; ++i)
+            {
+                int best = 0;
+                int bestError = std::numeric_limits<int>::max();
+                for (int p = 0; p < (c0 > c1 ? 4 : 3); ++p)
+                {
+                    int dr = texels[i].r - palette[p].r, dg = texels[i].g - palette[p].g, db = texels[i].b - palette[p].b;
+                    int error = dr * dr + dg * dg + db * db;
+                    if (error < bestError)
+                    {
+                        bestError = error;
+                        best = p;
+                    }
+                }
+                indices |= static_cast<uint32_t>(best) << (2 * i);
+            }
+
+            out[0] = static_cast<uint32_t>(c0) | (static_cast<uint32_t>(c1) << 16);
+            out[1] = indices;
+        }
+
+        void encodeBC4Block(const int values[16], uint32_t out[2])
+        {
+            int r0 = *std::max_element(values, values + 16);
+            int r1 = *std::min_element(values, values + 16);
+
+            int palette[8];
+            bc4Palette(r0, r1, palette);
+
+            uint64_t bits = static_cast<uint64_t>(r0) | (static_cast<uint64_t>(r1) << 8);
+            for (int i = 0; i < 16; ++i)
+            {
+                int best = 0;
+                int bestError = std::numeric_limits<int>::max();
+                for (int p = 0; p < 8; ++p)
+                {
+                    int error = std::abs(values[i] - palette[p]);
+                    if (error < bestError)
+                    {
+                        bestError = error;
+                        best = p;
+                    }
+                }
+                bits |= static_cast<uint64_t>(best) << (16 + 3 * i);
+            }
+
+            out[0] = static_cast<uint32_t>(bits);
+            out[1] = static_cast<uint32_t>(bits >> 32);
+        }
+
+        int decodeBC4Texel(const uint32_t block[2], int i)
+        {
+            uint64_t bits = static_cast<uint64_t>(block[0]) | (static_cast<uint64_t>(block[1]) << 32);
+            int palette[8];
+            bc4Palette(static_cast<int>(bits & 0xFF), static_cast<int>((bits >> 8) & 0xFF), palette);
+            return palette[(bits >> (16 + 3 * i)) & 7];
+        }
+    }
+
+    size_t blockWords(int width, int height, int format)
+    {
+        size_t tiles = static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4);
+        return tiles * (format == TEXTURE_BC5 ? 4 : 2);
+    }
+
+    void encodeBC1(const ppmLoader::ImageRGB &image, std::vector<uint32_t> &blocks)
+    {
+        int tilesX = (image.w + 3) / 4, tilesY = (image.h + 3) / 4;
+        for (int ty = 0; ty < tilesY; ++ty)
+        {
+            for (int tx = 0; tx < tilesX; ++tx)
+            {
+                Color texels[16];
+                for (int i = 0; i < 16; ++i)
+                {
+                    const ppmLoader::RGB &pixel = tileTexel(image, tx, ty, i);
+                    texels[i] = {pixel.r, pixel.g, pixel.b};
+                }
+                uint32_t block[2];
+                encodeBC1Block(texels, block);
+                blocks.push_back(block[0]);
+                blocks.push_back(block[1]);
+            }
+        }
+    }
+
+    void encodeBC4(const ppmLoader::ImageRGB &image, int channel, std::vector<uint32_t> &blocks)
+    {
+        int tilesX = (image.w + 3) / 4, tilesY = (image.h + 3) / 4;
+        for (int ty = 0; ty < tilesY; ++ty)
+        {
+            for (int tx = 0; tx < tilesX; ++tx)
+            {
+                int values[16];
+                for (int i = 0; i < 16; ++i)
+                    values[i] = channelOf(tileTexel(image, tx, ty, i), channel);
+                uint32_t block[2];
+                encodeBC4Block(values, block);
+                blocks.push_back(block[0]);
+                blocks.push_back(block[1]);
+            }
+        }
+    }
+
+    void encodeBC5(const ppmLoader::ImageRGB &image, std::vector<uint32_t> &blocks)
+    {
+        int tilesX = (image.w + 3) / 4, tilesY = (image.h + 3) / 4;
+        for (int ty = 0; ty < tilesY; ++ty)
+        {
+            for (int tx = 0; tx < tilesX; ++tx)
+            {
+                for (int channel = 0; channel < 2; ++channel)
+                {
+                    int values[16];
+                    for (int i = 0; i < 16; ++i)
+                        values[i] = channelOf(tileTexel(image, tx, ty, i), channel);
+                    uint32_t block[2];
+                    encodeBC4Block(values, block);
+                    blocks.push_back(block[0]);
+                    blocks.push_back(block[1]);
+                }
+            }
+        }
+    }
+
+    ppmLoader::ImageRGB decode(const std::vector<uint32_t> &blocks, size_t firstWord, int width, int height, int format)
+    {
+        ppmLoader::ImageRGB image;
+        image.w = width;
+        image.h = height;
+        image.data.resize(static_cast<size_t>(width) * height);
+
+        int tilesX = (width + 3) / 4;
+        size_t wordsPerTile = format == TEXTURE_BC5 ? 4 : 2;
+        for (int y = 0; y < height; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                const uint32_t *block = blocks.data() + firstWord + (static_cast<size_t>(y / 4) * tilesX + x / 4) * wordsPerTile;
+                int i = (y & 3) * 4 + (x & 3);
+                ppmLoader::RGB &out = image.data[static_cast<size_t>(y) * width + x];
+
+                if (format == TEXTURE_BC1)
+                {
+                    Color palette[4];
+                    bc1Palette(static_cast<uint16_t>(block[0] & 0xFFFF), static_cast<uint16_t>(block[0] >> 16), palette);
+                    const Color &c = palette[(block[1] >> (2 * i)) & 3];
+                    out = {static_cast<unsigned char>(c.r), static_cast<unsigned char>(c.g), static_cast<unsigned char>(c.b)};
+                }
+                else if (format == TEXTURE_BC4)
+                {
+                    unsigned char v = static_cast<unsigned char>(decodeBC4Texel(block, i));
+                    out = {v, v, v};
+                }
+                else
+                {
+                    int r = decodeBC4Texel(block, i);
+                    int g = decodeBC4Texel(block + 2, i);
+                    float nx = r / 255.0f * 2.0f - 1.0f, ny = g / 255.0f * 2.0f - 1.0f;
+                    float nz = std::sqrt(std::max(1.0f - nx * nx - ny * ny, 0.0f));
+                    out = {static_cast<unsigned char>(r), static_cast<unsigned char>(g), static_cast<unsigned char>(std::lround((nz * 0.5f + 0.5f) * 255.0f))};
+                }
+            }
+        }
+        return image;
+    }
+
+    double psnr(const ppmLoader::ImageRGB &reference, const ppmLoader::ImageRGB &image, int channels)
+    {
+        double squaredError = 0.0;
+        size_t count = std::min(reference.data.size(), image.data.size());
+        for (size_t i = 0; i < count; ++i)
+        {
+            for (int c = 0; c < channels; ++c)
+            {
+                double d = channelOf(reference.data[i], c) - channelOf(image.data[i], c);
+                squaredError += d * d;
+            }
+        }
+        if (count == 0 || squaredError == 0.0)
+            return std::numeric_limits<double>::infinity();
+        double mse = squaredError / (static_cast<double>(count) * channels);
+        return 10.0 * std::log10(255.0 * 255.0 / mse);
+    }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "../imageLoader/ImageLoader.h"
+
+// BC1/BC4/BC5-style 4x4 block encoders for material maps
+// Blocks are 8 bytes, stored as two 32-bit words (low word first) to match a uint2 in the kernel
+// Tiles are laid out row-major, ceil(w/4) x ceil(h/4); BC5 stores two BC4 blocks per tile (red then green)
+namespace blockCompression
+{
+    // 5:6:5 colour endpoints + 2-bit indices, for albedo maps
+    void encodeBC1(const ppmLoader::ImageRGB &image, std::vector<uint32_t> &blocks);
+
+    // 8-bit endpoints + 3-bit indices on one channel (0 = r, 1 = g, 2 = b), for metal/emissive maps
+    void encodeBC4(const ppmLoader::ImageRGB &image, int channel, std::vector<uint32_t> &blocks);
+
+    // Red and green as two BC4 blocks, for tangent-space normal maps (blue is rebuilt when sampling)
+    void encodeBC5(const ppmLoader::ImageRGB &image, std::vector<uint32_t> &blocks);
+
+    // Decode blocks starting at word firstWord back to RGB (same reconstruction as the kernel)
+    ppmLoader::ImageRGB decode(const std::vector<uint32_t> &blocks, size_t firstWord, int width, int height, int format);
+
+    // Peak signal-to-noise ratio over the first `channels` channels (r, g, b order)
+    double psnr(const ppmLoader::ImageRGB &reference, const ppmLoader::ImageRGB &image, int channels);
+
+    // Number of 32-bit words needed for a w x h image in the given format
+    size_t blockWords(int width, int height, int format);
+}
@@ -1,8 +1,14 @@
 #include "ImageLoader.h"
 #include <unistd.h>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <omp.h>
 
 // Source courtesy of J. Manson
 // http://josiahmanson.com/prose/optimize_ppm/
+// Files are memory-mapped and parsed in place: the header by hand, P6 pixels without copy,
+// P3 values with std::from_chars over parallel chunks
 
 
 namespace ppmLoader{
@@ -24,172 +30,257 @@ void load_ppm(ImageRGB &img, const string &name)
     img.w = 0;
     img.h = 0;
     img.data.clear();
-    
-    ifstream f(name.c_str(), ios::binary);
-    if (f.fail())
-    {
-        cout << "Could not open file: " << name << endl;
+
+    PPMFile file;
+    if (!file.open(name))
         return;
-    }
 
-    // get type of file
-    eat_comment(f);
-    int mode = 0;
-    string s;
-    f >> s;
-    if (s == "P3")
-        mode = 3;
-    else if (s == "P6")
-        mode = 6;
+    img.data.assign(file.pixels(), file.pixels() + file.pixelCount());
+    img.w = file.width();
+    img.h = file.height();
+}
 
-    // get w
-    eat_comment(f);
-    f >> img.w;
 
-    // get h
-    eat_comment(f);
-    f >> img.h;
+// Skip whitespace and '#' comments between header fields
+static size_t skip_header_space(const unsigned char *data, size_t size, size_t pos)
+{
+    while (pos < size)
+    {
+        if (data[pos] == '#')
+        {
+            while (pos < size && data[pos] != '\n')
+                pos++;
+        }
+        else if (data[pos] == ' ' || data[pos] == '\t' || data[pos] == '\n' || data[pos] == '\r')
+        {
+            pos++;
+        }
+        else
+        {
+            break;
+        }
+    }
+    return pos;
+}
 
-    // get bits
-    eat_comment(f);
-    int bits = 0;
-    f >> bits;
+static bool read_header_int(const unsigned char *data, size_t size, size_t &pos, int &value)
+{
+    pos = skip_header_space(data, size, pos);
+    if (pos >= size || data[pos] < '0' || data[pos] > '9')
+        return false;
+    value = 0;
+    while (pos < size && data[pos] >= '0' && data[pos] <= '9' && value < 1000000)
+        value = value * 10 + (data[pos++] - '0');
+    return true;
+}
 
-    // error checking
-    if (mode != 3 && mode != 6)
+bool parse_ppm_header(const unsigned char *data, size_t size, PPMHeader &header)
+{
+    size_t pos = skip_header_space(data, size, 0);
+    if (pos + 2 > size || data[pos] != 'P' || (data[pos + 1] != '3' && data[pos + 1] != '6'))
     {
         cout << "Unsupported magic number" << endl;
-        f.close();
-        return;
+        return false;
     }
-    if (img.w < 1)
+    header.mode = data[pos + 1] - '0';
+    pos += 2;
+
+    if (!read_header_int(data, size, pos, header.w) || header.w < 1)
     {
-        cout << "Unsupported width: " << img.w << endl;
-        f.close();
-        return;
+        cout << "Unsupported width: " << header.w << endl;
+        return false;
     }
-    if (img.h < 1)
+    if (!read_header_int(data, size, pos, header.h) || header.h < 1)
     {
-        cout << "Unsupported height: " << img.h << endl;
-        f.close();
-        return;
+        cout << "Unsupported height: " << header.h << endl;
+        return false;
     }
-    if (bits < 1 || bits > 255)
+    if (!read_header_int(data, size, pos, header.bits) || header.bits < 1 || header.bits > 255)
     {
-        cout << "Unsupported number of bits: " << bits << endl;
-        f.close();
-        return;
+        cout << "Unsupported number of bits: " << header.bits << endl;
+        return false;
     }
 
-    // load image data
-    img.data.resize(img.w * img.h);
+    // A single whitespace character separates the header from binary data
+    header.dataOffset = pos + 1;
+    return true;
+}
 
-    if (mode == 6)
-    {
-        f.get();
-        f.read((char*)&img.data[0], img.data.size() * 3);
-    }
-    else if (mode == 3)
+// Skip to the next ASCII value, jumping over separators and comments
+static const char *next_value(const char *p, const char *end)
+{
+    while (p < end && (*p < '0' || *p > '9'))
     {
-        for (unsigned int i = 0; i < img.data.size(); i++)
+        if (*p == '#')
+        {
+            const char *newline = static_cast<const char *>(memchr(p, '\n', end - p));
+            p = newline ? newline : end;
+        }
+        else
         {
-            int v;
-            f >> v;
-            img.data[i].r = v;
-            f >> v;
-            img.data[i].g = v;
-            f >> v;
-            img.data[i].b = v;
+            p++;
         }
     }
-
-    // close file
-    f.close();
+    return p;
 }
 
-
-void load_ppm( unsigned char * & pixels , unsigned int & w , unsigned int & h , const string &name , loadedFormat format)
+// Parse up to count values, returns how many were read
+static size_t parse_values(const char *p, const char *end, unsigned char *channels, size_t count)
 {
-    ifstream f(name.c_str(), ios::binary);
-    if (f.fail())
+    size_t parsed = 0;
+    while (parsed < count && (p = next_value(p, end)) < end)
     {
-        cout << "Could not open file: " << name << endl;
-        return;
+        unsigned int v = 0;
+        p = from_chars(p, end, v).ptr;
+        channels[parsed++] = static_cast<unsigned char>(min(v, 255u));
     }
+    return parsed;
+}
 
-    // get type of file
-    eat_comment(f);
-    int mode = 0;
-    string s;
-    f >> s;
-    if (s == "P3")
-        mode = 3;
-    else if (s == "P6")
-        mode = 6;
+static size_t count_values(const char *p, const char *end)
+{
+    size_t count = 0;
+    while ((p = next_value(p, end)) < end)
+    {
+        while (p < end && *p >= '0' && *p <= '9')
+            p++;
+        count++;
+    }
+    return count;
+}
 
-    // get w
-    eat_comment(f);
-    f >> w;
+bool parse_ascii_channels(const char *begin, const char *end, unsigned char *channels, size_t count)
+{
+    // A chunk boundary could fall inside a comment, so commented data is parsed in one piece
+    const size_t minChunkBytes = 64 * 1024;
+    size_t bytes = static_cast<size_t>(end - begin);
+    int chunkCount = static_cast<int>(min<size_t>(bytes / minChunkBytes + 1, static_cast<size_t>(omp_get_max_threads()) * 4));
+    if (memchr(begin, '#', bytes))
+        chunkCount = 1;
 
-    // get h
-    eat_comment(f);
-    f >> h;
+    // Chunk boundaries are moved past the value they fall in, so every value belongs to one chunk
+    vector<const char *> bounds(chunkCount + 1);
+    bounds[0] = begin;
+    bounds[chunkCount] = end;
+    for (int i = 1; i < chunkCount; i++)
+    {
+        const char *p = max(begin + bytes * i / chunkCount, bounds[i - 1]);
+        while (p < end && *p >= '0' && *p <= '9')
+            p++;
+        bounds[i] = p;
+    }
 
-    // get bits
-    eat_comment(f);
-    int bits = 0;
-    f >> bits;
+    // Count the values of each chunk, then parse them straight to their final offset
+    vector<size_t> offsets(chunkCount + 1, 0);
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < chunkCount; i++)
+        offsets[i + 1] = count_values(bounds[i], bounds[i + 1]);
+    for (int i = 0; i < chunkCount; i++)
+        offsets[i + 1] += offsets[i];
+    if (offsets[chunkCount] < count)
+        return false;
 
-    // error checking
-    if (mode != 3 && mode != 6)
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < chunkCount; i++)
     {
-        cout << "Unsupported magic number" << endl;
-        f.close();
-        return;
+        if (offsets[i] < count)
+            parse_values(bounds[i], bounds[i + 1], channels + offsets[i], count - offsets[i]);
     }
-    if (w < 1)
+    return true;
+}
+
+void decode_ppm(ImageRGB &img, const unsigned char *data, size_t size, const string &name)
+{
+    img.w = 0;
+    img.h = 0;
+    img.data.clear();
+
+    PPMHeader header;
+    if (!parse_ppm_header(data, size, header))
     {
-        cout << "Unsupported width: " << w << endl;
-        f.close();
+        cout << "Could not decode file: " << name << endl;
         return;
     }
-    if (h < 1)
+
+    size_t texels = static_cast<size_t>(header.w) * header.h;
+    img.data.resize(texels);
+
+    if (header.mode == 6)
     {
-        cout << "Unsupported height: " << h << endl;
-        f.close();
-        return;
+        if (header.dataOffset + texels * 3 > size)
+        {
+            cout << "Truncated pixel data in: " << name << endl;
+            img.data.clear();
+            return;
+        }
+        memcpy(img.data.data(), data + header.dataOffset, texels * 3);
     }
-    if (bits < 1 || bits > 255)
+    else
     {
-        cout << "Unsupported number of bits: " << bits << endl;
-        f.close();
-        return;
+        const char *begin = reinterpret_cast<const char *>(data) + min(header.dataOffset, size);
+        const char *end = reinterpret_cast<const char *>(data) + size;
+        if (!parse_ascii_channels(begin, end, &img.data[0].r, texels * 3))
+        {
+            cout << "Truncated pixel data in: " << name << endl;
+            img.data.clear();
+            return;
+        }
     }
 
-    // load image data
-    pixels = new unsigned char[3 * w * h];
+    img.w = header.w;
+    img.h = header.h;
+}
 
-    if (mode == 6)
+
+bool PPMFile::open(const string &path)
+{
+    data = nullptr;
+    decoded.clear();
+    if (!file.open(path))
+        return false;
+    if (!parse_ppm_header(file.data(), file.size(), header))
     {
-        f.get();
-        f.read( (char*)&(pixels[0]) , 3 * w * h );
+        cout << "Could not decode file: " << path << endl;
+        return false;
     }
-    else if (mode == 3)
+
+    size_t texels = static_cast<size_t>(header.w) * header.h;
+    if (header.mode == 6)
     {
-        for (unsigned int i = 0; i < w * h; i++)
+        // RGB is three packed bytes, so the mapped data can be used as is
+        if (header.dataOffset + texels * 3 > file.size())
         {
-            int v;
-            f >> v;
-            pixels[3*i + 0] = v;
-            f >> v;
-            pixels[3*i + 1] = v;
-            f >> v;
-            pixels[3*i + 2] = v;
+            cout << "Truncated pixel data in: " << path << endl;
+            return false;
         }
+        data = reinterpret_cast<const RGB *>(file.data() + header.dataOffset);
+        return true;
+    }
+
+    decoded.resize(texels);
+    const char *begin = reinterpret_cast<const char *>(file.data()) + min(header.dataOffset, file.size());
+    const char *end = reinterpret_cast<const char *>(file.data()) + file.size();
+    if (!parse_ascii_channels(begin, end, &decoded[0].r, texels * 3))
+    {
+        cout << "Truncated pixel data in: " << path << endl;
+        decoded.clear();
+        return false;
     }
+    data = decoded.data();
+    return true;
+}
 
-    // close file
-    f.close();
+
+void load_ppm( unsigned char * & pixels , unsigned int & w , unsigned int & h , const string &name , loadedFormat format)
+{
+    PPMFile file;
+    if (!file.open(name))
+        return;
+
+    w = file.width();
+    h = file.height();
+    pixels = new unsigned char[3 * w * h];
+    memcpy(pixels, file.pixels(), 3 * static_cast<size_t>(w) * h);
 
     if(format == rgb) {
         return;
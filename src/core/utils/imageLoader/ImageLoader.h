@@ -4,6 +4,7 @@
 #include <vector>
 #include <iostream>
 #include <fstream>
+#include "../mappedFile/MappedFile.h"
 
 // Source courtesy of J. Manson
 // http://josiahmanson.com/prose/optimize_ppm/
@@ -17,6 +18,7 @@ struct RGB
 {
     unsigned char r, g, b;
 };
+static_assert(sizeof(RGB) == 3, "RGB must match the packed PPM layout");
 
 struct ImageRGB
 {
@@ -27,6 +29,46 @@ struct ImageRGB
 
 void load_ppm(ImageRGB &img, const string &name);
 
+// PPM header read from memory, dataOffset is the first byte of the pixel data
+struct PPMHeader
+{
+    int mode = 0; // 3 (ASCII) or 6 (binary)
+    int w = 0;
+    int h = 0;
+    int bits = 0;
+    size_t dataOffset = 0;
+};
+
+// Parse the header of a PPM held in memory (e.g. a memory-mapped file), false if it is not a supported PPM
+bool parse_ppm_header(const unsigned char *data, size_t size, PPMHeader &header);
+
+// Decode a PPM held in memory, img is left empty on failure
+void decode_ppm(ImageRGB &img, const unsigned char *data, size_t size, const string &name);
+
+// Parse count ASCII values (P3 pixel data) from [begin, end) into channels, in parallel chunks
+// Returns false if the data holds fewer values
+bool parse_ascii_channels(const char *begin, const char *end, unsigned char *channels, size_t count);
+
+// PPM mapped in memory: P6 pixels are used in place without any copy, P3 is decoded once
+class PPMFile
+{
+public:
+    // Returns false (and reports why) if the file cannot be mapped or is not a valid PPM
+    bool open(const string &path);
+
+    inline int width() const { return header.w; }
+    inline int height() const { return header.h; }
+    inline const RGB *pixels() const { return data; } // width * height pixels, valid while the PPMFile lives
+    inline size_t pixelCount() const { return data ? static_cast<size_t>(header.w) * header.h : 0; }
+    inline bool isZeroCopy() const { return data && decoded.empty(); }
+
+private:
+    MappedFile file;
+    PPMHeader header;
+    vector<RGB> decoded; // P3 only
+    const RGB *data = nullptr;
+};
+
 
 enum loadedFormat {
     rgb,
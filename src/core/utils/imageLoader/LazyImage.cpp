@@ -0,0 +1,51 @@
+#include "LazyImage.h"
+
+bool LazyImage::setPath(const std::string &filePath)
+{
+    clear();
+    file = TextureCache::getInstance().probe(filePath);
+    if (!file)
+        return false;
+    path = filePath;
+    width = file->width;
+    height = file->height;
+    return true;
+}
+
+void LazyImage::set(const ppmLoader::ImageRGB &img)
+{
+    path.clear();
+    file.reset();
+    handle = TextureCache::adopt(img);
+    width = img.data.empty() ? 0 : img.w;
+    height = img.data.empty() ? 0 : img.h;
+}
+
+void LazyImage::clear()
+{
+    path.clear();
+    file.reset();
+    handle.reset();
+    width = 0;
+    height = 0;
+}
+
+const ppmLoader::ImageRGB &LazyImage::get() const
+{
+    static const ppmLoader::ImageRGB emptyImage = {0, 0, {}};
+    if (!handle && file)
+        handle = TextureCache::getInstance().load(file);
+    return handle ? *handle : emptyImage;
+}
+
+ImageHandle LazyImage::getHandle() const
+{
+    get();
+    return handle;
+}
+
+void LazyImage::release() const
+{
+    if (file && TextureCache::isCurrent(*file))
+        handle.reset();
+}
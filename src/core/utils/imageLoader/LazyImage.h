@@ -0,0 +1,42 @@
+#pragma once
+#include <string>
+#include "ImageLoader.h"
+#include "TextureCache.h"
+
+// Image of a material map: setting a path only reads the header of the mapped file,
+// the pixels are fetched from the TextureCache on first access and can be released again once
+// uploaded. Copies share the same pixels (undo commands keep maps this way)
+// The map keeps the version of the file it was set with, setting the path again picks up edits
+// Images set from memory have no backing file and are always kept
+class LazyImage
+{
+public:
+    // Map the file and read its size, returns false (and stays empty) if it is not a valid PPM
+    bool setPath(const std::string &path);
+    void set(const ppmLoader::ImageRGB &img);
+    void clear();
+
+    // Decoded pixels (decodes the mapped file on first call, an empty image if it fails)
+    const ppmLoader::ImageRGB &get() const;
+    // Shared handle on the decoded pixels
+    ImageHandle getHandle() const;
+
+    // Drop this image's reference on the pixels if they can be decoded again from the file
+    // (kept once the file changed on disk: the version this image was set with can't be decoded anymore)
+    void release() const;
+
+    inline int getWidth() const { return width; }
+    inline int getHeight() const { return height; }
+    inline bool empty() const { return width == 0 || height == 0; }
+    inline bool isDecoded() const { return handle != nullptr || empty(); }
+    inline const std::string &getPath() const { return path; }
+    // Version of the file the pixels come from, null for images set from memory
+    inline const TextureFileHandle &getFile() const { return file; }
+
+private:
+    std::string path; // empty for images set from memory
+    TextureFileHandle file;
+    mutable ImageHandle handle;
+    int width = 0;
+    int height = 0;
+};
@@ -0,0 +1,141 @@
+#include "TextureCache.h"
+#include <filesystem>
+
+// Path, modification time and size of the file, false if it cannot be read
+bool TextureCache::fileKey(const std::string &path, std::string &key)
+{
+    std::error_code error;
+    auto modified = std::filesystem::last_write_time(path, error);
+    if (error)
+        return false;
+    auto size = std::filesystem::file_size(path, error);
+    if (error)
+        return false;
+    key = path + '\n' + std::to_string(modified.time_since_epoch().count()) + '\n' + std::to_string(size);
+    return true;
+}
+
+// Drop the entries of file versions nothing references anymore (called with the lock held)
+void TextureCache::eraseUnused()
+{
+    for (auto it = entries.begin(); it != entries.end();)
+    {
+        if (it->second.file.expired() && it->second.image.expired())
+            it = entries.erase(it);
+        else
+            ++it;
+    }
+}
+
+TextureFileHandle TextureCache::probe(const std::string &path)
+{
+    std::string key;
+    if (!fileKey(path, key))
+    {
+        std::cerr << "Could not load image: " << path << std::endl;
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    eraseUnused();
+    Entry &entry = entries[key];
+    if (TextureFileHandle file = entry.file.lock())
+        return file;
+
+    auto file = std::make_shared<TextureFile>();
+    ppmLoader::PPMHeader header;
+    if (!file->file.open(path) || !ppmLoader::parse_ppm_header(file->file.data(), file->file.size(), header))
+    {
+        std::cerr << "Could not load image: " << path << std::endl;
+        if (entry.image.expired())
+            entries.erase(key);
+        return nullptr;
+    }
+    file->key = key;
+    file->path = path;
+    file->width = header.w;
+    file->height = header.h;
+    entry.file = file;
+    return file;
+}
+
+ImageHandle TextureCache::load(const TextureFileHandle &file)
+{
+    if (!file)
+        return nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(file->key);
+        if (it != entries.end())
+        {
+            if (ImageHandle image = it->second.image.lock())
+                return image;
+        }
+    }
+
+    if (!isCurrent(*file))
+    {
+        std::cerr << "Image changed on disk since it was loaded, load it again: " << file->path << std::endl;
+        return nullptr;
+    }
+
+    // Decode outside the lock so that different files decode concurrently
+    auto decoded = std::make_shared<ppmLoader::ImageRGB>();
+    ppmLoader::decode_ppm(*decoded, file->file.data(), file->file.size(), file->path);
+    if (decoded->data.empty())
+        return nullptr;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry &entry = entries[file->key];
+    if (ImageHandle image = entry.image.lock())
+        return image; // decoded by another thread meanwhile
+    if (entry.file.expired())
+        entry.file = file;
+    ImageHandle image = std::move(decoded);
+    entry.image = image;
+    return image;
+}
+
+ImageHandle TextureCache::load(const std::string &path)
+{
+    return load(probe(path));
+}
+
+bool TextureCache::isDecoded(const TextureFileHandle &file)
+{
+    if (!file)
+        return false;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(file->key);
+    return it != entries.end() && !it->second.image.expired();
+}
+
+bool TextureCache::isCurrent(const TextureFile &file)
+{
+    std::string key;
+    return fileKey(file.path, key) && key == file.key;
+}
+
+ImageHandle TextureCache::adopt(ppmLoader::ImageRGB image)
+{
+    return std::make_shared<const ppmLoader::ImageRGB>(std::move(image));
+}
+
+size_t TextureCache::getDecodedCount()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t count = 0;
+    for (const auto &entry : entries)
+    {
+        if (!entry.second.image.expired())
+            count++;
+    }
+    return count;
+}
+
+size_t TextureCache::getEntryCount()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    eraseUnused();
+    return entries.size();
+}
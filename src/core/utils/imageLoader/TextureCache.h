@@ -0,0 +1,76 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "ImageLoader.h"
+#include "../mappedFile/MappedFile.h"
+
+// Refcounted immutable image, shared instead of copying pixel vectors
+using ImageHandle = std::shared_ptr<const ppmLoader::ImageRGB>;
+
+// One version of an image file: its mapping and size as they were when probed
+// The key holds the path, modification time and size, so a file edited on disk is a new version
+struct TextureFile
+{
+    std::string key;
+    std::string path;
+    MappedFile file;
+    int width = 0;
+    int height = 0;
+};
+using TextureFileHandle = std::shared_ptr<const TextureFile>;
+
+// Decoded images shared by file version: materials, undo commands and UI previews all hold handles
+// to the same pixels. The cache only keeps weak references to the mappings and to the pixels:
+// an image is freed when its last handle goes away, and the entry of a version is dropped once
+// neither its mapping (held by LazyImages) nor its pixels are referenced anymore
+class TextureCache
+{
+public:
+    static TextureCache &getInstance()
+    {
+        static TextureCache instance;
+        return instance;
+    }
+
+    TextureCache(const TextureCache &) = delete;
+    TextureCache &operator=(const TextureCache &) = delete;
+
+    // Map the current version of the file and read its size without decoding, null if it is not a valid PPM
+    TextureFileHandle probe(const std::string &path);
+
+    // Decoded pixels of a file version, decoded once while any handle is alive (null handle on failure)
+    // A version no longer on disk is not decoded: its mapping shows the new bytes, or pages past the new end
+    ImageHandle load(const TextureFileHandle &file);
+    // Decoded pixels of the current version of the file
+    ImageHandle load(const std::string &path);
+
+    // True while the pixels of the file version are decoded and held by a handle
+    bool isDecoded(const TextureFileHandle &file);
+    // True while the file on disk is still this version
+    static bool isCurrent(const TextureFile &file);
+
+    // Share an image that has no file behind it
+    static ImageHandle adopt(ppmLoader::ImageRGB image);
+
+    // Number of file versions whose pixels are currently decoded
+    size_t getDecodedCount();
+    // Number of file versions still referenced by a mapping or decoded pixels
+    size_t getEntryCount();
+
+private:
+    TextureCache() = default;
+
+    struct Entry
+    {
+        std::weak_ptr<const TextureFile> file;
+        std::weak_ptr<const ppmLoader::ImageRGB> image;
+    };
+
+    std::mutex mutex;
+    std::unordered_map<std::string, Entry> entries;
+
+    static bool fileKey(const std::string &path, std::string &key);
+    void eraseUnused();
+};
@@ -0,0 +1,69 @@
+#include "MappedFile.h"
+#include <iostream>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+    : bytes(std::exchange(other.bytes, nullptr)),
+      length(std::exchange(other.length, 0)),
+      path(std::move(other.path))
+{
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+{
+    if (this != &other)
+    {
+        close();
+        bytes = std::exchange(other.bytes, nullptr);
+        length = std::exchange(other.length, 0);
+        path = std::move(other.path);
+    }
+    return *this;
+}
+
+bool MappedFile::open(const std::string &filePath)
+{
+    close();
+    path = filePath;
+
+    int fd = ::open(filePath.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        std::cerr << "Could not open file: " << filePath << std::endl;
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0)
+    {
+        std::cerr << "Could not map empty or unreadable file: " << filePath << std::endl;
+        ::close(fd);
+        return false;
+    }
+
+    void *mapping = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // the mapping stays valid after the descriptor is closed
+    if (mapping == MAP_FAILED)
+    {
+        std::cerr << "Could not map file: " << filePath << std::endl;
+        return false;
+    }
+
+    bytes = static_cast<const unsigned char *>(mapping);
+    length = static_cast<size_t>(info.st_size);
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (bytes)
+    {
+        munmap(const_cast<unsigned char *>(bytes), length);
+        bytes = nullptr;
+        length = 0;
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file
+// Pages are only read from disk when touched, so keeping many files mapped is cheap
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string &path) { open(path); }
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+
+    // Returns false (and reports on std::cerr) if the file cannot be opened or is empty
+    bool open(const std::string &path);
+    void close();
+
+    inline const unsigned char *data() const { return bytes; }
+    inline size_t size() const { return length; }
+    inline bool isOpen() const { return bytes != nullptr; }
+    inline const std::string &getPath() const { return path; }
+
+private:
+    const unsigned char *bytes = nullptr;
+    size_t length = 0;
+    std::string path;
+};
@@ -0,0 +1,198 @@
+#include "MeshCache.h"
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+#include <unistd.h>
+
+namespace MeshCache
+{
+    static const char MAGIC[8] = {'R', 'T', 'M', 'E', 'S', 'H', '\0', '\0'};
+
+    static uint64_t align16(uint64_t offset)
+    {
+        return (offset + 15) & ~uint64_t(15);
+    }
+
+    uint64_t hash(const void *data, size_t size, uint64_t seed)
+    {
+        const unsigned char *bytes = static_cast<const unsigned char *>(data);
+        uint64_t h = seed;
+        for (size_t i = 0; i < size; ++i)
+        {
+            h ^= bytes[i];
+            h *= 1099511628211ull;
+        }
+        return h;
+    }
+
+    std::string pathFor(const std::string &sourcePath, uint64_t key)
+    {
+        char hex[17];
+        std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(key));
+        return sourcePath + "." + hex + ".rtmesh";
+    }
+
+    // True if [offset, offset + count * stride) lies in the file
+    static bool inFile(uint64_t offset, uint64_t count, uint64_t stride, size_t fileSize)
+    {
+        return offset <= fileSize && (stride == 0 || count <= (fileSize - offset) / stride);
+    }
+
+    // Copy count * size bytes, if there is anything to copy
+    static void put(void *destination, const void *data, size_t count, size_t size)
+    {
+        if (count > 0)
+            std::memcpy(destination, data, count * size);
+    }
+
+    bool open(const std::string &cachePath, uint64_t key, View &view)
+    {
+        std::error_code error;
+        if (!std::filesystem::is_regular_file(cachePath, error))
+            return false;
+
+        auto file = std::make_shared<MappedFile>();
+        if (!file->open(cachePath) || file->size() < sizeof(Header))
+            return false;
+
+        Header header;
+        std::memcpy(&header, file->data(), sizeof(Header));
+        if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION ||
+            header.headerSize != sizeof(Header) || header.key != key)
+            return false;
+
+        size_t size = file->size();
+        if ((header.normalCount != 0 && header.normalCount != header.vertexCount) ||
+            !inFile(header.positionOffset, header.vertexCount, 3 * sizeof(float), size) ||
+            !inFile(header.normalOffset, header.normalCount, 3 * sizeof(float), size) ||
+            !inFile(header.indexOffset, header.triangleCount, 3 * sizeof(uint32_t), size) ||
+            !inFile(header.nodeOffset, header.nodeCount, sizeof(GPUBVHNode), size) ||
+            !inFile(header.triangleOrderOffset, header.bvhTriangleCount, sizeof(uint32_t), size) ||
+            !inFile(header.bvhTriangleOffset, header.bvhTriangleCount, sizeof(GPUTriangle), size) ||
+            !inFile(header.lodOffset, header.lodCount, sizeof(LODHeader), size))
+        {
+            std::cerr << "Truncated mesh cache: " << cachePath << std::endl;
+            return false;
+        }
+        std::vector<LODHeader> lodHeaders(header.lodCount);
+        put(lodHeaders.data(), file->data() + header.lodOffset, header.lodCount, sizeof(LODHeader));
+        for (const LODHeader &lod : lodHeaders)
+        {
+            if (!inFile(lod.indexOffset, lod.triangleCount, 3 * sizeof(uint32_t), size) ||
+                !inFile(lod.nodeOffset, lod.nodeCount, sizeof(GPUBVHNode), size) ||
+                !inFile(lod.triangleOrderOffset, lod.triangleCount, sizeof(uint32_t), size) ||
+                !inFile(lod.bvhTriangleOffset, lod.triangleCount, sizeof(GPUTriangle), size))
+            {
+                std::cerr << "Truncated mesh cache: " << cachePath << std::endl;
+                return false;
+            }
+        }
+
+        const unsigned char *data = file->data();
+        view.positions = reinterpret_cast<const float *>(data + header.positionOffset);
+        view.normals = header.normalCount ? reinterpret_cast<const float *>(data + header.normalOffset) : nullptr;
+        view.vertexCount = header.vertexCount;
+        view.indices = reinterpret_cast<const uint32_t *>(data + header.indexOffset);
+        view.triangleCount = header.triangleCount;
+        view.nodes = reinterpret_cast<const GPUBVHNode *>(data + header.nodeOffset);
+        view.nodeCount = header.nodeCount;
+        view.triangleOrder = reinterpret_cast<const uint32_t *>(data + header.triangleOrderOffset);
+        view.bvhTriangles = reinterpret_cast<const GPUTriangle *>(data + header.bvhTriangleOffset);
+        view.bvhTriangleCount = header.bvhTriangleCount;
+        view.lods.resize(lodHeaders.size());
+        for (size_t i = 0; i < lodHeaders.size(); ++i)
+        {
+            const LODHeader &lod = lodHeaders[i];
+            view.lods[i].indices = reinterpret_cast<const uint32_t *>(data + lod.indexOffset);
+            view.lods[i].triangleCount = lod.triangleCount;
+            view.lods[i].nodes = reinterpret_cast<const GPUBVHNode *>(data + lod.nodeOffset);
+            view.lods[i].nodeCount = lod.nodeCount;
+            view.lods[i].triangleOrder = reinterpret_cast<const uint32_t *>(data + lod.triangleOrderOffset);
+            view.lods[i].bvhTriangles = reinterpret_cast<const GPUTriangle *>(data + lod.bvhTriangleOffset);
+        }
+        view.file = std::move(file);
+        return true;
+    }
+
+    bool write(const std::string &cachePath, uint64_t key, const View &content)
+    {
+        Header header = {};
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.headerSize = sizeof(Header);
+        header.key = key;
+        header.vertexCount = content.vertexCount;
+        header.normalCount = content.normals ? content.vertexCount : 0;
+        header.triangleCount = content.triangleCount;
+        header.nodeCount = content.nodeCount;
+        header.bvhTriangleCount = content.bvhTriangleCount;
+        header.positionOffset = align16(sizeof(Header));
+        header.normalOffset = align16(header.positionOffset + header.vertexCount * 3 * sizeof(float));
+        header.indexOffset = align16(header.normalOffset + header.normalCount * 3 * sizeof(float));
+        header.nodeOffset = align16(header.indexOffset + header.triangleCount * 3 * sizeof(uint32_t));
+        header.triangleOrderOffset = align16(header.nodeOffset + header.nodeCount * sizeof(GPUBVHNode));
+        header.bvhTriangleOffset = align16(header.triangleOrderOffset + header.bvhTriangleCount * sizeof(uint32_t));
+        header.lodCount = content.lods.size();
+        header.lodOffset = align16(header.bvhTriangleOffset + header.bvhTriangleCount * sizeof(GPUTriangle));
+        uint64_t fileSize = header.lodOffset + header.lodCount * sizeof(LODHeader);
+        std::vector<LODHeader> lodHeaders(content.lods.size());
+        for (size_t i = 0; i < content.lods.size(); ++i)
+        {
+            LODHeader &lod = lodHeaders[i];
+            lod.triangleCount = content.lods[i].triangleCount;
+            lod.nodeCount = content.lods[i].nodeCount;
+            lod.indexOffset = align16(fileSize);
+            lod.nodeOffset = align16(lod.indexOffset + lod.triangleCount * 3 * sizeof(uint32_t));
+            lod.triangleOrderOffset = align16(lod.nodeOffset + lod.nodeCount * sizeof(GPUBVHNode));
+            lod.bvhTriangleOffset = align16(lod.triangleOrderOffset + lod.triangleCount * sizeof(uint32_t));
+            fileSize = lod.bvhTriangleOffset + lod.triangleCount * sizeof(GPUTriangle);
+        }
+
+        // Assemble the file in memory and write it in one go
+        std::vector<unsigned char> bytes(fileSize, 0);
+        unsigned char *data = bytes.data();
+        std::memcpy(data, &header, sizeof(Header));
+        put(data + header.positionOffset, content.positions, header.vertexCount, 3 * sizeof(float));
+        put(data + header.normalOffset, content.normals, header.normalCount, 3 * sizeof(float));
+        put(data + header.indexOffset, content.indices, header.triangleCount, 3 * sizeof(uint32_t));
+        put(data + header.nodeOffset, content.nodes, header.nodeCount, sizeof(GPUBVHNode));
+        put(data + header.triangleOrderOffset, content.triangleOrder, header.bvhTriangleCount, sizeof(uint32_t));
+        put(data + header.bvhTriangleOffset, content.bvhTriangles, header.bvhTriangleCount, sizeof(GPUTriangle));
+        put(data + header.lodOffset, lodHeaders.data(), header.lodCount, sizeof(LODHeader));
+        for (size_t i = 0; i < content.lods.size(); ++i)
+        {
+            const LODHeader &lod = lodHeaders[i];
+            const LODView &level = content.lods[i];
+            put(data + lod.indexOffset, level.indices, lod.triangleCount, 3 * sizeof(uint32_t));
+            put(data + lod.nodeOffset, level.nodes, lod.nodeCount, sizeof(GPUBVHNode));
+            put(data + lod.triangleOrderOffset, level.triangleOrder, lod.triangleCount, sizeof(uint32_t));
+            put(data + lod.bvhTriangleOffset, level.bvhTriangles, lod.triangleCount, sizeof(GPUTriangle));
+        }
+
+        // Unique temporary name: two loader threads may write the same cache
+        static std::atomic<unsigned int> writeCount{0};
+        std::string temporaryPath = cachePath + "." + std::to_string(getpid()) + "." + std::to_string(writeCount++) + ".tmp";
+        FILE *file = std::fopen(temporaryPath.c_str(), "wb");
+        if (!file)
+        {
+            std::cerr << "Could not write mesh cache: " << cachePath << std::endl;
+            return false;
+        }
+        bool written = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+        written = std::fclose(file) == 0 && written;
+
+        std::error_code error;
+        if (written)
+            std::filesystem::rename(temporaryPath, cachePath, error);
+        if (!written || error)
+        {
+            std::cerr << "Could not write mesh cache: " << cachePath << std::endl;
+            std::filesystem::remove(temporaryPath, error);
+            return false;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "../../defines/Defines.h"
+#include "../mappedFile/MappedFile.h"
+
+// Binary cache of a loaded mesh (.rtmesh), written next to the OFF file it comes from
+// It holds everything the loader produces: the placed vertex positions, normals and indices, and the BVH
+// nodes, triangle order and reordered triangles in their GPU layout, so that a cache hit maps the file and
+// uploads them as is; the same for every level of detail (indices over the shared positions and their BVH)
+// A cache file is only used if its key matches: the key hashes the source bytes, the placement of the
+// mesh, the BVH build parameters and the format version
+namespace MeshCache
+{
+    constexpr uint32_t VERSION = 3;
+
+    // Arrays stored in the file, in this order, each starting on a 16-byte boundary
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t headerSize;
+        uint64_t key;
+        uint64_t vertexCount;
+        uint64_t normalCount; // vertexCount, or 0 if the mesh has no normals
+        uint64_t triangleCount;
+        uint64_t nodeCount;
+        uint64_t bvhTriangleCount;
+        uint64_t positionOffset;
+        uint64_t normalOffset;
+        uint64_t indexOffset;
+        uint64_t nodeOffset;
+        uint64_t triangleOrderOffset;
+        uint64_t bvhTriangleOffset;
+        uint64_t lodCount;
+        uint64_t lodOffset; // lodCount LODHeader, then the arrays of every level
+    };
+
+    // Arrays of a level of detail (its BVH has one triangle per level triangle)
+    struct LODHeader
+    {
+        uint64_t triangleCount;
+        uint64_t nodeCount;
+        uint64_t indexOffset;
+        uint64_t nodeOffset;
+        uint64_t triangleOrderOffset;
+        uint64_t bvhTriangleOffset;
+    };
+
+    struct LODView
+    {
+        const uint32_t *indices = nullptr; // 3 indices into the mesh's positions per triangle
+        size_t triangleCount = 0;
+        const GPUBVHNode *nodes = nullptr;
+        size_t nodeCount = 0;
+        const uint32_t *triangleOrder = nullptr;
+        const GPUTriangle *bvhTriangles = nullptr;
+    };
+
+    // Arrays of a cache file (read from a mapping, pointers stay valid while file is alive, or to write)
+    struct View
+    {
+        std::shared_ptr<const MappedFile> file;
+        const float *positions = nullptr; // 3 floats per vertex
+        const float *normals = nullptr;   // 3 floats per vertex, or null
+        size_t vertexCount = 0;
+        const uint32_t *indices = nullptr; // 3 vertex indices per triangle
+        size_t triangleCount = 0;
+        const GPUBVHNode *nodes = nullptr;
+        size_t nodeCount = 0;
+        const uint32_t *triangleOrder = nullptr; // mesh triangle of each BVH triangle
+        const GPUTriangle *bvhTriangles = nullptr;
+        size_t bvhTriangleCount = 0;
+        std::vector<LODView> lods; // coarsest last
+    };
+
+    // 64-bit FNV-1a, seeded to chain several inputs into one key
+    uint64_t hash(const void *data, size_t size, uint64_t seed = 14695981039346656037ull);
+
+    // Cache file of a source for a key: <source>.<key in hex>.rtmesh
+    std::string pathFor(const std::string &sourcePath, uint64_t key);
+
+    // Map a cache file and check it against the key, false (silently) if there is no valid cache
+    bool open(const std::string &cachePath, uint64_t key, View &view);
+
+    // Write a cache file (through a temporary file renamed at the end, so readers never see it partially)
+    bool write(const std::string &cachePath, uint64_t key, const View &content);
+}
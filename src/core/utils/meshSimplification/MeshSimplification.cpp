@@ -0,0 +1,305 @@
+#include "MeshSimplification.h"
+#include <algorithm>
+#include <cstdint>
+#include <queue>
+#include <unordered_map>
+
+namespace meshSimplification
+{
+    // Sum of squared distances to a set of planes: v^T A v + 2 b.v + c, A symmetric
+    struct Quadric
+    {
+        double a2 = 0, ab = 0, ac = 0, ad = 0, b2 = 0, bc = 0, bd = 0, c2 = 0, cd = 0, d2 = 0;
+
+        // Plane a x + b y + c z + d = 0 (unit normal), weighted
+        static Quadric plane(double a, double b, double c, double d, double weight)
+        {
+            Quadric q;
+            q.a2 = weight * a * a;
+            q.ab = weight * a * b;
+            q.ac = weight * a * c;
+            q.ad = weight * a * d;
+            q.b2 = weight * b * b;
+            q.bc = weight * b * c;
+            q.bd = weight * b * d;
+            q.c2 = weight * c * c;
+            q.cd = weight * c * d;
+            q.d2 = weight * d * d;
+            return q;
+        }
+
+        Quadric &operator+=(const Quadric &q)
+        {
+            a2 += q.a2;
+            ab += q.ab;
+            ac += q.ac;
+            ad += q.ad;
+            b2 += q.b2;
+            bc += q.bc;
+            bd += q.bd;
+            c2 += q.c2;
+            cd += q.cd;
+            d2 += q.d2;
+            return *this;
+        }
+
+        double error(const vec3 &v) const
+        {
+            double x = v.x, y = v.y, z = v.z;
+            return a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x + b2 * y * y + 2 * bc * y * z + 2 * bd * y +
+                   c2 * z * z + 2 * cd * z + d2;
+        }
+    };
+
+    // Border edges get a plane perpendicular to their face, this much stronger than the face planes
+    static const double BORDER_WEIGHT = 10.0;
+    // A collapse may not turn a face by more than about 80 degrees
+    static const float MIN_NORMAL_COSINE = 0.2f;
+
+    struct Collapse
+    {
+        float cost;
+        unsigned int from, to;
+        unsigned int fromVersion, toVersion;
+
+        bool operator>(const Collapse &other) const { return cost > other.cost; }
+    };
+
+    static uint64_t edgeKey(unsigned int a, unsigned int b)
+    {
+        return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+    }
+
+    class Simplifier
+    {
+    public:
+        Simplifier(const std::vector<vec3> &positions, const std::vector<unsigned int> &indices)
+            : positions(positions), faces(indices), faceAlive(indices.size() / 3, 1), quadrics(positions.size()),
+              vertexFaces(positions.size()), version(positions.size(), 0), liveFaces(indices.size() / 3)
+        {
+            std::unordered_map<uint64_t, int> edgeFaces;
+            edgeFaces.reserve(faces.size());
+            for (size_t f = 0; f < faceAlive.size(); ++f)
+            {
+                const unsigned int *v = &faces[3 * f];
+                if (v[0] == v[1] || v[1] == v[2] || v[2] == v[0])
+                {
+                    faceAlive[f] = 0; // degenerate in the source
+                    liveFaces--;
+                    continue;
+                }
+                vec3 n = vec3::cross(positions[v[1]] - positions[v[0]], positions[v[2]] - positions[v[0]]);
+                float doubleArea = n.length();
+                if (doubleArea > 0.0f)
+                {
+                    n = n / doubleArea;
+                    Quadric q = Quadric::plane(n.x, n.y, n.z, -vec3::dot(n, positions[v[0]]), 0.5 * doubleArea);
+                    for (int k = 0; k < 3; ++k)
+                        quadrics[v[k]] += q;
+                }
+                for (int k = 0; k < 3; ++k)
+                {
+                    vertexFaces[v[k]].push_back(static_cast<unsigned int>(f));
+                    edgeFaces[edgeKey(v[k], v[(k + 1) % 3])]++;
+                }
+            }
+
+            // Keep open borders in place
+            for (size_t f = 0; f < faceAlive.size(); ++f)
+            {
+                if (!faceAlive[f])
+                    continue;
+                const unsigned int *v = &faces[3 * f];
+                vec3 n = vec3::cross(positions[v[1]] - positions[v[0]], positions[v[2]] - positions[v[0]]);
+                for (int k = 0; k < 3; ++k)
+                {
+                    unsigned int a = v[k], b = v[(k + 1) % 3];
+                    if (edgeFaces[edgeKey(a, b)] != 1)
+                        continue;
+                    vec3 edge = positions[b] - positions[a];
+                    vec3 p = vec3::cross(edge, n);
+                    float length = p.length();
+                    if (length <= 0.0f)
+                        continue;
+                    p = p / length;
+                    Quadric q = Quadric::plane(p.x, p.y, p.z, -vec3::dot(p, positions[a]), BORDER_WEIGHT * edge.squareLength());
+                    quadrics[a] += q;
+                    quadrics[b] += q;
+                }
+            }
+
+            for (size_t f = 0; f < faceAlive.size(); ++f)
+            {
+                if (!faceAlive[f])
+                    continue;
+                for (int k = 0; k < 3; ++k)
+                {
+                    unsigned int a = faces[3 * f + k], b = faces[3 * f + (k + 1) % 3];
+                    if (a < b || edgeFaces[edgeKey(a, b)] == 1) // interior edges are seen twice
+                        pushCollapse(a, b);
+                }
+            }
+        }
+
+        float run(size_t targetTriangles)
+        {
+            float maxError = 0.0f;
+            while (liveFaces > targetTriangles && !heap.empty())
+            {
+                Collapse collapse = heap.top();
+                heap.pop();
+                if (version[collapse.from] != collapse.fromVersion || version[collapse.to] != collapse.toVersion)
+                    continue; // one end changed since, a fresh candidate was queued then
+                if (!canCollapse(collapse.from, collapse.to))
+                    continue;
+                apply(collapse.from, collapse.to);
+                maxError = std::max(maxError, collapse.cost);
+            }
+            return maxError;
+        }
+
+        std::vector<unsigned int> result() const
+        {
+            std::vector<unsigned int> simplified;
+            simplified.reserve(3 * liveFaces);
+            for (size_t f = 0; f < faceAlive.size(); ++f)
+            {
+                if (faceAlive[f])
+                    simplified.insert(simplified.end(), faces.begin() + 3 * f, faces.begin() + 3 * f + 3);
+            }
+            return simplified;
+        }
+
+    private:
+        const std::vector<vec3> &positions;
+        std::vector<unsigned int> faces;
+        std::vector<char> faceAlive;
+        std::vector<Quadric> quadrics;
+        std::vector<std::vector<unsigned int>> vertexFaces; // may still list dead faces
+        std::vector<unsigned int> version;                // bumped whenever a vertex is merged or removed
+        size_t liveFaces;
+        std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> heap;
+        std::vector<unsigned int> scratch;
+
+        // Queue the cheaper direction of edge (a, b)
+        void pushCollapse(unsigned int a, unsigned int b)
+        {
+            Quadric q = quadrics[a];
+            q += quadrics[b];
+            double toB = q.error(positions[b]);
+            double toA = q.error(positions[a]);
+            if (toB <= toA)
+                heap.push({static_cast<float>(std::max(toB, 0.0)), a, b, version[a], version[b]});
+            else
+                heap.push({static_cast<float>(std::max(toA, 0.0)), b, a, version[b], version[a]});
+        }
+
+        bool hasVertex(unsigned int f, unsigned int vertex) const
+        {
+            return faces[3 * f] == vertex || faces[3 * f + 1] == vertex || faces[3 * f + 2] == vertex;
+        }
+
+        // Distinct vertices sharing a live face with vertex (vertex excluded), in scratch
+        void collectNeighbours(unsigned int vertex, std::vector<unsigned int> &neighbours) const
+        {
+            neighbours.clear();
+            for (unsigned int f : vertexFaces[vertex])
+            {
+                if (!faceAlive[f])
+                    continue;
+                for (int k = 0; k < 3; ++k)
+                {
+                    if (faces[3 * f + k] != vertex)
+                        neighbours.push_back(faces[3 * f + k]);
+                }
+            }
+            std::sort(neighbours.begin(), neighbours.end());
+            neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+        }
+
+        bool canCollapse(unsigned int from, unsigned int to)
+        {
+            // Link condition: the two ends may only share the vertices opposite to their common edge
+            int sharedFaces = 0;
+            for (unsigned int f : vertexFaces[from])
+            {
+                if (faceAlive[f] && hasVertex(f, to))
+                    sharedFaces++;
+            }
+            if (sharedFaces == 0)
+                return false; // the edge is gone
+            std::vector<unsigned int> toNeighbours;
+            collectNeighbours(to, toNeighbours);
+            collectNeighbours(from, scratch);
+            int shared = 0;
+            for (unsigned int vertex : scratch)
+            {
+                if (std::binary_search(toNeighbours.begin(), toNeighbours.end(), vertex))
+                    shared++;
+            }
+            if (shared > sharedFaces)
+                return false;
+
+            // Faces that stay must not flip or collapse
+            for (unsigned int f : vertexFaces[from])
+            {
+                if (!faceAlive[f] || hasVertex(f, to))
+                    continue;
+                const unsigned int *v = &faces[3 * f];
+                vec3 before = vec3::cross(positions[v[1]] - positions[v[0]], positions[v[2]] - positions[v[0]]);
+                vec3 p[3];
+                for (int k = 0; k < 3; ++k)
+                    p[k] = v[k] == from ? positions[to] : positions[v[k]];
+                vec3 after = vec3::cross(p[1] - p[0], p[2] - p[0]);
+                float lengths = before.length() * after.length();
+                if (lengths <= 0.0f || vec3::dot(before, after) < MIN_NORMAL_COSINE * lengths)
+                    return false;
+            }
+            return true;
+        }
+
+        void apply(unsigned int from, unsigned int to)
+        {
+            for (unsigned int f : vertexFaces[from])
+            {
+                if (!faceAlive[f])
+                    continue;
+                if (hasVertex(f, to))
+                {
+                    faceAlive[f] = 0;
+                    liveFaces--;
+                    continue;
+                }
+                for (int k = 0; k < 3; ++k)
+                {
+                    if (faces[3 * f + k] == from)
+                        faces[3 * f + k] = to;
+                }
+                vertexFaces[to].push_back(f);
+            }
+            std::vector<unsigned int>().swap(vertexFaces[from]);
+            quadrics[to] += quadrics[from];
+            version[from]++;
+            version[to]++;
+
+            // Drop dead faces from the merged list and queue the edges around the merged vertex
+            std::vector<unsigned int> &merged = vertexFaces[to];
+            merged.erase(std::remove_if(merged.begin(), merged.end(), [this](unsigned int f)
+                                        { return !faceAlive[f]; }),
+                         merged.end());
+            collectNeighbours(to, scratch);
+            for (unsigned int neighbour : scratch)
+                pushCollapse(to, neighbour);
+        }
+    };
+
+    std::vector<unsigned int> simplify(const std::vector<vec3> &positions, const std::vector<unsigned int> &indices,
+                                       size_t targetTriangles, float *maxError)
+    {
+        Simplifier simplifier(positions, indices);
+        float error = simplifier.run(targetTriangles);
+        if (maxError)
+            *maxError = error;
+        return simplifier.result();
+    }
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "../../math/vec3.h"
+
+// Quadric error metric (Garland-Heckbert) simplification of indexed triangle meshes, used to build mesh LODs
+// Edges are collapsed onto one of their two vertices, so a simplified mesh indexes the original positions:
+// every level of a mesh shares one vertex array (and follows its transforms)
+namespace meshSimplification
+{
+    // Collapse edges, cheapest first, until at most targetTriangles remain (or no collapse is legal anymore)
+    // Collapses that would flip a face or make the surface non-manifold are skipped; open borders are kept
+    // Returns the index buffer of the simplified mesh (3 indices per triangle); maxError receives the
+    // largest quadric error accepted (squared distance to the original planes), if given
+    std::vector<unsigned int> simplify(const std::vector<vec3> &positions, const std::vector<unsigned int> &indices,
+                                       size_t targetTriangles, float *maxError = nullptr);
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <iterator>
+#include <set>
+
+// Indices into a device array for objects that come and go: a freed index is handed out again before the
+// array grows, the lowest free one first, and the array shrinks as soon as its last indices are free
+// An index stays the same for as long as it is allocated
+class SlotAllocator
+{
+public:
+    int allocate()
+    {
+        if (freeSlots.empty())
+            return slotCount++;
+        int slot = *freeSlots.begin();
+        freeSlots.erase(freeSlots.begin());
+        return slot;
+    }
+
+    void free(int slot)
+    {
+        if (slot < 0 || slot >= slotCount)
+            return;
+        freeSlots.insert(slot);
+        while (!freeSlots.empty() && *freeSlots.rbegin() == slotCount - 1)
+        {
+            freeSlots.erase(std::prev(freeSlots.end()));
+            slotCount--;
+        }
+    }
+
+    void clear()
+    {
+        freeSlots.clear();
+        slotCount = 0;
+    }
+
+    // Size the device array needs: one past the highest allocated index
+    inline int size() const { return slotCount; }
+    inline int liveCount() const { return slotCount - static_cast<int>(freeSlots.size()); }
+
+private:
+    std::set<int> freeSlots;
+    int slotCount = 0;
+};
@@ -135,6 +135,8 @@ void MainWindow::setupLeftPanel()
             objectPropertiesPanel, &ObjectPropertiesPanel::onShapeSelectionChanged);
     connect(scenePanel, &ScenePanel::addedShape,
             objectPropertiesPanel, &ObjectPropertiesPanel::onShapeAdded);
+    connect(renderWidget, &RenderWidget::assetLoadingProgress,
+            scenePanel, &ScenePanel::onAssetLoadingProgress);
 
     // FPS Chart Panel
     FPSChart *fpsChart = new FPSChart();
@@ -176,6 +178,12 @@ void MainWindow::setupRightPanel()
     rightLayout->addWidget(paramsPanel);
 
     connect(parametersPanel, &ParametersPanel::screenshotButtonClicked, this, &MainWindow::onScreenshotButtonClicked);
+    connect(parametersPanel, &ParametersPanel::raySortingToggled, this, &MainWindow::onRaySortingToggled);
+    connect(parametersPanel, &ParametersPanel::textureCompressionToggled, this, &MainWindow::onTextureCompressionToggled);
+    connect(parametersPanel, &ParametersPanel::meshVertexFormatChanged, this, &MainWindow::onMeshVertexFormatChanged);
+    connect(parametersPanel, &ParametersPanel::deviceMeshBVHToggled, this, &MainWindow::onDeviceMeshBVHToggled);
+    connect(parametersPanel, &ParametersPanel::spatialMeshBVHToggled, this, &MainWindow::onSpatialMeshBVHToggled);
+    connect(parametersPanel, &ParametersPanel::textureBudgetChanged, this, &MainWindow::onTextureBudgetChanged);
 }
 
 void MainWindow::updateOverlayPositions()
@@ -456,6 +464,36 @@ void MainWindow::onScreenshotButtonClicked()
     renderWidget->captureScreenshot();
 }
 
+void MainWindow::onRaySortingToggled(bool enabled)
+{
+    renderWidget->setRaySorting(enabled);
+}
+
+void MainWindow::onTextureCompressionToggled(bool enabled)
+{
+    renderWidget->setTextureCompression(enabled);
+}
+
+void MainWindow::onMeshVertexFormatChanged(int format)
+{
+    renderWidget->setMeshVertexFormat(static_cast<VertexFormat>(format));
+}
+
+void MainWindow::onDeviceMeshBVHToggled(bool enabled)
+{
+    renderWidget->setDeviceMeshBVH(enabled);
+}
+
+void MainWindow::onSpatialMeshBVHToggled(bool enabled)
+{
+    renderWidget->setMeshBVHQuality(enabled ? QUALITY_SPATIAL : QUALITY_HIGH);
+}
+
+void MainWindow::onTextureBudgetChanged(int megabytes)
+{
+    renderWidget->setTextureBudget(static_cast<size_t>(megabytes) * 1024 * 1024);
+}
+
 void MainWindow::toggleFPSMode()
 {
     Camera::getInstance().onToggleActivate();
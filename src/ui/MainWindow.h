@@ -41,6 +41,12 @@ private slots:
     void onResetCamera();
     void ApplyUniformScaling();
     void onScreenshotButtonClicked();
+    void onRaySortingToggled(bool enabled);
+    void onTextureCompressionToggled(bool enabled);
+    void onMeshVertexFormatChanged(int format);
+    void onDeviceMeshBVHToggled(bool enabled);
+    void onSpatialMeshBVHToggled(bool enabled);
+    void onTextureBudgetChanged(int megabytes);
     void toggleFPSMode();
 
 private:
@@ -1,6 +1,7 @@
 #include "RenderWidget.h"
 #include "../core/commands/CommandsManager.h"
 #include "../core/camera/Camera.h"
+#include "../core/systems/AssetLoader/AssetLoader.h"
 #include <QTimer>
 #include <QDebug>
 #include <QKeyEvent>
@@ -215,6 +216,18 @@ void RenderWidget::scheduleNextFrame()
         deltaTime = elapsedTimer.elapsed() / 1000.0f;
         elapsedTimer.restart();
 
+        // Hand the meshes and textures finished by the loader threads to the scene
+        AssetLoader &assetLoader = AssetLoader::getInstance();
+        assetLoader.poll();
+        int assetBatch = assetLoader.getBatchSize();
+        int assetsLoaded = assetBatch - assetLoader.getPendingCount();
+        if (assetBatch != reportedAssetBatch || assetsLoaded != reportedAssetsLoaded)
+        {
+            reportedAssetBatch = assetBatch;
+            reportedAssetsLoaded = assetsLoaded;
+            emit assetLoadingProgress(assetsLoaded, assetBatch);
+        }
+
         // Update camera with delta time
         Camera &camera = Camera::getInstance();
         camera.update(deltaTime);
@@ -426,4 +439,52 @@ void RenderWidget::captureScreenshot()
     std::string dateTimeStr = QDateTime::currentDateTime().toString("dd_MM_yyyy_HH_mm_ss").toStdString();
 
     screenshot.save(QString("../screenshots/screenshot_" + QString::fromStdString(dateTimeStr) + ".png"));
-}
\ No newline at end of file
+}
+
+void RenderWidget::setRaySorting(bool enabled)
+{
+    if (renderEngine)
+    {
+        renderEngine->setRaySorting(enabled);
+    }
+}
+
+void RenderWidget::setTextureCompression(bool enabled)
+{
+    if (renderEngine)
+    {
+        renderEngine->setTextureCompression(enabled);
+    }
+}
+
+void RenderWidget::setMeshVertexFormat(VertexFormat format)
+{
+    if (renderEngine)
+    {
+        renderEngine->setMeshVertexFormat(format);
+    }
+}
+
+void RenderWidget::setDeviceMeshBVH(bool enabled)
+{
+    if (renderEngine)
+    {
+        renderEngine->setDeviceMeshBVH(enabled);
+    }
+}
+
+void RenderWidget::setMeshBVHQuality(int quality)
+{
+    if (renderEngine)
+    {
+        renderEngine->setMeshBVHQuality(quality);
+    }
+}
+
+void RenderWidget::setTextureBudget(size_t bytes)
+{
+    if (renderEngine)
+    {
+        renderEngine->setTextureBudget(bytes);
+    }
+}
@@ -17,9 +17,17 @@ public:
     explicit RenderWidget(QWidget *parent = nullptr);
     ~RenderWidget();
     void captureScreenshot();
+    void setRaySorting(bool enabled);
+    void setTextureCompression(bool enabled);
+    void setMeshVertexFormat(VertexFormat format);
+    void setDeviceMeshBVH(bool enabled);
+    void setMeshBVHQuality(int quality);
+    void setTextureBudget(size_t bytes);
 
 signals:
     void fpsUpdated(int fps);
+    // Assets of the current loading batch handed to the scene so far, (0, 0) once everything is loaded
+    void assetLoadingProgress(int loaded, int total);
 
 protected:
     void initializeGL() override;
@@ -52,6 +60,8 @@ private:
     int height;
 
     int frameCount;
+    int reportedAssetBatch = 0;
+    int reportedAssetsLoaded = 0;
     bool isRendering;
     bool glInitialized;
     bool textureInitialized; // Track if texture has been allocated once
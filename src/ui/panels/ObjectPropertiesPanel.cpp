@@ -20,6 +20,7 @@
 #include "../../core/commands/actionsCommands/materials/MaterialEmissiveCommand.h"
 #include "../../core/commands/actionsCommands/materials/MaterialDiffuseColorCommand.h"
 #include "../../core/systems/SceneManager/SceneManager.h"
+#include "../../core/systems/AssetLoader/AssetLoader.h"
 #include "./CustomDoubleSpinBox.h"
 
 ObjectPropertiesPanel::ObjectPropertiesPanel(QWidget *parent) : QWidget(parent), currentSelectedShapeID(SceneManager::getInstance().getShapes().front()->getID()), commandManager(CommandsManager::getInstance())
@@ -153,18 +154,8 @@ void ObjectPropertiesPanel::setupUI()
             {
         QString fileName = QFileDialog::getOpenFileName(nullptr, "Load Texture", "", "Image Files (*.ppm)");
         if (!fileName.isEmpty()) {
-            QPixmap pixmap(fileName);
-            if (!pixmap.isNull()) {
-                // Scale to fit the preview area while maintaining aspect ratio
-                QPixmap scaledPixmap = pixmap.scaled(texturePreview->width() - 2, texturePreview->height() - 2, Qt::KeepAspectRatio, Qt::SmoothTransformation);
-                texturePreview->setPixmap(scaledPixmap);
-                QFileInfo fileInfo(fileName);
-                textureNameLabel->setText(fileInfo.baseName());
-
-                ppmLoader::ImageRGB image;
-                ppmLoader::load_ppm(image, fileName.toStdString());
-                commandManager.executeCommand(new SetTextureShape(SceneManager::getInstance().getShapeByID(currentSelectedShapeID), image, fileName.toStdString()));
-            }
+            loadMapInBackground(fileName, texturePreview, textureNameLabel, [this](Shape *shape, const LazyImage &map)
+                                { commandManager.executeCommand(new SetTextureShape(shape, map, map.getPath())); });
         } });
 
     connect(clearTextureBtn, &QPushButton::clicked, [this, texturePreview, textureNameLabel, checkerboard]()
@@ -238,18 +229,8 @@ void ObjectPropertiesPanel::setupUI()
             fileName = dialog.selectedFiles().first();
         }
         if (!fileName.isEmpty()) {
-            QPixmap pixmap(fileName);
-            if (!pixmap.isNull()) {
-                // Scale to fit the preview area while maintaining aspect ratio
-                QPixmap scaledPixmap = pixmap.scaled(normalPreview->width() - 2, normalPreview->height() - 2, Qt::KeepAspectRatio, Qt::SmoothTransformation);
-                normalPreview->setPixmap(scaledPixmap);
-                QFileInfo fileInfo(fileName);
-                normalNameLabel->setText(fileInfo.baseName());
-
-                ppmLoader::ImageRGB image;
-                ppmLoader::load_ppm(image, fileName.toStdString());
-                commandManager.executeCommand(new SetNormalShape(SceneManager::getInstance().getShapeByID(currentSelectedShapeID), image, fileName.toStdString()));
-            }
+            loadMapInBackground(fileName, normalPreview, normalNameLabel, [this](Shape *shape, const LazyImage &map)
+                                { commandManager.executeCommand(new SetNormalShape(shape, map, map.getPath())); });
         } });
 
     connect(clearNormalBtn, &QPushButton::clicked, [this, normalPreview, normalNameLabel, flatnormal]()
@@ -331,18 +312,8 @@ void ObjectPropertiesPanel::setupUI()
             {
         QString fileName = QFileDialog::getOpenFileName(nullptr, "Load Texture", "", "Image Files (*.ppm)");
         if (!fileName.isEmpty()) {
-            QPixmap pixmap(fileName);
-            if (!pixmap.isNull()) {
-                // Scale to fit the preview area while maintaining aspect ratio
-                QPixmap scaledPixmap = pixmap.scaled(metalPreview->width() - 2, metalPreview->height() - 2, Qt::KeepAspectRatio, Qt::SmoothTransformation);
-                metalPreview->setPixmap(scaledPixmap);
-                QFileInfo fileInfo(fileName);
-                metalNameLabel->setText(fileInfo.baseName());
-
-                ppmLoader::ImageRGB image;
-                ppmLoader::load_ppm(image, fileName.toStdString());
-                commandManager.executeCommand(new SetMetallicShape(SceneManager::getInstance().getShapeByID(currentSelectedShapeID), image, fileName.toStdString()));
-            }
+            loadMapInBackground(fileName, metalPreview, metalNameLabel, [this](Shape *shape, const LazyImage &map)
+                                { commandManager.executeCommand(new SetMetallicShape(shape, map, map.getPath())); });
         } });
 
     connect(clearMetalBtn, &QPushButton::clicked, [this, metalPreview, metalNameLabel, blackimage]()
@@ -416,19 +387,8 @@ void ObjectPropertiesPanel::setupUI()
             {
         QString fileName = QFileDialog::getOpenFileName(nullptr, "Load Texture", "", "Image Files (*.ppm)");
         if (!fileName.isEmpty()) {
-            QPixmap pixmap(fileName);
-            if (!pixmap.isNull()) {
-                // Scale to fit the preview area while maintaining aspect ratio
-                QPixmap scaledPixmap = pixmap.scaled(emissivePreview->width() - 2, emissivePreview->height() - 2, Qt::KeepAspectRatio, Qt::SmoothTransformation);
-                emissivePreview->setPixmap(scaledPixmap);
-                QFileInfo fileInfo(fileName);
-                emissiveNameLabel->setText(fileInfo.baseName());
-
-                ppmLoader::ImageRGB image;
-                ppmLoader::load_ppm(image, fileName.toStdString());
-               // commandManager.executeCommand(new SetTextureShape(SceneManager::getInstance().getShapeByID(currentSelectedShapeID), image));
-                // TODO CREATE EMISSIVE MAP COMMANDS
-            }
+            // TODO CREATE EMISSIVE MAP COMMANDS (only previewed for now)
+            loadMapInBackground(fileName, emissivePreview, emissiveNameLabel, nullptr);
         } });
 
     connect(clearEmissiveBtn, &QPushButton::clicked, [this, emissivePreview, emissiveNameLabel, blackimage]()
@@ -472,6 +432,34 @@ void ObjectPropertiesPanel::setupUI()
     refractionIndexLayout->addStretch();
     layout->addLayout(refractionIndexLayout);
 
+    // BVH report of meshes, with the optimizer for meshes traced far more than they are edited
+    bvhFrame = new QFrame();
+    QVBoxLayout *bvhLayout = new QVBoxLayout(bvhFrame);
+    bvhLayout->setContentsMargins(0, 0, 0, 0);
+    QHBoxLayout *bvhHeaderLayout = new QHBoxLayout();
+    bvhHeaderLayout->addWidget(new QLabel("MESH BVH"));
+    optimizeBVHBtn = new QPushButton("Optimize");
+    optimizeBVHBtn->setMaximumWidth(70);
+    optimizeBVHBtn->setStyleSheet("QPushButton { background-color: #444; color: white; border: 1px solid #666; padding: 2px; }");
+    bvhHeaderLayout->addWidget(optimizeBVHBtn);
+    bvhHeaderLayout->addStretch();
+    bvhLayout->addLayout(bvhHeaderLayout);
+    bvhReportLabel = new QLabel();
+    bvhReportLabel->setWordWrap(true);
+    bvhReportLabel->setStyleSheet("QLabel { color: #ccc; font-size: 10px; }");
+    bvhLayout->addWidget(bvhReportLabel);
+    layout->addWidget(bvhFrame);
+    bvhFrame->hide();
+
+    connect(optimizeBVHBtn, &QPushButton::clicked, [this]()
+            {
+        Shape *shape = SceneManager::getInstance().getShapeByID(currentSelectedShapeID);
+        if (shape && shape->getType() == ShapeType::MESH) {
+            static_cast<Mesh *>(shape)->optimizeBVH();
+            CommandsManager::getInstance().notifyShapesChanged(); // new topologies to upload
+            updateBVHReport(shape);
+        } });
+
     // Only style the text color, inherit background from parent
     setStyleSheet("QLabel { color: white; }");
 
@@ -604,6 +592,20 @@ void ObjectPropertiesPanel::onShapeSelectionChanged(int shapeID)
 
     // Update texture
     onTextureSelectionChanged(mat);
+    updateBVHReport(shape);
+}
+
+void ObjectPropertiesPanel::updateBVHReport(Shape *shape)
+{
+    Mesh *mesh = shape && shape->getType() == ShapeType::MESH ? static_cast<Mesh *>(shape) : nullptr;
+    if (!mesh || mesh->empty())
+    {
+        bvhFrame->hide();
+        return;
+    }
+    bvhReportLabel->setText(QString::fromStdString(mesh->getBVH().report().toString()));
+    optimizeBVHBtn->setEnabled(!mesh->isBVHOptimized());
+    bvhFrame->show();
 }
 
 void defaultTexturePreview(QFrame *frame)
@@ -630,11 +632,43 @@ void defaultBlackPreview(QFrame *frame)
     frame->findChild<QLabel *>()->setPixmap(blackimage);
 }
 
+// Decode a map on a loader thread, then preview it and hand it to apply (if any) for the shape selected
+// when the file was chosen; the map holds the decoded pixels until they are uploaded
+void ObjectPropertiesPanel::loadMapInBackground(const QString &fileName, QLabel *preview, QLabel *nameLabel, MapApplier apply)
+{
+    std::string path = fileName.toStdString();
+    int shapeID = currentSelectedShapeID;
+    AssetLoader::getInstance().load<ImageHandle>(
+        path,
+        [path]()
+        { return TextureCache::getInstance().load(path); },
+        [this, fileName, path, shapeID, preview, nameLabel, apply](ImageHandle pixels)
+        {
+            if (!pixels)
+                return;
+            if (shapeID == currentSelectedShapeID)
+            {
+                QImage image(reinterpret_cast<const uchar *>(pixels->data.data()), pixels->w, pixels->h, pixels->w * 3, QImage::Format_RGB888);
+                preview->setPixmap(QPixmap::fromImage(image).scaled(preview->width() - 2, preview->height() - 2, Qt::KeepAspectRatio, Qt::SmoothTransformation));
+                nameLabel->setText(QFileInfo(fileName).baseName());
+            }
+
+            Shape *shape = SceneManager::getInstance().getShapeByID(shapeID);
+            LazyImage map;
+            if (apply && shape && map.setPath(path))
+            {
+                map.get(); // picks up the pixels decoded above from the TextureCache
+                apply(shape, map);
+            }
+        });
+}
+
 void ObjectPropertiesPanel::onTextureSelectionChanged(const Material *material)
 {
     if (material != nullptr)
     {
-        QImage image(reinterpret_cast<const uchar *>(material->getImage().data.data()), material->getImage().w, material->getImage().h, QImage::Format_RGB888);
+        ImageHandle albedo = material->getImageMap().getHandle(); // shares the material's pixels
+        QImage image = albedo ? QImage(reinterpret_cast<const uchar *>(albedo->data.data()), albedo->w, albedo->h, albedo->w * 3, QImage::Format_RGB888) : QImage();
         if (!image.isNull())
         {
             QPixmap pixmap = QPixmap::fromImage(image);
@@ -645,7 +679,8 @@ void ObjectPropertiesPanel::onTextureSelectionChanged(const Material *material)
             defaultTexturePreview(texturePreviewFrame);
         }
 
-        QImage normalimage(reinterpret_cast<const uchar *>(material->getNormals().data.data()), material->getNormals().w, material->getNormals().h, QImage::Format_RGB888);
+        ImageHandle normals = material->getNormalsMap().getHandle();
+        QImage normalimage = normals ? QImage(reinterpret_cast<const uchar *>(normals->data.data()), normals->w, normals->h, normals->w * 3, QImage::Format_RGB888) : QImage();
         if (!normalimage.isNull())
         {
             QPixmap pixmap = QPixmap::fromImage(normalimage);
@@ -656,7 +691,8 @@ void ObjectPropertiesPanel::onTextureSelectionChanged(const Material *material)
             defaultNormalPreview(normalPreviewFrame);
         }
 
-        QImage metallicImage(reinterpret_cast<const uchar *>(material->getMetallic().data.data()), material->getMetallic().w, material->getMetallic().h, QImage::Format_RGB888);
+        ImageHandle metallic = material->getMetallicMap().getHandle();
+        QImage metallicImage = metallic ? QImage(reinterpret_cast<const uchar *>(metallic->data.data()), metallic->w, metallic->h, metallic->w * 3, QImage::Format_RGB888) : QImage();
         if (!metallicImage.isNull())
         {
             QPixmap pixmap = QPixmap::fromImage(metallicImage);
@@ -667,7 +703,8 @@ void ObjectPropertiesPanel::onTextureSelectionChanged(const Material *material)
             defaultBlackPreview(metalPreviewFrame);
         }
 
-        QImage emissiveImage(reinterpret_cast<const uchar *>(material->getEmissive().data.data()), material->getEmissive().w, material->getEmissive().h, QImage::Format_RGB888);
+        ImageHandle emissive = material->getEmissiveMap().getHandle();
+        QImage emissiveImage = emissive ? QImage(reinterpret_cast<const uchar *>(emissive->data.data()), emissive->w, emissive->h, emissive->w * 3, QImage::Format_RGB888) : QImage();
         if (!emissiveImage.isNull())
         {
             QPixmap pixmap = QPixmap::fromImage(emissiveImage);
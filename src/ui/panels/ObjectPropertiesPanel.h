@@ -10,8 +10,10 @@
 #include <QMap>
 #include <QLabel>
 #include <QLineEdit>
+#include <functional>
 
 class RenderWidget;
+class Shape;
 
 class ObjectPropertiesPanel : public QWidget
 {
@@ -37,6 +39,11 @@ private:
     CommandsManager &commandManager;
 
     void onTextureSelectionChanged(const Material *material);
+    // Quality report of the selected mesh's BVH, hidden for other shapes
+    void updateBVHReport(Shape *shape);
+
+    using MapApplier = std::function<void(Shape *, const LazyImage &)>;
+    void loadMapInBackground(const QString &fileName, QLabel *preview, QLabel *nameLabel, MapApplier apply);
 
     QFrame *texturePreviewFrame;
     QPushButton *loadTextureBtn;
@@ -66,6 +73,10 @@ private:
     QSpinBox *emissiveSpinBox;
     QDoubleSpinBox *refractionIndexSpinBox;
 
+    QFrame *bvhFrame;
+    QLabel *bvhReportLabel;
+    QPushButton *optimizeBVHBtn;
+
     QMap<int, bool> keysPressed;
     bool isShortcutPressed() const;
 };
@@ -10,6 +10,7 @@
 #include "../../core/commands/CommandsManager.h"
 #include "../../core/commands/actionsCommands/camera/CameraNbBouncesCommand.h"
 #include "../../core/commands/actionsCommands/camera/CameraRPPCommand.h"
+#include "../../core/systems/RenderEngine/TextureResidency.h"
 
 ParametersPanel::ParametersPanel(QWidget *parent) : QWidget(parent)
 {
@@ -60,6 +61,76 @@ void ParametersPanel::setupUI()
     denoisingLayout->addStretch();
     layout->addLayout(denoisingLayout);
 
+    // Ray sorting (reorder secondary rays between bounces)
+    QHBoxLayout *raySortingLayout = new QHBoxLayout();
+    QLabel *raySortingLabel = new QLabel("RAY SORTING");
+    raySortingLabel->setStyleSheet("QLabel { font-size: 9px; }");
+    raySortingCheck = new QCheckBox();
+    raySortingCheck->setChecked(false);
+    raySortingLayout->addWidget(raySortingLabel);
+    raySortingLayout->addWidget(raySortingCheck);
+    raySortingLayout->addStretch();
+    layout->addLayout(raySortingLayout);
+
+    // Texture compression (BC blocks decoded in the kernel)
+    QHBoxLayout *textureCompressionLayout = new QHBoxLayout();
+    QLabel *textureCompressionLabel = new QLabel("COMPRESS TEXTURES");
+    textureCompressionLabel->setStyleSheet("QLabel { font-size: 9px; }");
+    textureCompressionCheck = new QCheckBox();
+    textureCompressionCheck->setChecked(false);
+    textureCompressionLayout->addWidget(textureCompressionLabel);
+    textureCompressionLayout->addWidget(textureCompressionCheck);
+    textureCompressionLayout->addStretch();
+    layout->addLayout(textureCompressionLayout);
+
+    // Device memory for textures (least recently bound ones fall back to a low-res mip beyond it)
+    QHBoxLayout *textureBudgetLayout = new QHBoxLayout();
+    QLabel *textureBudgetLabel = new QLabel("TEXTURE BUDGET (MB)");
+    textureBudgetLabel->setStyleSheet("QLabel { font-size: 9px; }");
+    textureBudgetSpin = new QSpinBox();
+    textureBudgetSpin->setRange(16, 16384);
+    textureBudgetSpin->setSingleStep(64);
+    textureBudgetSpin->setValue(static_cast<int>(TextureResidency::DEFAULT_BUDGET / (1024 * 1024)));
+    textureBudgetSpin->setMaximumWidth(60);
+    textureBudgetLayout->addWidget(textureBudgetLabel);
+    textureBudgetLayout->addWidget(textureBudgetSpin);
+    layout->addLayout(textureBudgetLayout);
+
+    // Device layout of mesh geometry (item index = VertexFormat)
+    QHBoxLayout *meshGeometryLayout = new QHBoxLayout();
+    QLabel *meshGeometryLabel = new QLabel("MESH GEOMETRY");
+    meshGeometryLabel->setStyleSheet("QLabel { font-size: 9px; }");
+    meshGeometryOptions = new QComboBox();
+    meshGeometryOptions->addItem("Triangles");
+    meshGeometryOptions->addItem("Indexed");
+    meshGeometryOptions->addItem("Indexed 16-bit");
+    meshGeometryLayout->addWidget(meshGeometryLabel);
+    meshGeometryLayout->addWidget(meshGeometryOptions);
+    meshGeometryLayout->addStretch();
+    layout->addLayout(meshGeometryLayout);
+
+    // Mesh BVHs built on the device from the uploaded geometry (for meshes edited often)
+    QHBoxLayout *deviceMeshBVHLayout = new QHBoxLayout();
+    QLabel *deviceMeshBVHLabel = new QLabel("GPU MESH BVH");
+    deviceMeshBVHLabel->setStyleSheet("QLabel { font-size: 9px; }");
+    deviceMeshBVHCheck = new QCheckBox();
+    deviceMeshBVHCheck->setChecked(false);
+    deviceMeshBVHLayout->addWidget(deviceMeshBVHLabel);
+    deviceMeshBVHLayout->addWidget(deviceMeshBVHCheck);
+    deviceMeshBVHLayout->addStretch();
+    layout->addLayout(deviceMeshBVHLayout);
+
+    // Spatial split mesh BVHs (SBVH): faster to trace on meshes with long or skewed triangles, slower to build
+    QHBoxLayout *spatialMeshBVHLayout = new QHBoxLayout();
+    QLabel *spatialMeshBVHLabel = new QLabel("SPATIAL SPLIT BVH");
+    spatialMeshBVHLabel->setStyleSheet("QLabel { font-size: 9px; }");
+    spatialMeshBVHCheck = new QCheckBox();
+    spatialMeshBVHCheck->setChecked(false);
+    spatialMeshBVHLayout->addWidget(spatialMeshBVHLabel);
+    spatialMeshBVHLayout->addWidget(spatialMeshBVHCheck);
+    spatialMeshBVHLayout->addStretch();
+    layout->addLayout(spatialMeshBVHLayout);
+
     QComboBox *bufferOptions = new QComboBox();
     bufferOptions->addItem("Final Image");
     bufferOptions->addItem("Albedo");
@@ -79,6 +150,24 @@ void ParametersPanel::setupUI()
     connect(denoiseCheck, &QCheckBox::stateChanged, [&camera](int state)
             { camera.setDenoise(state == Qt::Checked); });
 
+    connect(raySortingCheck, &QCheckBox::stateChanged, [this](int state)
+            { emit raySortingToggled(state == Qt::Checked); });
+
+    connect(textureCompressionCheck, &QCheckBox::stateChanged, [this](int state)
+            { emit textureCompressionToggled(state == Qt::Checked); });
+
+    connect(textureBudgetSpin, QOverload<int>::of(&QSpinBox::valueChanged), [this](int megabytes)
+            { emit textureBudgetChanged(megabytes); });
+
+    connect(meshGeometryOptions, QOverload<int>::of(&QComboBox::currentIndexChanged), [this](int index)
+            { emit meshVertexFormatChanged(index); });
+
+    connect(deviceMeshBVHCheck, &QCheckBox::stateChanged, [this](int state)
+            { emit deviceMeshBVHToggled(state == Qt::Checked); });
+
+    connect(spatialMeshBVHCheck, &QCheckBox::stateChanged, [this](int state)
+            { emit spatialMeshBVHToggled(state == Qt::Checked); });
+
     connect(bufferOptions, QOverload<int>::of(&QComboBox::currentIndexChanged), [&camera](int index)
             { camera.setBufferType(index); });
 
@@ -4,6 +4,7 @@
 
 class QSpinBox;
 class QCheckBox;
+class QComboBox;
 
 class ParametersPanel : public QWidget
 {
@@ -14,6 +15,12 @@ public:
 
 signals:
     void screenshotButtonClicked();
+    void raySortingToggled(bool enabled);
+    void textureCompressionToggled(bool enabled);
+    void textureBudgetChanged(int megabytes);
+    void meshVertexFormatChanged(int format);
+    void deviceMeshBVHToggled(bool enabled);
+    void spatialMeshBVHToggled(bool enabled);
 
 private slots:
     void onCameraNBouncesChanged(int bounces);
@@ -25,4 +32,10 @@ private:
     QSpinBox *raysSpin;
     QSpinBox *reboundsSpin;
     QCheckBox *denoiseCheck;
+    QCheckBox *raySortingCheck;
+    QCheckBox *textureCompressionCheck;
+    QSpinBox *textureBudgetSpin;
+    QComboBox *meshGeometryOptions;
+    QCheckBox *deviceMeshBVHCheck;
+    QCheckBox *spatialMeshBVHCheck;
 };
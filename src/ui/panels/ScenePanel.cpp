@@ -3,11 +3,13 @@
 #include "../../core/commands/actionsCommands/shapes/AddShapeCommand.h"
 #include "../../core/systems/SceneManager/SceneManager.h"
 #include "../../core/shapes/Mesh.h"
+#include "../../core/systems/AssetLoader/AssetLoader.h"
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QFrame>
 #include <QLabel>
 #include <QFileDialog>
+#include <QProgressBar>
 
 ScenePanel::ScenePanel(QWidget *parent) 
     : QWidget(parent)
@@ -98,6 +100,28 @@ void ScenePanel::setupUI()
 
     mainLayout->addWidget(addShapesFrame);
 
+    // Background loading progress, only shown while assets are loading
+    loadingBar = new QProgressBar(this);
+    loadingBar->setTextVisible(true);
+    loadingBar->setFormat("Loading assets %v / %m");
+    loadingBar->setMaximumHeight(16);
+    loadingBar->setStyleSheet(
+        "QProgressBar {"
+        "    background-color: rgba(40, 40, 40, 180);"
+        "    color: white;"
+        "    border: 1px solid rgba(80, 80, 80, 200);"
+        "    border-radius: 4px;"
+        "    font-size: 10px;"
+        "    text-align: center;"
+        "}"
+        "QProgressBar::chunk {"
+        "    background-color: rgba(0, 120, 215, 180);"
+        "    border-radius: 4px;"
+        "}"
+    );
+    loadingBar->hide();
+    mainLayout->addWidget(loadingBar);
+
     // Connect signals
     connect(addSphereBtn, &QPushButton::clicked, this, &ScenePanel::onAddSphere);
     connect(addSquareBtn, &QPushButton::clicked, this, &ScenePanel::onAddSquare);
@@ -152,13 +176,39 @@ void ScenePanel::onAddMesh()
         filePath = dialog.selectedFiles().first();
 
         if (!filePath.isEmpty()) {
-            commandManager.executeCommand(
-                new AddShapeCommand(new Mesh(filePath.toStdString()))
-            );
-            emit addedShape();
-            sceneTreeWidget->setSelected(
-                SceneManager::getInstance().getShapes().back()->getID()
+            // Parse the file and build the BVH on a loader thread, add the mesh once it is ready
+            std::string meshPath = filePath.toStdString();
+            int quality = Mesh::getDefaultBVHQuality();
+            AssetLoader::getInstance().load<Mesh *>(
+                meshPath,
+                [meshPath, quality]() {
+                    Mesh *mesh = new Mesh(meshPath, quality);
+                    if (mesh->empty()) {
+                        delete mesh;
+                        return static_cast<Mesh *>(nullptr);
+                    }
+                    return mesh;
+                },
+                [this](Mesh *mesh) {
+                    if (!mesh)
+                        return;
+                    commandManager.executeCommand(new AddShapeCommand(mesh));
+                    emit addedShape();
+                    sceneTreeWidget->setSelected(mesh->getID());
+                }
             );
         }
     }
+}
+
+void ScenePanel::onAssetLoadingProgress(int loaded, int total)
+{
+    if (total == 0)
+    {
+        loadingBar->hide();
+        return;
+    }
+    loadingBar->setRange(0, total);
+    loadingBar->setValue(loaded);
+    loadingBar->show();
 }
\ No newline at end of file
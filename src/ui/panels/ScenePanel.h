@@ -6,6 +6,7 @@
 
 // Forward declaration
 class SceneTreeWidget;
+class QProgressBar;
 
 class ScenePanel : public QWidget
 {
@@ -25,11 +26,16 @@ private:
     QPushButton *addTriangleBtn;
     QPushButton *addMeshBtn;
 
+    QProgressBar *loadingBar;
+
 public:
     explicit ScenePanel(QWidget *parent = nullptr);
     void setupUI();
     SceneTreeWidget* getSceneTreeWidget() const { return sceneTreeWidget; }
 
+public slots:
+    void onAssetLoadingProgress(int loaded, int total);
+
 private slots:
     void onAddSphere();
     void onAddSquare();
@@ -0,0 +1,73 @@
+// Material reload: a scene loaded after another one puts its textured material in the same slot with the same
+// maps version; the renderer must still see new maps there and upload the textures again
+#include <iostream>
+#include <vector>
+#include "../src/core/systems/SceneManager/SceneManager.h"
+#include "../src/core/systems/RenderEngine/UploadedMaterial.h"
+
+static int failures = 0;
+
+static void check(bool condition, const std::string &what)
+{
+    if (!condition)
+    {
+        std::cerr << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+// What RenderEngine::setupMaterialBuffer records for each slot
+static std::vector<UploadedMaterial> uploadedSlots(const SceneManager &sceneManager)
+{
+    std::vector<UploadedMaterial> slots(sceneManager.getMaterialSlotCount());
+    for (const Material *material : sceneManager.getMaterials())
+        slots[material->getGPUIndex()] = UploadedMaterial(*material, material->hasTexture());
+    return slots;
+}
+
+// Default scene plus one sphere with a texture set once from memory
+static Material *loadTexturedScene(SceneManager &sceneManager, unsigned char value)
+{
+    sceneManager.defaultScene();
+    Material *material = new Material();
+    material->set_texture(ppmLoader::ImageRGB{1, 1, {{value, value, value}}});
+    sceneManager.addShape(new Sphere(0.1f, vec3(0.0f, 0.0f, 0.0f), "Textured", material));
+    return material;
+}
+
+int main()
+{
+    SceneManager &sceneManager = SceneManager::getInstance();
+
+    Material *first = loadTexturedScene(sceneManager, 10);
+    int firstSlot = first->getGPUIndex();
+    uint32_t firstMapsVersion = first->getMapsVersion();
+    uint64_t firstSerial = first->getSerial();
+    int firstGeneration = sceneManager.getSceneGeneration();
+    std::vector<UploadedMaterial> before = uploadedSlots(sceneManager);
+    check(!UploadedMaterial::mapsChanged(before, uploadedSlots(sceneManager)), "same scene, same maps");
+
+    Material *second = loadTexturedScene(sceneManager, 20);
+    check(second->getGPUIndex() == firstSlot, "reloaded material takes the same slot");
+    check(second->getMapsVersion() == firstMapsVersion, "reloaded material has the same maps version");
+    check(second->getSerial() != firstSerial, "reloaded material has a new serial");
+    check(sceneManager.getSceneGeneration() != firstGeneration, "reload starts a new scene generation");
+
+    std::vector<UploadedMaterial> after = uploadedSlots(sceneManager);
+    check(!before[firstSlot].holds(*second), "slot does not hold the reloaded material yet");
+    check(UploadedMaterial::mapsChanged(before, after), "textures uploaded again after the reload");
+
+    // Editing a map of a material already uploaded is a change too, any other edit is not
+    second->setDiffuse(vec3(1.0f, 0.0f, 0.0f));
+    check(!UploadedMaterial::mapsChanged(after, uploadedSlots(sceneManager)), "color edit keeps the textures");
+    second->remove_texture();
+    check(UploadedMaterial::mapsChanged(after, uploadedSlots(sceneManager)), "removed map uploads the textures again");
+
+    if (failures > 0)
+    {
+        std::cerr << failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "material reload: all checks passed" << std::endl;
+    return 0;
+}
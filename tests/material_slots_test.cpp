@@ -0,0 +1,86 @@
+// Material slots: materials are stored at their GPU index, which differs from their persistent ID (read from
+// scene files or counted globally); every shape must still find its material with the kernel's lookup
+#include <iostream>
+#include <vector>
+#include "../src/core/systems/SceneManager/SceneManager.h"
+
+// get_material_by_index of kernels/rayTrace.cl
+static const GPUMaterial *materialByIndex(int materialIndex, const std::vector<GPUMaterial> &materials)
+{
+    if (materialIndex < 0 || materialIndex >= static_cast<int>(materials.size()))
+        return nullptr;
+    return materials[materialIndex].material_id == materialIndex ? &materials[materialIndex] : nullptr;
+}
+
+static int failures = 0;
+
+static void check(bool condition, const std::string &what)
+{
+    if (!condition)
+    {
+        std::cerr << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+// The material array as RenderEngine::setupMaterialBuffer lays it out
+static std::vector<GPUMaterial> materialArray(const SceneManager &sceneManager)
+{
+    std::vector<GPUMaterial> materials(sceneManager.getMaterialSlotCount());
+    for (GPUMaterial &material : materials)
+        material.material_id = -1;
+    for (const Material *material : sceneManager.getMaterials())
+        materials[material->getGPUIndex()] = material->toGPU();
+    return materials;
+}
+
+int main()
+{
+    SceneManager &sceneManager = SceneManager::getInstance();
+
+    // IDs far from the slots: one read from a scene file, others after default materials used up IDs
+    for (int i = 0; i < 8; ++i)
+        delete new Material();
+    std::vector<Shape *> spheres;
+    for (int i = 0; i < 4; ++i)
+    {
+        Material *material = i == 0 ? new Material(nlohmann::json{{"material_id", 1000}}) : new Material();
+        spheres.push_back(new Sphere(0.1f, vec3(static_cast<float>(i), 0.0f, 0.0f), "Sphere", material));
+        sceneManager.addShape(spheres.back());
+    }
+    check(spheres[0]->getMaterial()->getMaterialId() == 1000, "material ID read from JSON");
+    check(spheres[0]->getMaterial()->getGPUIndex() != 1000, "slot differs from the material ID");
+
+    auto checkLookups = [&](const std::string &when)
+    {
+        std::vector<GPUMaterial> materials = materialArray(sceneManager);
+        for (Shape *shape : sceneManager.getShapes())
+        {
+            if (shape->getType() != SPHERE || !shape->getMaterial())
+                continue;
+            int index = static_cast<Sphere *>(shape)->toGPU().materialIndex;
+            check(index == shape->getMaterial()->getGPUIndex(), when + ": shape refers to its material's slot");
+            check(materialByIndex(index, materials) != nullptr, when + ": kernel finds the material of " + std::to_string(index));
+        }
+    };
+    checkLookups("after adding");
+
+    // A freed slot is reused by the next material, with yet another ID
+    sceneManager.deleteShape(spheres[1]);
+    int freedSlot = spheres[1]->getMaterial()->getGPUIndex();
+    check(freedSlot == -1, "removed material gives its slot back");
+    delete spheres[1];
+    Shape *replacement = new Sphere(0.1f, vec3(5.0f, 0.0f, 0.0f), "Sphere", new Material());
+    sceneManager.addShape(replacement);
+    check(replacement->getMaterial()->getGPUIndex() < sceneManager.getMaterialSlotCount(), "reused slot within the array");
+    check(replacement->getMaterial()->getGPUIndex() != replacement->getMaterial()->getMaterialId(), "reused slot differs from the ID");
+    checkLookups("after reusing a slot");
+
+    if (failures > 0)
+    {
+        std::cerr << failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "material slots: all checks passed" << std::endl;
+    return 0;
+}
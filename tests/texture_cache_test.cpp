@@ -0,0 +1,107 @@
+// Texture cache: a file edited on disk is loaded again instead of served stale, and the entry of a file
+// version is dropped once no map and no decoded pixels reference it anymore
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include "../src/core/utils/imageLoader/LazyImage.h"
+
+static int failures = 0;
+
+static void check(bool condition, const std::string &what)
+{
+    if (!condition)
+    {
+        std::cerr << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+// Binary PPM filled with one color
+static void writePPM(const std::string &path, int width, int height, unsigned char value)
+{
+    std::ofstream out(path, std::ios::binary);
+    out << "P6\n"
+        << width << " " << height << "\n255\n";
+    for (int i = 0; i < width * height * 3; ++i)
+        out.put(static_cast<char>(value));
+}
+
+int main()
+{
+    TextureCache &cache = TextureCache::getInstance();
+    std::string path = "texture_cache_test_" + std::to_string(getpid()) + ".ppm";
+    writePPM(path, 2, 2, 10);
+
+    {
+        LazyImage map;
+        check(map.setPath(path), "probe a valid file");
+        check(map.getWidth() == 2 && map.getHeight() == 2, "size read from the header");
+        check(cache.getEntryCount() == 1, "one entry while a map holds the file");
+
+        LazyImage copy = map;
+        check(!map.get().data.empty() && map.get().data[0].r == 10, "decoded pixels");
+        check(copy.getHandle() == map.getHandle(), "copies share the pixels");
+        check(cache.getDecodedCount() == 1, "one decoded file");
+
+        // Edit the file on disk: the old map keeps its version, a new map sees the edit
+        writePPM(path, 3, 1, 20);
+        LazyImage edited;
+        check(edited.setPath(path), "probe the edited file");
+        check(edited.getWidth() == 3 && edited.getHeight() == 1, "size of the edited file");
+        check(!edited.get().data.empty() && edited.get().data[0].r == 20, "pixels of the edited file, not the cached ones");
+        check(map.get().data[0].r == 10, "older map keeps its pixels");
+        check(cache.getEntryCount() == 2, "one entry per file version");
+
+        // The file changed on disk, so the old version could not be decoded again: release keeps its pixels
+        map.release();
+        copy.release();
+        check(map.isDecoded() && cache.getDecodedCount() == 2, "superseded pixels kept on release");
+        edited.release();
+        check(!edited.isDecoded() && cache.getDecodedCount() == 1, "pixels of the current version are freed");
+    }
+    check(cache.getEntryCount() == 0, "entries dropped once nothing references them");
+
+    // Pixels held without a map keep the entry, and a new map picks them up
+    ImageHandle pixels = cache.load(path);
+    check(pixels && pixels->w == 3, "load by path decodes the current version");
+    check(cache.getEntryCount() == 1, "decoded pixels keep their entry");
+    LazyImage map;
+    check(map.setPath(path) && map.getHandle() == pixels, "map shares the pixels decoded before");
+    map.clear();
+    pixels.reset();
+    check(cache.getEntryCount() == 0, "entry dropped with its last pixels");
+
+    // Released before the file is rewritten shorter in place: the old version can't be decoded anymore,
+    // its mapping would read the new bytes or pages past the end of the file
+    {
+        writePPM(path, 4, 4, 30);
+        LazyImage released;
+        check(released.setPath(path) && released.get().data[0].r == 30, "decode before the rewrite");
+        released.release();
+        check(!released.isDecoded(), "pixels of the current version are released");
+        writePPM(path, 1, 1, 40);
+        check(released.get().data.empty() && !released.getHandle(), "superseded version fails to decode");
+    }
+
+    // Released after the file was rewritten: the pixels of the superseded version are kept
+    {
+        LazyImage kept;
+        check(kept.setPath(path) && kept.get().data[0].r == 40, "decode the shorter file");
+        writePPM(path, 2, 2, 50);
+        kept.release();
+        check(kept.isDecoded() && kept.get().data[0].r == 40, "superseded pixels kept on release");
+        LazyImage current;
+        check(current.setPath(path) && current.get().data[0].r == 50, "new map decodes the rewritten file");
+    }
+    check(cache.getEntryCount() == 0, "entries dropped after the rewrites");
+
+    std::remove(path.c_str());
+    check(!cache.probe(path), "missing file fails to probe");
+    check(cache.getEntryCount() == 0, "failed probe leaves no entry");
+
+    if (failures == 0)
+        std::cout << "texture_cache_test passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}